@@ -0,0 +1,457 @@
+#include "caps_tracer.h"
+
+#define SIZE_NONE (-1) /* 没有 caps（没有过滤条件 / 查询失败） */
+#define SIZE_ANY (-2)  /* ANY caps */
+
+typedef enum
+{
+    OP_CAPS_QUERY,
+    OP_ACCEPT_CAPS,
+    OP_CAPS_EVENT,
+    OP_RECONFIGURE,
+    OP_FALLBACK, /* caps_tracer_query_caps() */
+    N_OPS,
+} CapsOp;
+
+static const gchar *op_names[N_OPS] = {"caps query", "accept-caps", "caps event", "reconfigure", "fallback"};
+
+/* 一个被追踪的 pad 的统计 */
+typedef struct _PadHook
+{
+    GstPad *pad;
+    gchar *name;                        /* 元素:pad */
+    GstCaps *last_caps;                 /* 上一次推送的 CAPS 事件中的 caps */
+    guint count[N_OPS];
+    GstClockTime time[N_OPS];           /* 累计耗时（包括嵌套的转发） */
+    GstClockTime max_time;              /* 最慢的一次 */
+    gint max_size;                      /* 见过的最大 caps（结构体个数） */
+    guint refused;                      /* 失败的查询 / 被拒绝的 caps */
+    guint renegotiations;
+} PadHook;
+
+/* 一条记录 */
+typedef struct _CapsRecord
+{
+    PadHook *hook;
+    CapsOp op;
+    guint depth;              /* 嵌套层数：在另一个查询/事件里面发生时大于 0 */
+    GstClockTime start;
+    GstClockTime duration;
+    gint in_size;             /* 过滤条件 / 事件中的 caps */
+    gint out_size;            /* 查询结果 */
+    gboolean ok;
+    gboolean renegotiation;
+} CapsRecord;
+
+/* 进行中的查询/事件：-pre 钩子压栈，-post 钩子出栈 */
+typedef struct _Frame
+{
+    GstPad *pad;
+    CapsTracer *ct;           /* 为 NULL（不在 pipeline 中 / 不需要记录的事件）时出栈后直接丢弃 */
+    PadHook *hook;
+    CapsOp op;
+    GstClockTime start;
+    gint in_size;
+    gboolean renegotiation;
+} Frame;
+
+struct _CapsTracer
+{
+    GstElement *pipeline;
+    GHashTable *pads;         /* GstPad* -> PadHook* */
+    GPtrArray *hooks;         /* PadHook*，按第一次出现的顺序 */
+    GArray *records;          /* CapsRecord，按完成的顺序 */
+    GstClockTime origin;      /* caps_tracer_new() 的时间 */
+    GstClockTime top_time[N_OPS]; /* 最外层调用的累计耗时（嵌套的不重复计算） */
+    guint top_count[N_OPS];
+};
+
+/**
+ * GStreamer 没有注销 tracer 钩子的接口，所以整个进程只创建一个 tracer 对象，
+ * 钩子通过 current 找到当前的 CapsTracer（没有时什么也不做）
+ */
+typedef struct _CapsHookTracer
+{
+    GstTracer parent;
+} CapsHookTracer;
+
+typedef struct _CapsHookTracerClass
+{
+    GstTracerClass parent_class;
+} CapsHookTracerClass;
+
+GType caps_hook_tracer_get_type(void);
+G_DEFINE_TYPE(CapsHookTracer, caps_hook_tracer, GST_TYPE_TRACER);
+
+static GMutex tracer_lock;    /* 保护 current 以及其中的 pads、hooks、records 和统计 */
+static CapsTracer *current;
+static GstTracer *hook_tracer;
+static GPrivate stack_key = G_PRIVATE_INIT((GDestroyNotify)g_array_unref); /* 当前线程的 Frame 栈 */
+
+static gint
+caps_size(const GstCaps *caps)
+{
+    if (caps == NULL)
+        return SIZE_NONE;
+    return gst_caps_is_any(caps) ? SIZE_ANY : (gint)gst_caps_get_size(caps);
+}
+
+static const gchar *
+format_size(gint size, gchar *buf, gsize len)
+{
+    if (size == SIZE_NONE)
+        return "-";
+    if (size == SIZE_ANY)
+        return "ANY";
+    g_snprintf(buf, len, "%d", size);
+    return buf;
+}
+
+static GArray *
+frame_stack(void)
+{
+    GArray *stack = g_private_get(&stack_key);
+
+    if (G_UNLIKELY(stack == NULL))
+    {
+        stack = g_array_sized_new(FALSE, FALSE, sizeof(Frame), 16);
+        g_private_set(&stack_key, stack);
+    }
+    return stack;
+}
+
+/* pipeline 中的 pad 第一次出现时创建统计，其他 pad 返回 NULL（调用时持有 tracer_lock） */
+static PadHook *
+pad_hook(CapsTracer *ct, GstPad *pad)
+{
+    PadHook *hook = g_hash_table_lookup(ct->pads, pad);
+
+    if (hook != NULL || !gst_object_has_as_ancestor(GST_OBJECT(pad), GST_OBJECT(ct->pipeline)))
+        return hook;
+    hook = g_new0(PadHook, 1);
+    hook->pad = gst_object_ref(pad);
+    hook->name = g_strdup_printf("%s:%s", GST_DEBUG_PAD_NAME(pad));
+    hook->max_size = SIZE_NONE;
+    g_hash_table_insert(ct->pads, pad, hook);
+    g_ptr_array_add(ct->hooks, hook);
+    return hook;
+}
+
+/* 开始一条记录；caps 不为 NULL 时是 CAPS 事件，同时判断是否为重新协商 */
+static void
+frame_push(GstPad *pad, CapsOp op, GstClockTime start, GstCaps *filter, GstCaps *caps)
+{
+    Frame frame = {pad, NULL, NULL, op, start, caps_size(caps != NULL ? caps : filter), FALSE};
+
+    if (op != N_OPS)
+    {
+        g_mutex_lock(&tracer_lock);
+        if (current != NULL && (frame.hook = pad_hook(current, pad)) != NULL)
+        {
+            frame.ct = current;
+            if (caps != NULL)
+            {
+                frame.renegotiation = frame.hook->last_caps != NULL && !gst_caps_is_equal(frame.hook->last_caps, caps);
+                gst_caps_replace(&frame.hook->last_caps, caps);
+            }
+        }
+        g_mutex_unlock(&tracer_lock);
+    }
+    g_array_append_val(frame_stack(), frame);
+}
+
+/* 结束 pad 上最近的一条记录，返回 FALSE 表示不需要记录 */
+static gboolean
+frame_pop(GstPad *pad, Frame *frame)
+{
+    GArray *stack = frame_stack();
+    guint i = stack->len;
+
+    // 正常情况下就是栈顶；找不到（例如追踪开始之前已经在进行中）时忽略
+    while (i > 0 && g_array_index(stack, Frame, i - 1).pad != pad)
+        i--;
+    if (i == 0)
+        return FALSE;
+    *frame = g_array_index(stack, Frame, i - 1);
+    g_array_set_size(stack, i - 1);
+    return frame->ct != NULL;
+}
+
+/* 嵌套层数：栈中需要记录的调用个数 */
+static guint
+frame_depth(void)
+{
+    GArray *stack = frame_stack();
+    guint i, depth = 0;
+
+    for (i = 0; i < stack->len; i++)
+        if (g_array_index(stack, Frame, i).ct != NULL)
+            depth++;
+    return depth;
+}
+
+static void
+record_end(const Frame *frame, GstClockTime end, gint out_size, gboolean ok)
+{
+    PadHook *hook = frame->hook;
+    CapsOp op = frame->op;
+    CapsRecord record = {hook, op, frame_depth(), frame->start, end - frame->start, frame->in_size, out_size, ok, frame->renegotiation};
+
+    g_mutex_lock(&tracer_lock);
+    // 记录开始之后 CapsTracer 已经被释放
+    if (current != frame->ct)
+    {
+        g_mutex_unlock(&tracer_lock);
+        return;
+    }
+    g_array_append_val(current->records, record);
+    hook->count[op]++;
+    hook->time[op] += record.duration;
+    hook->max_time = MAX(hook->max_time, record.duration);
+    hook->max_size = MAX(hook->max_size, MAX(record.in_size, out_size));
+    if (!ok)
+        hook->refused++;
+    if (record.renegotiation)
+        hook->renegotiations++;
+    if (record.depth == 0)
+    {
+        current->top_time[op] += record.duration;
+        current->top_count[op]++;
+    }
+    g_mutex_unlock(&tracer_lock);
+}
+
+/* pad-query-pre/post：只记录 CAPS 和 ACCEPT_CAPS，失败的查询同样会调用 post 钩子 */
+static void
+do_query_pre(GObject *self, GstClockTime ts, GstPad *pad, GstQuery *query)
+{
+    GstCaps *caps = NULL;
+
+    switch (GST_QUERY_TYPE(query))
+    {
+    case GST_QUERY_CAPS:
+        gst_query_parse_caps(query, &caps);
+        frame_push(pad, OP_CAPS_QUERY, ts, caps, NULL);
+        break;
+    case GST_QUERY_ACCEPT_CAPS:
+        gst_query_parse_accept_caps(query, &caps);
+        frame_push(pad, OP_ACCEPT_CAPS, ts, caps, NULL);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+do_query_post(GObject *self, GstClockTime ts, GstPad *pad, GstQuery *query, gboolean res)
+{
+    GstCaps *caps = NULL;
+    gboolean accepted = FALSE;
+    Frame frame;
+
+    if (GST_QUERY_TYPE(query) != GST_QUERY_CAPS && GST_QUERY_TYPE(query) != GST_QUERY_ACCEPT_CAPS)
+        return;
+    if (!frame_pop(pad, &frame))
+        return;
+    if (frame.op == OP_CAPS_QUERY)
+    {
+        if (res)
+            gst_query_parse_caps_result(query, &caps);
+        record_end(&frame, ts, caps_size(caps), res);
+    }
+    else
+    {
+        if (res)
+            gst_query_parse_accept_caps_result(query, &accepted);
+        record_end(&frame, ts, SIZE_NONE, res && accepted);
+    }
+}
+
+/* pad-push-event-pre/post：post 钩子拿不到事件，所以每个事件都要压栈，不需要记录的 op 为 N_OPS */
+static void
+do_push_event_pre(GObject *self, GstClockTime ts, GstPad *pad, GstEvent *event)
+{
+    GstCaps *caps;
+
+    switch (GST_EVENT_TYPE(event))
+    {
+    case GST_EVENT_CAPS:
+        gst_event_parse_caps(event, &caps);
+        frame_push(pad, OP_CAPS_EVENT, ts, NULL, caps);
+        break;
+    case GST_EVENT_RECONFIGURE:
+        frame_push(pad, OP_RECONFIGURE, ts, NULL, NULL);
+        break;
+    default:
+        frame_push(pad, N_OPS, ts, NULL, NULL);
+        break;
+    }
+}
+
+static void
+do_push_event_post(GObject *self, GstClockTime ts, GstPad *pad, gboolean res)
+{
+    Frame frame;
+
+    if (frame_pop(pad, &frame))
+        record_end(&frame, ts, SIZE_NONE, res);
+}
+
+static void
+caps_hook_tracer_class_init(CapsHookTracerClass *klass)
+{
+}
+
+static void
+caps_hook_tracer_init(CapsHookTracer *self)
+{
+    GstTracer *tracer = GST_TRACER(self);
+
+    gst_tracing_register_hook(tracer, "pad-query-pre", G_CALLBACK(do_query_pre));
+    gst_tracing_register_hook(tracer, "pad-query-post", G_CALLBACK(do_query_post));
+    gst_tracing_register_hook(tracer, "pad-push-event-pre", G_CALLBACK(do_push_event_pre));
+    gst_tracing_register_hook(tracer, "pad-push-event-post", G_CALLBACK(do_push_event_post));
+}
+
+static void
+pad_hook_free(PadHook *hook)
+{
+    gst_object_unref(hook->pad);
+    gst_caps_replace(&hook->last_caps, NULL);
+    g_free(hook->name);
+    g_free(hook);
+}
+
+CapsTracer *
+caps_tracer_new(GstElement *pipeline)
+{
+    CapsTracer *ct = g_new0(CapsTracer, 1);
+
+    ct->pipeline = gst_object_ref(pipeline);
+    ct->pads = g_hash_table_new(NULL, NULL);
+    ct->hooks = g_ptr_array_new_with_free_func((GDestroyNotify)pad_hook_free);
+    ct->records = g_array_new(FALSE, FALSE, sizeof(CapsRecord));
+    ct->origin = gst_util_get_timestamp();
+
+    g_mutex_lock(&tracer_lock);
+    g_warn_if_fail(current == NULL);
+    if (hook_tracer == NULL)
+        hook_tracer = gst_object_ref_sink(g_object_new(caps_hook_tracer_get_type(), NULL));
+    current = ct;
+    g_mutex_unlock(&tracer_lock);
+    return ct;
+}
+
+GstCaps *
+caps_tracer_query_caps(CapsTracer *ct, GstPad *pad, GstCaps *filter)
+{
+    GstCaps *caps;
+    Frame frame;
+
+    frame_push(pad, OP_FALLBACK, gst_util_get_timestamp(), filter, NULL);
+    caps = gst_pad_query_caps(pad, filter);
+    if (frame_pop(pad, &frame))
+        record_end(&frame, gst_util_get_timestamp(), caps_size(caps), !gst_caps_is_empty(caps));
+    return caps;
+}
+
+static gint
+compare_start(gconstpointer a, gconstpointer b)
+{
+    const CapsRecord *ra = a, *rb = b;
+
+    return ra->start < rb->start ? -1 : ra->start > rb->start;
+}
+
+void
+caps_tracer_print_log(CapsTracer *ct)
+{
+    GArray *sorted;
+    gchar in[16], out[16];
+    guint i;
+
+    // 记录是在完成时加入的（嵌套的查询先完成），按开始时间排序后才能看出调用关系
+    g_mutex_lock(&tracer_lock);
+    sorted = g_array_sized_new(FALSE, FALSE, sizeof(CapsRecord), ct->records->len);
+    g_array_append_vals(sorted, ct->records->data, ct->records->len);
+    g_mutex_unlock(&tracer_lock);
+    g_array_sort(sorted, compare_start);
+
+    g_print("%10s %10s  %-40s %6s %6s\n", "t(ms)", "took(us)", "operation / pad", "in", "out");
+    for (i = 0; i < sorted->len; i++)
+    {
+        CapsRecord *r = &g_array_index(sorted, CapsRecord, i);
+        gchar *what = g_strdup_printf("%*s%s %s", r->depth * 2, "", op_names[r->op], r->hook->name);
+
+        g_print("%10.3f %10.1f  %-40s %6s %6s %s%s\n", (r->start - ct->origin) / 1e6, r->duration / 1e3, what,
+                format_size(r->in_size, in, sizeof(in)), format_size(r->out_size, out, sizeof(out)),
+                r->ok ? "ok" : r->op == OP_ACCEPT_CAPS ? "refused" : "failed",
+                r->renegotiation ? " renegotiation" : "");
+        g_free(what);
+    }
+    g_array_free(sorted, TRUE);
+}
+
+void
+caps_tracer_print_summary(CapsTracer *ct)
+{
+    const PadHook *largest = NULL;
+    GstClockTime total = 0;
+    guint i, op, renegotiations = 0;
+    gchar size[16];
+
+    g_mutex_lock(&tracer_lock);
+    g_print("%-28s %-28s %7s %10s %7s %7s %6s %6s %8s %9s %8s\n", "pad", "peer", "caps-q", "caps(us)", "accept",
+            "events", "reneg", "refuse", "fallback", "max(us)", "max caps");
+    for (i = 0; i < ct->hooks->len; i++)
+    {
+        const PadHook *hook = g_ptr_array_index(ct->hooks, i);
+        GstPad *peer = gst_pad_get_peer(hook->pad);
+        gchar *peer_name = peer ? g_strdup_printf("%s:%s", GST_DEBUG_PAD_NAME(peer)) : g_strdup("-");
+        guint calls = 0;
+
+        for (op = 0; op < N_OPS; op++)
+            calls += hook->count[op];
+        // 没有发生过协商的 pad（例如还没有链接的 request pad）不打印
+        if (calls > 0)
+            g_print("%-28s %-28s %7u %10.1f %7u %7u %6u %6u %8u %9.1f %8s\n", hook->name, peer_name,
+                    hook->count[OP_CAPS_QUERY], hook->time[OP_CAPS_QUERY] / 1e3, hook->count[OP_ACCEPT_CAPS],
+                    hook->count[OP_CAPS_EVENT] + hook->count[OP_RECONFIGURE], hook->renegotiations, hook->refused,
+                    hook->count[OP_FALLBACK], hook->max_time / 1e3, format_size(hook->max_size, size, sizeof(size)));
+        if (largest == NULL || hook->max_size > largest->max_size)
+            largest = hook;
+        renegotiations += hook->renegotiations;
+        g_free(peer_name);
+        if (peer != NULL)
+            gst_object_unref(peer);
+    }
+
+    // 嵌套的查询已经包含在外层调用的耗时里，总计只累加最外层的调用
+    g_print("Totals (outermost calls only):\n");
+    for (op = 0; op < N_OPS; op++)
+    {
+        g_print("  %-12s %6u calls %10.3f ms\n", op_names[op], ct->top_count[op], ct->top_time[op] / 1e6);
+        total += ct->top_time[op];
+    }
+    g_print("  negotiation  %10.3f ms, %u renegotiation(s)", total / 1e6, renegotiations);
+    if (largest != NULL && largest->max_size > 0)
+        g_print(", largest caps %d structures on %s", largest->max_size, largest->name);
+    g_print("\n");
+    g_mutex_unlock(&tracer_lock);
+}
+
+void
+caps_tracer_free(CapsTracer *ct)
+{
+    // 之后钩子不再访问 ct，进行中的调用在 record_end() 中丢弃
+    g_mutex_lock(&tracer_lock);
+    if (current == ct)
+        current = NULL;
+    g_mutex_unlock(&tracer_lock);
+
+    g_hash_table_destroy(ct->pads);
+    g_ptr_array_free(ct->hooks, TRUE);
+    g_array_free(ct->records, TRUE);
+    gst_object_unref(ct->pipeline);
+    g_free(ct);
+}
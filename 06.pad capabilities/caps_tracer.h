@@ -0,0 +1,34 @@
+#ifndef CAPS_TRACER_H
+#define CAPS_TRACER_H
+
+#include <gst/gst.h>
+
+/**
+ * Caps 协商耗时追踪
+ *
+ * 记录 pipeline 中每个 pad 上的：
+ * - CAPS 查询（gst_pad_query_caps / 链接时的交集计算）
+ * - ACCEPT_CAPS 查询（gst_pad_query_accept_caps，是否被拒绝）
+ * - CAPS 事件（协商结果，推送与上一次不同的 caps 就是重新协商）
+ * - RECONFIGURE 事件（下游要求上游重新协商）
+ * 每一项记录耗时（包括嵌套转发给对端的时间）、caps 的结构体个数（交集的规模）和结果。
+ *
+ * 探针看不到失败的查询（查询函数返回 FALSE 时不会调用查询后的探针），
+ * 所以这里用 tracer 钩子（pad-query-pre/post、pad-push-event-pre/post）计时，失败时同样会调用 post 钩子，
+ * 也不需要修改 pad。事件在推送的一方（CAPS 事件为 src pad）记录。
+ */
+
+typedef struct _CapsTracer CapsTracer;
+
+/* 追踪 pipeline 中（包括之后加入的元素）所有的 pad（应在链接元素之前调用，链接本身就会触发 CAPS 查询）；同一时间只能有一个 */
+CapsTracer *caps_tracer_new(GstElement *pipeline);
+/* 代替 gst_pad_query_caps()：pad 还没有协商好的 caps 时调用，记为一次回退查询 */
+GstCaps *caps_tracer_query_caps(CapsTracer *ct, GstPad *pad, GstCaps *filter);
+/* 按开始时间打印每一条记录，嵌套的查询缩进显示 */
+void caps_tracer_print_log(CapsTracer *ct);
+/* 打印每个 pad 的汇总和总计 */
+void caps_tracer_print_summary(CapsTracer *ct);
+/* 停止追踪并释放（应在 pipeline 切换到 NULL 之后调用） */
+void caps_tracer_free(CapsTracer *ct);
+
+#endif /* CAPS_TRACER_H */
@@ -1,5 +1,7 @@
 #include <gst/gst.h>
 
+#include "caps_tracer.h"
+
 /**
  * 重新梳理并总结一下概念：
  *
@@ -197,7 +199,7 @@ print_pad_templates_information(GstElementFactory *factory)
             channels: 2
  */
 static void
-print_pad_capabilities(GstElement *element, gchar *pad_name)
+print_pad_capabilities(GstElement *element, gchar *pad_name, CapsTracer *tracer)
 {
     GstPad *pad = NULL;
     GstCaps *caps = NULL;
@@ -215,7 +217,10 @@ print_pad_capabilities(GstElement *element, gchar *pad_name)
     /* 获取pad当前的caps能力 */
     caps = gst_pad_get_current_caps(pad);
     if (!caps)
-        caps = gst_pad_query_caps(pad, NULL);
+    {
+        /* 还没有协商好，只能查询 pad 可以接受的所有 caps（追踪时记为一次回退查询） */
+        caps = tracer ? caps_tracer_query_caps(tracer, pad, NULL) : gst_pad_query_caps(pad, NULL);
+    }
 
     /* Print and free */
     g_print("Caps for the %s pad:\n", pad_name);
@@ -232,9 +237,27 @@ int main(int argc, char *argv[])
     GstMessage *msg;
     GstStateChangeReturn ret;
     gboolean terminate = FALSE;
+    GOptionContext *context;
+    GError *error = NULL;
+    CapsTracer *tracer = NULL;
+    gboolean trace_caps = FALSE, trace_caps_log = FALSE;
+    GOptionEntry entries[] = {
+        {"trace-caps", 0, 0, G_OPTION_ARG_NONE, &trace_caps, "Time every CAPS/ACCEPT_CAPS query and CAPS event and print a per-pad summary", NULL},
+        {"trace-caps-log", 0, 0, G_OPTION_ARG_NONE, &trace_caps_log, "Also print every traced call in order (implies --trace-caps)", NULL},
+        {NULL}};
 
     /* Initialize GStreamer */
-    gst_init(&argc, &argv);
+    context = g_option_context_new("- pad capabilities");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    trace_caps = trace_caps || trace_caps_log;
 
     /* Create the element factories */
     source_factory = gst_element_factory_find("audiotestsrc");
@@ -288,9 +311,19 @@ int main(int argc, char *argv[])
 
     /* Build the pipeline */
     gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
+    /* 在链接之前开始追踪：gst_element_link() 本身就要查询两边的 caps 求交集 */
+    if (trace_caps)
+        tracer = caps_tracer_new(pipeline);
     if (gst_element_link(source, sink) != TRUE)
     {
         g_printerr("Elements could not be linked.\n");
+        if (tracer)
+        {
+            /* 链接失败时追踪结果最有用：可以看到是哪一次查询返回了空的交集 */
+            caps_tracer_print_log(tracer);
+            caps_tracer_print_summary(tracer);
+            caps_tracer_free(tracer);
+        }
         gst_object_unref(pipeline);
         return -1;
     }
@@ -303,7 +336,7 @@ int main(int argc, char *argv[])
         Caps for the sink pad:
          ANY
      */
-    print_pad_capabilities(sink, "sink");
+    print_pad_capabilities(sink, "sink", tracer);
 
     /* Start playing */
     ret = gst_element_set_state(pipeline, GST_STATE_PLAYING);
@@ -357,7 +390,7 @@ int main(int argc, char *argv[])
                                 channels: 2
                                 channel-mask: 0x0000000000000003
                      */
-                    print_pad_capabilities(sink, "sink");
+                    print_pad_capabilities(sink, "sink", tracer);
 
                     /**
                      * 打印输出结果：
@@ -369,7 +402,16 @@ int main(int argc, char *argv[])
                                 channels: 2
                                 channel-mask: 0x0000000000000003
                      */
-                    print_pad_capabilities(source, "src");
+                    print_pad_capabilities(source, "src", tracer);
+
+                    /* 进入 PLAYING 时协商已经完成，打印追踪结果 */
+                    if (tracer && new_state == GST_STATE_PLAYING)
+                    {
+                        g_print("\nCaps negotiation trace:\n");
+                        if (trace_caps_log)
+                            caps_tracer_print_log(tracer);
+                        caps_tracer_print_summary(tracer);
+                    }
                 }
                 break;
             default:
@@ -384,6 +426,8 @@ int main(int argc, char *argv[])
     /* Free resources */
     gst_object_unref(bus);
     gst_element_set_state(pipeline, GST_STATE_NULL);
+    if (tracer)
+        caps_tracer_free(tracer);
     gst_object_unref(pipeline);
     gst_object_unref(source_factory);
     gst_object_unref(sink_factory);
@@ -0,0 +1,442 @@
+#include "branch_manager.h"
+
+#define SETTLE_MS 500                 /* 操作完成后继续观察原有分支的时间（毫秒） */
+#define PTS_TOLERANCE (GST_MSECOND)   /* 时间戳间隙小于此值不算丢帧 */
+
+typedef enum
+{
+    OP_NONE,
+    OP_ADD,
+    OP_REMOVE,
+} OpType;
+
+/* 一个被监视的原有分支 */
+typedef struct _Watch
+{
+    BranchManager *bm;
+    gchar *label;
+    GstPad *pad;            /* 分支末端 sink 的 sink pad */
+    gulong probe_id;
+    /* 以下字段由流线程写入，用 bm->lock 保护 */
+    gint64 last_arrival;    /* 上一个 buffer 的到达时间（微秒） */
+    gint64 nominal_gap;     /* 没有操作时的平均到达间隔（指数滑动平均） */
+    GstClockTime next_pts;  /* 下一个 buffer 期望的时间戳 */
+    gint64 window_max_gap;  /* 当前操作期间的最大到达间隔 */
+    guint64 window_dropped; /* 当前操作期间的丢帧数 */
+    /* 汇总，只在主线程读写 */
+    gint64 worst_added;     /* 所有操作中最大的额外延迟 */
+    guint64 total_dropped;  /* 所有操作期间的丢帧总数 */
+} Watch;
+
+/* 一个动态添加的分支 */
+typedef struct _Branch
+{
+    BranchManager *bm;
+    gchar *name;
+    GstElement *bin;  /* queue + sink 组成的 bin，sink pad 为 ghost pad */
+    GstPad *tee_pad;  /* 向 tee 申请的 src pad */
+    GstPad *sink_pad; /* 分支末端 sink 的 sink pad（第一个 buffer / EOS 探针） */
+    gint removing;    /* IDLE 回调是否已经执行（原子操作） */
+} Branch;
+
+struct _BranchManager
+{
+    GstElement *pipeline;
+    GstElement *tee;
+    GPtrArray *watches; /* Watch* */
+    GList *branches;    /* Branch*，按添加顺序 */
+    guint next_id;
+    GMutex lock;
+    /* 当前操作（同一时刻只允许一个） */
+    OpType op;
+    gchar *op_name;
+    gint64 op_start;  /* 开始时间 */
+    gint64 op_linked; /* 添加：链接到 tee 的时间；删除：从 tee 断开的时间 */
+    gint64 op_done;   /* 添加：第一个 buffer 到达新分支；删除：EOS 到达分支末端 */
+    guint settle_id;
+    guint ops;
+};
+
+/* 原有分支的 buffer 探针：记录到达间隔和时间戳间隙 */
+static GstPadProbeReturn
+watch_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Watch *w = user_data;
+    BranchManager *bm = w->bm;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now = g_get_monotonic_time();
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+
+    g_mutex_lock(&bm->lock);
+    if (w->last_arrival != 0)
+    {
+        gint64 gap = now - w->last_arrival;
+
+        if (bm->op != OP_NONE)
+            w->window_max_gap = MAX(w->window_max_gap, gap);
+        else
+            w->nominal_gap = w->nominal_gap ? (w->nominal_gap * 7 + gap) / 8 : gap;
+    }
+    w->last_arrival = now;
+
+    if (GST_CLOCK_TIME_IS_VALID(pts))
+    {
+        // 时间戳跳过了一段：按这个 buffer 的时长换算成丢失的 buffer 数
+        if (bm->op != OP_NONE && GST_CLOCK_TIME_IS_VALID(w->next_pts) && pts > w->next_pts + PTS_TOLERANCE &&
+            GST_BUFFER_DURATION_IS_VALID(buffer) && GST_BUFFER_DURATION(buffer) > 0)
+            w->window_dropped += (pts - w->next_pts + GST_BUFFER_DURATION(buffer) / 2) / GST_BUFFER_DURATION(buffer);
+        w->next_pts = GST_BUFFER_DURATION_IS_VALID(buffer) ? pts + GST_BUFFER_DURATION(buffer) : GST_CLOCK_TIME_NONE;
+    }
+    g_mutex_unlock(&bm->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+BranchManager *
+branch_manager_new(GstElement *pipeline, GstElement *tee)
+{
+    BranchManager *bm = g_new0(BranchManager, 1);
+
+    bm->pipeline = gst_object_ref(pipeline);
+    bm->tee = gst_object_ref(tee);
+    bm->watches = g_ptr_array_new();
+    g_mutex_init(&bm->lock);
+    return bm;
+}
+
+void
+branch_manager_watch(BranchManager *bm, GstElement *sink, const gchar *label)
+{
+    Watch *w = g_new0(Watch, 1);
+
+    w->bm = bm;
+    w->label = g_strdup(label);
+    w->pad = gst_element_get_static_pad(sink, "sink");
+    w->next_pts = GST_CLOCK_TIME_NONE;
+    w->probe_id = gst_pad_add_probe(w->pad, GST_PAD_PROBE_TYPE_BUFFER, watch_probe, w, NULL);
+    g_ptr_array_add(bm->watches, w);
+}
+
+/* 开始一次操作：清空各个原有分支本次操作的统计 */
+static void
+op_begin(BranchManager *bm, OpType op, const gchar *name)
+{
+    guint i;
+
+    g_mutex_lock(&bm->lock);
+    for (i = 0; i < bm->watches->len; i++)
+    {
+        Watch *w = g_ptr_array_index(bm->watches, i);
+
+        w->window_max_gap = 0;
+        w->window_dropped = 0;
+    }
+    bm->op = op;
+    g_free(bm->op_name);
+    bm->op_name = g_strdup(name);
+    bm->op_start = g_get_monotonic_time();
+    bm->op_linked = 0;
+    bm->op_done = 0;
+    g_mutex_unlock(&bm->lock);
+}
+
+/* 观察期结束：打印本次操作对原有分支的影响 */
+static gboolean
+op_report(gpointer user_data)
+{
+    BranchManager *bm = user_data;
+    guint i;
+
+    g_mutex_lock(&bm->lock);
+    g_print("[branch] %s %s: %s after %.2f ms, done after %.2f ms\n",
+            bm->op == OP_ADD ? "add" : "remove", bm->op_name,
+            bm->op == OP_ADD ? "linked" : "unlinked",
+            (bm->op_linked - bm->op_start) / 1000.0, (bm->op_done - bm->op_start) / 1000.0);
+    for (i = 0; i < bm->watches->len; i++)
+    {
+        Watch *w = g_ptr_array_index(bm->watches, i);
+        // 额外延迟：操作期间最大的到达间隔超出平时间隔的部分
+        gint64 added = MAX(0, w->window_max_gap - w->nominal_gap);
+
+        g_print("    %-8s max gap %.2f ms (nominal %.2f ms, +%.2f ms), %" G_GUINT64_FORMAT " dropped\n",
+                w->label, w->window_max_gap / 1000.0, w->nominal_gap / 1000.0, added / 1000.0, w->window_dropped);
+        w->worst_added = MAX(w->worst_added, added);
+        w->total_dropped += w->window_dropped;
+    }
+    bm->op = OP_NONE;
+    bm->ops++;
+    g_mutex_unlock(&bm->lock);
+
+    bm->settle_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/* 操作完成（主线程）：再观察 SETTLE_MS 毫秒，捕捉操作之后才出现的卡顿 */
+static void
+op_finish(BranchManager *bm)
+{
+    bm->settle_id = g_timeout_add(SETTLE_MS, op_report, bm);
+}
+
+static void
+branch_free(Branch *br)
+{
+    if (br->tee_pad)
+        gst_object_unref(br->tee_pad);
+    if (br->sink_pad)
+        gst_object_unref(br->sink_pad);
+    gst_object_unref(br->bin);
+    g_free(br->name);
+    g_free(br);
+}
+
+static gboolean
+add_done(gpointer user_data)
+{
+    op_finish(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+/* 新分支的第一个 buffer 到达 sink：添加操作完成 */
+static GstPadProbeReturn
+first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Branch *br = user_data;
+
+    g_mutex_lock(&br->bm->lock);
+    br->bm->op_done = g_get_monotonic_time();
+    g_mutex_unlock(&br->bm->lock);
+    g_idle_add(add_done, br->bm);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean
+branch_manager_add(BranchManager *bm, BranchKind kind)
+{
+    Branch *br;
+    gchar *desc;
+    GError *error = NULL;
+    GstElement *sink;
+    GstPad *bin_pad;
+
+    if (bm->op != OP_NONE)
+    {
+        g_printerr("Previous branch operation is still in progress.\n");
+        return FALSE;
+    }
+
+    br = g_new0(Branch, 1);
+    br->bm = bm;
+    br->name = g_strdup_printf("%s_%u", kind == BRANCH_RECORDER ? "recorder" : "analyzer", ++bm->next_id);
+    // async=false：新 sink 不需要 preroll，加入时不会让整个 pipeline 重新进入 PAUSED
+    if (kind == BRANCH_RECORDER)
+        desc = g_strdup_printf("queue ! audioconvert ! wavenc ! filesink name=sink async=false location=%s.wav", br->name);
+    else
+        desc = g_strdup("queue ! audioconvert ! level post-messages=false ! fakesink name=sink sync=false async=false");
+    br->bin = gst_parse_bin_from_description(desc, TRUE, &error);
+    g_free(desc);
+    if (br->bin == NULL)
+    {
+        g_printerr("Could not create branch %s: %s\n", br->name, error->message);
+        g_clear_error(&error);
+        g_free(br->name);
+        g_free(br);
+        return FALSE;
+    }
+    gst_object_ref_sink(br->bin);
+    gst_element_set_name(br->bin, br->name);
+    sink = gst_bin_get_by_name(GST_BIN(br->bin), "sink");
+    br->sink_pad = gst_element_get_static_pad(sink, "sink");
+    gst_object_unref(sink);
+    gst_pad_add_probe(br->sink_pad, GST_PAD_PROBE_TYPE_BUFFER, first_buffer_probe, br, NULL);
+
+    op_begin(bm, OP_ADD, br->name);
+
+    /**
+     * 先让新分支进入 PLAYING，再链接到 tee：
+     * 如果先链接，tee 可能向一个还没有激活的 pad 推数据，得到 FLUSHING 而让整个 pipeline 停止
+     */
+    gst_bin_add(GST_BIN(bm->pipeline), br->bin);
+    gst_element_sync_state_with_parent(br->bin);
+    br->tee_pad = gst_element_request_pad_simple(bm->tee, "src_%u");
+    bin_pad = gst_element_get_static_pad(br->bin, "sink");
+    if (gst_pad_link(br->tee_pad, bin_pad) != GST_PAD_LINK_OK)
+    {
+        g_printerr("Branch %s could not be linked to the tee.\n", br->name);
+        gst_object_unref(bin_pad);
+        gst_element_release_request_pad(bm->tee, br->tee_pad);
+        gst_element_set_state(br->bin, GST_STATE_NULL);
+        gst_bin_remove(GST_BIN(bm->pipeline), br->bin);
+        branch_free(br);
+        g_mutex_lock(&bm->lock);
+        bm->op = OP_NONE;
+        g_mutex_unlock(&bm->lock);
+        return FALSE;
+    }
+    gst_object_unref(bin_pad);
+
+    g_mutex_lock(&bm->lock);
+    bm->op_linked = g_get_monotonic_time();
+    g_mutex_unlock(&bm->lock);
+    bm->branches = g_list_append(bm->branches, br);
+    g_print("Added branch %s on %s\n", br->name, GST_PAD_NAME(br->tee_pad));
+    return TRUE;
+}
+
+/* 分支已经排空（主线程）：停止并移出 pipeline */
+static gboolean
+remove_done(gpointer user_data)
+{
+    Branch *br = user_data;
+    BranchManager *bm = br->bm;
+
+    gst_element_set_state(br->bin, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(bm->pipeline), br->bin);
+    g_print("Removed branch %s\n", br->name);
+    branch_free(br);
+    op_finish(bm);
+    return G_SOURCE_REMOVE;
+}
+
+/* 分支末端的事件探针：EOS 到达说明分支里的数据已经全部处理完 */
+static GstPadProbeReturn
+eos_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Branch *br = user_data;
+
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS)
+        return GST_PAD_PROBE_OK;
+
+    g_mutex_lock(&br->bm->lock);
+    br->bm->op_done = g_get_monotonic_time();
+    g_mutex_unlock(&br->bm->lock);
+    // 不能在流线程里改变自己所在元素的状态，回到主线程处理
+    g_idle_add(remove_done, br);
+    // 丢弃 EOS：否则 sink 会向总线发送 EOS 消息
+    return GST_PAD_PROBE_DROP;
+}
+
+/**
+ * tee.src_N 空闲时调用（tee 没有在向这个 pad 推数据）
+ *
+ * 如果添加探针时 pad 已经空闲，会在调用 gst_pad_add_probe() 的线程中立即执行，
+ * 否则在 tee 的流线程中、本次推送结束之后执行。其他分支只会在这一次推送中多等待断开链接的时间。
+ */
+static GstPadProbeReturn
+unlink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Branch *br = user_data;
+    GstPad *bin_pad;
+
+    // IDLE 探针可能被调用不止一次，只处理第一次
+    if (!g_atomic_int_compare_and_exchange(&br->removing, FALSE, TRUE))
+        return GST_PAD_PROBE_OK;
+
+    bin_pad = gst_element_get_static_pad(br->bin, "sink");
+    gst_pad_unlink(br->tee_pad, bin_pad);
+    gst_element_release_request_pad(br->bm->tee, br->tee_pad);
+    g_mutex_lock(&br->bm->lock);
+    br->bm->op_linked = g_get_monotonic_time();
+    g_mutex_unlock(&br->bm->lock);
+
+    // EOS 经过 queue 流到分支末端，录音分支的 wavenc 在收到 EOS 时回写 WAV 文件头
+    gst_pad_send_event(bin_pad, gst_event_new_eos());
+    gst_object_unref(bin_pad);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean
+branch_manager_remove(BranchManager *bm, const gchar *name)
+{
+    Branch *br = NULL;
+    GList *l;
+
+    if (bm->op != OP_NONE)
+    {
+        g_printerr("Previous branch operation is still in progress.\n");
+        return FALSE;
+    }
+    if (name == NULL)
+    {
+        l = g_list_last(bm->branches);
+        br = l ? l->data : NULL;
+    }
+    for (l = bm->branches; name != NULL && l != NULL; l = l->next)
+    {
+        if (g_strcmp0(((Branch *)l->data)->name, name) == 0)
+            br = l->data;
+    }
+    if (br == NULL)
+    {
+        g_printerr("No branch to remove.\n");
+        return FALSE;
+    }
+
+    op_begin(bm, OP_REMOVE, br->name);
+    bm->branches = g_list_remove(bm->branches, br);
+    gst_pad_add_probe(br->sink_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, eos_probe, br, NULL);
+    gst_pad_add_probe(br->tee_pad, GST_PAD_PROBE_TYPE_IDLE, unlink_probe, br, NULL);
+    return TRUE;
+}
+
+guint
+branch_manager_count(BranchManager *bm)
+{
+    return g_list_length(bm->branches);
+}
+
+void
+branch_manager_list(BranchManager *bm)
+{
+    GList *l;
+
+    g_print("%u dynamic branch(es)\n", branch_manager_count(bm));
+    for (l = bm->branches; l != NULL; l = l->next)
+    {
+        Branch *br = l->data;
+
+        g_print("    %s on %s\n", br->name, GST_PAD_NAME(br->tee_pad));
+    }
+}
+
+void
+branch_manager_print_summary(BranchManager *bm)
+{
+    guint i;
+
+    g_mutex_lock(&bm->lock);
+    g_print("Branch operations: %u\n", bm->ops);
+    for (i = 0; i < bm->watches->len; i++)
+    {
+        Watch *w = g_ptr_array_index(bm->watches, i);
+
+        g_print("    %-8s worst added latency %.2f ms, %" G_GUINT64_FORMAT " dropped during operations\n",
+                w->label, w->worst_added / 1000.0, w->total_dropped);
+    }
+    g_mutex_unlock(&bm->lock);
+}
+
+void
+branch_manager_free(BranchManager *bm)
+{
+    guint i;
+
+    if (bm->settle_id)
+        g_source_remove(bm->settle_id);
+    for (i = 0; i < bm->watches->len; i++)
+    {
+        Watch *w = g_ptr_array_index(bm->watches, i);
+
+        gst_pad_remove_probe(w->pad, w->probe_id);
+        gst_object_unref(w->pad);
+        g_free(w->label);
+        g_free(w);
+    }
+    g_ptr_array_free(bm->watches, TRUE);
+    // 剩余的分支仍在 pipeline 中，随 pipeline 一起释放
+    g_list_free_full(bm->branches, (GDestroyNotify)branch_free);
+    g_mutex_clear(&bm->lock);
+    gst_object_unref(bm->tee);
+    gst_object_unref(bm->pipeline);
+    g_free(bm->op_name);
+    g_free(bm);
+}
@@ -0,0 +1,42 @@
+#ifndef BRANCH_MANAGER_H
+#define BRANCH_MANAGER_H
+
+#include <gst/gst.h>
+
+/**
+ * tee 分支的热插拔（pipeline 保持 PLAYING）
+ *
+ * 添加：新建 queue + sink 组成的 bin，同步到 pipeline 的状态后再向 tee 申请 src pad 并链接。
+ * 删除：在 tee 的 src pad 上加 IDLE 探针，等 tee 没有在向这个 pad 推数据时：
+ *     断开链接 -> 释放 request pad -> 向分支发送 EOS
+ * EOS 流到分支的 sink 后（录音分支此时已经写好文件头），回到主线程把 bin 设为 NULL 并移出 pipeline。
+ *
+ * 每次操作期间，在原有分支（branch_manager_watch）的 sink pad 上测量：
+ * - buffer 到达间隔的最大值与平时间隔之差（操作带来的额外延迟）
+ * - 时间戳不连续导致的丢帧数
+ * 所有函数都必须在主线程（GMainLoop 所在线程）调用。
+ */
+
+typedef enum
+{
+    BRANCH_ANALYZER, /* queue -> audioconvert -> level -> fakesink */
+    BRANCH_RECORDER, /* queue -> audioconvert -> wavenc -> filesink（<分支名>.wav） */
+} BranchKind;
+
+typedef struct _BranchManager BranchManager;
+
+BranchManager *branch_manager_new(GstElement *pipeline, GstElement *tee);
+/* 监视一个原有分支：sink 为分支末端的元素，label 为报告中的名字（必须在 PLAYING 之前调用） */
+void branch_manager_watch(BranchManager *bm, GstElement *sink, const gchar *label);
+/* 添加一个分支；上一次操作还没有完成时返回 FALSE */
+gboolean branch_manager_add(BranchManager *bm, BranchKind kind);
+/* 删除一个分支，name 为 NULL 时删除最后添加的分支；没有可删除的分支或上一次操作还没有完成时返回 FALSE */
+gboolean branch_manager_remove(BranchManager *bm, const gchar *name);
+/* 当前动态添加的分支数 */
+guint branch_manager_count(BranchManager *bm);
+void branch_manager_list(BranchManager *bm);
+/* 打印所有操作对原有分支的影响（最大额外延迟、丢帧总数） */
+void branch_manager_print_summary(BranchManager *bm);
+void branch_manager_free(BranchManager *bm);
+
+#endif /* BRANCH_MANAGER_H */
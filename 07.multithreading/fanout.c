@@ -0,0 +1,337 @@
+#include "fanout.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#define SAMPLES_PER_BUFFER 1024 /* audiotestsrc 每个 buffer 的采样数 */
+#define MAX_PENDING 16          /* 每个 strand 最多缓存的 buffer/事件数，满了之后 tee 等待（相当于 queue 的 max-size-buffers） */
+#define SLICE_ITEMS 8           /* 线程池中的线程处理一个 strand 最多的个数，之后让出线程，保证各分支公平 */
+#define POLL_INTERVAL (10 * GST_MSECOND) /* 等待结束时采样线程数的间隔 */
+
+typedef struct _Fanout Fanout;
+
+/**
+ * 一个分支的执行队列（strand）
+ *
+ * scheduled 表示这个 strand 已经在线程池的队列中或正在被处理，保证同一时刻只有一个线程处理它，
+ * 所以分支里的元素看到的 buffer/事件顺序与 tee 推出的顺序相同。
+ */
+typedef struct _Strand
+{
+    Fanout *fo;
+    GstPad *tee_pad;    /* tee.src_N */
+    GstPad *peer;       /* 分支第一个元素的 sink pad */
+    GMutex lock;
+    GCond cond;         /* 队列有空位时通知 tee 的流线程 */
+    GQueue items;       /* 待处理的 GstBuffer / GstEvent */
+    gboolean scheduled;
+    gboolean flushing;  /* pipeline 停止时置位，tee 不再等待 */
+} Strand;
+
+struct _Fanout
+{
+    FanoutMode mode;
+    GstElement *pipeline;
+    GThreadPool *pool;
+    Strand *strands;
+    gint n_strands;
+};
+
+gboolean
+fanout_mode_from_name(const gchar *name, FanoutMode *mode)
+{
+    if (g_strcmp0(name, "queue") == 0)
+        *mode = FANOUT_QUEUE;
+    else if (g_strcmp0(name, "pool") == 0)
+        *mode = FANOUT_POOL;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/* 线程池中的线程：按顺序把 strand 中的 buffer/事件交给分支 */
+static void
+run_strand(Strand *s, Fanout *fo)
+{
+    gint i;
+
+    for (i = 0; i < SLICE_ITEMS; i++)
+    {
+        GstMiniObject *item;
+
+        g_mutex_lock(&s->lock);
+        item = g_queue_pop_head(&s->items);
+        if (item == NULL)
+        {
+            s->scheduled = FALSE;
+            g_mutex_unlock(&s->lock);
+            return;
+        }
+        g_cond_signal(&s->cond);
+        g_mutex_unlock(&s->lock);
+
+        // 直接调用分支第一个元素的 chain 函数，分支中的处理都在当前线程完成
+        if (GST_IS_BUFFER(item))
+            gst_pad_chain(s->peer, GST_BUFFER_CAST(item));
+        else
+            gst_pad_send_event(s->peer, GST_EVENT_CAST(item));
+    }
+    // 用完时间片：还有数据时重新排到线程池队列的末尾（scheduled 保持 TRUE）
+    g_mutex_lock(&s->lock);
+    if (s->items.length > 0 && !s->flushing)
+        g_thread_pool_push(fo->pool, s, NULL);
+    else
+        s->scheduled = FALSE;
+    g_mutex_unlock(&s->lock);
+}
+
+/**
+ * tee.src_N 上的探针（tee 的流线程）
+ *
+ * buffer 和串行事件（caps、segment、EOS 等）放进 strand，返回 HANDLED：数据由我们接管，tee 认为推送成功；
+ * 非串行事件（如 flush）直接通过链接送到分支。
+ * 查询（caps、allocation）也直接通过链接在 tee 的线程中处理，没有像 queue 那样与数据排队。
+ */
+static GstPadProbeReturn
+strand_probe(GstPad *pad, GstPadProbeInfo *info, Strand *s)
+{
+    if ((info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) && !GST_EVENT_IS_SERIALIZED(GST_PAD_PROBE_INFO_EVENT(info)))
+        return GST_PAD_PROBE_OK;
+
+    g_mutex_lock(&s->lock);
+    while (s->items.length >= MAX_PENDING && !s->flushing)
+        g_cond_wait(&s->cond, &s->lock);
+    if (s->flushing)
+    {
+        g_mutex_unlock(&s->lock);
+        gst_mini_object_unref(GST_MINI_OBJECT_CAST(info->data));
+        return GST_PAD_PROBE_HANDLED;
+    }
+    g_queue_push_tail(&s->items, info->data);
+    if (!s->scheduled)
+    {
+        s->scheduled = TRUE;
+        g_thread_pool_push(s->fo->pool, s, NULL);
+    }
+    g_mutex_unlock(&s->lock);
+    return GST_PAD_PROBE_HANDLED;
+}
+
+/* 停止前唤醒等待中的 tee，并丢弃还没处理的数据 */
+static void
+strands_flush(Fanout *fo)
+{
+    gint i;
+
+    for (i = 0; i < fo->n_strands; i++)
+    {
+        Strand *s = &fo->strands[i];
+
+        if (s->fo == NULL) // 没有初始化（创建分支失败）
+            continue;
+        g_mutex_lock(&s->lock);
+        s->flushing = TRUE;
+        g_queue_clear_full(&s->items, (GDestroyNotify)gst_mini_object_unref);
+        g_cond_broadcast(&s->cond);
+        g_mutex_unlock(&s->lock);
+    }
+}
+
+/* 当前进程的线程数（Linux 读取 /proc/self/status，其他平台返回 0） */
+static gint
+count_threads(void)
+{
+    gchar *contents = NULL, *line;
+    gint threads = 0;
+
+    if (!g_file_get_contents("/proc/self/status", &contents, NULL, NULL))
+        return 0;
+    line = strstr(contents, "\nThreads:");
+    if (line != NULL)
+        threads = (gint)g_ascii_strtoll(line + sizeof("\nThreads:") - 1, NULL, 10);
+    g_free(contents);
+    return threads;
+}
+
+/* 创建一个分支：[queue ->] audioconvert -> volume -> fakesink，返回分支第一个元素 */
+static GstElement *
+add_branch(Fanout *fo, gint index)
+{
+    GstElement *queue = NULL, *convert, *volume, *sink;
+    gchar *name;
+
+    convert = gst_element_factory_make("audioconvert", NULL);
+    volume = gst_element_factory_make("volume", NULL);
+    name = g_strdup_printf("sink_%d", index);
+    sink = gst_element_factory_make("fakesink", name);
+    g_free(name);
+    if (fo->mode == FANOUT_QUEUE)
+        queue = gst_element_factory_make("queue", NULL);
+    if (!convert || !volume || !sink || (fo->mode == FANOUT_QUEUE && !queue))
+        return NULL;
+
+    // volume=0.5：每个分支都要修改采样，tee 共享的 buffer 会被复制一份，模拟实际的分支处理
+    g_object_set(volume, "volume", 0.5, NULL);
+    // async=false：sink 不 preroll。否则 pool 模式下线程在 gst_pad_chain() 中阻塞在 preroll 上，
+    // 分支数多于线程数时其余分支得不到调度、永远无法 preroll，pipeline 停在 PAUSED（与 branch_manager.c 相同）
+    g_object_set(sink, "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add_many(GST_BIN(fo->pipeline), convert, volume, sink, NULL);
+    if (!gst_element_link_many(convert, volume, sink, NULL))
+        return NULL;
+    if (queue == NULL)
+        return convert;
+    gst_bin_add(GST_BIN(fo->pipeline), queue);
+    if (!gst_element_link(queue, convert))
+        return NULL;
+    return queue;
+}
+
+int
+fanout_run(FanoutMode mode, gint branches, gint threads, gint buffers, gboolean csv)
+{
+    Fanout fo = {0};
+    GstElement *source, *tee;
+    GstBus *bus;
+    GstMessage *msg = NULL;
+    GError *error = NULL;
+    struct rusage ru_start, ru_end;
+    gint64 start, end;
+    gdouble wall, cpu;
+    glong nvcsw, nivcsw;
+    gint i, peak_threads = 0, ret = 0;
+    gchar *layout;
+
+    fo.mode = mode;
+    fo.pipeline = gst_pipeline_new("fanout-pipeline");
+    source = gst_element_factory_make("audiotestsrc", "source");
+    tee = gst_element_factory_make("tee", "tee");
+    if (!fo.pipeline || !source || !tee)
+    {
+        g_printerr("Not all elements could be created.\n");
+        return -1;
+    }
+    g_object_set(source, "samplesperbuffer", SAMPLES_PER_BUFFER, "num-buffers", buffers, NULL);
+    gst_bin_add_many(GST_BIN(fo.pipeline), source, tee, NULL);
+    gst_element_link(source, tee);
+
+    if (mode == FANOUT_POOL)
+    {
+        // exclusive=TRUE：线程在创建线程池时一次性启动，运行期间线程数固定
+        fo.pool = g_thread_pool_new((GFunc)run_strand, &fo, threads, TRUE, &error);
+        if (fo.pool == NULL)
+        {
+            g_printerr("Could not create the thread pool: %s\n", error->message);
+            g_clear_error(&error);
+            gst_object_unref(fo.pipeline);
+            return -1;
+        }
+        fo.strands = g_new0(Strand, branches);
+        fo.n_strands = branches;
+    }
+
+    for (i = 0; i < branches && ret == 0; i++)
+    {
+        GstElement *head = add_branch(&fo, i);
+        GstPad *tee_pad, *head_pad;
+
+        if (head == NULL)
+        {
+            g_printerr("Branch %d could not be created.\n", i);
+            ret = -1;
+            break;
+        }
+        tee_pad = gst_element_request_pad_simple(tee, "src_%u");
+        head_pad = gst_element_get_static_pad(head, "sink");
+        if (gst_pad_link(tee_pad, head_pad) != GST_PAD_LINK_OK)
+        {
+            g_printerr("Branch %d could not be linked to the tee.\n", i);
+            ret = -1;
+        }
+        else if (mode == FANOUT_POOL)
+        {
+            Strand *s = &fo.strands[i];
+
+            s->fo = &fo;
+            s->tee_pad = gst_object_ref(tee_pad);
+            s->peer = gst_object_ref(head_pad);
+            g_mutex_init(&s->lock);
+            g_cond_init(&s->cond);
+            g_queue_init(&s->items);
+            gst_pad_add_probe(tee_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                              (GstPadProbeCallback)strand_probe, s, NULL);
+        }
+        gst_object_unref(head_pad);
+        gst_object_unref(tee_pad); // request pad 随 pipeline 一起释放
+    }
+
+    if (ret == 0)
+    {
+        layout = mode == FANOUT_POOL ? g_strdup_printf("pool of %d threads", threads) : g_strdup("queue per branch");
+        if (!csv)
+            g_print("Fan-out to %d branches (%s) on %u cores...\n", branches, layout, g_get_num_processors());
+        g_free(layout);
+        getrusage(RUSAGE_SELF, &ru_start);
+        start = g_get_monotonic_time();
+        gst_element_set_state(fo.pipeline, GST_STATE_PLAYING);
+
+        /* Wait until error or EOS */
+        // 每 10ms 醒来一次，记录线程数的峰值
+        bus = gst_element_get_bus(fo.pipeline);
+        while (msg == NULL)
+        {
+            msg = gst_bus_timed_pop_filtered(bus, POLL_INTERVAL, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+            peak_threads = MAX(peak_threads, count_threads());
+        }
+        end = g_get_monotonic_time();
+        getrusage(RUSAGE_SELF, &ru_end);
+        if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+        {
+            gchar *debug_info;
+
+            gst_message_parse_error(msg, &error, &debug_info);
+            g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), error->message);
+            g_clear_error(&error);
+            g_free(debug_info);
+            ret = -1;
+        }
+        gst_message_unref(msg);
+        gst_object_unref(bus);
+
+        // RUSAGE_SELF 统计的是整个进程（所有线程）的上下文切换和 CPU 时间
+        wall = (gdouble)(end - start) / G_USEC_PER_SEC;
+        cpu = ru_end.ru_utime.tv_sec - ru_start.ru_utime.tv_sec + ru_end.ru_stime.tv_sec - ru_start.ru_stime.tv_sec +
+              (ru_end.ru_utime.tv_usec - ru_start.ru_utime.tv_usec + ru_end.ru_stime.tv_usec - ru_start.ru_stime.tv_usec) / 1e6;
+        nvcsw = ru_end.ru_nvcsw - ru_start.ru_nvcsw;
+        nivcsw = ru_end.ru_nivcsw - ru_start.ru_nivcsw;
+        if (ret == 0 && csv)
+            g_print("%s,%d,%d,%.3f,%.0f,%d,%ld,%ld,%.3f\n", mode == FANOUT_POOL ? "pool" : "queue", branches,
+                    mode == FANOUT_POOL ? threads : branches, wall, (gdouble)buffers * branches / wall,
+                    peak_threads, nvcsw, nivcsw, cpu);
+        else if (ret == 0)
+            g_print("%d branches: %.0f buffers/sec aggregate, %d threads at peak, "
+                    "%ld voluntary + %ld involuntary context switches, %.2f s CPU in %.2f s\n",
+                    branches, buffers * branches / wall, peak_threads, nvcsw, nivcsw, cpu, wall);
+    }
+
+    /* Free resources */
+    // 先唤醒可能在探针中等待的 tee，否则 pipeline 无法停止
+    strands_flush(&fo);
+    gst_element_set_state(fo.pipeline, GST_STATE_NULL);
+    if (fo.pool)
+        g_thread_pool_free(fo.pool, FALSE, TRUE);
+    for (i = 0; i < fo.n_strands; i++)
+    {
+        Strand *s = &fo.strands[i];
+
+        if (s->fo == NULL) // 没有初始化（创建分支失败）
+            continue;
+        g_queue_clear_full(&s->items, (GDestroyNotify)gst_mini_object_unref);
+        gst_object_unref(s->tee_pad);
+        gst_object_unref(s->peer);
+        g_mutex_clear(&s->lock);
+        g_cond_clear(&s->cond);
+    }
+    g_free(fo.strands);
+    gst_object_unref(fo.pipeline);
+    return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <gst/gst.h>
+
+/**
+ * 大规模 tee 扇出的基准测试（--fanout=N）
+ *
+ *     audiotestsrc -> tee ─┬─> [分支 0] audioconvert -> volume -> fakesink
+ *                          ├─> [分支 1] ...
+ *                          └─> [分支 N-1] ...
+ *
+ * 两种分支布局：
+ * - queue：与示例相同，每个分支前面一个 queue，每个 queue 一个流线程，N 个分支就是 N 个线程
+ * - pool： 分支前面没有 queue，tee.src_N 上的探针把 buffer/事件放进这个分支的队列（strand），
+ *          由固定大小的线程池（默认等于 CPU 核数）依次调用 gst_pad_chain() 交给分支处理；
+ *          同一个分支同一时刻只在一个线程上运行，保证顺序
+ * 运行结束后报告吞吐量、线程数峰值、上下文切换次数和 CPU 时间。
+ */
+
+typedef enum
+{
+    FANOUT_QUEUE, /* 每个分支一个 queue（一个线程） */
+    FANOUT_POOL,  /* 所有分支共用一个线程池 */
+} FanoutMode;
+
+/* 按名字查找布局（queue/pool），找不到返回 FALSE */
+gboolean fanout_mode_from_name(const gchar *name, FanoutMode *mode);
+/* 运行一次：threads 只用于 pool 布局，buffers 为 audiotestsrc 生成的 buffer 数，csv 为 TRUE 时只输出一行 CSV */
+int fanout_run(FanoutMode mode, gint branches, gint threads, gint buffers, gboolean csv);
+
+#endif /* FANOUT_H */
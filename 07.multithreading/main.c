@@ -1,17 +1,154 @@
 #include <gst/gst.h>
+#include <stdio.h>
+
+#include "branch_manager.h"
+#include "fanout.h"
+#include "queue_telemetry.h"
+#include "thread_policy.h"
+
+#define DEFAULT_TELEMETRY_INTERVAL 100 /* queue 水位的默认采样间隔（毫秒） */
+#define DEFAULT_FANOUT_BUFFERS 2000    /* 扇出测试中 audiotestsrc 生成的 buffer 数 */
+
+#ifdef HEADLESS_BENCH
+/**
+ * make bench 编译的无界面基准测试版本：
+ * - audio_sink/video_sink 换成 fakesink sync=false，不再按实时速度播放
+ * - audiotestsrc 生成 --bench-samples 个采样后发出 EOS
+ * - 结束时输出一行 JSON（吞吐量、每个流线程的 CPU 时间、峰值内存），见 common/bench_report.c
+ */
+#include "bench_report.h"
+
+#define BENCH_SAMPLES_PER_BUFFER 1024      /* audiotestsrc 每个 buffer 的采样数 */
+#define DEFAULT_BENCH_SAMPLES (44100 * 600) /* 默认生成 10 分钟的音频 */
+#endif
+
+/* Structure to contain all our information, so we can pass it around */
+typedef struct _CustomData
+{
+    GstElement *pipeline;
+    GMainLoop *main_loop;    /* GLib's Main Loop */
+    GstMessage *msg;         /* 结束主循环的 ERROR/EOS 消息 */
+    BranchManager *branches; /* 运行中动态添加/删除的 tee 分支 */
+} CustomData;
+
+/* Forward definition for the message, keyboard and hot-plug timer functions */
+static gboolean handle_message(GstBus *bus, GstMessage *msg, CustomData *data);
+#ifndef HEADLESS_BENCH
+static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomData *data);
+#endif
+static gboolean hotplug_tick(CustomData *data);
 
 int main(int argc, char *argv[])
 {
     GstElement *pipeline, *audio_source, *tee, *audio_queue, *audio_convert, *audio_resample, *audio_sink;
     GstElement *video_queue, *visual, *video_convert, *video_sink;
+    CustomData data = {0};
     GstBus *bus;
-    GstMessage *msg;
+    GIOChannel *io_stdin = NULL;
     GstPad *tee_audio_pad, *tee_video_pad;
     GstPad *queue_audio_pad, *queue_video_pad;
+    QueueTelemetry *telemetry = NULL;
+    gchar *telemetry_path = NULL;
+    gint telemetry_interval = DEFAULT_TELEMETRY_INTERVAL;
+    gint hotplug_interval = 0;
+    gint fanout = 0, fanout_threads = g_get_num_processors(), fanout_buffers = DEFAULT_FANOUT_BUFFERS;
+    gchar *fanout_layout = NULL;
+    FanoutMode fanout_mode = FANOUT_QUEUE;
+    gboolean csv = FALSE;
+    ThreadPolicy *thread_policy = NULL;
+    gchar **policy_rules = NULL;
+    gboolean thread_stats = FALSE;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"telemetry", 0, 0, G_OPTION_ARG_FILENAME, &telemetry_path, "Sample queue fill levels into a CSV time series", "FILE"},
+        {"telemetry-interval", 0, 0, G_OPTION_ARG_INT, &telemetry_interval, "Queue sampling interval in milliseconds", "MS"},
+        {"hotplug-interval", 0, 0, G_OPTION_ARG_INT, &hotplug_interval, "Add/remove an analyzer branch every MS milliseconds (0 = off)", "MS"},
+        {"fanout", 0, 0, G_OPTION_ARG_INT, &fanout, "Benchmark a tee fanning out to N branches instead of the demo", "N"},
+        {"fanout-layout", 0, 0, G_OPTION_ARG_STRING, &fanout_layout, "Branch layout for --fanout: queue (thread per branch) or pool", "LAYOUT"},
+        {"fanout-threads", 0, 0, G_OPTION_ARG_INT, &fanout_threads, "Threads in the shared pool (default: number of cores)", "N"},
+        {"fanout-buffers", 0, 0, G_OPTION_ARG_INT, &fanout_buffers, "Buffers the source produces in the --fanout benchmark", "N"},
+        {"csv", 0, 0, G_OPTION_ARG_NONE, &csv, "Print the --fanout result as one CSV line", NULL},
+        {"thread-policy", 0, 0, G_OPTION_ARG_STRING_ARRAY, &policy_rules, "Pin/prioritise an element's streaming thread, e.g. audio_queue:cpus=2:fifo=50 (repeatable)", "RULE"},
+        {"thread-stats", 0, 0, G_OPTION_ARG_NONE, &thread_stats, "Report per-thread scheduling latency without changing any policy", NULL},
+        {NULL}};
+#ifdef HEADLESS_BENCH
+    BenchReport *report;
+    gint64 bench_samples = DEFAULT_BENCH_SAMPLES;
+    gchar *bench_output = NULL;
+    GOptionEntry bench_entries[] = {
+        {"bench-samples", 0, 0, G_OPTION_ARG_INT64, &bench_samples, "Number of samples to generate", "N"},
+        {"bench-output", 0, 0, G_OPTION_ARG_FILENAME, &bench_output, "Write the JSON report to FILE instead of stdout", "FILE"},
+        {NULL}};
+#endif
+
+    /* Parse command line options */
+    context = g_option_context_new("- multithreading with tee and queues");
+    g_option_context_add_main_entries(context, entries, NULL);
+#ifdef HEADLESS_BENCH
+    g_option_context_add_main_entries(context, bench_entries, NULL);
+#endif
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (telemetry_interval <= 0 || hotplug_interval < 0)
+    {
+        g_printerr("--telemetry-interval must be > 0 and --hotplug-interval >= 0\n");
+        return -1;
+    }
+#ifdef HEADLESS_BENCH
+    if (bench_samples <= 0)
+    {
+        g_printerr("--bench-samples must be > 0\n");
+        return -1;
+    }
+    // 向上取整为整数个 buffer
+    bench_samples = (bench_samples + BENCH_SAMPLES_PER_BUFFER - 1) / BENCH_SAMPLES_PER_BUFFER * BENCH_SAMPLES_PER_BUFFER;
+#endif
+
+    if (fanout_layout && !fanout_mode_from_name(fanout_layout, &fanout_mode))
+    {
+        g_printerr("Unknown fan-out layout '%s' (use queue or pool)\n", fanout_layout);
+        return -1;
+    }
+    g_free(fanout_layout);
+    if (policy_rules || thread_stats)
+    {
+        gchar **rule;
+
+        thread_policy = thread_policy_new();
+        for (rule = policy_rules; rule && *rule; rule++)
+        {
+            if (!thread_policy_add_rule(thread_policy, *rule, &error))
+            {
+                g_printerr("%s\n", error->message);
+                g_clear_error(&error);
+                return -1;
+            }
+        }
+        g_strfreev(policy_rules);
+    }
 
     /* Initialize GStreamer */
     gst_init(&argc, &argv);
 
+    /* Wide fan-out benchmark, see fanout.c */
+    // 比较每个分支一个 queue（线程）与共用线程池两种布局
+    if (fanout > 0)
+    {
+        if (fanout_threads <= 0 || fanout_buffers <= 0)
+        {
+            g_printerr("--fanout-threads and --fanout-buffers must be > 0\n");
+            return -1;
+        }
+        return fanout_run(fanout_mode, fanout, fanout_threads, fanout_buffers, csv);
+    }
+
     /* Create the elements */
     /**
      * GStreamer是一个多线程的框架，在内部，它根据需要创建和销毁线程
@@ -27,11 +164,19 @@ int main(int argc, char *argv[])
     audio_queue = gst_element_factory_make("queue", "audio_queue");
     audio_convert = gst_element_factory_make("audioconvert", "audio_convert");
     audio_resample = gst_element_factory_make("audioresample", "audio_resample");
+#ifdef HEADLESS_BENCH
+    audio_sink = gst_element_factory_make("fakesink", "audio_sink");
+#else
     audio_sink = gst_element_factory_make("autoaudiosink", "audio_sink");
+#endif
     video_queue = gst_element_factory_make("queue", "video_queue");
     visual = gst_element_factory_make("wavescope", "visual"); // 消费一个音频信号并且将它渲染成波形，简易的示波器
     video_convert = gst_element_factory_make("videoconvert", "csp");
+#ifdef HEADLESS_BENCH
+    video_sink = gst_element_factory_make("fakesink", "video_sink");
+#else
     video_sink = gst_element_factory_make("autovideosink", "video_sink");
+#endif
 
     /* Create the empty pipeline */
     pipeline = gst_pipeline_new("test-pipeline");
@@ -46,6 +191,15 @@ int main(int argc, char *argv[])
     /* Configure elements */
     g_object_set(audio_source, "freq", 215.0f, NULL);
     g_object_set(visual, "shader", 0, "style", 1, NULL);
+#ifdef HEADLESS_BENCH
+    // sync=false：sink 收到 buffer 立即返回，不等待时钟，pipeline 以 CPU 能达到的最快速度运行
+    g_object_set(audio_sink, "sync", FALSE, NULL);
+    g_object_set(video_sink, "sync", FALSE, NULL);
+    g_object_set(audio_source,
+                 "samplesperbuffer", BENCH_SAMPLES_PER_BUFFER,
+                 "num-buffers", (gint)(bench_samples / BENCH_SAMPLES_PER_BUFFER),
+                 NULL);
+#endif
 
     /* Link all elements that can be automatically linked because they have "Always" pads */
     gst_bin_add_many(GST_BIN(pipeline), audio_source, tee, audio_queue, audio_convert, audio_resample, audio_sink,
@@ -103,13 +257,94 @@ int main(int argc, char *argv[])
     gst_object_unref(queue_audio_pad); // 释放结构体内存(并不会释放pad)
     gst_object_unref(queue_video_pad); // 释放结构体内存(并不会释放pad)
 
+    /**
+     * 运行中动态添加/删除分支（见 branch_manager.c）
+     * 在原有的两个分支的 sink 上测量每次操作带来的额外延迟和丢帧
+     */
+    data.pipeline = pipeline;
+#ifdef HEADLESS_BENCH
+    if (hotplug_interval > 0) // 基准测试只在需要时加探针，避免影响测量结果
+#endif
+    {
+        data.branches = branch_manager_new(pipeline, tee);
+        branch_manager_watch(data.branches, audio_sink, "audio");
+        branch_manager_watch(data.branches, video_sink, "video");
+    }
+
+#ifdef HEADLESS_BENCH
+    report = bench_report_new("07.multithreading");
+    bench_report_watch_threads(report, pipeline);
+    bench_report_count_sink(report, audio_sink, "audio_sink");
+    bench_report_count_sink(report, video_sink, "video_sink");
+    bench_report_start(report);
+#endif
+
+    /* Start sampling the queue fill levels */
+    // 采样线程定时读取两个分支 queue 的水位，找出阻塞 tee 的分支（通常是 wavescope -> videoconvert）
+    if (telemetry_path)
+    {
+        telemetry = queue_telemetry_new(telemetry_interval, telemetry_path);
+        queue_telemetry_add(telemetry, audio_queue, "audio");
+        queue_telemetry_add(telemetry, video_queue, "video");
+        if (!queue_telemetry_start(telemetry))
+        {
+            gst_object_unref(pipeline);
+            return -1;
+        }
+    }
+
+    /* Apply the scheduling policy to each streaming thread as it starts */
+    // 例如把 audio_queue 的线程固定在单独的核上并使用 SCHED_FIFO，避免与 video 分支的转换争抢 CPU
+    if (thread_policy)
+        thread_policy_watch(thread_policy, pipeline);
+
+    /* Add a bus watch, so we get notified when a message arrives */
+    bus = gst_element_get_bus(pipeline);
+    gst_bus_add_watch(bus, (GstBusFunc)handle_message, &data);
+
+#ifndef HEADLESS_BENCH
+    /* Add a keyboard watch so we get notified of keystrokes */
+    // 从标准输入读取命令：a 添加分析分支，r 添加录音分支，d [名字] 删除分支，l 列出分支，q 结束
+#ifdef G_OS_WIN32
+    io_stdin = g_io_channel_win32_new_fd(fileno(stdin));
+#else
+    io_stdin = g_io_channel_unix_new(fileno(stdin));
+#endif
+    g_io_add_watch(io_stdin, G_IO_IN, (GIOFunc)handle_keyboard, &data);
+    g_print("Commands: a = add analyzer, r = add recorder, d [name] = remove branch, l = list, q = quit\n");
+#endif
+    // 定时交替添加/删除一个分析分支，用于无人值守地测量热插拔的影响
+    if (hotplug_interval > 0)
+        g_timeout_add(hotplug_interval, (GSourceFunc)hotplug_tick, &data);
+
     /* Start playing the pipeline */
     gst_element_set_state(pipeline, GST_STATE_PLAYING);
 
-    /* Wait until error or EOS */
-    // 阻塞直到ERROR或EOS事件触发
-    bus = gst_element_get_bus(pipeline);
-    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    /* Create a GLib Main Loop and set it to run */
+    // 运行主循环，直到ERROR或EOS事件触发
+    data.main_loop = g_main_loop_new(NULL, FALSE);
+    g_main_loop_run(data.main_loop);
+#ifdef HEADLESS_BENCH
+    // 在 pipeline 停止之前读取各线程的 CPU 时间
+    bench_report_stop(report);
+    if (data.msg != NULL && GST_MESSAGE_TYPE(data.msg) == GST_MESSAGE_EOS)
+        bench_report_write(report, bench_samples, bench_output);
+    else
+        g_printerr("Benchmark pipeline failed before EOS.\n");
+#endif
+
+    if (telemetry)
+    {
+        queue_telemetry_stop(telemetry);
+        queue_telemetry_print_summary(telemetry);
+        queue_telemetry_free(telemetry);
+    }
+    g_free(telemetry_path);
+    if (data.branches)
+        branch_manager_print_summary(data.branches);
+    // 流线程退出之前读取调度统计
+    if (thread_policy)
+        thread_policy_print_summary(thread_policy);
 
     /* Release the request pads from the Tee, and unref them */
     gst_element_release_request_pad(tee, tee_audio_pad); // 释放申请的tee.src_0 pad插槽
@@ -118,11 +353,100 @@ int main(int argc, char *argv[])
     gst_object_unref(tee_video_pad);                     // 释放结构体内存
 
     /* Free resources */
-    if (msg != NULL)
-        gst_message_unref(msg);
+    if (data.msg != NULL)
+        gst_message_unref(data.msg);
+    g_main_loop_unref(data.main_loop);
+    if (io_stdin)
+        g_io_channel_unref(io_stdin);
+    gst_bus_remove_watch(bus);
     gst_object_unref(bus);
     gst_element_set_state(pipeline, GST_STATE_NULL);
 
+    if (data.branches)
+        branch_manager_free(data.branches);
+    if (thread_policy)
+        thread_policy_free(thread_policy);
     gst_object_unref(pipeline);
+#ifdef HEADLESS_BENCH
+    bench_report_free(report);
+    g_free(bench_output);
+#endif
     return 0;
-}
\ No newline at end of file
+}
+
+/* Process messages from the bus */
+static gboolean handle_message(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+    GError *err;
+    gchar *debug_info;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &err, &debug_info);
+        g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+        g_printerr("Debugging information: %s\n", debug_info ? debug_info : "none");
+        g_clear_error(&err);
+        g_free(debug_info);
+        /* fall through */
+    case GST_MESSAGE_EOS:
+        // 保存消息，主循环结束后由 main() 判断是正常结束还是出错
+        if (data->msg == NULL)
+            data->msg = gst_message_ref(msg);
+        g_main_loop_quit(data->main_loop);
+        break;
+    default:
+        break;
+    }
+
+    /* We want to keep receiving messages */
+    return TRUE;
+}
+
+#ifndef HEADLESS_BENCH
+/* Process keyboard input */
+static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomData *data)
+{
+    gchar *str = NULL;
+
+    // 读取一行输入
+    if (g_io_channel_read_line(source, &str, NULL, NULL, NULL) == G_IO_STATUS_NORMAL)
+    {
+        gchar *arg = g_strstrip(str + 1); // 命令后面的参数（分支名）
+
+        switch (g_ascii_tolower(str[0]))
+        {
+        case 'a':
+            branch_manager_add(data->branches, BRANCH_ANALYZER);
+            break;
+        case 'r':
+            branch_manager_add(data->branches, BRANCH_RECORDER);
+            break;
+        case 'd':
+            branch_manager_remove(data->branches, *arg ? arg : NULL);
+            break;
+        case 'l':
+            branch_manager_list(data->branches);
+            break;
+        case 'q':
+            // 发送 EOS 而不是直接退出，录音分支可以写完文件头
+            gst_element_send_event(data->pipeline, gst_event_new_eos());
+            break;
+        default:
+            break;
+        }
+    }
+    g_free(str);
+    return TRUE;
+}
+#endif
+
+/* 定时器：没有动态分支时添加一个分析分支，否则删除它 */
+static gboolean hotplug_tick(CustomData *data)
+{
+    if (branch_manager_count(data->branches) == 0)
+        branch_manager_add(data->branches, BRANCH_ANALYZER);
+    else
+        branch_manager_remove(data->branches, NULL);
+    return G_SOURCE_CONTINUE;
+}
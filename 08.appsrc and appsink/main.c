@@ -1,10 +1,47 @@
 #include <gst/gst.h>
 #include <gst/audio/audio.h>
+#include <gst/app/app.h>
 #include <string.h>
 
+#include "app_consumer.h"
+#include "feeder_pool.h"
+#include "latency_stamp.h"
+#include "multistream.h"
+#include "native_format.h"
+#include "pcm_replay.h"
+#include "queue_telemetry.h"
+#include "thread_policy.h"
+#include "push_batch.h"
+#include "spsc_ring.h"
+#include "waveform.h"
+
+#ifdef HEADLESS_BENCH
+/**
+ * make bench 编译的无界面基准测试版本：
+ * - audio_sink/video_sink 换成 fakesink sync=false，appsink 也不再同步时钟
+ * - audio_sink 前面加一个 capsfilter 模拟声卡的格式（--sink-caps），音频分支的转换开销与真实设备相同
+ * - 生成 --bench-samples 个采样后向 appsrc 发送 EOS
+ * - 结束时输出一行 JSON（吞吐量、每个流线程的 CPU 时间、峰值内存），见 common/bench_report.c
+ */
+#include "bench_report.h"
+
+#define DEFAULT_BENCH_SAMPLES (SAMPLE_RATE * 600) /* 默认生成 10 分钟的音频 */
+/* 模拟的声卡格式：与 06 示例中 autoaudiosink 协商的结果相同 */
+#define DEFAULT_BENCH_SINK_CAPS "audio/x-raw,format=F32LE,layout=interleaved,rate=48000,channels=2"
+#endif
+
 #define CHUNK_SIZE 1024   /* Amount of bytes we are sending in each buffer */
 #define SAMPLE_RATE 44100 /* Samples per second we are sending */
 
+#define DEFAULT_POOL_BUFFERS 256 /* 缓冲池中 buffer 的默认个数 */
+#define STATS_INTERVAL 5         /* 打印统计信息的间隔（秒） */
+#define DEFAULT_RING_SIZE 64     /* 生产者线程环形队列的默认容量（chunk 个数） */
+#define DEFAULT_BATCH_LATENCY 50 /* 批量推送的默认延迟预算（毫秒） */
+#define DEFAULT_STREAM_SECONDS 60 /* 多路模式下每一路生成的音频时长（秒） */
+#define DEFAULT_RENDER_SECONDS 3600 /* 离线渲染默认生成的音频时长（秒） */
+#define DEFAULT_TELEMETRY_INTERVAL 100 /* queue 水位的默认采样间隔（毫秒） */
+#define DEFAULT_LATENCY_SPIKE 2.0 /* 延迟超过 p50 的多少倍算作尖峰 */
+
 /* Structure to contain all our information, so we can pass it to callbacks */
 typedef struct _CustomData
 {
@@ -14,33 +51,196 @@ typedef struct _CustomData
         *video_queue, *audio_convert2, *visual, *video_convert, *video_sink, //
         *app_queue, *app_sink;                                               //
     guint64 num_samples;                                                     /* Number of samples generated so far (for timestamp generation) */
-    gfloat a, b, c, d;                                                       /* For waveform generation */
+    Waveform wf;                                                             /* For waveform generation（向量化的波形生成器） */
     guint sourceid;                                                          /* To control the GSource */
     GMainLoop *main_loop;                                                    /* GLib's Main Loop */
+    GstCaps *audio_caps;                                                     /* appsrc 的 caps，协商缓冲池时使用 */
+    FeederPool pool;                                                         /* 生产者使用的缓冲池 */
+    gboolean pool_ready;                                                     /* 缓冲池是否已经协商过 */
+    gint pool_buffers;                                                       /* --pool-buffers: 池中 buffer 个数，0 表示禁用缓冲池 */
+    gint pool_buffer_size;                                                   /* --pool-buffer-size: 池中每个 buffer 的大小 */
+    gboolean producer_thread;                                                /* --producer-thread: 在独立线程中生成数据 */
+    gint ring_size;                                                          /* --ring-size: 环形队列容量 */
+    SpscRing ring;                                                           /* 生产者线程 -> appsrc 的无锁环形队列 */
+    GThread *producer;                                                       /* 生产者线程 */
+    GMutex producer_lock;                                                    /* 只用于线程休眠/唤醒，不保护环形队列 */
+    GCond producer_cond;                                                     /* 生产者等待 "需要数据且队列未满"，消费者等待 "队列非空" */
+    gint producer_waiting;                                                   /* 生产者正在等待（原子操作） */
+    gint consumer_waiting;                                                   /* 消费者正在等待（原子操作） */
+    gint feeding;                                                            /* need-data/enough-data 设置的节流标志（原子操作） */
+    gint producer_stop;                                                      /* 通知生产者线程退出（原子操作） */
+    gint ring_underflows;                                                    /* appsrc 需要数据时环形队列为空的次数（原子操作） */
+    gint batch_size;                                                         /* --batch-size: 每次推送的 chunk 个数，1 表示逐个推送 */
+    gint batch_latency;                                                      /* --batch-latency: 一个批次最多覆盖的时长（毫秒），0 表示不限制 */
+    PushBatch batch;                                                         /* 批量推送（GstBufferList） */
+    AppConsumer consumer;                                                    /* appsink 消费者（回调方式） */
+    gint sink_max_buffers;                                                   /* --sink-max-buffers: appsink 队列上限，0 表示不限制 */
+    gboolean sink_drop;                                                      /* --sink-drop: 队列满时丢弃最旧的 buffer 而不是阻塞 */
+    gint sink_peak;                                                          /* 上次打印统计以来的峰值（原子操作） */
+    gboolean sink_s16;                                                       /* appsink 收到的是 S16 数据（电平表只处理 S16） */
+    PcmReplay replay;                                                        /* --replay: 回放的 PCM 文件（file 为 NULL 表示生成波形） */
+    gint producer_done;                                                      /* 数据源已经结束，生产者线程不再生成数据（原子操作） */
+    guint64 max_samples;                                                     /* 生成多少个采样后结束（离线渲染/基准测试），0 表示不限制 */
+    ThreadPolicy *thread_policy;                                             /* --thread-policy: 流线程的亲和性/调度策略，NULL 表示不修改 */
+    LatencyTracker *latency;                                                 /* --latency: 给每个 chunk 打上创建时间，在各分支的 sink 测量延迟 */
+    gboolean native_format;                                                  /* --native-format: 按音频 sink 的首选格式生成，去掉 audioconvert/audioresample */
+    NativeFormat native;                                                     /* 查询 sink 的格式、监听 RECONFIGURE */
+    GstAudioInfo out_info;                                                   /* 生成器当前输出的格式（与 appsrc 的 caps 相同） */
+    GstClockTime ts_base;                                                    /* 最近一次切换采样率时的时间戳 */
+    guint64 ts_base_samples;                                                 /* 最近一次切换采样率时的采样计数 */
+    WaveformKernel kernel;                                                   /* 生成器使用的实现（切换格式时重新初始化） */
+#ifdef HEADLESS_BENCH
+    gint64 bench_samples; /* --bench-samples: 生成的采样总数 */
+    BenchReport *report;  /* 基准测试统计 */
+#endif
 } CustomData;
 
+/* 是否已经生成了 max_samples 个采样（离线渲染、基准测试） */
+static gboolean
+samples_done(CustomData *data)
+{
+    return data->max_samples != 0 && data->num_samples >= data->max_samples;
+}
+
+/* 推送完剩余的数据后向 appsrc 发送 EOS，返回 FALSE 以移除空闲函数 */
+static gboolean
+end_stream(CustomData *data)
+{
+    if (data->batch_size > 1)
+        push_batch_flush(&data->batch);
+    gst_app_src_end_of_stream(GST_APP_SRC(data->app_src));
+    data->sourceid = 0;
+    return FALSE;
+}
+
+/* 新格式的第一个 chunk 上保存新 caps 的 qdata */
+static GQuark
+chunk_caps_quark(void)
+{
+    return g_quark_from_static_string("chunk-caps");
+}
+
+static WaveformFormat
+waveform_format_of(const GstAudioInfo *info)
+{
+    return GST_AUDIO_INFO_FORMAT(info) == GST_AUDIO_FORMAT_F32 ? WAVEFORM_FORMAT_F32 : WAVEFORM_FORMAT_S16;
+}
+
 /**
- * This method is called by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
- * The idle handler is added to the mainloop when appsrc requests us to start sending data (need-data signal)
- * and is removed when appsrc has enough data (enough-data signal).
- *
- * 实现数据生成 -> 触发appsrc元素的`push-buffer`事件 -> 传递生成的数据
+ * --native-format: sink 的首选格式变化时（例如切换了输出设备）切换生成器的输出格式，
+ * 返回新的 caps，没有变化时返回 NULL。
+ * 只在生成数据的上下文中调用（主循环或生产者线程），生成器和缓冲池不需要加锁。
+ */
+static GstCaps *
+switch_native_format(CustomData *data)
+{
+    GstAudioInfo info;
+    GstCaps *caps;
+
+    if (!native_format_changed(&data->native, &data->out_info, &info))
+        return NULL;
+    g_print("Sink format changed: %s %d Hz %d channels -> %s %d Hz %d channels\n",
+            GST_AUDIO_INFO_NAME(&data->out_info), GST_AUDIO_INFO_RATE(&data->out_info), GST_AUDIO_INFO_CHANNELS(&data->out_info),
+            GST_AUDIO_INFO_NAME(&info), GST_AUDIO_INFO_RATE(&info), GST_AUDIO_INFO_CHANNELS(&info));
+
+    // 时间戳从当前位置继续，之后按新的采样率计算
+    data->ts_base += gst_util_uint64_scale(data->num_samples - data->ts_base_samples, GST_SECOND, GST_AUDIO_INFO_RATE(&data->out_info));
+    data->ts_base_samples = data->num_samples;
+    data->out_info = info;
+    waveform_clear(&data->wf);
+    waveform_init(&data->wf, GST_AUDIO_INFO_CHANNELS(&info), waveform_format_of(&info), data->kernel);
+
+    // 缓冲池的 caps 和 buffer 大小都变了：停用旧的池，生成这个 chunk 时重新协商
+    feeder_pool_clear(&data->pool);
+    data->pool_ready = FALSE;
+    caps = gst_audio_info_to_caps(&info);
+    gst_caps_replace(&data->audio_caps, caps);
+    return caps;
+}
+
+/**
+ * 推送 buffer 之前调用：新格式的第一个 chunk 带着新的 caps（switch_native_format()），
+ * 在它之前切换 appsrc 的 caps。appsrc 把 caps 变化和 buffer 按顺序放在同一个内部队列中，
+ * 之前推送的旧格式 chunk 仍然以旧的 caps 到达下游。
+ */
+static void
+apply_chunk_caps(CustomData *data, GstBuffer *buffer)
+{
+    GstCaps *caps = gst_mini_object_steal_qdata(GST_MINI_OBJECT(buffer), chunk_caps_quark());
+    GstAudioInfo info;
+
+    if (caps == NULL)
+        return;
+    // 批量模式下攒着的旧格式 chunk 先推送出去
+    if (data->batch_size > 1)
+        push_batch_flush(&data->batch);
+    gst_app_src_set_caps(GST_APP_SRC(data->app_src), caps);
+    // 电平表只处理 S16（app_queue 中还有少量旧格式的 buffer，切换的瞬间电平可能不准）
+    // （生产者线程模式下这里运行在 appsrc 的流线程中，out_info 可能已经是更新的格式，所以从 caps 中读取）
+    if (gst_audio_info_from_caps(&info, caps))
+        data->sink_s16 = GST_AUDIO_INFO_FORMAT(&info) == GST_AUDIO_FORMAT_S16;
+    gst_caps_unref(caps);
+}
+
+/**
+ * Generate the next CHUNK_SIZE bytes of waveform into a new buffer.
  *
+ * 生成下一个 chunk 的波形数据并设置时间戳，数据源结束时返回 NULL。
+ * 默认模式下由主循环的 push_data() 调用，--producer-thread 模式下只由生产者线程调用。
  */
-static gboolean
-push_data(CustomData *data)
+static GstBuffer *
+generate_chunk(CustomData *data)
 {
     GstBuffer *buffer;
-    GstFlowReturn ret;
-    int i;
     GstMapInfo map;
-    gint16 *raw;
+    GstCaps *new_caps = NULL;
     gint num_samples = CHUNK_SIZE / 2; /* Because each sample is 16 bits */
-    gfloat freq;
+    gint rate = SAMPLE_RATE;
+    gsize size;
+
+    if (samples_done(data))
+        return NULL;
 
-    /* Create a new empty buffer */
-    /** 创建(new)结构体并分配(alloc)指定大小的数据区（ GstBuffer的数据结构 + 结构体的数据字段*pool ） */
-    buffer = gst_buffer_new_and_alloc(CHUNK_SIZE);
+    /* Replay mode: wrap the next slice of the mapped file, no copy */
+    // 回放模式：chunk 直接指向映射的文件数据，不分配、不拷贝；时长与合成波形的 chunk 相同（512 帧）
+    if (data->replay.file != NULL)
+    {
+        buffer = pcm_replay_next(&data->replay, num_samples * GST_AUDIO_INFO_BPF(&data->replay.info));
+        if (buffer == NULL)
+            return NULL;
+        num_samples = gst_buffer_get_size(buffer) / GST_AUDIO_INFO_BPF(&data->replay.info);
+        rate = GST_AUDIO_INFO_RATE(&data->replay.info);
+        // 时间戳同样由采样计数计算
+        GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, rate);
+        GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, rate);
+        data->num_samples += num_samples;
+        if (data->latency)
+            latency_stamp_add(buffer);
+        return buffer;
+    }
+
+    /* Follow the sink's native format */
+    // 每个 chunk 固定为 512 帧（原来的 1024 字节 S16 单声道），字节数随格式变化
+    if (data->native_format)
+        new_caps = switch_native_format(data);
+    rate = GST_AUDIO_INFO_RATE(&data->out_info);
+    size = (gsize)num_samples * GST_AUDIO_INFO_BPF(&data->out_info);
+
+    /* Take a buffer from the pool */
+    /**
+     * 原来这里每次都调用 gst_buffer_new_and_alloc(CHUNK_SIZE) 创建(new)结构体并分配(alloc)数据区，
+     * 现在改为从缓冲池中取 buffer，下游用完后 buffer 会回到池中被重复使用。
+     * 第一次调用时 appsrc 已经链接到下游，此时向下游发送 ALLOCATION 查询协商缓冲池。
+     */
+    if (!data->pool_ready)
+    {
+        feeder_pool_setup(&data->pool, data->app_src, data->audio_caps, MAX((gsize)data->pool_buffer_size, size), data->pool_buffers);
+        data->pool_ready = TRUE;
+    }
+    buffer = feeder_pool_acquire(&data->pool, size);
+    // 新格式的第一个 chunk 带上新的 caps，推送它之前切换 appsrc 的 caps，见 apply_chunk_caps()
+    if (new_caps)
+        gst_mini_object_set_qdata(GST_MINI_OBJECT(buffer), chunk_caps_quark(), new_caps, (GDestroyNotify)gst_caps_unref);
 
     /* Set its timestamp and duration */
     /** 将缓冲区看作是GstBuffer结构体指针，在指定的字段写入数据 */
@@ -59,34 +259,66 @@ push_data(CustomData *data)
     // 每个缓冲区都附有计时器和持续时间，描述了缓冲区内容应该被解码、渲染或播放的时刻。
     // buffer->pts =  采样计数 * 单位时间(ns) / 采样率(hz)
     // 注：单位时间/采样率=每个采样的时间长度，所以pts=总采样计数*每个采样时间长度=总时间（ns）
-    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE);
+    // --native-format 切换过采样率时，从切换时的时间戳（ts_base）开始按新的采样率计算
+    GST_BUFFER_TIMESTAMP(buffer) = data->ts_base + gst_util_uint64_scale(data->num_samples - data->ts_base_samples, GST_SECOND, rate);
     // buffer->duration = 本缓冲区的采样个数 * 单位时间(ns) / 采样率(hz)
     // 注：duration= 本缓冲区的采样个数 * 每个采样的时间长度 = 本缓冲区数据的耗时（ns）
-    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, SAMPLE_RATE);
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, rate);
 
     // 将buffer结构体重新映射到map结构体（以可写入方式）
     gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-    // 获取数据区指针
-    raw = (gint16 *)map.data;
 
     /* Generate some psychodelic waveforms */
     // ################## 开始生成波形 ##################
-    data->c += data->d;
-    data->d -= data->c / 1000;
-    freq = 1100 + 1000 * data->d;
-    for (i = 0; i < num_samples; i++) // 生成采样
-    {
-        data->a += data->b;
-        data->b -= data->a / freq;
-        raw[i] = (gint16)(500 * data->a);
-    }
+    // 原来的逐采样递推（data->a += data->b; data->b -= data->a / freq;）改为分块旋转的向量化实现，
+    // 输出与原来一致（误差在 1 个最低有效位以内），见 common/waveform.c
+    waveform_fill(&data->wf, map.data, num_samples);
     // ################## 结束生成波形 ##################
     // 解除内存映射
     gst_buffer_unmap(buffer, &map);
     data->num_samples += num_samples; // 总采样计数器自增
+    // 记录创建时间（--producer-thread 模式下包括在环形队列中等待的时间）
+    if (data->latency)
+        latency_stamp_add(buffer);
+    return buffer;
+}
+
+/**
+ * This method is called by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
+ * The idle handler is added to the mainloop when appsrc requests us to start sending data (need-data signal)
+ * and is removed when appsrc has enough data (enough-data signal).
+ *
+ * 实现数据生成 -> 触发appsrc元素的`push-buffer`事件 -> 传递生成的数据
+ *
+ */
+static gboolean
+push_data(CustomData *data)
+{
+    GstBuffer *buffer;
+    GstFlowReturn ret = GST_FLOW_OK;
+    guint i;
+
+    /* Batching mode: generate a whole batch and push it as one GstBufferList */
+    // 批量模式：一次生成一个批次的 chunk，攒满后 push_batch_add() 用 gst_app_src_push_buffer_list() 一次推送
+    if (data->batch_size > 1)
+    {
+        for (i = 0; i < data->batch.batch_size && ret == GST_FLOW_OK; i++)
+        {
+            if ((buffer = generate_chunk(data)) == NULL)
+                return end_stream(data);
+            apply_chunk_caps(data, buffer);
+            ret = push_batch_add(&data->batch, buffer);
+        }
+        return ret == GST_FLOW_OK;
+    }
+
+    // 数据源结束（回放到文件末尾或基准测试的采样数已满）：发送 EOS
+    if ((buffer = generate_chunk(data)) == NULL)
+        return end_stream(data);
 
     /* Push the buffer into the appsrc */
     // 触发app_source的push-buffer事件（简单理解为函数调用），传输buffer数据。
+    apply_chunk_caps(data, buffer);
     g_signal_emit_by_name(data->app_src, "push-buffer", buffer, &ret);
 
     /* Free the buffer now that we are done with it */
@@ -138,22 +370,201 @@ stop_feed(GstElement *source, CustomData *data)
     }
 }
 
-/* The appsink has received a buffer */
-static GstFlowReturn
-new_sample(GstElement *sink, CustomData *data)
+/**
+ * 唤醒正在等待的一方（生产者或消费者）
+ *
+ * 快速路径上不加锁：只有对方标记了 waiting 时才加锁并广播。
+ * 等待方先设置 waiting 再重新检查条件，通知方先修改环形队列再检查 waiting，
+ * 两边都是带内存屏障的原子操作，所以不会丢失唤醒；等待方还带有超时作为兜底。
+ */
+static void
+wake_waiters(CustomData *data, gint *waiting)
+{
+    if (g_atomic_int_get(waiting))
+    {
+        g_mutex_lock(&data->producer_lock);
+        g_cond_broadcast(&data->producer_cond);
+        g_mutex_unlock(&data->producer_lock);
+    }
+}
+
+/**
+ * 生产者线程：在需要数据（feeding）且环形队列未满时不停地生成 chunk。
+ * 主循环完全不参与数据生成，need-data/enough-data 只用来给这个线程节流。
+ */
+static gpointer
+producer_loop(CustomData *data)
 {
-    GstSample *sample;
+    GstBuffer *buffer = NULL;
+    gint64 chunk_us = G_USEC_PER_SEC * (CHUNK_SIZE / 2) / SAMPLE_RATE; // 一个 chunk 的时长
 
-    /* Retrieve the buffer */
-    g_signal_emit_by_name(sink, "pull-sample", &sample);
-    if (sample)
+#ifdef HEADLESS_BENCH
+    bench_report_add_thread(data->report, "producer");
+#endif
+    if (data->thread_policy)
+        thread_policy_add_thread(data->thread_policy, "producer");
+    while (!g_atomic_int_get(&data->producer_stop))
     {
-        /* The only thing we do in this example is print a * to indicate a received buffer */
-        g_print("*");
-        gst_sample_unref(sample);
-        return GST_FLOW_OK;
+        if (g_atomic_int_get(&data->feeding) && spsc_ring_length(&data->ring) < data->ring.capacity)
+        {
+            if (buffer == NULL && (buffer = generate_chunk(data)) == NULL)
+            {
+                // 数据源已结束：通知消费者在队列取空后发送 EOS，之后只等待退出
+                g_atomic_int_set(&data->producer_done, TRUE);
+                g_atomic_int_set(&data->feeding, FALSE);
+                wake_waiters(data, &data->consumer_waiting);
+                continue;
+            }
+            if (spsc_ring_push(&data->ring, buffer))
+            {
+                buffer = NULL;
+                wake_waiters(data, &data->consumer_waiting);
+            }
+            continue;
+        }
+
+        // 不需要数据或队列已满：休眠，直到消费者取走数据或 appsrc 再次需要数据
+        g_mutex_lock(&data->producer_lock);
+        g_atomic_int_set(&data->producer_waiting, TRUE);
+        if (!g_atomic_int_get(&data->producer_stop) &&
+            (!g_atomic_int_get(&data->feeding) || spsc_ring_length(&data->ring) >= data->ring.capacity))
+            g_cond_wait_until(&data->producer_cond, &data->producer_lock, g_get_monotonic_time() + chunk_us);
+        g_atomic_int_set(&data->producer_waiting, FALSE);
+        g_mutex_unlock(&data->producer_lock);
     }
-    return GST_FLOW_ERROR;
+
+    if (buffer)
+        gst_buffer_unref(buffer);
+    return NULL;
+}
+
+/**
+ * --producer-thread 模式下的 need-data 回调（运行在 appsrc 的流线程中）
+ *
+ * 打开节流标志并唤醒生产者，然后把环形队列中已经生成好的 chunk 全部推送给 appsrc，
+ * 直到队列为空或 appsrc 发出 enough-data。
+ * 如果此时队列为空，说明生产者没跟上（下溢），记录下来并等待生产者生成至少一个 chunk。
+ */
+static void
+ring_need_data(GstElement *source, guint size, CustomData *data)
+{
+    GstBuffer *buffer;
+    GstFlowReturn ret;
+    gint64 chunk_us = G_USEC_PER_SEC * (CHUNK_SIZE / 2) / SAMPLE_RATE;
+
+    g_atomic_int_set(&data->feeding, TRUE);
+    wake_waiters(data, &data->producer_waiting);
+
+    buffer = spsc_ring_pop(&data->ring);
+    if (buffer == NULL)
+    {
+        g_atomic_int_inc(&data->ring_underflows);
+        g_mutex_lock(&data->producer_lock);
+        g_atomic_int_set(&data->consumer_waiting, TRUE);
+        while (!g_atomic_int_get(&data->producer_stop) && (buffer = spsc_ring_pop(&data->ring)) == NULL)
+        {
+            // 生产者已经结束：再检查一次队列（结束标志在最后一个 chunk 入队之后设置），仍为空说明所有数据都已推送
+            if (g_atomic_int_get(&data->producer_done) && (buffer = spsc_ring_pop(&data->ring)) == NULL)
+            {
+                g_atomic_int_set(&data->consumer_waiting, FALSE);
+                g_mutex_unlock(&data->producer_lock);
+                end_stream(data);
+                return;
+            }
+            if (buffer != NULL)
+                break;
+            g_cond_wait_until(&data->producer_cond, &data->producer_lock, g_get_monotonic_time() + chunk_us);
+        }
+        g_atomic_int_set(&data->consumer_waiting, FALSE);
+        g_mutex_unlock(&data->producer_lock);
+    }
+
+    while (buffer != NULL)
+    {
+        apply_chunk_caps(data, buffer);
+        if (data->batch_size > 1)
+        {
+            // 批量模式：攒够一个批次才推送（push_batch_add 接管 buffer）
+            ret = push_batch_add(&data->batch, buffer);
+        }
+        else
+        {
+            g_signal_emit_by_name(data->app_src, "push-buffer", buffer, &ret);
+            gst_buffer_unref(buffer);
+        }
+        wake_waiters(data, &data->producer_waiting);
+        // push-buffer 可能同步触发 enough-data，此时停止推送，剩下的留在队列中
+        if (ret != GST_FLOW_OK || !g_atomic_int_get(&data->feeding))
+            break;
+        buffer = spsc_ring_pop(&data->ring);
+    }
+    // 队列已空：不再等待凑满批次，把攒到的部分推送出去，避免额外的延迟
+    if (data->batch_size > 1)
+        push_batch_flush(&data->batch);
+}
+
+/* --producer-thread 模式下的 enough-data 回调：只关闭节流标志 */
+static void
+ring_enough_data(GstElement *source, CustomData *data)
+{
+    g_atomic_int_set(&data->feeding, FALSE);
+}
+
+/**
+ * The appsink has received a buffer
+ *
+ * 原来这里通过 new-sample 信号 + pull-sample 信号逐个取 sample，只打印一个 *。
+ * 现在由 common/app_consumer.c 注册回调唤醒独立的消费者线程，消费者线程每次取空 appsink 的队列，
+ * 把只读映射的数据交给下面这个 "电平表"：计算 S16 采样的峰值，随统计信息一起打印。
+ */
+static void
+level_consume(gpointer user_data, const guint8 *bytes, gsize size, GstClockTime pts)
+{
+    CustomData *data = user_data;
+    const gint16 *samples = (const gint16 *)bytes;
+    gsize i, n = size / sizeof(gint16);
+    gint peak = 0;
+
+    if (!data->sink_s16)
+        return;
+    for (i = 0; i < n; i++)
+        peak = MAX(peak, ABS(samples[i]));
+    if (peak > g_atomic_int_get(&data->sink_peak))
+        g_atomic_int_set(&data->sink_peak, peak);
+}
+
+static void
+level_eos(gpointer user_data)
+{
+    g_print("appsink: end of stream\n");
+}
+
+static const ConsumerSink level_sink = {level_consume, level_eos};
+
+/* 定时打印缓冲池的命中/未命中统计 */
+static gboolean
+print_stats(CustomData *data)
+{
+    feeder_pool_print_stats(&data->pool, "\n");
+    if (data->batch_size > 1)
+        push_batch_print_stats(&data->batch, "");
+    app_consumer_print_stats(&data->consumer, "");
+    if (data->replay.file)
+        g_print("replay: %u loops, %" G_GUINT64_FORMAT " samples pushed\n", data->replay.loops, data->num_samples);
+    g_print("appsink level: peak %d\n", g_atomic_int_get(&data->sink_peak));
+    g_atomic_int_set(&data->sink_peak, 0);
+    if (data->producer_thread)
+        g_print("producer ring: %d underflows, %u/%u chunks queued\n",
+                g_atomic_int_get(&data->ring_underflows), spsc_ring_length(&data->ring), data->ring.capacity);
+    return TRUE;
+}
+
+/* 数据源结束（回放文件播放完毕、基准测试的采样数已满），所有数据都到达 sink 后退出主循环 */
+static void
+eos_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+    g_print("End-Of-Stream reached.\n");
+    g_main_loop_quit(data->main_loop);
 }
 
 /* This function is called when an error message is posted on the bus */
@@ -171,6 +582,162 @@ error_cb(GstBus *bus, GstMessage *msg, CustomData *data)
     g_free(debug_info);
     g_main_loop_quit(data->main_loop);
 }
+
+/**
+ * 离线渲染模式的生产者线程：不等待任何时钟，全速生成并推送。
+ * appsrc 设置了 block=TRUE，内部队列满时 push 会阻塞，所以唯一的反压来自 appsrc/queue 的容量限制。
+ */
+static gpointer
+render_loop(CustomData *data)
+{
+    GstBuffer *buffer;
+    GstFlowReturn ret = GST_FLOW_OK;
+
+    // generate_chunk() 与实时播放时完全相同，时间戳也相同
+    while (ret == GST_FLOW_OK && !g_atomic_int_get(&data->producer_stop) && (buffer = generate_chunk(data)) != NULL)
+    {
+        if (data->batch_size > 1)
+            ret = push_batch_add(&data->batch, buffer);
+        else
+            ret = gst_app_src_push_buffer(GST_APP_SRC(data->app_src), buffer);
+    }
+    if (ret == GST_FLOW_OK)
+    {
+        push_batch_flush(&data->batch);
+        gst_app_src_end_of_stream(GST_APP_SRC(data->app_src));
+    }
+    return NULL;
+}
+
+/**
+ * 离线渲染模式（--render=FILE）
+ *
+ *     appsrc(is-live=false, block=true) -> queue -> wavenc -> filesink
+ *
+ * filesink 不同步时钟，pipeline 以 CPU 和磁盘能达到的最快速度运行。
+ * 文件名以 .wav 结尾时写 WAV，否则写原始 PCM。结束后打印实时倍数（音频时长 / 实际耗时）。
+ */
+static int
+render_run(CustomData *data, const gchar *path)
+{
+    GstElement *queue, *encoder = NULL, *file_sink;
+    GstAudioInfo info;
+    GstBus *bus;
+    GThread *producer;
+    gint64 start, end;
+    gdouble wall, seconds;
+    gboolean wav = g_str_has_suffix(path, ".wav") || g_str_has_suffix(path, ".WAV");
+
+    data->pipeline = gst_pipeline_new("render-pipeline");
+    data->app_src = gst_element_factory_make("appsrc", "audio_source");
+    queue = gst_element_factory_make("queue", "render_queue");
+    if (wav)
+        encoder = gst_element_factory_make("wavenc", "encoder");
+    file_sink = gst_element_factory_make("filesink", "file_sink");
+    if (!data->pipeline || !data->app_src || !queue || (wav && !encoder) || !file_sink)
+    {
+        g_printerr("Not all elements could be created.\n");
+        return -1;
+    }
+
+    gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
+    if (data->replay.file)
+        info = data->replay.info;
+    data->audio_caps = gst_audio_info_to_caps(&info);
+    g_object_set(data->app_src,
+                 "caps", data->audio_caps,
+                 "format", GST_FORMAT_TIME,
+                 "is-live", FALSE, // 非实时源：不按时钟节奏产生数据
+                 "block", TRUE,    // 内部队列满时阻塞 push，而不是无限增长
+                 NULL);
+    if (data->pool_buffers > 0)
+        g_object_set(data->app_src, "max-bytes", (guint64)MAX(data->pool_buffers / 4, 1) * CHUNK_SIZE, NULL);
+    g_object_set(file_sink, "location", path, NULL);
+    push_batch_init(&data->batch, data->app_src, data->batch_size,
+                    data->batch_latency > 0 ? data->batch_latency * GST_MSECOND : GST_CLOCK_TIME_NONE,
+                    gst_util_uint64_scale(CHUNK_SIZE / 2, GST_SECOND, GST_AUDIO_INFO_RATE(&info)));
+
+    gst_bin_add_many(GST_BIN(data->pipeline), data->app_src, queue, file_sink, NULL);
+    if (encoder)
+        gst_bin_add(GST_BIN(data->pipeline), encoder);
+    if (!(encoder ? gst_element_link_many(data->app_src, queue, encoder, file_sink, NULL)
+                  : gst_element_link_many(data->app_src, queue, file_sink, NULL)))
+    {
+        g_printerr("Elements could not be linked.\n");
+        gst_object_unref(data->pipeline);
+        return -1;
+    }
+
+    bus = gst_element_get_bus(data->pipeline);
+    gst_bus_add_signal_watch(bus);
+    g_signal_connect(G_OBJECT(bus), "message::error", (GCallback)error_cb, data);
+    g_signal_connect(G_OBJECT(bus), "message::eos", (GCallback)eos_cb, data);
+    gst_object_unref(bus);
+
+    g_print("Rendering to %s...\n", path);
+    data->main_loop = g_main_loop_new(NULL, FALSE);
+    start = g_get_monotonic_time();
+    gst_element_set_state(data->pipeline, GST_STATE_PLAYING);
+    producer = g_thread_new("render", (GThreadFunc)render_loop, data);
+    g_main_loop_run(data->main_loop);
+    end = g_get_monotonic_time();
+
+    // 出错时生产者可能阻塞在 push 中：切换到 NULL 会让 push 返回 FLUSHING
+    g_atomic_int_set(&data->producer_stop, TRUE);
+    gst_element_set_state(data->pipeline, GST_STATE_NULL);
+    g_thread_join(producer);
+
+    wall = (gdouble)(end - start) / G_USEC_PER_SEC;
+    seconds = (gdouble)data->num_samples / GST_AUDIO_INFO_RATE(&info);
+    g_print("Rendered %.1f s of audio in %.3f s: %.1fx realtime\n", seconds, wall, seconds / wall);
+    feeder_pool_print_stats(&data->pool, "");
+
+    push_batch_clear(&data->batch);
+    feeder_pool_clear(&data->pool);
+    gst_object_unref(data->pipeline);
+    g_main_loop_unref(data->main_loop);
+    gst_caps_unref(data->audio_caps);
+    return 0;
+}
+#ifdef HEADLESS_BENCH
+/**
+ * 基准测试中模拟的声卡：capsfilter ! fakesink sync=false 组成的 bin，只接受 caps_str 描述的格式。
+ * 单独的 fakesink 什么格式都接受，audioconvert/audioresample 会直接透传，测不出转换的开销。
+ */
+static GstElement *
+make_device_sink(const gchar *caps_str)
+{
+    GstElement *bin, *filter, *sink;
+    GstCaps *caps;
+    GstPad *pad;
+
+    caps = gst_caps_from_string(caps_str);
+    filter = gst_element_factory_make("capsfilter", "audio_device_caps");
+    sink = gst_element_factory_make("fakesink", "audio_device");
+    if (caps == NULL || !filter || !sink)
+    {
+        if (caps)
+            gst_caps_unref(caps);
+        if (filter)
+            gst_object_unref(filter);
+        if (sink)
+            gst_object_unref(sink);
+        return NULL;
+    }
+    g_object_set(filter, "caps", caps, NULL);
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_caps_unref(caps);
+
+    bin = gst_bin_new("audio_sink");
+    gst_bin_add_many(GST_BIN(bin), filter, sink, NULL);
+    gst_element_link(filter, sink);
+    pad = gst_element_get_static_pad(filter, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(pad);
+    return bin;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     CustomData data;
@@ -179,29 +746,233 @@ int main(int argc, char *argv[])
     GstAudioInfo info;
     GstCaps *audio_caps;
     GstBus *bus;
+    GOptionContext *context;
+    GError *error = NULL;
+    gchar *kernel_name = NULL;
+    WaveformKernel kernel = WAVEFORM_KERNEL_AUTO;
+    gchar *replay_path = NULL;
+    gboolean replay_loop = FALSE;
+    gint replay_rate = SAMPLE_RATE, replay_channels = 1;
+    gint streams = 0, workers = g_get_num_processors();
+    gdouble stream_seconds = DEFAULT_STREAM_SECONDS;
+    gboolean csv = FALSE;
+    gchar *render_path = NULL;
+    gdouble render_seconds = DEFAULT_RENDER_SECONDS;
+    QueueTelemetry *telemetry = NULL;
+    gchar *telemetry_path = NULL;
+    gint telemetry_interval = DEFAULT_TELEMETRY_INTERVAL;
+    gchar **policy_rules = NULL;
+    gboolean thread_stats = FALSE;
+    gboolean latency = FALSE;
+    gdouble latency_spike = DEFAULT_LATENCY_SPIKE;
+#ifdef HEADLESS_BENCH
+    gchar *bench_output = NULL;
+    gchar *sink_caps = NULL;
+#endif
 
     /* Initialize custom data structure */
     memset(&data, 0, sizeof(data));
-    data.b = 1; /* For waveform generation */
-    data.d = 1;
+    data.pool_buffers = DEFAULT_POOL_BUFFERS;
+    data.pool_buffer_size = CHUNK_SIZE;
+    data.ring_size = DEFAULT_RING_SIZE;
+    data.batch_size = 1;
+    data.batch_latency = DEFAULT_BATCH_LATENCY;
+#ifdef HEADLESS_BENCH
+    data.bench_samples = DEFAULT_BENCH_SAMPLES;
+#endif
+
+    /* Parse command line options */
+    // 命令行参数，gst_init_get_option_group() 同时处理 GStreamer 自己的参数（如 --gst-debug）
+    GOptionEntry entries[] = {
+        {"pool-buffers", 0, 0, G_OPTION_ARG_INT, &data.pool_buffers, "Number of buffers in the producer pool, 0 disables the pool", "N"},
+        {"pool-buffer-size", 0, 0, G_OPTION_ARG_INT, &data.pool_buffer_size, "Size of each pooled buffer in bytes", "BYTES"},
+        {"producer-thread", 0, 0, G_OPTION_ARG_NONE, &data.producer_thread, "Generate audio on a dedicated thread feeding a lock-free ring", NULL},
+        {"ring-size", 0, 0, G_OPTION_ARG_INT, &data.ring_size, "Capacity of the producer ring in chunks (rounded up to a power of two)", "N"},
+        {"waveform-kernel", 0, 0, G_OPTION_ARG_STRING, &kernel_name, "Waveform generator implementation: auto, scalar, sse or avx2", "NAME"},
+        {"batch-size", 0, 0, G_OPTION_ARG_INT, &data.batch_size, "Chunks per push, > 1 pushes GstBufferLists through gst_app_src_push_buffer_list()", "N"},
+        {"batch-latency", 0, 0, G_OPTION_ARG_INT, &data.batch_latency, "Maximum duration covered by one batch in milliseconds, 0 for no limit", "MS"},
+        {"sink-max-buffers", 0, 0, G_OPTION_ARG_INT, &data.sink_max_buffers, "Maximum buffers queued in appsink, 0 for no limit", "N"},
+        {"sink-drop", 0, 0, G_OPTION_ARG_NONE, &data.sink_drop, "Drop the oldest buffers when appsink is full instead of blocking", NULL},
+        {"streams", 0, 0, G_OPTION_ARG_INT, &streams, "Run N independent generators into an audiomixer instead of the tee demo", "N"},
+        {"workers", 0, 0, G_OPTION_ARG_INT, &workers, "Worker threads generating audio for --streams (default: number of cores)", "N"},
+        {"stream-seconds", 0, 0, G_OPTION_ARG_DOUBLE, &stream_seconds, "Seconds of audio each --streams generator produces", "S"},
+        {"csv", 0, 0, G_OPTION_ARG_NONE, &csv, "Print the --streams result as one CSV line", NULL},
+        {"telemetry", 0, 0, G_OPTION_ARG_FILENAME, &telemetry_path, "Sample queue fill levels into a CSV time series", "FILE"},
+        {"telemetry-interval", 0, 0, G_OPTION_ARG_INT, &telemetry_interval, "Queue sampling interval in milliseconds", "MS"},
+        {"thread-policy", 0, 0, G_OPTION_ARG_STRING_ARRAY, &policy_rules, "Pin/prioritise a streaming thread by element name (or 'producer'), e.g. audio_queue:cpus=2:fifo=50 (repeatable)", "RULE"},
+        {"thread-stats", 0, 0, G_OPTION_ARG_NONE, &thread_stats, "Report per-thread scheduling latency without changing any policy", NULL},
+        {"latency", 0, 0, G_OPTION_ARG_NONE, &latency, "Stamp each chunk with its creation time and report the latency to each branch's sink", NULL},
+        {"latency-spike", 0, 0, G_OPTION_ARG_DOUBLE, &latency_spike, "Count latencies above FACTOR x p50 as spikes", "FACTOR"},
+        {"native-format", 0, 0, G_OPTION_ARG_NONE, &data.native_format, "Generate in the audio sink's preferred format and drop audioconvert/audioresample from the audio branch", NULL},
+        {"render", 0, 0, G_OPTION_ARG_FILENAME, &render_path, "Render offline, as fast as possible, to a .wav or raw PCM file", "FILE"},
+        {"render-seconds", 0, 0, G_OPTION_ARG_DOUBLE, &render_seconds, "Seconds of audio to render with --render", "S"},
+        {"replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path, "Replay a memory-mapped WAV or raw S16LE file instead of the waveform", "FILE"},
+        {"replay-loop", 0, 0, G_OPTION_ARG_NONE, &replay_loop, "Restart the replay file when it ends", NULL},
+        {"replay-rate", 0, 0, G_OPTION_ARG_INT, &replay_rate, "Sample rate of a raw replay file", "HZ"},
+        {"replay-channels", 0, 0, G_OPTION_ARG_INT, &replay_channels, "Channel count of a raw replay file", "N"},
+#ifdef HEADLESS_BENCH
+        {"bench-samples", 0, 0, G_OPTION_ARG_INT64, &data.bench_samples, "Number of samples to generate", "N"},
+        {"bench-output", 0, 0, G_OPTION_ARG_FILENAME, &bench_output, "Write the JSON report to FILE instead of stdout", "FILE"},
+        {"sink-caps", 0, 0, G_OPTION_ARG_STRING, &sink_caps, "Format accepted by the emulated audio device (default " DEFAULT_BENCH_SINK_CAPS ")", "CAPS"},
+#endif
+        {NULL}};
+    context = g_option_context_new("- appsrc and appsink demo");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (data.pool_buffers < 0 || data.pool_buffer_size < CHUNK_SIZE)
+    {
+        g_printerr("--pool-buffers must be >= 0 and --pool-buffer-size must be >= %d\n", CHUNK_SIZE);
+        return -1;
+    }
+    if (data.ring_size <= 0)
+    {
+        g_printerr("--ring-size must be > 0\n");
+        return -1;
+    }
+    if (data.batch_size <= 0 || data.batch_latency < 0)
+    {
+        g_printerr("--batch-size must be > 0 and --batch-latency must be >= 0\n");
+        return -1;
+    }
+    if (data.sink_max_buffers < 0)
+    {
+        g_printerr("--sink-max-buffers must be >= 0\n");
+        return -1;
+    }
+#ifdef HEADLESS_BENCH
+    if (data.bench_samples <= 0)
+    {
+        g_printerr("--bench-samples must be > 0\n");
+        return -1;
+    }
+    data.max_samples = data.bench_samples;
+#endif
+    if (render_seconds <= 0 || telemetry_interval <= 0 || latency_spike <= 1.0)
+    {
+        g_printerr("--render-seconds and --telemetry-interval must be > 0 and --latency-spike must be > 1\n");
+        return -1;
+    }
+    if (kernel_name && !waveform_kernel_from_name(kernel_name, &kernel))
+    {
+        g_printerr("Unknown waveform kernel '%s'\n", kernel_name);
+        return -1;
+    }
+    g_free(kernel_name);
+    if (data.native_format && (replay_path || render_path || streams > 0))
+    {
+        g_printerr("--native-format only applies to the generated waveform in the tee pipeline\n");
+        return -1;
+    }
+    if (policy_rules || thread_stats)
+    {
+        gchar **rule;
+
+        data.thread_policy = thread_policy_new();
+        for (rule = policy_rules; rule && *rule; rule++)
+        {
+            if (!thread_policy_add_rule(data.thread_policy, *rule, &error))
+            {
+                g_printerr("%s\n", error->message);
+                g_clear_error(&error);
+                return -1;
+            }
+        }
+        g_strfreev(policy_rules);
+    }
+
+    /* Map the replay file */
+    if (replay_path)
+    {
+        if (replay_rate <= 0 || replay_channels <= 0)
+        {
+            g_printerr("--replay-rate and --replay-channels must be > 0\n");
+            return -1;
+        }
+        if (!pcm_replay_open(&data.replay, replay_path, replay_loop, replay_rate, replay_channels, &error))
+        {
+            g_printerr("Could not open replay file: %s\n", error->message);
+            g_clear_error(&error);
+            return -1;
+        }
+        g_print("Replaying %s: %s, %d Hz, %d channels, %" G_GSIZE_FORMAT " bytes%s\n", replay_path,
+                GST_AUDIO_INFO_NAME(&data.replay.info), GST_AUDIO_INFO_RATE(&data.replay.info),
+                GST_AUDIO_INFO_CHANNELS(&data.replay.info), data.replay.size, replay_loop ? ", looping" : "");
+        // 回放的 chunk 直接包装文件映射，不使用缓冲池
+        data.pool_buffers = 0;
+        g_free(replay_path);
+    }
+
+    /* Initialize the waveform generator: S16 mono, same as the appsrc caps */
+    waveform_init(&data.wf, 1, WAVEFORM_FORMAT_S16, kernel);
+    g_print("Waveform kernel: %s\n", waveform_kernel_name(data.wf.kernel));
+    data.kernel = kernel;
 
     /* Initialize GStreamer */
     // 初始化
     gst_init(&argc, &argv);
+    // 生成器的输出格式，--native-format 时在下面按 sink 的首选格式修改
+    gst_audio_info_set_format(&data.out_info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
+
+    /* Many-stream scaling mode, see multistream.c */
+    // 多路模式：N 个独立的 appsrc 生成器 -> audiomixer -> fakesink，与下面的 tee 示例无关
+    if (streams > 0)
+    {
+        if (workers <= 0 || stream_seconds <= 0)
+        {
+            g_printerr("--workers and --stream-seconds must be > 0\n");
+            return -1;
+        }
+        return multistream_run(streams, workers, stream_seconds, data.wf.kernel, csv);
+    }
+
+    /* Offline rendering mode */
+    // 离线渲染：不经过 tee 和音视频 sink，直接写文件
+    if (render_path)
+    {
+        gint rate = data.replay.file ? GST_AUDIO_INFO_RATE(&data.replay.info) : SAMPLE_RATE;
+        int ret;
+
+        data.max_samples = (guint64)(render_seconds * rate);
+        ret = render_run(&data, render_path);
+        g_free(render_path);
+        waveform_clear(&data.wf);
+        pcm_replay_close(&data.replay);
+        return ret;
+    }
 
     /* Create the elements */
     // 创建元素
     data.app_src = gst_element_factory_make("appsrc", "audio_source");
     data.tee = gst_element_factory_make("tee", "tee");
     data.audio_queue = gst_element_factory_make("queue", "audio_queue");
-    data.audio_convert1 = gst_element_factory_make("audioconvert", "audio_convert1");
-    data.audio_resample = gst_element_factory_make("audioresample", "audio_resample");
+    // --native-format: 直接生成 sink 的格式，音频分支不需要转换
+    if (!data.native_format)
+    {
+        data.audio_convert1 = gst_element_factory_make("audioconvert", "audio_convert1");
+        data.audio_resample = gst_element_factory_make("audioresample", "audio_resample");
+    }
+#ifdef HEADLESS_BENCH
+    data.audio_sink = make_device_sink(sink_caps ? sink_caps : DEFAULT_BENCH_SINK_CAPS);
+    g_free(sink_caps);
+#else
     data.audio_sink = gst_element_factory_make("autoaudiosink", "audio_sink");
+#endif
     data.video_queue = gst_element_factory_make("queue", "video_queue");
     data.audio_convert2 = gst_element_factory_make("audioconvert", "audio_convert2");
     data.visual = gst_element_factory_make("wavescope", "visual");
     data.video_convert = gst_element_factory_make("videoconvert", "video_convert");
+#ifdef HEADLESS_BENCH
+    data.video_sink = gst_element_factory_make("fakesink", "video_sink");
+#else
     data.video_sink = gst_element_factory_make("autovideosink", "video_sink");
+#endif
     data.app_queue = gst_element_factory_make("queue", "app_queue");
     data.app_sink = gst_element_factory_make("appsink", "app_sink");
 
@@ -210,7 +981,8 @@ int main(int argc, char *argv[])
     data.pipeline = gst_pipeline_new("test-pipeline");
     if (!data.pipeline                                                                                          //
         || !data.app_src || !data.tee                                                                           //
-        || !data.audio_queue || !data.audio_convert1 || !data.audio_resample || !data.audio_sink                //
+        || !data.audio_queue || (!data.native_format && (!data.audio_convert1 || !data.audio_resample))        //
+        || !data.audio_sink                                                                                     //
         || !data.video_queue || !data.audio_convert2 || !data.visual || !data.video_convert || !data.video_sink //
         || !data.app_queue || !data.app_sink                                                                    //
     )
@@ -222,11 +994,36 @@ int main(int argc, char *argv[])
     /* Configure wavescope */
     // 配置波形生成的元素
     g_object_set(data.visual, "shader", 0, "style", 0, NULL);
+#ifdef HEADLESS_BENCH
+    // sync=false：sink 收到 buffer 立即返回，不等待时钟，pipeline 以 CPU 能达到的最快速度运行
+    // （audio_sink 是模拟声卡的 bin，里面的 fakesink 已经设置过）
+    g_object_set(data.video_sink, "sync", FALSE, NULL);
+    g_object_set(data.app_sink, "sync", FALSE, NULL);
+#endif
 
     /* Configure appsrc */
     // 配置appsrc元素
     // 生成caps属性
     gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
+    // 按 sink 的首选格式生成：查询 audio_sink 能接受的 caps，生成器改为输出这个格式
+    if (data.native_format)
+    {
+        if (!native_format_init(&data.native, data.audio_sink, SAMPLE_RATE, &info))
+        {
+            g_printerr("Could not find a format the audio sink accepts without conversion.\n");
+            gst_object_unref(data.pipeline);
+            return -1;
+        }
+        g_print("Native format: %s, %d Hz, %d channels\n", GST_AUDIO_INFO_NAME(&info), GST_AUDIO_INFO_RATE(&info),
+                GST_AUDIO_INFO_CHANNELS(&info));
+        data.out_info = info;
+        waveform_clear(&data.wf);
+        waveform_init(&data.wf, GST_AUDIO_INFO_CHANNELS(&info), waveform_format_of(&info), kernel);
+    }
+    // 回放模式：caps 使用文件的格式（appsrc 和 appsink 都是）
+    if (data.replay.file)
+        info = data.replay.info;
+    data.sink_s16 = GST_AUDIO_INFO_FORMAT(&info) == GST_AUDIO_FORMAT_S16;
     audio_caps = gst_audio_info_to_caps(&info);
     // 配置appsrc元素的属性
     g_object_set(data.app_src,
@@ -234,43 +1031,77 @@ int main(int argc, char *argv[])
                  "format", GST_FORMAT_TIME, // 格式为时间(根据提供的纳秒级时间戳来安排缓冲区的播放顺序和时间)
                  NULL                       // 结束标志
     );
+    // max-bytes: appsrc 内部队列的上限，默认 200000 字节（约 195 个 chunk）。
+    // 缓冲池不会增长，appsrc 队列 + 下游各 queue 中同时存在的 buffer 必须少于池的大小，
+    // 所以这里把 appsrc 队列限制为池的 1/4，其余留给下游的 queue。
+    if (data.pool_buffers > 0)
+        g_object_set(data.app_src, "max-bytes", (guint64)MAX(data.pool_buffers / 4, 1) * CHUNK_SIZE, NULL);
     // 设置appsrc元素的事件回调函数。
     // 在appsrc内部队列数据不足或快满时分别被触发。
     // GStreamer有单独线程处理流，appsrc的数据来源一般也是是其他线程，并不一定来自主线程。
     // 数据的消耗一般也是由程序单独管理，甚至由于数据消耗足够快而不需要处理"enough-data"信号。
-    g_signal_connect(data.app_src, "need-data", G_CALLBACK(start_feed), &data);
-    g_signal_connect(data.app_src, "enough-data", G_CALLBACK(stop_feed), &data);
+    if (data.producer_thread)
+    {
+        // 独立生产者线程模式：need-data/enough-data 只给生产者线程节流，数据从环形队列中取。
+        // min-percent: 队列低于 50% 时就发出 need-data，而不是等到完全为空
+        g_object_set(data.app_src, "min-percent", 50, NULL);
+        g_signal_connect(data.app_src, "need-data", G_CALLBACK(ring_need_data), &data);
+        g_signal_connect(data.app_src, "enough-data", G_CALLBACK(ring_enough_data), &data);
+    }
+    else
+    {
+        g_signal_connect(data.app_src, "need-data", G_CALLBACK(start_feed), &data);
+        g_signal_connect(data.app_src, "enough-data", G_CALLBACK(stop_feed), &data);
+    }
+    // 批量推送：批次大小受延迟预算限制（例如 50ms 约为 4 个 11.6ms 的 chunk）
+    push_batch_init(&data.batch, data.app_src, data.batch_size,
+                    data.batch_latency > 0 ? data.batch_latency * GST_MSECOND : GST_CLOCK_TIME_NONE,
+                    gst_util_uint64_scale(CHUNK_SIZE / 2, GST_SECOND, GST_AUDIO_INFO_RATE(&info)));
+    if (data.batch_size > 1)
+        g_print("Batching %u chunks per push\n", data.batch.batch_size);
 
     /* Configure appsink */
     // 配置appsink元素属性
+    // emit-signals 保持默认值 FALSE：不发出 new-sample 信号，改为注册回调函数
     g_object_set(data.app_sink,
-                 "emit-signals", TRUE, // 允许发出例如`new-sample`的信号(appsink的emit-signals属性的默认值为false)
-                 "caps", audio_caps,   // 能力描述
-                 NULL                  //
+                 "caps", audio_caps, // 能力描述
+                 NULL                //
     );
-    // 配置appsink元素的事件回调函数
-    g_signal_connect(data.app_sink, "new-sample", G_CALLBACK(new_sample), &data);
+    // --native-format: 格式可能在运行中变化，appsink 接受生成器能输出的所有格式
+    if (data.native_format)
+    {
+        GstCaps *native_caps = gst_caps_from_string(NATIVE_FORMAT_CAPS);
+        g_object_set(data.app_sink, "caps", native_caps, NULL);
+        gst_caps_unref(native_caps);
+    }
+    // 注册回调：回调只唤醒消费者线程，消费者线程每次取空队列，数据以只读方式映射后交给 level_sink
+    // max-buffers/drop 决定消费者跟不上时的策略：阻塞（反压到 tee 的所有分支）或丢弃最旧的 buffer
+    app_consumer_attach(&data.consumer, data.app_sink, &level_sink, &data, data.sink_max_buffers, data.sink_drop);
 
-    // 释放caps能力描述结构体
-    gst_caps_unref(audio_caps);
+    // 保留caps，第一次推送数据时用它与下游协商缓冲池
+    data.audio_caps = audio_caps;
 
     /* Link all elements that can be automatically linked because they have "Always" pads */
     // 将所有元素添加到管道
     gst_bin_add_many(
         GST_BIN(data.pipeline),                                                                  //
         data.app_src, data.tee,                                                                  //
-        data.audio_queue, data.audio_convert1, data.audio_resample, data.audio_sink,             //
+        data.audio_queue, data.audio_sink,                                                       //
         data.video_queue, data.audio_convert2, data.visual, data.video_convert, data.video_sink, //
         data.app_queue, data.app_sink,                                                           //
         NULL                                                                                     //
     );
+    if (!data.native_format)
+        gst_bin_add_many(GST_BIN(data.pipeline), data.audio_convert1, data.audio_resample, NULL);
     // 连接元素
     // app_src ->   tee
     //              tee.src_1 -> audio_queue -> audio_convert1 -> audio_resample -> audio_sink
+    //                          （--native-format 时为 audio_queue -> audio_sink）
     //              tee.src_2 -> video_queue -> audio_convert2 -> visual -> video_convert -> video_sink
     //              tee.src_3 -> app_queue -> app_sink
     if (gst_element_link_many(data.app_src, data.tee, NULL) != TRUE ||
-        gst_element_link_many(data.audio_queue, data.audio_convert1, data.audio_resample, data.audio_sink, NULL) != TRUE ||
+        (data.native_format ? !gst_element_link(data.audio_queue, data.audio_sink)
+                            : !gst_element_link_many(data.audio_queue, data.audio_convert1, data.audio_resample, data.audio_sink, NULL)) ||
         gst_element_link_many(data.video_queue, data.audio_convert2, data.visual, data.video_convert, data.video_sink, NULL) != TRUE ||
         gst_element_link_many(data.app_queue, data.app_sink, NULL) != TRUE)
     {
@@ -309,13 +1140,68 @@ int main(int argc, char *argv[])
     gst_object_unref(queue_video_pad);
     gst_object_unref(queue_app_pad);
 
+    /* Measure the latency from chunk creation to each sink */
+    // wavescope 把多个音频 chunk 画成一帧视频，输出的是新 buffer，时间戳要由它转交
+    if (latency)
+    {
+        data.latency = latency_tracker_new(latency_spike);
+        latency_tracker_watch(data.latency, data.audio_sink, data.audio_queue, "audio");
+        latency_tracker_relay(data.latency, data.visual);
+        latency_tracker_watch(data.latency, data.video_sink, data.video_queue, "video");
+        latency_tracker_watch(data.latency, data.app_sink, data.app_queue, "app");
+    }
+
+    /* Renegotiate when the audio sink's format changes */
+    // 切换输出设备时 sink 向上游发送 RECONFIGURE，生成下一个 chunk 之前重新查询
+    if (data.native_format)
+        native_format_watch(&data.native, data.app_src);
+
     /* Instruct the bus to emit signals for each received message, and connect to the interesting signals */
     bus = gst_element_get_bus(data.pipeline); // 获取管道总线
     gst_bus_add_signal_watch(bus);            // 给总线添加信号(事件)监听
     // 给总线添加事件(error)处理回调函数
     g_signal_connect(G_OBJECT(bus), "message::error", (GCallback)error_cb, &data);
+    g_signal_connect(G_OBJECT(bus), "message::eos", (GCallback)eos_cb, &data);
     gst_object_unref(bus);
 
+#ifdef HEADLESS_BENCH
+    data.report = bench_report_new("08.appsrc and appsink");
+    bench_report_watch_threads(data.report, data.pipeline);
+    bench_report_count_sink(data.report, data.audio_sink, "audio_sink");
+    bench_report_count_sink(data.report, data.video_sink, "video_sink");
+    bench_report_count_sink(data.report, data.app_sink, "app_sink");
+    bench_report_start(data.report);
+#endif
+
+    /* Apply the scheduling policy to each streaming thread as it starts */
+    // 音频分支（audio_queue）与视频转换（video_queue）分开在不同的核上，音频线程使用 SCHED_FIFO
+    if (data.thread_policy)
+        thread_policy_watch(data.thread_policy, data.pipeline);
+
+    /* Start the producer thread before the pipeline asks for data */
+    if (data.producer_thread)
+    {
+        spsc_ring_init(&data.ring, data.ring_size);
+        g_mutex_init(&data.producer_lock);
+        g_cond_init(&data.producer_cond);
+        data.producer = g_thread_new("producer", (GThreadFunc)producer_loop, &data);
+    }
+
+    /* Start sampling the queue fill levels */
+    // 采样线程定时读取三个分支 queue 的水位，找出阻塞 tee 的分支
+    if (telemetry_path)
+    {
+        telemetry = queue_telemetry_new(telemetry_interval, telemetry_path);
+        queue_telemetry_add(telemetry, data.audio_queue, "audio");
+        queue_telemetry_add(telemetry, data.video_queue, "video");
+        queue_telemetry_add(telemetry, data.app_queue, "app");
+        if (!queue_telemetry_start(telemetry))
+        {
+            gst_object_unref(data.pipeline);
+            return -1;
+        }
+    }
+
     /* Start playing the pipeline */
     // 开始播放
     gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
@@ -326,9 +1212,29 @@ int main(int argc, char *argv[])
     // 主循环的作用是等待事件触发、调用绑定的事件处理函数。
     // （参考nodejs的事件处理机制，也是有一个循环）
     data.main_loop = g_main_loop_new(NULL, FALSE);
+    // 定时打印缓冲池统计
+    g_timeout_add_seconds(STATS_INTERVAL, (GSourceFunc)print_stats, &data);
     // 运行主循环，实际上也起到了阻塞的作用。
     // 程序在其他地方通过调用g_main_loop_quit退出主循环
     g_main_loop_run(data.main_loop);
+#ifdef HEADLESS_BENCH
+    // 在生产者线程和 pipeline 停止之前读取各线程的 CPU 时间
+    bench_report_stop(data.report);
+    bench_report_write(data.report, data.num_samples, bench_output);
+#endif
+
+    if (telemetry)
+    {
+        queue_telemetry_stop(telemetry);
+        queue_telemetry_print_summary(telemetry);
+        queue_telemetry_free(telemetry);
+    }
+    g_free(telemetry_path);
+    if (data.latency)
+        latency_tracker_print_summary(data.latency);
+    // 流线程退出之前读取调度统计
+    if (data.thread_policy)
+        thread_policy_print_summary(data.thread_policy);
 
     /* Release the request pads from the Tee, and unref them */
     // 释放手动申请的tee.src_pad_[1,2,3]
@@ -340,9 +1246,50 @@ int main(int argc, char *argv[])
     gst_object_unref(tee_pad_2);
     gst_object_unref(tee_pad_3);
 
+    /* Stop the producer thread */
+    if (data.producer_thread)
+    {
+        g_atomic_int_set(&data.producer_stop, TRUE);
+        g_mutex_lock(&data.producer_lock);
+        g_cond_broadcast(&data.producer_cond);
+        g_mutex_unlock(&data.producer_lock);
+    }
+
     /* Free resources */
     // 修改并释放管道状态
     gst_element_set_state(data.pipeline, GST_STATE_NULL);
     gst_object_unref(data.pipeline);
+    if (data.producer_thread)
+    {
+        GstBuffer *buffer;
+
+        g_thread_join(data.producer);
+        while ((buffer = spsc_ring_pop(&data.ring)) != NULL)
+            gst_buffer_unref(buffer);
+        spsc_ring_clear(&data.ring);
+        g_mutex_clear(&data.producer_lock);
+        g_cond_clear(&data.producer_cond);
+    }
+    print_stats(&data);
+    push_batch_clear(&data.batch);
+    app_consumer_clear(&data.consumer);
+    feeder_pool_clear(&data.pool);
+    waveform_clear(&data.wf);
+    pcm_replay_close(&data.replay);
+    gst_caps_unref(data.audio_caps);
+    if (data.native_format)
+    {
+        g_print("native format: %u renegotiations, ended at %s %d Hz %d channels\n", data.native.changes,
+                GST_AUDIO_INFO_NAME(&data.out_info), GST_AUDIO_INFO_RATE(&data.out_info), GST_AUDIO_INFO_CHANNELS(&data.out_info));
+        native_format_clear(&data.native);
+    }
+    if (data.thread_policy)
+        thread_policy_free(data.thread_policy);
+    if (data.latency)
+        latency_tracker_free(data.latency);
+#ifdef HEADLESS_BENCH
+    bench_report_free(data.report);
+    g_free(bench_output);
+#endif
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "multistream.h"
+
+#include <gst/audio/audio.h>
+#include <gst/app/app.h>
+
+#define CHUNK_FRAMES 512  /* 每个 chunk 的帧数，与单路模式相同 */
+#define SAMPLE_RATE 44100 /* 与单路模式相同 */
+#define SLICE_CHUNKS 8    /* worker 处理一路最多生成的 chunk 数，之后让出线程，保证各路公平 */
+#define HISTORY 256       /* 每一路记录最近多少个 chunk 的生成时间（用于计算延迟） */
+#define APPSRC_CHUNKS 4   /* 每个 appsrc 内部队列最多缓存的 chunk 数 */
+
+typedef struct _Multistream Multistream;
+
+/* 一路生成器 */
+typedef struct _Stream
+{
+    Multistream *ms;
+    gint index;
+    GstElement *app_src;
+    Waveform wf;           /* 独立的振荡器状态 */
+    guint64 num_samples;   /* 已生成的采样数 */
+    gboolean eos;          /* 已经发送 EOS */
+    gint feeding;          /* need-data/enough-data 设置的节流标志（原子操作） */
+    gint scheduled;        /* 已经在线程池的队列中或正在被处理（原子操作） */
+    gint64 *gen_time;      /* 第 k 个 chunk 的生成时间存放在 gen_time[k % HISTORY] */
+} Stream;
+
+struct _Multistream
+{
+    Stream *streams;
+    gint n_streams;
+    guint64 total_samples; /* 每一路生成的采样总数 */
+    GThreadPool *pool;     /* 生成波形的线程池 */
+    GstElement *pipeline;
+    /* 延迟统计，只由 fakesink 的流线程写入 */
+    gint64 latency_sum;
+    gint64 latency_max;
+    guint64 latency_count;
+};
+
+/**
+ * 在 worker 线程中为一路生成数据
+ *
+ * scheduled 标志保证同一时刻只有一个 worker 处理这一路，所以 Stream 的状态不需要加锁；
+ * 不同 worker 先后处理同一路时，原子操作的内存屏障保证后一个 worker 看到前一个写入的状态。
+ */
+static void
+generate_stream(Stream *s, Multistream *ms)
+{
+    GstMapInfo map;
+    guint i;
+
+    for (i = 0; i < SLICE_CHUNKS && !s->eos && g_atomic_int_get(&s->feeding); i++)
+    {
+        GstBuffer *buffer;
+        guint64 chunk = s->num_samples / CHUNK_FRAMES;
+
+        if (s->num_samples >= ms->total_samples)
+        {
+            gst_app_src_end_of_stream(GST_APP_SRC(s->app_src));
+            s->eos = TRUE;
+            break;
+        }
+
+        buffer = gst_buffer_new_and_alloc(CHUNK_FRAMES * sizeof(gint16));
+        GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(s->num_samples, GST_SECOND, SAMPLE_RATE);
+        GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(CHUNK_FRAMES, GST_SECOND, SAMPLE_RATE);
+        gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+        waveform_fill(&s->wf, map.data, CHUNK_FRAMES);
+        gst_buffer_unmap(buffer, &map);
+        s->num_samples += CHUNK_FRAMES;
+
+        // 记录生成时间，buffer 经过 appsrc 的队列（加锁）传到下游，sink 线程读取时一定能看到
+        s->gen_time[chunk % HISTORY] = g_get_monotonic_time();
+        // 直接调用 gst_app_src_push_buffer()（接管 buffer），不经过信号
+        if (gst_app_src_push_buffer(GST_APP_SRC(s->app_src), buffer) != GST_FLOW_OK)
+        {
+            s->eos = TRUE;
+            break;
+        }
+    }
+
+    g_atomic_int_set(&s->scheduled, FALSE);
+    // 清除 scheduled 之前 need-data 可能已经到来，此时需要自己重新排队
+    if (!s->eos && g_atomic_int_get(&s->feeding) && g_atomic_int_compare_and_exchange(&s->scheduled, FALSE, TRUE))
+        g_thread_pool_push(ms->pool, s, NULL);
+}
+
+/* appsrc 需要数据：打开节流标志，如果这一路不在线程池中就把它排进去 */
+static void
+stream_need_data(GstElement *source, guint size, Stream *s)
+{
+    g_atomic_int_set(&s->feeding, TRUE);
+    if (g_atomic_int_compare_and_exchange(&s->scheduled, FALSE, TRUE))
+        g_thread_pool_push(s->ms->pool, s, NULL);
+}
+
+static void
+stream_enough_data(GstElement *source, Stream *s)
+{
+    g_atomic_int_set(&s->feeding, FALSE);
+}
+
+/**
+ * fakesink 上的探针：计算端到端延迟
+ *
+ * audiomixer 输出的第 k 个 chunk 要等所有输入的第 k 个 chunk 都到达后才能生成，
+ * 所以延迟 = 现在 - 各路中最晚生成第 k 个 chunk 的时间。
+ */
+static GstPadProbeReturn
+latency_probe(GstPad *pad, GstPadProbeInfo *info, Multistream *ms)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now = g_get_monotonic_time(), latest = 0, latency;
+    guint64 chunk;
+    gint i;
+
+    if (!GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+    chunk = gst_util_uint64_scale(GST_BUFFER_PTS(buffer), SAMPLE_RATE, GST_SECOND) / CHUNK_FRAMES;
+    for (i = 0; i < ms->n_streams; i++)
+        latest = MAX(latest, ms->streams[i].gen_time[chunk % HISTORY]);
+    if (latest == 0)
+        return GST_PAD_PROBE_OK;
+    latency = now - latest;
+    ms->latency_sum += latency;
+    ms->latency_max = MAX(ms->latency_max, latency);
+    ms->latency_count++;
+    return GST_PAD_PROBE_OK;
+}
+
+int
+multistream_run(gint streams, gint workers, gdouble seconds, WaveformKernel kernel, gboolean csv)
+{
+    Multistream ms = {0};
+    GstElement *mixer, *sink;
+    GstAudioInfo info;
+    GstCaps *caps;
+    GstPad *sink_pad;
+    GstBus *bus;
+    GstMessage *msg;
+    GError *error = NULL;
+    gint64 start, end;
+    gdouble wall, rate;
+    gint i, ret = 0;
+
+    ms.n_streams = streams;
+    ms.total_samples = (guint64)(seconds * SAMPLE_RATE) / CHUNK_FRAMES * CHUNK_FRAMES;
+    ms.streams = g_new0(Stream, streams);
+    ms.pool = g_thread_pool_new((GFunc)generate_stream, &ms, workers, TRUE, &error);
+    if (ms.pool == NULL)
+    {
+        g_printerr("Could not create the worker pool: %s\n", error->message);
+        g_clear_error(&error);
+        g_free(ms.streams);
+        return -1;
+    }
+
+    ms.pipeline = gst_pipeline_new("multistream-pipeline");
+    mixer = gst_element_factory_make("audiomixer", "mixer");
+    sink = gst_element_factory_make("fakesink", "sink");
+    if (!ms.pipeline || !mixer || !sink)
+    {
+        g_printerr("Not all elements could be created.\n");
+        return -1;
+    }
+    // audiomixer 每次输出一个 chunk，输出的第 k 个 buffer 对应各路的第 k 个 chunk
+    g_object_set(mixer, "output-buffer-duration", gst_util_uint64_scale(CHUNK_FRAMES, GST_SECOND, SAMPLE_RATE), NULL);
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_bin_add_many(GST_BIN(ms.pipeline), mixer, sink, NULL);
+    gst_element_link(mixer, sink);
+
+    gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
+    caps = gst_audio_info_to_caps(&info);
+    for (i = 0; i < streams; i++)
+    {
+        Stream *s = &ms.streams[i];
+        gchar *name = g_strdup_printf("source_%d", i);
+
+        s->ms = &ms;
+        s->index = i;
+        s->gen_time = g_new0(gint64, HISTORY);
+        waveform_init(&s->wf, 1, WAVEFORM_FORMAT_S16, kernel);
+        s->app_src = gst_element_factory_make("appsrc", name);
+        g_free(name);
+        g_object_set(s->app_src,
+                     "caps", caps,
+                     "format", GST_FORMAT_TIME,
+                     "max-bytes", (guint64)APPSRC_CHUNKS * CHUNK_FRAMES * sizeof(gint16),
+                     NULL);
+        g_signal_connect(s->app_src, "need-data", G_CALLBACK(stream_need_data), s);
+        g_signal_connect(s->app_src, "enough-data", G_CALLBACK(stream_enough_data), s);
+        gst_bin_add(GST_BIN(ms.pipeline), s->app_src);
+        // audiomixer 的 sink pad 是 Request pad，gst_element_link 会自动申请
+        if (!gst_element_link(s->app_src, mixer))
+        {
+            g_printerr("Could not link %s to the mixer.\n", GST_OBJECT_NAME(s->app_src));
+            ret = -1;
+        }
+    }
+    gst_caps_unref(caps);
+
+    sink_pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)latency_probe, &ms, NULL);
+    gst_object_unref(sink_pad);
+
+    if (ret == 0)
+    {
+        if (!csv)
+            g_print("Mixing %d streams of %.1f s with %d workers on %u cores...\n", streams, seconds, workers, g_get_num_processors());
+        start = g_get_monotonic_time();
+        gst_element_set_state(ms.pipeline, GST_STATE_PLAYING);
+
+        /* Wait until error or EOS */
+        bus = gst_element_get_bus(ms.pipeline);
+        msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+        end = g_get_monotonic_time();
+        if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+        {
+            gchar *debug_info;
+
+            gst_message_parse_error(msg, &error, &debug_info);
+            g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), error->message);
+            g_clear_error(&error);
+            g_free(debug_info);
+            ret = -1;
+        }
+        gst_message_unref(msg);
+        gst_object_unref(bus);
+
+        wall = (gdouble)(end - start) / G_USEC_PER_SEC;
+        rate = (gdouble)ms.total_samples * streams / wall;
+        if (ret == 0 && csv)
+            g_print("%d,%d,%u,%.3f,%.0f,%.2f,%.3f,%.3f\n", streams, workers, g_get_num_processors(), wall, rate,
+                    seconds / wall, ms.latency_count ? ms.latency_sum / 1000.0 / ms.latency_count : 0.0,
+                    ms.latency_max / 1000.0);
+        else if (ret == 0)
+            g_print("%d streams, %d workers: %.0f samples/sec aggregate (%.1fx realtime), "
+                    "latency avg %.3f ms, max %.3f ms\n",
+                    streams, workers, rate, seconds / wall,
+                    ms.latency_count ? ms.latency_sum / 1000.0 / ms.latency_count : 0.0, ms.latency_max / 1000.0);
+    }
+
+    /* Free resources */
+    gst_element_set_state(ms.pipeline, GST_STATE_NULL);
+    // 等待线程池中剩余的任务结束（appsrc 已停止，push 会立即返回）
+    g_thread_pool_free(ms.pool, FALSE, TRUE);
+    gst_object_unref(ms.pipeline);
+    for (i = 0; i < streams; i++)
+    {
+        waveform_clear(&ms.streams[i].wf);
+        g_free(ms.streams[i].gen_time);
+    }
+    g_free(ms.streams);
+    return ret;
+}
@@ -0,0 +1,22 @@
+#ifndef MULTISTREAM_H
+#define MULTISTREAM_H
+
+#include <gst/gst.h>
+
+#include "waveform.h"
+
+/**
+ * 多路生成器模式（--streams=N）
+ *
+ * 创建 N 个相互独立的 appsrc 生成器，每个都有自己的振荡器状态，全部送入 audiomixer：
+ *     appsrc_0 ─┐
+ *     appsrc_1 ─┼─> audiomixer -> fakesink sync=false
+ *     ...      ─┘
+ * 波形生成由 --workers 个线程组成的线程池完成，运行结束后报告总吞吐量和延迟，
+ * 用不同的 N 和线程数运行（make bench-streams）即可看出吞吐量和延迟如何随之变化。
+ */
+
+/* 运行多路模式：seconds 为每一路生成的音频时长，csv 为 TRUE 时只输出一行 CSV */
+int multistream_run(gint streams, gint workers, gdouble seconds, WaveformKernel kernel, gboolean csv);
+
+#endif /* MULTISTREAM_H */
@@ -0,0 +1,102 @@
+#include "native_format.h"
+
+#include <string.h>
+
+/* 从 sink 的 caps 中选出首选的、我们能直接生成的格式 */
+static gboolean
+choose_format(NativeFormat *nf, GstAudioInfo *info)
+{
+    GstCaps *sink_caps, *ours, *caps;
+    GstStructure *s;
+    const gchar *format;
+    gint rate, channels;
+
+    sink_caps = gst_pad_query_caps(nf->sink_pad, NULL);
+    ours = gst_caps_from_string(NATIVE_FORMAT_CAPS);
+    // INTERSECT_FIRST：结果按 sink_caps 的顺序排列，第一个结构就是 sink 最想要的
+    caps = gst_caps_intersect_full(sink_caps, ours, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref(sink_caps);
+    gst_caps_unref(ours);
+    if (gst_caps_is_empty(caps))
+    {
+        gst_caps_unref(caps);
+        return FALSE;
+    }
+
+    caps = gst_caps_truncate(caps);
+    caps = gst_caps_make_writable(caps);
+    s = gst_caps_get_structure(caps, 0);
+    // format 可能还是一个列表，取第一个；rate/channels 是范围时取最接近原来格式的值
+    gst_structure_fixate_field(s, "format");
+    gst_structure_fixate_field_nearest_int(s, "rate", nf->preferred_rate);
+    gst_structure_fixate_field_nearest_int(s, "channels", 1);
+    format = gst_structure_get_string(s, "format");
+    gst_structure_get_int(s, "rate", &rate);
+    gst_structure_get_int(s, "channels", &channels);
+
+    // 声道位置使用默认布局（立体声为左右，其他按 GStreamer 的默认顺序）
+    gst_audio_info_set_format(info, gst_audio_format_from_string(format), rate, channels, NULL);
+    gst_caps_unref(caps);
+    return TRUE;
+}
+
+/* appsrc 的 src pad 上的探针：只记下 RECONFIGURE，真正的查询在生成下一个 chunk 时进行 */
+static GstPadProbeReturn
+reconfigure_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    NativeFormat *nf = user_data;
+
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_RECONFIGURE)
+        g_atomic_int_set(&nf->reconfigure, TRUE);
+    return GST_PAD_PROBE_OK;
+}
+
+gboolean
+native_format_init(NativeFormat *nf, GstElement *sink, gint preferred_rate, GstAudioInfo *info)
+{
+    memset(nf, 0, sizeof(*nf));
+    nf->preferred_rate = preferred_rate;
+    // NULL 状态下 autoaudiosink 还没有创建真正的 sink，查询到的只是模板 caps；
+    // 切换到 READY 后它会打开设备，查询结果是设备实际支持的格式
+    if (gst_element_set_state(sink, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+        return FALSE;
+    nf->sink_pad = gst_element_get_static_pad(sink, "sink");
+    if (nf->sink_pad == NULL || !choose_format(nf, info))
+    {
+        native_format_clear(nf);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+native_format_watch(NativeFormat *nf, GstElement *app_src)
+{
+    nf->src_pad = gst_element_get_static_pad(app_src, "src");
+    nf->probe_id = gst_pad_add_probe(nf->src_pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, reconfigure_probe, nf, NULL);
+}
+
+gboolean
+native_format_changed(NativeFormat *nf, const GstAudioInfo *current, GstAudioInfo *info)
+{
+    // tee 链接新分支、queue 重新激活时也会发出 RECONFIGURE，大多数情况下格式并没有变化
+    if (!g_atomic_int_compare_and_exchange(&nf->reconfigure, TRUE, FALSE))
+        return FALSE;
+    if (!choose_format(nf, info) || gst_audio_info_is_equal(info, current))
+        return FALSE;
+    nf->changes++;
+    return TRUE;
+}
+
+void
+native_format_clear(NativeFormat *nf)
+{
+    if (nf->src_pad)
+    {
+        gst_pad_remove_probe(nf->src_pad, nf->probe_id);
+        gst_object_unref(nf->src_pad);
+    }
+    if (nf->sink_pad)
+        gst_object_unref(nf->sink_pad);
+    nf->src_pad = nf->sink_pad = NULL;
+}
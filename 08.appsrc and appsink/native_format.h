@@ -0,0 +1,47 @@
+#ifndef NATIVE_FORMAT_H
+#define NATIVE_FORMAT_H
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+/**
+ * 按音频 sink 的原生格式生成数据（--native-format）
+ *
+ * appsrc 原来固定输出 S16 单声道 44100Hz，而声卡通常工作在 F32LE 48000Hz 立体声（见 06 示例），
+ * 每个 buffer 都要经过 audioconvert 和 audioresample。波形生成器本来就能直接输出 F32/S16、任意声道数，
+ * 所以开始生成数据之前先查询 sink 能接受的 caps，选出它的首选格式，直接按这个格式生成，
+ * 音频分支中的 audioconvert/audioresample 就可以去掉。
+ *
+ * - 选择：sink 的 caps 与 "我们能生成的格式"（S16/F32，交错，1~8 声道）求交集，保留 sink 的顺序（第一个就是它的首选），
+ *   采样率和声道数是范围时取最接近 preferred_rate 和单声道的值（不需要转换时按原来的格式生成，计算量最小）
+ * - 重新协商：输出设备变化时 sink 会向上游发送 RECONFIGURE 事件，appsrc 的 src pad 上的探针记下这个事件，
+ *   生成下一个 chunk 之前重新查询，格式变化时由调用者切换生成器和 appsrc 的 caps
+ */
+
+/* 我们能直接生成的格式 */
+#define NATIVE_FORMAT_CAPS                                        \
+    "audio/x-raw, "                                               \
+    "format = (string) { " GST_AUDIO_NE(F32) ", " GST_AUDIO_NE(S16) " }, " \
+    "layout = (string) interleaved, "                             \
+    "rate = (int) [ 1, MAX ], "                                   \
+    "channels = (int) [ 1, 8 ]"
+
+typedef struct _NativeFormat
+{
+    GstPad *sink_pad;    /* 查询的 pad：音频 sink 的 sink pad */
+    GstPad *src_pad;     /* 安装探针的 pad：appsrc 的 src pad */
+    gulong probe_id;
+    gint preferred_rate; /* sink 的采样率是范围时使用的采样率 */
+    gint reconfigure;    /* 收到 RECONFIGURE 之后需要重新查询（原子操作） */
+    guint changes;       /* 格式变化的次数 */
+} NativeFormat;
+
+/* 查询 sink 的首选格式写入 info（sink 会被切换到 READY，以便 autoaudiosink 创建真正的设备 sink） */
+gboolean native_format_init(NativeFormat *nf, GstElement *sink, gint preferred_rate, GstAudioInfo *info);
+/* 监听 app_src 收到的 RECONFIGURE 事件 */
+void native_format_watch(NativeFormat *nf, GstElement *app_src);
+/* 收到过 RECONFIGURE 时重新查询：首选格式与 current 不同时写入 info 并返回 TRUE */
+gboolean native_format_changed(NativeFormat *nf, const GstAudioInfo *current, GstAudioInfo *info);
+void native_format_clear(NativeFormat *nf);
+
+#endif /* NATIVE_FORMAT_H */
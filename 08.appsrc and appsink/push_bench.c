@@ -0,0 +1,150 @@
+/**
+ * appsrc 推送方式基准测试
+ *
+ * 对比三种把 chunk 交给 appsrc 的方式每秒能推送多少个 chunk：
+ * - signal:  g_signal_emit_by_name(app_src, "push-buffer", ...)，即 08 示例原来的方式
+ * - direct:  gst_app_src_push_buffer()，不经过信号
+ * - list-N:  每 N 个 chunk 攒成一个 GstBufferList，gst_app_src_push_buffer_list() 一次推送
+ *
+ * pipeline 为 appsrc ! queue ! fakesink sync=false，appsrc 设置 block=TRUE，
+ * 推送完 --chunks 个 chunk 后发送 EOS，计时到 EOS 从总线上返回为止（端到端吞吐量）。
+ * chunk 的数据是同一块只读内存，不生成波形，测到的只有推送路径本身的开销。
+ *
+ *   make bench-push
+ *   ./push_bench.out [--chunks=200000]
+ */
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+#include "push_batch.h"
+
+#define CHUNK_SIZE 1024   /* 与 main.c 相同 */
+#define SAMPLE_RATE 44100 /* 与 main.c 相同 */
+
+static guint8 chunk_data[CHUNK_SIZE]; /* 所有 chunk 共用的只读数据 */
+
+/* 创建一个包装 chunk_data 的 buffer 并设置时间戳 */
+static GstBuffer *
+make_chunk(guint64 index)
+{
+    GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, chunk_data, CHUNK_SIZE, 0, CHUNK_SIZE, NULL, NULL);
+    guint64 samples = index * (CHUNK_SIZE / 2);
+
+    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(samples, GST_SECOND, SAMPLE_RATE);
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(CHUNK_SIZE / 2, GST_SECOND, SAMPLE_RATE);
+    return buffer;
+}
+
+/**
+ * 以指定方式推送 chunks 个 chunk，返回每秒的 chunk 数，失败返回 0。
+ * batch 为 0 表示 signal 方式，1 表示 direct 方式，> 1 表示 GstBufferList 批次大小。
+ */
+static gdouble
+run_mode(guint batch, guint64 chunks)
+{
+    GstElement *pipeline, *app_src;
+    GstBus *bus;
+    GstMessage *msg;
+    GstFlowReturn ret = GST_FLOW_OK;
+    PushBatch pb;
+    gint64 start, end;
+    guint64 i;
+
+    pipeline = gst_parse_launch("appsrc name=src format=time block=true max-bytes=65536 "
+                                "caps=audio/x-raw,format=S16LE,rate=44100,channels=1,layout=interleaved "
+                                "! queue ! fakesink sync=false",
+                                NULL);
+    if (pipeline == NULL)
+        return 0;
+    app_src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    push_batch_init(&pb, app_src, MAX(batch, 1), GST_CLOCK_TIME_NONE, 0);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < chunks && ret == GST_FLOW_OK; i++)
+    {
+        GstBuffer *buffer = make_chunk(i);
+
+        if (batch == 0)
+        {
+            g_signal_emit_by_name(app_src, "push-buffer", buffer, &ret);
+            gst_buffer_unref(buffer);
+        }
+        else
+        {
+            ret = push_batch_add(&pb, buffer);
+        }
+    }
+    if (ret == GST_FLOW_OK)
+        ret = push_batch_flush(&pb);
+    gst_app_src_end_of_stream(GST_APP_SRC(app_src));
+
+    // 等待所有数据流过 pipeline
+    bus = gst_element_get_bus(pipeline);
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    end = g_get_monotonic_time();
+    if (msg == NULL || GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+        ret = GST_FLOW_ERROR;
+    if (msg)
+        gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    push_batch_clear(&pb);
+    gst_object_unref(app_src);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    if (ret != GST_FLOW_OK)
+        return 0;
+    return (gdouble)chunks * G_USEC_PER_SEC / (end - start);
+}
+
+int main(int argc, char *argv[])
+{
+    gint chunks = 200000;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"chunks", 0, 0, G_OPTION_ARG_INT, &chunks, "Chunks pushed per measurement", "N"},
+        {NULL}};
+    const guint batches[] = {0, 1, 4, 16, 64};
+    gdouble baseline = 0;
+    guint i;
+
+    context = g_option_context_new("- appsrc push path benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (chunks <= 0)
+    {
+        g_printerr("--chunks must be > 0\n");
+        return -1;
+    }
+    gst_init(&argc, &argv);
+
+    g_print("%-8s %14s %9s\n", "mode", "chunks/sec", "speedup");
+    for (i = 0; i < G_N_ELEMENTS(batches); i++)
+    {
+        gdouble rate = run_mode(batches[i], chunks);
+        gchar *name = batches[i] == 0   ? g_strdup("signal")
+                      : batches[i] == 1 ? g_strdup("direct")
+                                        : g_strdup_printf("list-%u", batches[i]);
+
+        if (rate == 0)
+        {
+            g_printerr("%s: pipeline failed\n", name);
+            g_free(name);
+            return -1;
+        }
+        if (baseline == 0)
+            baseline = rate;
+        g_print("%-8s %14.0f %8.2fx\n", name, rate, rate / baseline);
+        g_free(name);
+    }
+    return 0;
+}
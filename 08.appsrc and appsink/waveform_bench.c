@@ -0,0 +1,200 @@
+/**
+ * 波形生成器微基准测试
+ *
+ * 对比 push_data() 原始的逐采样递推（legacy）与 common/waveform.c 中各个实现（scalar/sse/avx2）
+ * 每秒能生成的采样数，并检查前若干个 chunk 的输出与原始实现的最大误差。
+ *
+ *   make bench-waveform
+ *   ./waveform_bench.out [--seconds=1] [--frames=512]
+ */
+#include <glib.h>
+#include <stdlib.h>
+
+#include "waveform.h"
+
+#define CHECK_CHUNKS 16 /* 误差检查使用的 chunk 数 */
+
+/* 原始实现：逐采样递推，每个采样一次除法；多声道时每个声道独立递推 */
+typedef struct _Legacy
+{
+    gint channels;
+    WaveformFormat format;
+    gfloat *a, *b;
+    gfloat c, d;
+} Legacy;
+
+static void
+legacy_init(Legacy *lg, gint channels, WaveformFormat format)
+{
+    gint ch;
+
+    lg->channels = channels;
+    lg->format = format;
+    lg->a = g_new0(gfloat, channels);
+    lg->b = g_new0(gfloat, channels);
+    for (ch = 0; ch < channels; ch++)
+        lg->b[ch] = 1;
+    lg->c = 0;
+    lg->d = 1;
+}
+
+static void
+legacy_clear(Legacy *lg)
+{
+    g_free(lg->a);
+    g_free(lg->b);
+}
+
+static void
+legacy_fill(Legacy *lg, gpointer out, gint num_frames)
+{
+    gint i, ch;
+    gfloat freq;
+
+    lg->c += lg->d;
+    lg->d -= lg->c / 1000;
+    freq = 1100 + 1000 * lg->d;
+    for (ch = 0; ch < lg->channels; ch++)
+    {
+        gfloat a = lg->a[ch], b = lg->b[ch];
+        for (i = 0; i < num_frames; i++)
+        {
+            a += b;
+            b -= a / freq;
+            if (lg->format == WAVEFORM_FORMAT_S16)
+                ((gint16 *)out)[i * lg->channels + ch] = (gint16)(500 * a);
+            else
+                ((gfloat *)out)[i * lg->channels + ch] = 500 * a / 32768.0f;
+        }
+        lg->a[ch] = a;
+        lg->b[ch] = b;
+    }
+}
+
+/* 运行 seconds 秒，返回每秒生成的采样数（帧数 * 声道数） */
+static gdouble
+run_kernel(gint kernel, gint channels, WaveformFormat format, gint frames, gdouble seconds, gpointer out)
+{
+    Waveform wf;
+    Legacy lg;
+    gint64 start, deadline, now;
+    guint64 chunks = 0;
+    gint i;
+
+    if (kernel < 0)
+        legacy_init(&lg, channels, format);
+    else
+        waveform_init(&wf, channels, format, (WaveformKernel)kernel);
+
+    start = g_get_monotonic_time();
+    deadline = start + (gint64)(seconds * G_USEC_PER_SEC);
+    do
+    {
+        // 每次检查时间之前生成 64 个 chunk，减少计时本身的开销
+        for (i = 0; i < 64; i++)
+        {
+            if (kernel < 0)
+                legacy_fill(&lg, out, frames);
+            else
+                waveform_fill(&wf, out, frames);
+        }
+        chunks += 64;
+        now = g_get_monotonic_time();
+    } while (now < deadline);
+
+    if (kernel < 0)
+        legacy_clear(&lg);
+    else
+        waveform_clear(&wf);
+    return (gdouble)chunks * frames * channels * G_USEC_PER_SEC / (now - start);
+}
+
+/* 前 CHECK_CHUNKS 个 chunk 与原始实现的最大误差（S16 为整数单位，F32 为满幅的比例） */
+static gdouble
+max_error(gint kernel, gint channels, WaveformFormat format, gint frames)
+{
+    gsize bytes = (gsize)frames * channels * (format == WAVEFORM_FORMAT_S16 ? 2 : 4);
+    gpointer ref = g_malloc(bytes), out = g_malloc(bytes);
+    Waveform wf;
+    Legacy lg;
+    gdouble err = 0;
+    gint chunk, i;
+
+    legacy_init(&lg, channels, format);
+    waveform_init(&wf, channels, format, (WaveformKernel)kernel);
+    for (chunk = 0; chunk < CHECK_CHUNKS; chunk++)
+    {
+        legacy_fill(&lg, ref, frames);
+        waveform_fill(&wf, out, frames);
+        for (i = 0; i < frames * channels; i++)
+        {
+            gdouble diff = format == WAVEFORM_FORMAT_S16
+                               ? ABS(((gint16 *)ref)[i] - ((gint16 *)out)[i])
+                               : ABS(((gfloat *)ref)[i] - ((gfloat *)out)[i]);
+            err = MAX(err, diff);
+        }
+    }
+    legacy_clear(&lg);
+    waveform_clear(&wf);
+    g_free(ref);
+    g_free(out);
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    gdouble seconds = 1.0;
+    gint frames = 512; /* 与 08 示例的 chunk 相同：1024 字节 S16 单声道 */
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"seconds", 0, 0, G_OPTION_ARG_DOUBLE, &seconds, "Run time per measurement", "S"},
+        {"frames", 0, 0, G_OPTION_ARG_INT, &frames, "Frames per chunk", "N"},
+        {NULL}};
+    const gint channel_counts[] = {1, 2, 8};
+    const WaveformFormat formats[] = {WAVEFORM_FORMAT_S16, WAVEFORM_FORMAT_F32};
+    gpointer out;
+    guint f, c;
+    gint kernel;
+
+    context = g_option_context_new("- waveform generator microbenchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (frames <= 0 || seconds <= 0)
+    {
+        g_printerr("--frames and --seconds must be > 0\n");
+        return -1;
+    }
+
+    out = g_malloc((gsize)frames * 8 * sizeof(gfloat));
+    g_print("%-6s %-8s %-8s %14s %9s %10s\n", "format", "channels", "kernel", "samples/sec", "speedup", "max-error");
+    for (f = 0; f < G_N_ELEMENTS(formats); f++)
+    {
+        for (c = 0; c < G_N_ELEMENTS(channel_counts); c++)
+        {
+            const gchar *fmt = formats[f] == WAVEFORM_FORMAT_S16 ? "S16" : "F32";
+            gdouble legacy = run_kernel(-1, channel_counts[c], formats[f], frames, seconds, out);
+
+            g_print("%-6s %-8d %-8s %14.0f %8.2fx %10s\n", fmt, channel_counts[c], "legacy", legacy, 1.0, "-");
+            for (kernel = WAVEFORM_KERNEL_SCALAR; kernel < WAVEFORM_KERNEL_COUNT; kernel++)
+            {
+                gdouble rate;
+
+                if (!waveform_kernel_supported((WaveformKernel)kernel))
+                    continue;
+                rate = run_kernel(kernel, channel_counts[c], formats[f], frames, seconds, out);
+                g_print("%-6s %-8d %-8s %14.0f %8.2fx %10.3g\n", fmt, channel_counts[c],
+                        waveform_kernel_name((WaveformKernel)kernel), rate, rate / legacy,
+                        max_error(kernel, channel_counts[c], formats[f], frames));
+            }
+        }
+    }
+    g_free(out);
+    return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * 网络缓冲基准测试
+ *
+ * 本地 HTTP 服务器（common/http_server.c）限速提供一个媒体文件，playbin（fakesink sync=true，按实际速度消耗数据）
+ * 分别用以下配置播放 --seconds 秒：
+ *
+ *   stream     固定的缓冲大小（playbin 默认），只处理 BUFFERING 消息
+ *   adaptive   stream + 根据下载/播放速率调整缓冲时长
+ *   download   渐进式下载到临时文件
+ *   ring       临时文件中的环形缓冲区（BUFFERING_DEFAULT_RING_SIZE）
+ *
+ * 输出启动时间（到第一次进入 PLAYING）、卡顿次数和总时长、queue2 的最大占用、进程的峰值 RSS。
+ * 峰值 RSS 只增不减，所以每个配置在单独的子进程中运行（本程序加上 --run=配置）。
+ *
+ *   make bench-buffering MEDIA=~/Videos/sintel_trailer-480p.webm RATE=150
+ *   ./buffering_bench.out --serve=FILE [--rate=150] [--seconds=30]
+ */
+#include <gst/gst.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "buffering_controller.h"
+#include "http_server.h"
+
+typedef struct _Config
+{
+    const gchar *name;
+    BufferingMode mode;
+    gboolean adaptive;
+} Config;
+
+static const Config configs[] = {
+    {"stream", BUFFERING_MODE_STREAM, FALSE},
+    {"adaptive", BUFFERING_MODE_STREAM, TRUE},
+    {"download", BUFFERING_MODE_DOWNLOAD, FALSE},
+    {"ring", BUFFERING_MODE_RING, FALSE},
+};
+
+typedef struct _BenchData
+{
+    GMainLoop *loop;
+    BufferingController buffering;
+    gboolean failed;
+} BenchData;
+
+static gboolean
+handle_message(GstBus *bus, GstMessage *msg, BenchData *data)
+{
+    GError *err;
+    gchar *debug_info;
+
+    if (buffering_controller_handle_message(&data->buffering, msg))
+        return TRUE;
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &err, &debug_info);
+        g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+        g_clear_error(&err);
+        g_free(debug_info);
+        data->failed = TRUE;
+        g_main_loop_quit(data->loop);
+        break;
+    case GST_MESSAGE_EOS:
+        g_main_loop_quit(data->loop);
+        break;
+    default:
+        break;
+    }
+    return TRUE;
+}
+
+static gboolean
+stop(GMainLoop *loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* 子进程的最后一行（结果），之前是缓冲进度等输出 */
+static const gchar *
+last_line(gchar *output)
+{
+    gchar *end = output + strlen(output), *p;
+
+    while (end > output && (end[-1] == '\n' || end[-1] == '\r'))
+        *--end = '\0';
+    for (p = end; p > output && p[-1] != '\n' && p[-1] != '\r'; p--)
+        ;
+    return p;
+}
+
+/* 子进程：运行一个配置，输出一行结果 */
+static int
+run_config(const Config *config, const gchar *serve, gint rate, gint seconds)
+{
+    gchar *root = g_path_get_dirname(serve), *name = g_path_get_basename(serve), *uri;
+    HttpServer *server;
+    GstElement *playbin;
+    GstBus *bus;
+    BenchData data = {0};
+    gint64 position = 0;
+    struct rusage usage;
+    GError *error = NULL;
+
+    server = http_server_new(root, 0, &error);
+    g_free(root);
+    if (server == NULL)
+    {
+        g_printerr("Could not start the local server: %s\n", error->message);
+        g_clear_error(&error);
+        g_free(name);
+        return 1;
+    }
+    http_server_set_rate(server, (guint64)MAX(rate, 0) * 1024);
+    uri = http_server_get_uri(server, name);
+    g_free(name);
+
+    // sync=true：sink 按时钟消耗数据，下载跟不上时真的会卡顿
+    playbin = gst_element_factory_make("playbin", NULL);
+    g_object_set(playbin, "uri", uri,
+                 "video-sink", gst_element_factory_make("fakesink", NULL),
+                 "audio-sink", gst_element_factory_make("fakesink", NULL), NULL);
+    buffering_controller_init(&data.buffering, playbin, playbin, config->mode, config->adaptive, BUFFERING_DEFAULT_RING_SIZE);
+    bus = gst_element_get_bus(playbin);
+    gst_bus_add_watch(bus, (GstBusFunc)handle_message, &data);
+    data.loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add_seconds(seconds, (GSourceFunc)stop, data.loop);
+
+    if (buffering_controller_start(&data.buffering) == GST_STATE_CHANGE_FAILURE)
+        data.failed = TRUE;
+    else
+        g_main_loop_run(data.loop);
+    gst_element_query_position(playbin, GST_FORMAT_TIME, &position);
+    gst_element_set_state(playbin, GST_STATE_NULL);
+
+    getrusage(RUSAGE_SELF, &usage);
+    if (!data.failed)
+    {
+        // 子进程的输出就是表格的一行
+        g_print("%-9s %11.1f %7u %10.1f %11.1f %11ld %11.1f %9.1f\n", config->name,
+                data.buffering.startup >= 0 ? data.buffering.startup / 1e3 : -1.0,
+                data.buffering.stalls, buffering_controller_get_stall_time(&data.buffering) / 1e3,
+                data.buffering.peak_bytes / 1024.0, usage.ru_maxrss,
+                data.buffering.avg_in / 1024, position / 1e9);
+    }
+
+    buffering_controller_clear(&data.buffering);
+    g_main_loop_unref(data.loop);
+    gst_bus_remove_watch(bus);
+    gst_object_unref(bus);
+    gst_object_unref(playbin);
+    http_server_free(server);
+    g_free(uri);
+    return data.failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    gchar *serve = NULL, *run = NULL, *output;
+    const gchar *line;
+    gint rate = 150, seconds = 30;
+    guint i;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"serve", 0, 0, G_OPTION_ARG_FILENAME, &serve, "Media file to serve from the local HTTP server", "FILE"},
+        {"rate", 0, 0, G_OPTION_ARG_INT, &rate, "Throttle the server to KB/s (default: 150)", "KB"},
+        {"seconds", 0, 0, G_OPTION_ARG_INT, &seconds, "Wall-clock seconds per configuration (default: 30)", "N"},
+        {"run", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &run, "Run a single configuration", "NAME"},
+        {NULL}};
+
+    context = g_option_context_new("- network buffering benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (serve == NULL)
+    {
+        g_printerr("Usage: %s --serve=FILE [--rate=KB] [--seconds=N]\n", argv[0]);
+        return -1;
+    }
+
+    if (run != NULL)
+    {
+        for (i = 0; i < G_N_ELEMENTS(configs); i++)
+        {
+            if (strcmp(run, configs[i].name) == 0)
+                return run_config(&configs[i], serve, rate, MAX(seconds, 1));
+        }
+        g_printerr("Unknown configuration: %s\n", run);
+        return -1;
+    }
+
+    g_print("%s via 127.0.0.1 at %d KB/s, %d s per run\n\n", serve, rate, seconds);
+    g_print("%-9s %11s %7s %10s %11s %11s %11s %9s\n",
+            "config", "startup-ms", "stalls", "stall-ms", "queue-KB", "rss-KB", "in-KB/s", "played-s");
+    for (i = 0; i < G_N_ELEMENTS(configs); i++)
+    {
+        gchar *rate_arg = g_strdup_printf("--rate=%d", rate), *seconds_arg = g_strdup_printf("--seconds=%d", seconds),
+              *serve_arg = g_strdup_printf("--serve=%s", serve), *run_arg = g_strdup_printf("--run=%s", configs[i].name);
+        gchar *child_argv[] = {argv[0], serve_arg, rate_arg, seconds_arg, run_arg, NULL};
+
+        output = NULL;
+        if (!g_spawn_sync(NULL, child_argv, NULL, G_SPAWN_DEFAULT, NULL, NULL, &output, NULL, NULL, &error))
+        {
+            g_printerr("Could not run %s: %s\n", configs[i].name, error->message);
+            g_clear_error(&error);
+        }
+        // 子进程的 stderr 直接输出，只收集 stdout
+        line = output != NULL ? last_line(output) : "";
+        if (g_str_has_prefix(line, configs[i].name))
+            g_print("%s\n", line);
+        else
+            g_print("%-9s %11s\n", configs[i].name, "failed");
+        g_free(output);
+        g_free(rate_arg);
+        g_free(seconds_arg);
+        g_free(serve_arg);
+        g_free(run_arg);
+    }
+    g_free(serve);
+    return 0;
+}
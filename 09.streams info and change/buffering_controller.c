@@ -0,0 +1,290 @@
+#include "buffering_controller.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#define MIN_DURATION (1 * GST_SECOND)   /* adaptive：开始时的缓冲时长，尽快出第一帧 */
+#define MAX_DURATION (60 * GST_SECOND)  /* adaptive：缓冲时长的上限 */
+#define MAX_DOUBLINGS 5                 /* 卡顿后加倍的次数上限 */
+#define SAMPLE_INTERVAL 500             /* 采样 queue2 的间隔（毫秒） */
+#define RATE_SMOOTHING 0.3              /* 速率的指数平滑系数 */
+
+#define GST_PLAY_FLAG_DOWNLOAD (1 << 7) /* playbin flags：渐进式下载 */
+
+static gboolean
+has_property(GstElement *element, const gchar *name)
+{
+    return g_object_class_find_property(G_OBJECT_GET_CLASS(element), name) != NULL;
+}
+
+static void
+update_rate(gdouble *avg, gint rate)
+{
+    if (rate <= 0)
+        return;
+    *avg = *avg > 0 ? *avg + RATE_SMOOTHING * (rate - *avg) : rate;
+}
+
+/* uridecodebin 插入 queue2 时记下它（流线程） */
+static void
+deep_element_added(GstBin *bin, GstBin *sub_bin, GstElement *element, BufferingController *bc)
+{
+    GstElementFactory *factory = gst_element_get_factory(element);
+
+    if (factory == NULL || strcmp(GST_OBJECT_NAME(factory), "queue2") != 0)
+        return;
+    g_mutex_lock(&bc->lock);
+    if (bc->queue == NULL)
+        bc->queue = gst_object_ref(element);
+    g_mutex_unlock(&bc->lock);
+}
+
+static GstElement *
+get_queue(BufferingController *bc)
+{
+    GstElement *queue;
+
+    g_mutex_lock(&bc->lock);
+    queue = bc->queue ? gst_object_ref(bc->queue) : NULL;
+    g_mutex_unlock(&bc->lock);
+    return queue;
+}
+
+/**
+ * 缓冲时长：每卡顿一次加倍；下载比播放慢时，至少缓冲 剩余时长 × (1 - in/out)，
+ * 这样缓冲满之后下载的速度足以支撑播放到结束
+ */
+static GstClockTime
+compute_target(BufferingController *bc)
+{
+    GstClockTime target = MIN_DURATION << MIN(bc->stalls, MAX_DOUBLINGS);
+    gint64 position, duration;
+
+    if (bc->avg_in > 0 && bc->avg_in < bc->avg_out &&
+        gst_element_query_position(bc->pipeline, GST_FORMAT_TIME, &position) &&
+        gst_element_query_duration(bc->pipeline, GST_FORMAT_TIME, &duration) && duration > position)
+    {
+        target = MAX(target, (GstClockTime)((duration - position) * (1.0 - bc->avg_in / bc->avg_out)));
+    }
+    return MIN(target, MAX_DURATION);
+}
+
+/* 调整 queue2 的缓冲时长：只增不减，已经缓冲的数据不会被丢弃 */
+static void
+retune(BufferingController *bc)
+{
+    GstClockTime target;
+    GstElement *queue;
+
+    if (!bc->adaptive || bc->mode == BUFFERING_MODE_DOWNLOAD)
+        return;
+    target = compute_target(bc);
+    if (target <= bc->target)
+        return;
+    queue = get_queue(bc);
+    if (queue == NULL)
+        return;
+    bc->target = target;
+    // 字节数不限，由时长决定缓冲多少（ring 模式下字节数受 ring-buffer-max-size 限制）
+    g_object_set(queue, "max-size-time", (guint64)target, "max-size-bytes", 0, NULL);
+    g_print("Buffering target: %.1f s (in %.1f KB/s, out %.1f KB/s)\n",
+            target / 1e9, bc->avg_in / 1024, bc->avg_out / 1024);
+    gst_object_unref(queue);
+}
+
+/* 定期采样 queue2 的占用和下载速率，播放中发现下载跟不上时提前增加缓冲时长 */
+static gboolean
+sample_queue(BufferingController *bc)
+{
+    GstElement *queue = get_queue(bc);
+    guint level = 0;
+    gint64 rate = 0;
+
+    if (queue == NULL)
+        return G_SOURCE_CONTINUE;
+    g_object_get(queue, "current-level-bytes", &level, NULL);
+    bc->peak_bytes = MAX(bc->peak_bytes, level);
+    if (has_property(queue, "avg-in-rate"))
+    {
+        g_object_get(queue, "avg-in-rate", &rate, NULL);
+        update_rate(&bc->avg_in, (gint)MIN(rate, G_MAXINT));
+    }
+    gst_object_unref(queue);
+    if (!bc->buffering)
+        retune(bc);
+    return G_SOURCE_CONTINUE;
+}
+
+void buffering_controller_init(BufferingController *bc, GstElement *pipeline, GstElement *decoder,
+                               BufferingMode mode, gboolean adaptive, guint64 ring_size)
+{
+    gint flags;
+
+    memset(bc, 0, sizeof(*bc));
+    g_mutex_init(&bc->lock);
+    bc->pipeline = pipeline;
+    bc->decoder = decoder;
+    bc->mode = mode;
+    bc->adaptive = adaptive;
+    bc->startup = -1;
+    bc->percent = 100;
+
+    // playbin 总是使用缓冲；单独使用的 uridecodebin 默认不发送 BUFFERING 消息
+    if (has_property(decoder, "use-buffering"))
+        g_object_set(decoder, "use-buffering", TRUE, NULL);
+    if (mode != BUFFERING_MODE_STREAM)
+    {
+        if (has_property(decoder, "flags"))
+        {
+            g_object_get(decoder, "flags", &flags, NULL);
+            g_object_set(decoder, "flags", flags | GST_PLAY_FLAG_DOWNLOAD, NULL);
+        }
+        else
+        {
+            g_object_set(decoder, "download", TRUE, NULL);
+        }
+    }
+    if (mode == BUFFERING_MODE_RING)
+        g_object_set(decoder, "ring-buffer-max-size", ring_size, NULL);
+    if (adaptive && mode != BUFFERING_MODE_DOWNLOAD)
+    {
+        // 开始时只缓冲 MIN_DURATION，之后由 retune() 增加
+        bc->target = MIN_DURATION;
+        g_object_set(decoder, "buffer-duration", (gint64)MIN_DURATION, "buffer-size", 0, NULL);
+    }
+    bc->element_added_id = g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(deep_element_added), bc);
+}
+
+GstStateChangeReturn buffering_controller_start(BufferingController *bc)
+{
+    GstStateChangeReturn ret;
+
+    bc->start_time = g_get_monotonic_time();
+    ret = gst_element_set_state(bc->pipeline, GST_STATE_PLAYING);
+    bc->is_live = ret == GST_STATE_CHANGE_NO_PREROLL;
+    if (ret != GST_STATE_CHANGE_FAILURE)
+        bc->sample_id = g_timeout_add(SAMPLE_INTERVAL, (GSourceFunc)sample_queue, bc);
+    return ret;
+}
+
+static void
+handle_buffering(BufferingController *bc, GstMessage *msg)
+{
+    gint percent, avg_in, avg_out;
+    gint64 now = g_get_monotonic_time();
+
+    gst_message_parse_buffering(msg, &percent);
+    gst_message_parse_buffering_stats(msg, NULL, &avg_in, &avg_out, NULL);
+    update_rate(&bc->avg_in, avg_in);
+    update_rate(&bc->avg_out, avg_out);
+    bc->percent = percent;
+    // 用测得的下载速率代替固定的 connection-speed（kbps）
+    if (bc->avg_in > 0 && has_property(bc->decoder, "connection-speed"))
+        g_object_set(bc->decoder, "connection-speed", (guint64)(bc->avg_in * 8 / 1000), NULL);
+    if (bc->is_live)
+        return;
+
+    if (percent < 100)
+    {
+        g_print("Buffering... %3d%%  \r", percent);
+        if (!bc->buffering)
+        {
+            bc->buffering = TRUE;
+            gst_element_set_state(bc->pipeline, GST_STATE_PAUSED);
+            // 开始播放之后的缓冲是一次卡顿
+            if (bc->startup >= 0)
+            {
+                bc->stalls++;
+                bc->stall_start = now;
+                retune(bc);
+            }
+        }
+    }
+    else if (bc->buffering)
+    {
+        g_print("Buffering... done\n");
+        bc->buffering = FALSE;
+        if (bc->stall_start > 0)
+        {
+            bc->stall_time += now - bc->stall_start;
+            bc->stall_start = 0;
+        }
+        gst_element_set_state(bc->pipeline, GST_STATE_PLAYING);
+    }
+}
+
+gboolean buffering_controller_handle_message(BufferingController *bc, GstMessage *msg)
+{
+    GstState old_state, new_state, pending_state;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_BUFFERING:
+        handle_buffering(bc, msg);
+        return TRUE;
+    case GST_MESSAGE_STATE_CHANGED:
+        gst_message_parse_state_changed(msg, &old_state, &new_state, &pending_state);
+        if (GST_MESSAGE_SRC(msg) == GST_OBJECT(bc->pipeline) && new_state == GST_STATE_PLAYING && bc->startup < 0)
+            bc->startup = g_get_monotonic_time() - bc->start_time;
+        return FALSE;
+    default:
+        return FALSE;
+    }
+}
+
+gint64 buffering_controller_get_stall_time(BufferingController *bc)
+{
+    gint64 stall_time = bc->stall_time;
+
+    // 还没有结束的卡顿也算进去
+    if (bc->stall_start > 0)
+        stall_time += g_get_monotonic_time() - bc->stall_start;
+    return stall_time;
+}
+
+void buffering_controller_print_stats(BufferingController *bc)
+{
+    struct rusage usage;
+    gint64 stall_time = buffering_controller_get_stall_time(bc);
+
+    getrusage(RUSAGE_SELF, &usage);
+    g_print("Buffering: mode %s%s", buffering_mode_to_string(bc->mode), bc->adaptive ? " (adaptive)" : "");
+    if (bc->startup >= 0)
+        g_print(", startup %.1f ms", bc->startup / 1e3);
+    g_print(", %u stall(s) %.1f ms, peak queue %.1f KB, download %.1f KB/s, peak RSS %ld KB\n",
+            bc->stalls, stall_time / 1e3, bc->peak_bytes / 1024.0, bc->avg_in / 1024, usage.ru_maxrss);
+}
+
+void buffering_controller_clear(BufferingController *bc)
+{
+    if (bc->sample_id != 0)
+        g_source_remove(bc->sample_id);
+    if (bc->element_added_id != 0)
+        g_signal_handler_disconnect(bc->pipeline, bc->element_added_id);
+    if (bc->queue != NULL)
+        gst_object_unref(bc->queue);
+    g_mutex_clear(&bc->lock);
+    memset(bc, 0, sizeof(*bc));
+}
+
+static const gchar *mode_names[] = {"stream", "download", "ring"};
+
+gboolean buffering_mode_from_string(const gchar *str, BufferingMode *mode)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(mode_names); i++)
+    {
+        if (g_strcmp0(str, mode_names[i]) == 0)
+        {
+            *mode = (BufferingMode)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+const gchar *buffering_mode_to_string(BufferingMode mode)
+{
+    return mode_names[mode];
+}
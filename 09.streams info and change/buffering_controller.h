@@ -0,0 +1,79 @@
+#ifndef BUFFERING_CONTROLLER_H
+#define BUFFERING_CONTROLLER_H
+
+#include <gst/gst.h>
+
+/**
+ * 网络播放的缓冲控制（代替固定的 connection-speed）
+ *
+ * 播放网络文件时 uridecodebin 在源后面插入 queue2，队列的填充程度通过 GST_MESSAGE_BUFFERING（0~100%）报告。
+ * 应用需要在缓冲不足时暂停 pipeline、缓冲到 100% 后再继续播放，否则数据一断就会卡住。这里：
+ *
+ * - 处理 BUFFERING 消息：低于 100% 时暂停，到 100% 时恢复；第一次进入 PLAYING 之后的暂停记为一次卡顿（stall）
+ * - 三种缓冲方式：
+ *     stream    queue2 在内存中缓冲一段时间的数据（默认）
+ *     download  整个文件下载到临时文件，queue2 根据下载速度估计何时可以不中断地播放到结束
+ *     ring      同样缓冲到临时文件，但只保留 ring-buffer-max-size 字节的环形缓冲区
+ * - adaptive：根据 queue2 报告的下载速率（avg-in）和播放消耗速率（avg-out）调整 queue2 的 max-size-time：
+ *     开始时只缓冲 MIN_DURATION，尽快出第一帧；每卡顿一次缓冲时长加倍；
+ *     下载比播放慢时缓冲 剩余时长 × (1 - in/out)，缓冲满之后可以不再卡顿地播放到结束
+ * - 测得的下载速率同时写入 connection-speed（kbps），自适应流（HLS/DASH）据此选择码率
+ *
+ * 统计：启动时间（开始播放到第一次进入 PLAYING）、卡顿次数和总时长、queue2 的最大占用、下载速率。
+ */
+
+typedef enum
+{
+    BUFFERING_MODE_STREAM,
+    BUFFERING_MODE_DOWNLOAD,
+    BUFFERING_MODE_RING
+} BufferingMode;
+
+#define BUFFERING_DEFAULT_RING_SIZE (16 * 1024 * 1024)
+
+typedef struct _BufferingController
+{
+    GstElement *pipeline;     /* 接收状态切换的 pipeline */
+    GstElement *decoder;      /* playbin 或 uridecodebin：缓冲方式、connection-speed 设置在它上面 */
+    BufferingMode mode;
+    gboolean adaptive;
+    gboolean is_live;         /* 直播源没有缓冲，不暂停 */
+    gulong element_added_id;
+
+    GMutex lock;              /* 保护 queue：deep-element-added 在流线程中调用 */
+    GstElement *queue;        /* uridecodebin 内部的 queue2 */
+
+    gint64 start_time;        /* buffering_controller_start() 的时刻（单调时钟，微秒） */
+    gint64 startup;           /* 第一次进入 PLAYING 的耗时（微秒），-1 表示还没有 */
+    gboolean buffering;       /* 正在缓冲（pipeline 被暂停） */
+    gint64 stall_start;
+    guint stalls;
+    gint64 stall_time;        /* 卡顿的总时长（微秒） */
+    gint percent;             /* 最近一次的缓冲百分比 */
+    gdouble avg_in, avg_out;  /* 下载速率、消耗速率（字节/秒，指数平滑） */
+    guint64 peak_bytes;       /* queue2 的最大占用（current-level-bytes） */
+    GstClockTime target;      /* adaptive：当前的缓冲时长 */
+    guint sample_id;          /* 定时采样 queue2 占用的 GSource */
+} BufferingController;
+
+/**
+ * decoder 是 playbin 或 uridecodebin（--instant 模式），缓冲方式通过它的属性设置；
+ * ring_size 为 ring 模式的环形缓冲区大小（字节）
+ */
+void buffering_controller_init(BufferingController *bc, GstElement *pipeline, GstElement *decoder,
+                               BufferingMode mode, gboolean adaptive, guint64 ring_size);
+/* 开始计时并把 pipeline 设置为 PLAYING */
+GstStateChangeReturn buffering_controller_start(BufferingController *bc);
+/* 总线消息：处理 BUFFERING（返回 TRUE）和 pipeline 的 STATE_CHANGED（返回 FALSE，调用者继续处理） */
+gboolean buffering_controller_handle_message(BufferingController *bc, GstMessage *msg);
+/* 卡顿的总时长（微秒），包括还没有结束的卡顿 */
+gint64 buffering_controller_get_stall_time(BufferingController *bc);
+/* 输出统计（以及进程的峰值 RSS） */
+void buffering_controller_print_stats(BufferingController *bc);
+void buffering_controller_clear(BufferingController *bc);
+
+/* 解析 stream/download/ring */
+gboolean buffering_mode_from_string(const gchar *str, BufferingMode *mode);
+const gchar *buffering_mode_to_string(BufferingMode mode);
+
+#endif /* BUFFERING_CONTROLLER_H */
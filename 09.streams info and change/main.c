@@ -1,11 +1,22 @@
 // playback-tutorial-1.c
 #include <gst/gst.h>
 #include <stdio.h>
+#include <sys/resource.h>
+
+#include "buffering_controller.h"
+#include "http_server.h"
+#include "media_index.h"
+#include "switch_latency.h"
+#include "track_selector.h"
+
+#define DEFAULT_URI "https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_cropped_multilingual.webm"
+#define STATS_INTERVAL 5 /* CPU 占用的输出间隔（秒） */
 
 /* Structure to contain all our information, so we can pass it around */
 typedef struct _CustomData
 {
-    GstElement *playbin; /* Our one and only element */
+    GstElement *playbin;  /* Our one and only element */
+    GstElement *pipeline; /* 正在运行的 pipeline：playbin，或者 --instant 模式下自己搭建的 pipeline */
 
     gint n_video; /* Number of embedded video streams */
     gint n_audio; /* Number of embedded audio streams */
@@ -16,6 +27,14 @@ typedef struct _CustomData
     gint current_text;  /* Currently playing subtitle stream */
 
     GMainLoop *main_loop; /* GLib's Main Loop */
+
+    gboolean instant;       /* --instant: 所有音轨同时解码，用 input-selector 切换 */
+    TrackSelector selector; /* --instant 模式的 pipeline */
+    SwitchLatency latency;  /* 切换延迟的测量（两种模式都有） */
+    GstClockTime last_cpu;  /* 上次输出时进程的 CPU 时间 */
+    gint64 last_stats;      /* 上次输出的时刻（单调时钟，微秒） */
+
+    BufferingController buffering; /* 网络缓冲：卡顿时暂停，统计启动时间和卡顿 */
 } CustomData;
 
 /* playbin flags */
@@ -29,47 +48,146 @@ typedef enum
 /* Forward definition for the message and keyboard processing functions */
 static gboolean handle_message(GstBus *bus, GstMessage *msg, CustomData *data);
 static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomData *data);
+static gboolean print_cpu_stats(CustomData *data);
+static void print_indexed_streams(const gchar *path, const gchar *uri);
 
-int main(int argc, char *argv[])
+/* 进程的 CPU 时间（用户态 + 内核态） */
+static GstClockTime
+process_cpu_time(void)
 {
-    CustomData data;
-    GstBus *bus;
-    GstStateChangeReturn ret;
-    gint flags;
-    GIOChannel *io_stdin;
+    struct rusage usage;
 
-    /* Initialize GStreamer */
-    gst_init(&argc, &argv);
+    getrusage(RUSAGE_SELF, &usage);
+    return GST_TIMEVAL_TO_TIME(usage.ru_utime) + GST_TIMEVAL_TO_TIME(usage.ru_stime);
+}
+
+/* --instant：自己搭建的 pipeline，所有音轨同时解码 */
+static gboolean
+create_selector_pipeline(CustomData *data, const gchar *uri)
+{
+    if (!track_selector_init(&data->selector, uri))
+        return FALSE;
+    data->pipeline = data->selector.pipeline;
+    switch_latency_init(&data->latency, data->pipeline, data->selector.audio_sink);
+    return TRUE;
+}
+
+/* playbin：通过 current-audio 切换音轨 */
+static gboolean
+create_playbin(CustomData *data, const gchar *uri)
+{
+    GstElement *audio_sink;
+    gint flags;
 
     /* Create the elements */
-    data.playbin = gst_element_factory_make("playbin", "playbin");
+    data->playbin = gst_element_factory_make("playbin", "playbin");
+    // 自己创建音频 sink，以便在它的 sink pad 上测量切换延迟（playbin 默认也是使用 autoaudiosink）
+    audio_sink = gst_element_factory_make("autoaudiosink", "audio_sink");
 
-    if (!data.playbin)
-    {
-        g_printerr("Not all elements could be created.\n");
-        return -1;
-    }
+    if (!data->playbin || !audio_sink)
+        return FALSE;
+    data->pipeline = data->playbin;
+    switch_latency_init(&data->latency, data->pipeline, audio_sink);
+    g_object_set(data->playbin, "audio-sink", audio_sink, NULL);
 
     /* Set the URI to play */
-    g_object_set(data.playbin, "uri", "https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_cropped_multilingual.webm", NULL);
+    g_object_set(data->playbin, "uri", uri, NULL);
     // 额外添加字幕流（媒体文件本身就包含了多个字幕流，通过suburi属性设置的字幕流将会被加入字幕列表中并成为当前选中的字幕。）
-    g_object_set(data.playbin, "suburi", "https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer_gr.srt", NULL);
+    g_object_set(data->playbin, "suburi", "https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer_gr.srt", NULL);
     // subtitle-font-desc属性值的格式是：[FAMILY-LIST（字体）] [STYLE-OPTIONS（字体属性）] [SIZE（字号）]
-    g_object_set(data.playbin, "subtitle-font-desc", "Sans, 18", NULL);
+    g_object_set(data->playbin, "subtitle-font-desc", "Sans, 18", NULL);
     /* Set flags to show Audio and Video but ignore Subtitles */
-    g_object_get(data.playbin, "flags", &flags, NULL); // 获取flags默认值
+    g_object_get(data->playbin, "flags", &flags, NULL); // 获取flags默认值
     // 使用音频和视频，取消字幕，其他值保留默认值
     flags |= GST_PLAY_FLAG_VIDEO | GST_PLAY_FLAG_AUDIO; // 修改flag
     flags &= ~GST_PLAY_FLAG_TEXT;
-    g_object_set(data.playbin, "flags", flags, NULL); // 写入flags
+    g_object_set(data->playbin, "flags", flags, NULL); // 写入flags
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    CustomData data = {0};
+    GstBus *bus;
+    GstStateChangeReturn ret;
+    GIOChannel *io_stdin;
+    gchar *uri = NULL, *index_path = NULL, *buffering = NULL, *serve = NULL;
+    gboolean adaptive = FALSE;
+    gint rate = 0;
+    BufferingMode mode = BUFFERING_MODE_STREAM;
+    HttpServer *server = NULL;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"uri", 0, 0, G_OPTION_ARG_STRING, &uri, "URI to play (default: the multilingual Sintel clip)", "URI"},
+        {"instant", 0, 0, G_OPTION_ARG_NONE, &data.instant, "Decode all audio tracks and switch with an input-selector", NULL},
+        {"index", 0, 0, G_OPTION_ARG_FILENAME, &index_path, "Media index built by 15 to print the stream info before playing", "FILE"},
+        {"buffering", 0, 0, G_OPTION_ARG_STRING, &buffering, "Buffering mode: stream (default), download or ring", "MODE"},
+        {"adaptive", 0, 0, G_OPTION_ARG_NONE, &adaptive, "Size the buffer from the measured download and playback rates", NULL},
+        {"serve", 0, 0, G_OPTION_ARG_FILENAME, &serve, "Play FILE through a local HTTP server (see --rate)", "FILE"},
+        {"rate", 0, 0, G_OPTION_ARG_INT, &rate, "Throttle the local server to KB/s", "KB"},
+        {NULL}};
+
+    /* Initialize GStreamer */
+    context = g_option_context_new("- streams info and change");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (buffering != NULL && !buffering_mode_from_string(buffering, &mode))
+    {
+        g_printerr("Unknown buffering mode: %s\n", buffering);
+        return -1;
+    }
+    // --serve: 本地限速的 HTTP 服务器，模拟慢速网络（common/http_server.c）
+    if (serve != NULL)
+    {
+        gchar *root = g_path_get_dirname(serve), *name = g_path_get_basename(serve);
+
+        server = http_server_new(root, 0, &error);
+        g_free(root);
+        if (server == NULL)
+        {
+            g_printerr("Could not start the local server: %s\n", error->message);
+            g_clear_error(&error);
+            g_free(name);
+            return -1;
+        }
+        http_server_set_rate(server, (guint64)MAX(rate, 0) * 1024);
+        g_free(uri);
+        uri = http_server_get_uri(server, name);
+        g_free(name);
+        g_print("Serving %s at %s\n", serve, uri);
+    }
+    if (uri == NULL)
+        uri = g_strdup(DEFAULT_URI);
+
+    // --instant: 不使用 playbin，见 track_selector.h
+    if (!(data.instant ? create_selector_pipeline(&data, uri) : create_playbin(&data, uri)))
+    {
+        g_printerr("Not all elements could be created.\n");
+        return -1;
+    }
 
     /* Set connection speed. This will affect some internal decisions of playbin */
     // Network connection speed in kbps. Default: (0 = unknown)
     // 告知playbin当前网络连接的最大速度，playbin会选择最合适版本的视频流。
-    g_object_set(data.playbin, "connection-speed", 56, NULL); // 56kbps
+    // 不再固定为 56kbps：缓冲控制根据 BUFFERING 消息中测得的下载速率设置，见 buffering_controller.h
+    // --instant 模式下缓冲方式设置在 uridecodebin 上
+    buffering_controller_init(&data.buffering, data.pipeline, data.instant ? data.selector.source : data.playbin,
+                              mode, adaptive, BUFFERING_DEFAULT_RING_SIZE);
+
+    // --index: 播放之前就从索引中取得流信息（PLAYING 之后 analyze_streams() 还会输出一次，可以对比）
+    if (index_path != NULL)
+        print_indexed_streams(index_path, uri);
 
     /* Add a bus watch, so we get notified when a message arrives */
-    bus = gst_element_get_bus(data.playbin);
+    bus = gst_element_get_bus(data.pipeline);
     gst_bus_add_watch(bus, (GstBusFunc)handle_message, &data); // 给playbin元素的总线添加监听器
 
     /* Add a keyboard watch so we get notified of keystrokes */
@@ -85,15 +203,20 @@ int main(int argc, char *argv[])
     g_io_add_watch(io_stdin, G_IO_IN, (GIOFunc)handle_keyboard, &data);
 
     /* Start playing */
-    // 设置状态为播放
-    ret = gst_element_set_state(data.playbin, GST_STATE_PLAYING);
+    // 设置状态为播放（网络源缓冲不足时由缓冲控制暂停，缓冲到 100% 再继续）
+    ret = buffering_controller_start(&data.buffering);
     if (ret == GST_STATE_CHANGE_FAILURE)
     {
         g_printerr("Unable to set the pipeline to the playing state.\n");
-        gst_object_unref(data.playbin);
+        gst_object_unref(data.pipeline);
         return -1;
     }
 
+    // 定期输出 CPU 占用：两种模式对比保持所有音轨解码的代价
+    data.last_cpu = process_cpu_time();
+    data.last_stats = g_get_monotonic_time();
+    g_timeout_add_seconds(STATS_INTERVAL, (GSourceFunc)print_cpu_stats, &data);
+
     /* Create a GLib Main Loop and set it to run */
     // 创建并运行主函数
     data.main_loop = g_main_loop_new(NULL, FALSE); // 创建glib主循环
@@ -101,14 +224,56 @@ int main(int argc, char *argv[])
 
     /* Free resources */
     // 释放资源
+    switch_latency_print_summary(&data.latency, data.instant ? "input-selector" : "current-audio");
+    buffering_controller_print_stats(&data.buffering);
     g_main_loop_unref(data.main_loop);
     g_io_channel_unref(io_stdin);
     gst_object_unref(bus);
-    gst_element_set_state(data.playbin, GST_STATE_NULL);
-    gst_object_unref(data.playbin);
+    gst_element_set_state(data.pipeline, GST_STATE_NULL);
+    switch_latency_clear(&data.latency);
+    buffering_controller_clear(&data.buffering);
+    if (data.instant)
+        track_selector_clear(&data.selector);
+    else
+        gst_object_unref(data.playbin);
+    if (server != NULL)
+        http_server_free(server);
+    g_free(uri);
+    g_free(index_path);
+    g_free(buffering);
+    g_free(serve);
     return 0;
 }
 
+/* 从 15 示例生成的索引中查询 uri 的流信息 */
+static void print_indexed_streams(const gchar *path, const gchar *uri)
+{
+    MediaIndex index;
+    const MediaIndexFile *file;
+    GError *error = NULL;
+    GstClockTime t = gst_util_get_timestamp();
+
+    if (!media_index_open(&index, path, &error))
+    {
+        g_printerr("%s\n", error->message);
+        g_clear_error(&error);
+        return;
+    }
+    file = media_index_lookup(&index, uri);
+    t = gst_util_get_timestamp() - t;
+    if (file == NULL)
+    {
+        g_print("%s is not in %s\n", uri, path);
+    }
+    else
+    {
+        g_print("From %s (open + lookup %.1f us):\n", path, t / 1e3);
+        media_index_print(&index, file);
+        g_print("\n");
+    }
+    media_index_close(&index);
+}
+
 /* Extract some metadata from the streams and print it on the screen */
 static void analyze_streams(CustomData *data)
 {
@@ -211,12 +376,43 @@ static void analyze_streams(CustomData *data)
     g_print("Type any number and hit ENTER to select a different audio stream\n");
 }
 
+/* --instant 模式：流信息来自 input-selector 的各个 sink pad */
+static void analyze_tracks(CustomData *data)
+{
+    data->n_audio = track_selector_n_tracks(&data->selector);
+    data->current_audio = track_selector_current(&data->selector);
+    track_selector_print_streams(&data->selector);
+    g_print("\n");
+    g_print("Currently playing audio stream %d\n", data->current_audio);
+    g_print("Type any number and hit ENTER to select a different audio stream\n");
+}
+
+/* 定期输出进程的 CPU 占用，--instant 模式下还有每个音轨的流线程的 CPU 占用（* 为选中的音轨） */
+static gboolean print_cpu_stats(CustomData *data)
+{
+    GstClockTime cpu = process_cpu_time();
+    gint64 now = g_get_monotonic_time();
+    GstClockTime interval = (now - data->last_stats) * GST_USECOND;
+
+    g_print("cpu: process %5.1f%%", 100.0 * (cpu - data->last_cpu) / interval);
+    if (data->instant)
+        track_selector_print_cpu(&data->selector, interval);
+    g_print("\n");
+    data->last_cpu = cpu;
+    data->last_stats = now;
+    return TRUE;
+}
+
 /* Process messages from GStreamer */
 static gboolean handle_message(GstBus *bus, GstMessage *msg, CustomData *data)
 {
     GError *err;
     gchar *debug_info;
 
+    // BUFFERING：缓冲不足时暂停、缓冲完成后继续播放
+    if (buffering_controller_handle_message(&data->buffering, msg))
+        return TRUE;
+
     switch (GST_MESSAGE_TYPE(msg))
     {
     case GST_MESSAGE_ERROR:
@@ -243,13 +439,16 @@ static gboolean handle_message(GstBus *bus, GstMessage *msg, CustomData *data)
         gst_message_parse_state_changed(msg, &old_state, &new_state, &pending_state);
 
         // 消息来源是playbin
-        if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data->playbin))
+        if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data->pipeline))
         {
             if (new_state == GST_STATE_PLAYING) // 当前状态是播放
             {
                 /* Once we are in the playing state, analyze the streams */
                 // 分析playbin中的流信息
-                analyze_streams(data);
+                if (data->instant)
+                    analyze_tracks(data);
+                else
+                    analyze_streams(data);
             }
         }
     }
@@ -281,8 +480,24 @@ static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomDat
             // 这种切换不是立即生效的
             // 一些之前解码好的音频数据将仍然在pipeline中流动，虽然新的流已经开始解码。
             // 延迟取决于容器中流的特定多路复用和playbin的内部queue的长度（这取决于网络状况）。
+            if (index == data->current_audio)
+            {
+                g_print("Already playing audio stream %d\n", index);
+                g_free(str);
+                return TRUE;
+            }
             g_print("Setting current audio stream to %d\n", index);
-            g_object_set(data->playbin, "current-audio", index, NULL);
+            switch_latency_request(&data->latency);
+            if (data->instant)
+            {
+                // --instant: 所有音轨都已经在解码，input-selector 在下一个 buffer 的边界切换
+                track_selector_select(&data->selector, index);
+            }
+            else
+            {
+                g_object_set(data->playbin, "current-audio", index, NULL);
+            }
+            data->current_audio = index;
 
             // 修改字幕/视频流同理
             // g_print("Setting current text stream to %d\n", index);
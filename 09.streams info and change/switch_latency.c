@@ -0,0 +1,131 @@
+#include "switch_latency.h"
+
+#include <string.h>
+
+/* 新音轨的第一个 buffer：计算并输出延迟，调用者持有 sl->lock */
+static void
+switch_done(SwitchLatency *sl, GstPad *pad, GstBuffer *buffer)
+{
+    GstClockTime arrival = (g_get_monotonic_time() - sl->request_time) * GST_USECOND;
+    GstClockTime audible = GST_CLOCK_TIME_NONE, rt = GST_CLOCK_TIME_NONE;
+    GstEvent *event;
+    GstSegment segment;
+
+    event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (event != NULL)
+    {
+        gst_event_copy_segment(event, &segment);
+        rt = gst_segment_to_running_time(&segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+        gst_event_unref(event);
+    }
+    if (GST_CLOCK_TIME_IS_VALID(rt) && GST_CLOCK_TIME_IS_VALID(sl->request_rt))
+        audible = rt + sl->latency > sl->request_rt ? rt + sl->latency - sl->request_rt : 0;
+
+    sl->pending = FALSE;
+    sl->switches++;
+    sl->total_arrival += arrival;
+    if (GST_CLOCK_TIME_IS_VALID(audible))
+    {
+        sl->total_audible += audible;
+        sl->max_audible = MAX(sl->max_audible, audible);
+        g_print("Switched: first buffer arrived after %.1f ms, audible after %.1f ms\n",
+                arrival / 1e6, audible / 1e6);
+    }
+    else
+    {
+        g_print("Switched: first buffer arrived after %.1f ms\n", arrival / 1e6);
+    }
+}
+
+/* 音频 sink 的 sink pad 上的探针（流线程） */
+static GstPadProbeReturn
+switch_probe(GstPad *pad, GstPadProbeInfo *info, SwitchLatency *sl)
+{
+    g_mutex_lock(&sl->lock);
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+    {
+        if (sl->pending && sl->new_stream)
+            switch_done(sl, pad, GST_PAD_PROBE_INFO_BUFFER(info));
+    }
+    else if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_STREAM_START)
+    {
+        const gchar *stream_id;
+
+        // 切换时 input-selector 会把新 pad 的 sticky 事件（STREAM_START、CAPS、SEGMENT）转发到下游
+        gst_event_parse_stream_start(GST_PAD_PROBE_INFO_EVENT(info), &stream_id);
+        if (g_strcmp0(stream_id, sl->stream_id) != 0)
+        {
+            g_free(sl->stream_id);
+            sl->stream_id = g_strdup(stream_id);
+            if (sl->pending)
+                sl->new_stream = TRUE;
+        }
+    }
+    g_mutex_unlock(&sl->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+void
+switch_latency_init(SwitchLatency *sl, GstElement *pipeline, GstElement *audio_sink)
+{
+    memset(sl, 0, sizeof(*sl));
+    g_mutex_init(&sl->lock);
+    sl->pipeline = pipeline;
+    // autoaudiosink 是一个 bin，探针加在它的 ghost pad 上
+    sl->pad = gst_element_get_static_pad(audio_sink, "sink");
+    sl->probe_id = gst_pad_add_probe(sl->pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                                     (GstPadProbeCallback)switch_probe, sl, NULL);
+}
+
+void
+switch_latency_request(SwitchLatency *sl)
+{
+    GstClock *clock = gst_element_get_clock(sl->pipeline);
+    GstClockTime rt = GST_CLOCK_TIME_NONE, latency = 0;
+    GstQuery *query;
+
+    // 请求时的 running time = 时钟时间 - base time（音频 sink 提供时钟，它反映的是已经播放出来的位置）
+    if (clock != NULL)
+    {
+        rt = gst_clock_get_time(clock) - gst_element_get_base_time(sl->pipeline);
+        gst_object_unref(clock);
+    }
+    query = gst_query_new_latency();
+    if (gst_element_query(sl->pipeline, query))
+        gst_query_parse_latency(query, NULL, &latency, NULL);
+    gst_query_unref(query);
+
+    g_mutex_lock(&sl->lock);
+    // 上一次切换还没有完成时，以最新的请求为准
+    sl->pending = TRUE;
+    sl->new_stream = FALSE;
+    sl->request_time = g_get_monotonic_time();
+    sl->request_rt = rt;
+    sl->latency = latency;
+    g_mutex_unlock(&sl->lock);
+}
+
+void
+switch_latency_print_summary(SwitchLatency *sl, const gchar *mode)
+{
+    g_mutex_lock(&sl->lock);
+    if (sl->switches > 0)
+        g_print("%s switching: %u switches, first buffer after %.1f ms on average, audible after %.1f ms (max %.1f ms)\n",
+                mode, sl->switches, sl->total_arrival / 1e6 / sl->switches,
+                sl->total_audible / 1e6 / sl->switches, sl->max_audible / 1e6);
+    g_mutex_unlock(&sl->lock);
+}
+
+void
+switch_latency_clear(SwitchLatency *sl)
+{
+    if (sl->pad)
+    {
+        gst_pad_remove_probe(sl->pad, sl->probe_id);
+        gst_object_unref(sl->pad);
+        sl->pad = NULL;
+    }
+    g_free(sl->stream_id);
+    sl->stream_id = NULL;
+    g_mutex_clear(&sl->lock);
+}
@@ -0,0 +1,40 @@
+#ifndef SWITCH_LATENCY_H
+#define SWITCH_LATENCY_H
+
+#include <gst/gst.h>
+
+/**
+ * 音轨切换延迟的测量（两种切换方式通用）
+ *
+ * 在音频 sink 的 sink pad 上加探针：切换请求之后，带有新的 stream-id 的 STREAM_START 事件之后的第一个 buffer
+ * 就是新音轨的第一个 buffer。
+ *
+ * - arrival：从请求到这个 buffer 到达 sink 的墙钟时间
+ * - audible：从请求到这个 buffer 被播放出来的时间 = buffer 的 running time + pipeline 延迟 - 请求时的 running time。
+ *   sink 按 running time 播放，之前已经排在它前面的旧音轨数据（各个 queue、sink 的缓冲区）都包含在这个时间里
+ */
+
+typedef struct _SwitchLatency
+{
+    GstElement *pipeline;
+    GstPad *pad;              /* 音频 sink 的 sink pad */
+    gulong probe_id;
+    GMutex lock;              /* 保护以下字段：探针运行在流线程中，请求在主线程中 */
+    gchar *stream_id;         /* 当前音轨的 stream-id */
+    gboolean pending;         /* 正在等待新音轨的第一个 buffer */
+    gboolean new_stream;      /* 请求之后已经收到了新的 STREAM_START */
+    gint64 request_time;      /* 请求的时刻（单调时钟，微秒） */
+    GstClockTime request_rt;  /* 请求时 pipeline 的 running time */
+    GstClockTime latency;     /* pipeline 的延迟 */
+    guint switches;           /* 已完成的切换次数 */
+    GstClockTime total_arrival, total_audible, max_audible;
+} SwitchLatency;
+
+void switch_latency_init(SwitchLatency *sl, GstElement *pipeline, GstElement *audio_sink);
+/* 切换之前在主线程中调用，记下请求的时刻 */
+void switch_latency_request(SwitchLatency *sl);
+/* 退出时输出所有切换的平均值和最大值 */
+void switch_latency_print_summary(SwitchLatency *sl, const gchar *mode);
+void switch_latency_clear(SwitchLatency *sl);
+
+#endif /* SWITCH_LATENCY_H */
@@ -0,0 +1,282 @@
+#include "track_selector.h"
+
+#include <pthread.h>
+#include <string.h>
+
+static GstClockTime
+thread_cpu_time(clockid_t clock)
+{
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return GST_TIMESPEC_TO_TIME(ts);
+}
+
+/* 音轨的第一个 buffer：记下推送它的流线程（uridecodebin 内部 multiqueue 的线程，解码器也运行在这个线程中） */
+static GstPadProbeReturn
+track_thread_probe(GstPad *pad, GstPadProbeInfo *info, Track *track)
+{
+    if (pthread_getcpuclockid(pthread_self(), &track->clock) == 0)
+    {
+        track->last_cpu = thread_cpu_time(track->clock);
+        g_atomic_int_set(&track->has_clock, TRUE);
+    }
+    return GST_PAD_PROBE_REMOVE;
+}
+
+/* 第一个音频 pad 出现时才把输出部分加入 pipeline，否则没有音频的文件中 sink 无法 preroll；调用者持有 ts->lock */
+static void
+add_audio_output(TrackSelector *ts)
+{
+    gst_bin_add_many(GST_BIN(ts->pipeline), ts->selector, ts->audio_convert, ts->audio_resample, ts->audio_sink, NULL);
+    gst_element_link_many(ts->selector, ts->audio_convert, ts->audio_resample, ts->audio_sink, NULL);
+    // 从下游到上游切换状态，上游开始推送数据时下游已经准备好
+    gst_element_sync_state_with_parent(ts->audio_sink);
+    gst_element_sync_state_with_parent(ts->audio_resample);
+    gst_element_sync_state_with_parent(ts->audio_convert);
+    gst_element_sync_state_with_parent(ts->selector);
+    ts->audio_added = TRUE;
+}
+
+static void
+add_video_output(TrackSelector *ts)
+{
+    gst_bin_add_many(GST_BIN(ts->pipeline), ts->video_convert, ts->video_sink, NULL);
+    gst_element_link(ts->video_convert, ts->video_sink);
+    gst_element_sync_state_with_parent(ts->video_sink);
+    gst_element_sync_state_with_parent(ts->video_convert);
+    ts->video_added = TRUE;
+}
+
+/* 不需要的 pad（第二个视频流、字幕）连接到 fakesink，否则 uridecodebin 会因为 not-linked 而报错 */
+static GstPad *
+add_fakesink(TrackSelector *ts)
+{
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+
+    g_object_set(sink, "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add(GST_BIN(ts->pipeline), sink);
+    gst_element_sync_state_with_parent(sink);
+    return gst_element_get_static_pad(sink, "sink");
+}
+
+/* This function will be called by the pad-added signal */
+static void
+pad_added_handler(GstElement *src, GstPad *new_pad, TrackSelector *ts)
+{
+    GstCaps *caps;
+    const gchar *type;
+    GstPad *sink_pad;
+    Track *track = NULL;
+    guint index = 0;
+
+    caps = gst_pad_get_current_caps(new_pad);
+    if (caps == NULL)
+        caps = gst_pad_query_caps(new_pad, NULL);
+    type = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+    g_mutex_lock(&ts->lock);
+    if (g_str_has_prefix(type, "audio/x-raw"))
+    {
+        if (!ts->audio_added)
+            add_audio_output(ts);
+        // 每个音轨申请一个 sink pad，第一个音轨自动成为 active-pad
+        track = g_new0(Track, 1);
+        track->pad = gst_element_request_pad_simple(ts->selector, "sink_%u");
+        gst_pad_add_probe(track->pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)track_thread_probe, track, NULL);
+        g_ptr_array_add(ts->tracks, track);
+        index = ts->tracks->len - 1;
+        sink_pad = gst_object_ref(track->pad);
+    }
+    else if (g_str_has_prefix(type, "video/x-raw") && !ts->video_added)
+    {
+        add_video_output(ts);
+        sink_pad = gst_element_get_static_pad(ts->video_convert, "sink");
+    }
+    else
+    {
+        sink_pad = add_fakesink(ts);
+    }
+    g_mutex_unlock(&ts->lock);
+
+    if (GST_PAD_LINK_FAILED(gst_pad_link(new_pad, sink_pad)))
+        g_printerr("Type is '%s' but link failed.\n", type);
+    else if (track != NULL)
+        g_print("Linked audio track %u to %s\n", index, GST_PAD_NAME(sink_pad));
+    gst_object_unref(sink_pad);
+    gst_caps_unref(caps);
+}
+
+gboolean
+track_selector_init(TrackSelector *ts, const gchar *uri)
+{
+    memset(ts, 0, sizeof(*ts));
+    g_mutex_init(&ts->lock);
+    ts->tracks = g_ptr_array_new();
+
+    ts->pipeline = gst_pipeline_new("instant-pipeline");
+    ts->source = gst_element_factory_make("uridecodebin", "source");
+    ts->selector = gst_element_factory_make("input-selector", "selector");
+    ts->audio_convert = gst_element_factory_make("audioconvert", "audio_convert");
+    ts->audio_resample = gst_element_factory_make("audioresample", "audio_resample");
+    ts->audio_sink = gst_element_factory_make("autoaudiosink", "audio_sink");
+    ts->video_convert = gst_element_factory_make("videoconvert", "video_convert");
+    ts->video_sink = gst_element_factory_make("autovideosink", "video_sink");
+    if (!ts->pipeline || !ts->source || !ts->selector || !ts->audio_convert || !ts->audio_resample ||
+        !ts->audio_sink || !ts->video_convert || !ts->video_sink)
+        return FALSE;
+
+    g_object_set(ts->source, "uri", uri, NULL);
+    g_object_set(ts->selector, "sync-streams", TRUE, "cache-buffers", TRUE, NULL);
+    // active-segment：按选中音轨的 segment 计算 running time（文件播放，不需要按时钟同步）
+    gst_util_set_object_arg(G_OBJECT(ts->selector), "sync-mode", "active-segment");
+    gst_bin_add(GST_BIN(ts->pipeline), ts->source);
+    g_signal_connect(ts->source, "pad-added", G_CALLBACK(pad_added_handler), ts);
+    return TRUE;
+}
+
+gint
+track_selector_n_tracks(TrackSelector *ts)
+{
+    gint n;
+
+    g_mutex_lock(&ts->lock);
+    n = ts->tracks->len;
+    g_mutex_unlock(&ts->lock);
+    return n;
+}
+
+gint
+track_selector_current(TrackSelector *ts)
+{
+    GstPad *active = NULL;
+    gint index = -1;
+    guint i;
+
+    g_mutex_lock(&ts->lock);
+    if (ts->audio_added)
+        g_object_get(ts->selector, "active-pad", &active, NULL);
+    if (active == NULL)
+    {
+        g_mutex_unlock(&ts->lock);
+        return -1;
+    }
+    for (i = 0; i < ts->tracks->len; i++)
+    {
+        if (((Track *)g_ptr_array_index(ts->tracks, i))->pad == active)
+            index = i;
+    }
+    g_mutex_unlock(&ts->lock);
+    gst_object_unref(active);
+    return index;
+}
+
+gboolean
+track_selector_select(TrackSelector *ts, gint index)
+{
+    Track *track;
+
+    g_mutex_lock(&ts->lock);
+    if (index < 0 || index >= (gint)ts->tracks->len)
+    {
+        g_mutex_unlock(&ts->lock);
+        return FALSE;
+    }
+    track = g_ptr_array_index(ts->tracks, index);
+    // 只是修改 active-pad：正在推送的 buffer 完成之后，下一个 buffer 就来自新的音轨
+    g_object_set(ts->selector, "active-pad", track->pad, NULL);
+    g_mutex_unlock(&ts->lock);
+    return TRUE;
+}
+
+void
+track_selector_print_streams(TrackSelector *ts)
+{
+    guint i;
+
+    g_mutex_lock(&ts->lock);
+    g_print("%u audio stream(s), all decoding\n", ts->tracks->len);
+    for (i = 0; i < ts->tracks->len; i++)
+    {
+        Track *track = g_ptr_array_index(ts->tracks, i);
+        GstEvent *event = gst_pad_get_sticky_event(track->pad, GST_EVENT_TAG, 0);
+        GstTagList *tags;
+        gchar *str;
+
+        g_print("audio stream %u:\n", i);
+        if (event == NULL)
+            continue;
+        // 标签由 demuxer 和解码器发出，作为 sticky 事件保存在 pad 上
+        gst_event_parse_tag(event, &tags);
+        if (gst_tag_list_get_string(tags, GST_TAG_AUDIO_CODEC, &str))
+        {
+            g_print("\t codec: %s\n", str);
+            g_free(str);
+        }
+        if (gst_tag_list_get_string(tags, GST_TAG_LANGUAGE_CODE, &str))
+        {
+            g_print("\t language: %s\n", str);
+            g_free(str);
+        }
+        gst_event_unref(event);
+    }
+    g_mutex_unlock(&ts->lock);
+}
+
+void
+track_selector_print_cpu(TrackSelector *ts, GstClockTime interval)
+{
+    gint current = track_selector_current(ts);
+    guint i;
+
+    if (interval == 0)
+        return;
+    g_mutex_lock(&ts->lock);
+    for (i = 0; i < ts->tracks->len; i++)
+    {
+        Track *track = g_ptr_array_index(ts->tracks, i);
+        GstClockTime cpu;
+
+        if (!g_atomic_int_get(&track->has_clock))
+            continue;
+        // 选中的音轨的线程还要运行 audioconvert/audioresample/sink，其余音轨的 CPU 就是保持 "热" 状态的代价
+        // 线程退出后（例如 EOS 之后）CPU 时钟读不到，返回 0，不能让差值下溢
+        cpu = thread_cpu_time(track->clock);
+        g_print("  track %u%s %5.1f%%", i, (gint)i == current ? "*" : " ",
+                cpu > track->last_cpu ? 100.0 * (cpu - track->last_cpu) / interval : 0.0);
+        track->last_cpu = cpu;
+    }
+    g_mutex_unlock(&ts->lock);
+}
+
+void
+track_selector_clear(TrackSelector *ts)
+{
+    guint i;
+
+    for (i = 0; i < ts->tracks->len; i++)
+    {
+        Track *track = g_ptr_array_index(ts->tracks, i);
+
+        gst_element_release_request_pad(ts->selector, track->pad);
+        gst_object_unref(track->pad);
+        g_free(track);
+    }
+    g_ptr_array_unref(ts->tracks);
+    // 没有加入 pipeline 的元素需要单独释放
+    if (!ts->audio_added)
+    {
+        gst_object_unref(ts->selector);
+        gst_object_unref(ts->audio_convert);
+        gst_object_unref(ts->audio_resample);
+        gst_object_unref(ts->audio_sink);
+    }
+    if (!ts->video_added)
+    {
+        gst_object_unref(ts->video_convert);
+        gst_object_unref(ts->video_sink);
+    }
+    gst_object_unref(ts->pipeline);
+    g_mutex_clear(&ts->lock);
+}
@@ -0,0 +1,57 @@
+#ifndef TRACK_SELECTOR_H
+#define TRACK_SELECTOR_H
+
+#include <gst/gst.h>
+#include <time.h>
+
+/**
+ * 立即切换音轨（--instant）
+ *
+ * playbin 的 current-audio 切换之后，已经解码、排在 playbin 内部各个 queue 中的旧音轨数据还要继续播放完。
+ * 这里不使用 playbin，而是自己搭建 pipeline：uridecodebin 解码所有音轨，每个音轨连接到 input-selector 的一个 sink pad，
+ * input-selector 之后直接是音频 sink，中间没有 queue：
+ *
+ *   uridecodebin ─ audio_0 ─> input-selector ─> audioconvert ─> audioresample ─> autoaudiosink
+ *                ├ audio_1 ─>
+ *                ├ video   ─> videoconvert ─> autovideosink
+ *                └ 其他    ─> fakesink
+ *
+ * - sync-streams：没有选中的音轨按 running time 与选中的音轨保持同步（解码领先时等待，落后时丢弃），一直处于 "热" 状态
+ * - cache-buffers：缓存选中的音轨已经输出的 buffer，之后重新选中这个音轨时可以从缓存中重放，不会出现空隙；
+ *   没有选中的音轨的 buffer 不缓存，在 sync-streams 下按 running time 丢弃
+ * - 切换只是修改 active-pad，在下一个 buffer 的边界生效
+ *
+ * 代价是所有音轨都在持续解码，track_selector_print_cpu() 输出每个音轨的解码线程占用的 CPU。
+ */
+
+/* 一个音轨 */
+typedef struct _Track
+{
+    GstPad *pad;           /* input-selector 上申请的 sink pad */
+    clockid_t clock;       /* 解码这个音轨的流线程的 CPU 时钟 */
+    gint has_clock;        /* clock 已经设置（原子操作，流线程写入、主线程读取） */
+    GstClockTime last_cpu; /* 上次输出时的 CPU 时间 */
+} Track;
+
+typedef struct _TrackSelector
+{
+    GstElement *pipeline, *source,                                   //
+        *selector, *audio_convert, *audio_resample, *audio_sink,    //
+        *video_convert, *video_sink;                                 //
+    GMutex lock;                                                     /* 保护以下字段：pad-added 在流线程中调用 */
+    GPtrArray *tracks;                                               /* Track，顺序与 uridecodebin 添加 pad 的顺序相同 */
+    gboolean audio_added, video_added;                               /* 输出部分是否已经加入 pipeline */
+} TrackSelector;
+
+gboolean track_selector_init(TrackSelector *ts, const gchar *uri);
+gint track_selector_n_tracks(TrackSelector *ts);
+/* 当前选中的音轨，没有音轨时返回 -1 */
+gint track_selector_current(TrackSelector *ts);
+gboolean track_selector_select(TrackSelector *ts, gint index);
+/* 输出各音轨的编码和语言 */
+void track_selector_print_streams(TrackSelector *ts);
+/* 输出上次调用以来各音轨的流线程的 CPU 占用，interval 为经过的墙钟时间 */
+void track_selector_print_cpu(TrackSelector *ts, GstClockTime interval);
+void track_selector_clear(TrackSelector *ts);
+
+#endif /* TRACK_SELECTOR_H */
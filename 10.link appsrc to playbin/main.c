@@ -1,10 +1,18 @@
 #include <gst/gst.h>
 #include <gst/audio/audio.h>
+#include <gst/app/app.h>
 #include <string.h>
 
+#include "feeder_pool.h"
+#include "pcm_replay.h"
+#include "push_batch.h"
+
 #define CHUNK_SIZE 1024   /* Amount of bytes we are sending in each buffer */
 #define SAMPLE_RATE 44100 /* Samples per second we are sending */
 
+#define DEFAULT_POOL_BUFFERS 256 /* 缓冲池中 buffer 的默认个数 */
+#define DEFAULT_BATCH_LATENCY 50 /* 批量推送的默认延迟预算（毫秒） */
+
 /* Structure to contain all our information, so we can pass it to callbacks */
 typedef struct _CustomData
 {
@@ -17,24 +25,52 @@ typedef struct _CustomData
     guint sourceid; /* To control the GSource */
 
     GMainLoop *main_loop; /* GLib's Main Loop */
+
+    GstCaps *audio_caps;   /* appsrc 的 caps，协商缓冲池时使用 */
+    FeederPool pool;       /* 生产者使用的缓冲池 */
+    gboolean pool_ready;   /* 缓冲池是否已经协商过 */
+    gint pool_buffers;     /* --pool-buffers: 池中 buffer 个数，0 表示禁用缓冲池 */
+    gint pool_buffer_size; /* --pool-buffer-size: 池中每个 buffer 的大小 */
+
+    gint batch_size;    /* --batch-size: 每次推送的 chunk 个数，1 表示逐个推送 */
+    gint batch_latency; /* --batch-latency: 一个批次最多覆盖的时长（毫秒），0 表示不限制 */
+    PushBatch batch;    /* 批量推送（GstBufferList） */
+
+    PcmReplay replay; /* --replay: 回放的 PCM 文件（file 为 NULL 表示生成波形） */
 } CustomData;
 
-/* This method is called by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
- * The ide handler is added to the mainloop when appsrc requests us to start sending data (need-data signal)
- * and is removed when appsrc has enough data (enough-data signal).
- */
-static gboolean push_data(CustomData *data)
+/* Generate the next CHUNK_SIZE bytes of waveform into a new buffer, NULL when the replay file ended */
+static GstBuffer *generate_chunk(CustomData *data)
 {
     GstBuffer *buffer;
-    GstFlowReturn ret;
     int i;
     GstMapInfo map;
     gint16 *raw;
     gint num_samples = CHUNK_SIZE / 2; /* Because each sample is 16 bits */
     gfloat freq;
 
-    /* Create a new empty buffer */
-    buffer = gst_buffer_new_and_alloc(CHUNK_SIZE);
+    /* Replay mode: wrap the next slice of the mapped file, no copy */
+    if (data->replay.file != NULL)
+    {
+        gint rate = GST_AUDIO_INFO_RATE(&data->replay.info);
+
+        buffer = pcm_replay_next(&data->replay, num_samples * GST_AUDIO_INFO_BPF(&data->replay.info));
+        if (buffer == NULL)
+            return NULL;
+        num_samples = gst_buffer_get_size(buffer) / GST_AUDIO_INFO_BPF(&data->replay.info);
+        GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, rate);
+        GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(num_samples, GST_SECOND, rate);
+        data->num_samples += num_samples;
+        return buffer;
+    }
+
+    /* Take a buffer from the pool, negotiating it with downstream on first use */
+    if (!data->pool_ready)
+    {
+        feeder_pool_setup(&data->pool, data->app_source, data->audio_caps, data->pool_buffer_size, data->pool_buffers);
+        data->pool_ready = TRUE;
+    }
+    buffer = feeder_pool_acquire(&data->pool, CHUNK_SIZE);
 
     /* Set its timestamp and duration */
     GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(data->num_samples, GST_SECOND, SAMPLE_RATE);
@@ -54,6 +90,43 @@ static gboolean push_data(CustomData *data)
     }
     gst_buffer_unmap(buffer, &map);
     data->num_samples += num_samples;
+    return buffer;
+}
+
+/* The replay file ended: push what is left and send EOS, removing the idle handler */
+static gboolean end_stream(CustomData *data)
+{
+    if (data->batch_size > 1)
+        push_batch_flush(&data->batch);
+    gst_app_src_end_of_stream(GST_APP_SRC(data->app_source));
+    data->sourceid = 0;
+    return FALSE;
+}
+
+/* This method is called by the idle GSource in the mainloop, to feed CHUNK_SIZE bytes into appsrc.
+ * The ide handler is added to the mainloop when appsrc requests us to start sending data (need-data signal)
+ * and is removed when appsrc has enough data (enough-data signal).
+ */
+static gboolean push_data(CustomData *data)
+{
+    GstBuffer *buffer;
+    GstFlowReturn ret = GST_FLOW_OK;
+    guint i;
+
+    /* Batching mode: generate a whole batch and push it as one GstBufferList */
+    if (data->batch_size > 1)
+    {
+        for (i = 0; i < data->batch.batch_size && ret == GST_FLOW_OK; i++)
+        {
+            if ((buffer = generate_chunk(data)) == NULL)
+                return end_stream(data);
+            ret = push_batch_add(&data->batch, buffer);
+        }
+        return ret == GST_FLOW_OK;
+    }
+
+    if ((buffer = generate_chunk(data)) == NULL)
+        return end_stream(data);
 
     /* Push the buffer into the appsrc */
     g_signal_emit_by_name(data->app_source, "push-buffer", buffer, &ret);
@@ -109,6 +182,13 @@ static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data)
     g_main_loop_quit(data->main_loop);
 }
 
+/* This function is called when the replay file has been played to the end */
+static void eos_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+    g_print("End-Of-Stream reached.\n");
+    g_main_loop_quit(data->main_loop);
+}
+
 /* This function is called when playbin has created the appsrc element, so we have
  * a chance to configure it. */
 static void source_setup(GstElement *pipeline, GstElement *source, CustomData *data)
@@ -123,10 +203,21 @@ static void source_setup(GstElement *pipeline, GstElement *source, CustomData *d
     // info={ int16, 44.1khz, 单通道 }
     // caps={ info }
     gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_S16, SAMPLE_RATE, 1, NULL);
+    // 回放模式：caps 使用文件的格式
+    if (data->replay.file)
+        info = data->replay.info;
     audio_caps = gst_audio_info_to_caps(&info);
     g_object_set(source, "caps", audio_caps, "format", GST_FORMAT_TIME, NULL);
+    // 缓冲池不会增长，限制 appsrc 内部队列，为下游留出足够的 buffer
+    if (data->pool_buffers > 0)
+        g_object_set(source, "max-bytes", (guint64)MAX(data->pool_buffers / 4, 1) * CHUNK_SIZE, NULL);
     g_signal_connect(source, "need-data", G_CALLBACK(start_feed), data);
     g_signal_connect(source, "enough-data", G_CALLBACK(stop_feed), data);
+    // 批量推送直接调用 gst_app_src_push_buffer_list()，批次大小受延迟预算限制
+    push_batch_init(&data->batch, source, data->batch_size,
+                    data->batch_latency > 0 ? data->batch_latency * GST_MSECOND : GST_CLOCK_TIME_NONE,
+                    gst_util_uint64_scale(CHUNK_SIZE / 2, GST_SECOND, GST_AUDIO_INFO_RATE(&info)));
+    gst_caps_replace(&data->audio_caps, audio_caps);
     gst_caps_unref(audio_caps);
 }
 
@@ -134,11 +225,69 @@ int main(int argc, char *argv[])
 {
     CustomData data;
     GstBus *bus;
+    GOptionContext *context;
+    GError *error = NULL;
+    gchar *replay_path = NULL;
+    gboolean replay_loop = FALSE;
+    gint replay_rate = SAMPLE_RATE, replay_channels = 1;
 
     /* Initialize cumstom data structure */
     memset(&data, 0, sizeof(data));
     data.b = 1; /* For waveform generation */
     data.d = 1;
+    data.pool_buffers = DEFAULT_POOL_BUFFERS;
+    data.pool_buffer_size = CHUNK_SIZE;
+    data.batch_size = 1;
+    data.batch_latency = DEFAULT_BATCH_LATENCY;
+
+    /* Parse command line options */
+    GOptionEntry entries[] = {
+        {"pool-buffers", 0, 0, G_OPTION_ARG_INT, &data.pool_buffers, "Number of buffers in the producer pool, 0 disables the pool", "N"},
+        {"pool-buffer-size", 0, 0, G_OPTION_ARG_INT, &data.pool_buffer_size, "Size of each pooled buffer in bytes", "BYTES"},
+        {"batch-size", 0, 0, G_OPTION_ARG_INT, &data.batch_size, "Chunks per push, > 1 pushes GstBufferLists through gst_app_src_push_buffer_list()", "N"},
+        {"batch-latency", 0, 0, G_OPTION_ARG_INT, &data.batch_latency, "Maximum duration covered by one batch in milliseconds, 0 for no limit", "MS"},
+        {"replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path, "Replay a memory-mapped WAV or raw S16LE file instead of the waveform", "FILE"},
+        {"replay-loop", 0, 0, G_OPTION_ARG_NONE, &replay_loop, "Restart the replay file when it ends", NULL},
+        {"replay-rate", 0, 0, G_OPTION_ARG_INT, &replay_rate, "Sample rate of a raw replay file", "HZ"},
+        {"replay-channels", 0, 0, G_OPTION_ARG_INT, &replay_channels, "Channel count of a raw replay file", "N"},
+        {NULL}};
+    context = g_option_context_new("- link appsrc to playbin");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (data.pool_buffers < 0 || data.pool_buffer_size < CHUNK_SIZE)
+    {
+        g_printerr("--pool-buffers must be >= 0 and --pool-buffer-size must be >= %d\n", CHUNK_SIZE);
+        return -1;
+    }
+    if (data.batch_size <= 0 || data.batch_latency < 0)
+    {
+        g_printerr("--batch-size must be > 0 and --batch-latency must be >= 0\n");
+        return -1;
+    }
+    if (replay_path)
+    {
+        if (replay_rate <= 0 || replay_channels <= 0)
+        {
+            g_printerr("--replay-rate and --replay-channels must be > 0\n");
+            return -1;
+        }
+        if (!pcm_replay_open(&data.replay, replay_path, replay_loop, replay_rate, replay_channels, &error))
+        {
+            g_printerr("Could not open replay file: %s\n", error->message);
+            g_clear_error(&error);
+            return -1;
+        }
+        // 回放的 chunk 直接包装文件映射，不使用缓冲池
+        data.pool_buffers = 0;
+        g_free(replay_path);
+    }
 
     /* Initialize GStreamer */
     gst_init(&argc, &argv);
@@ -153,6 +302,7 @@ int main(int argc, char *argv[])
     bus = gst_element_get_bus(data.pipeline);
     gst_bus_add_signal_watch(bus);
     g_signal_connect(G_OBJECT(bus), "message::error", (GCallback)error_cb, &data);
+    g_signal_connect(G_OBJECT(bus), "message::eos", (GCallback)eos_cb, &data);
     gst_object_unref(bus);
 
     /* Start playing the pipeline */
@@ -165,5 +315,15 @@ int main(int argc, char *argv[])
     /* Free resources */
     gst_element_set_state(data.pipeline, GST_STATE_NULL);
     gst_object_unref(data.pipeline);
+    feeder_pool_print_stats(&data.pool, "");
+    if (data.batch_size > 1)
+    {
+        push_batch_print_stats(&data.batch, "");
+        push_batch_clear(&data.batch);
+    }
+    feeder_pool_clear(&data.pool);
+    pcm_replay_close(&data.replay);
+    if (data.audio_caps)
+        gst_caps_unref(data.audio_caps);
     return 0;
 }
\ No newline at end of file
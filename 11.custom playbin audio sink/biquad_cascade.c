@@ -0,0 +1,448 @@
+#include "biquad_cascade.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BIQUAD_X86 1
+#endif
+
+/* 系数数组中各系数的偏移（单位为 lanes） */
+#define CO_B0 0
+#define CO_B1 1
+#define CO_B2 2
+#define CO_A1 3
+#define CO_A2 4
+
+/* 对一个声道的 n 个连续采样原地做整个级联，z 为该声道的状态 z1[lanes] z2[lanes] */
+typedef void (*CascadeFunc)(const gfloat *co, gint lanes, gfloat *z, gfloat *x, gint n);
+
+/* ################## 标量实现 ################## */
+
+/* 第 k 级单独处理 n 个采样（波前的开头结尾部分使用） */
+static inline void
+stage_run(const gfloat *co, gint lanes, gfloat *z, gint k, gfloat *x, gint n)
+{
+    gfloat b0 = co[CO_B0 * lanes + k], b1 = co[CO_B1 * lanes + k], b2 = co[CO_B2 * lanes + k];
+    gfloat a1 = co[CO_A1 * lanes + k], a2 = co[CO_A2 * lanes + k];
+    gfloat z1 = z[k], z2 = z[lanes + k];
+    gint i;
+
+    for (i = 0; i < n; i++)
+    {
+        gfloat in = x[i];
+        gfloat y = b0 * in + z1;
+        z1 = b1 * in - a1 * y + z2;
+        z2 = b2 * in - a2 * y;
+        x[i] = y;
+    }
+    z[k] = z1;
+    z[lanes + k] = z2;
+}
+
+static void
+cascade_scalar(const gfloat *co, gint lanes, gfloat *z, gfloat *x, gint n)
+{
+    gint i, k;
+
+    // 逐个采样经过所有频段：状态一直在 z 中，频段少时全部在 L1 里
+    for (i = 0; i < n; i++)
+    {
+        gfloat v = x[i];
+        for (k = 0; k < lanes; k++)
+        {
+            gfloat y = co[CO_B0 * lanes + k] * v + z[k];
+            z[k] = co[CO_B1 * lanes + k] * v - co[CO_A1 * lanes + k] * y + z[lanes + k];
+            z[lanes + k] = co[CO_B2 * lanes + k] * v - co[CO_A2 * lanes + k] * y;
+            v = y;
+        }
+        x[i] = v;
+    }
+}
+
+/**
+ * 波前的开头：第 0..w-2 步只有前几级有采样可处理，逐级计算
+ * x[0..w-2] 不修改（第 w-1 级在这之后才开始输出），prev 得到第 w-2 步各级的输出：
+ * 第 k 级处理了采样 0..w-2-k，最后一个输出就是 prev[k]（prev[w-1] 无意义）
+ */
+static void
+wavefront_prologue(const gfloat *co, gint lanes, gfloat *z, gint g0, gint w, const gfloat *x, gfloat *prev)
+{
+    gfloat tmp[BIQUAD_MAX_BANDS];
+    gint k;
+
+    memcpy(tmp, x, sizeof(gfloat) * (w - 1));
+    for (k = 0; k < w - 1; k++)
+    {
+        stage_run(co, lanes, z, g0 + k, tmp, w - 1 - k);
+        prev[k] = tmp[w - 2 - k];
+    }
+    prev[w - 1] = 0;
+}
+
+/**
+ * 波前的结尾：最后一步之后第 k 级还差采样 n-k..n-1 没有处理
+ * 第 k 级的输入为第 k-1 级在最后一步的输出 prev[k-1]，加上第 k-1 级在结尾部分的输出
+ */
+static void
+wavefront_epilogue(const gfloat *co, gint lanes, gfloat *z, gint g0, gint w, const gfloat *prev, gfloat *x, gint n)
+{
+    gfloat tail[BIQUAD_MAX_BANDS];
+    gint k;
+
+    for (k = 1; k < w; k++)
+    {
+        memmove(tail + 1, tail, sizeof(gfloat) * (k - 1));
+        tail[0] = prev[k - 1];
+        stage_run(co, lanes, z, g0 + k, tail, k);
+    }
+    memcpy(x + n - (w - 1), tail, sizeof(gfloat) * (w - 1));
+}
+
+/* ################## SSE2 实现 ################## */
+#ifdef BIQUAD_X86
+__attribute__((target("sse2"))) static void
+cascade_sse(const gfloat *co, gint lanes, gfloat *z, gfloat *x, gint n)
+{
+    gint g0, s, k;
+
+    // 每 4 级一组，组与组之间依次处理整个 buffer
+    for (g0 = 0; g0 < lanes; g0 += 4)
+    {
+        gfloat prev[4];
+        __m128 b0, b1, b2, a1, a2, z1, z2, vp;
+
+        if (n < 4)
+        {
+            for (k = 0; k < 4; k++)
+                stage_run(co, lanes, z, g0 + k, x, n);
+            continue;
+        }
+
+        wavefront_prologue(co, lanes, z, g0, 4, x, prev);
+        b0 = _mm_loadu_ps(co + CO_B0 * lanes + g0);
+        b1 = _mm_loadu_ps(co + CO_B1 * lanes + g0);
+        b2 = _mm_loadu_ps(co + CO_B2 * lanes + g0);
+        a1 = _mm_loadu_ps(co + CO_A1 * lanes + g0);
+        a2 = _mm_loadu_ps(co + CO_A2 * lanes + g0);
+        z1 = _mm_loadu_ps(z + g0);
+        z2 = _mm_loadu_ps(z + lanes + g0);
+        vp = _mm_loadu_ps(prev);
+
+        for (s = 3; s < n; s++)
+        {
+            // 上一步的输出整体移动一个通道（第 k-1 级 -> 第 k 级），第 0 个通道放入新的采样
+            __m128 in = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(vp), 4));
+            __m128 y;
+
+            in = _mm_move_ss(in, _mm_set_ss(x[s]));
+            y = _mm_add_ps(_mm_mul_ps(b0, in), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, y));
+            // 最后一级的输出是采样 s-3 的最终结果（x[s] 已经读取，写回不会覆盖还没处理的采样）
+            x[s - 3] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+            vp = y;
+        }
+
+        _mm_storeu_ps(z + g0, z1);
+        _mm_storeu_ps(z + lanes + g0, z2);
+        _mm_storeu_ps(prev, vp);
+        wavefront_epilogue(co, lanes, z, g0, 4, prev, x, n);
+    }
+}
+
+/* ################## AVX2 实现 ################## */
+__attribute__((target("avx2"))) static void
+cascade_avx2(const gfloat *co, gint lanes, gfloat *z, gfloat *x, gint n)
+{
+    // 通道 i 取上一步的通道 i-1（通道 0 取什么都可以，随后被新的采样替换）
+    const __m256i shift = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+    gint g0, s, k;
+
+    for (g0 = 0; g0 < lanes; g0 += 8)
+    {
+        gfloat prev[8];
+        __m256 b0, b1, b2, a1, a2, z1, z2, vp;
+
+        if (n < 8)
+        {
+            for (k = 0; k < 8; k++)
+                stage_run(co, lanes, z, g0 + k, x, n);
+            continue;
+        }
+
+        wavefront_prologue(co, lanes, z, g0, 8, x, prev);
+        b0 = _mm256_loadu_ps(co + CO_B0 * lanes + g0);
+        b1 = _mm256_loadu_ps(co + CO_B1 * lanes + g0);
+        b2 = _mm256_loadu_ps(co + CO_B2 * lanes + g0);
+        a1 = _mm256_loadu_ps(co + CO_A1 * lanes + g0);
+        a2 = _mm256_loadu_ps(co + CO_A2 * lanes + g0);
+        z1 = _mm256_loadu_ps(z + g0);
+        z2 = _mm256_loadu_ps(z + lanes + g0);
+        vp = _mm256_loadu_ps(prev);
+
+        for (s = 7; s < n; s++)
+        {
+            __m256 in = _mm256_blend_ps(_mm256_permutevar8x32_ps(vp, shift), _mm256_set1_ps(x[s]), 0x01);
+            __m256 y = _mm256_add_ps(_mm256_mul_ps(b0, in), z1);
+            __m128 hi;
+
+            z1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, in), _mm256_mul_ps(a1, y)), z2);
+            z2 = _mm256_sub_ps(_mm256_mul_ps(b2, in), _mm256_mul_ps(a2, y));
+            hi = _mm256_extractf128_ps(y, 1);
+            x[s - 7] = _mm_cvtss_f32(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(3, 3, 3, 3)));
+            vp = y;
+        }
+
+        _mm256_storeu_ps(z + g0, z1);
+        _mm256_storeu_ps(z + lanes + g0, z2);
+        _mm256_storeu_ps(prev, vp);
+        wavefront_epilogue(co, lanes, z, g0, 8, prev, x, n);
+    }
+}
+#endif /* BIQUAD_X86 */
+
+/* ################## 运行时分派 ################## */
+
+static const gchar *kernel_names[BIQUAD_KERNEL_COUNT] = {"auto", "scalar", "sse", "avx2"};
+
+gboolean
+biquad_kernel_supported(BiquadKernel kernel)
+{
+    switch (kernel)
+    {
+    case BIQUAD_KERNEL_AUTO:
+    case BIQUAD_KERNEL_SCALAR:
+        return TRUE;
+#ifdef BIQUAD_X86
+    case BIQUAD_KERNEL_SSE:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case BIQUAD_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+const gchar *
+biquad_kernel_name(BiquadKernel kernel)
+{
+    return kernel < BIQUAD_KERNEL_COUNT ? kernel_names[kernel] : "unknown";
+}
+
+gboolean
+biquad_kernel_from_name(const gchar *name, BiquadKernel *kernel)
+{
+    gint i;
+
+    for (i = 0; i < BIQUAD_KERNEL_COUNT; i++)
+    {
+        if (g_ascii_strcasecmp(name, kernel_names[i]) == 0)
+        {
+            *kernel = (BiquadKernel)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static CascadeFunc
+get_cascade_func(BiquadKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef BIQUAD_X86
+    case BIQUAD_KERNEL_SSE:
+        return cascade_sse;
+    case BIQUAD_KERNEL_AVX2:
+        return cascade_avx2;
+#endif
+    default:
+        return cascade_scalar;
+    }
+}
+
+/* 把一级设置为直通 */
+static void
+set_identity(BiquadCascade *bc, gint k)
+{
+    gint lanes = bc->lanes;
+
+    bc->coeffs[CO_B0 * lanes + k] = 1;
+    bc->coeffs[CO_B1 * lanes + k] = 0;
+    bc->coeffs[CO_B2 * lanes + k] = 0;
+    bc->coeffs[CO_A1 * lanes + k] = 0;
+    bc->coeffs[CO_A2 * lanes + k] = 0;
+}
+
+void
+biquad_cascade_init(BiquadCascade *bc, gint bands, gint channels, BiquadKernel kernel)
+{
+    gint width, k;
+
+    bands = CLAMP(bands, 1, BIQUAD_MAX_BANDS);
+    if (!biquad_kernel_supported(kernel))
+        kernel = BIQUAD_KERNEL_AUTO;
+    if (kernel == BIQUAD_KERNEL_AUTO)
+    {
+        // 频段不超过 4 个时 SSE 正好一个向量，AVX2 反而要多算 4 个直通级
+        kernel = BIQUAD_KERNEL_SCALAR;
+        if (biquad_kernel_supported(BIQUAD_KERNEL_SSE))
+            kernel = BIQUAD_KERNEL_SSE;
+        if (bands > 4 && biquad_kernel_supported(BIQUAD_KERNEL_AVX2))
+            kernel = BIQUAD_KERNEL_AVX2;
+    }
+
+    width = kernel == BIQUAD_KERNEL_AVX2 ? 8 : kernel == BIQUAD_KERNEL_SSE ? 4 : 1;
+    bc->bands = bands;
+    bc->lanes = (bands + width - 1) / width * width;
+    bc->channels = MAX(channels, 1);
+    bc->kernel = kernel;
+    bc->coeffs = g_new0(gfloat, 5 * bc->lanes);
+    bc->state = g_new0(gfloat, 2 * bc->lanes * bc->channels);
+    bc->scratch = g_new0(gfloat, BIQUAD_SCRATCH);
+    for (k = 0; k < bc->lanes; k++)
+        set_identity(bc, k);
+}
+
+void
+biquad_cascade_clear(BiquadCascade *bc)
+{
+    g_free(bc->coeffs);
+    g_free(bc->state);
+    g_free(bc->scratch);
+    bc->coeffs = NULL;
+    bc->state = NULL;
+    bc->scratch = NULL;
+}
+
+void
+biquad_cascade_set_band(BiquadCascade *bc, gint band, BiquadType type, gdouble freq, gdouble width, gdouble gain_db, gint rate)
+{
+    gdouble A, omega, bw, alpha, c, d;
+    gdouble b0, b1, b2, a0, a1, a2;
+    gint lanes = bc->lanes;
+
+    g_return_if_fail(band >= 0 && band < bc->bands);
+
+    // 0 dB 或者带宽为 0：直通
+    if (gain_db == 0 || rate <= 0 || width <= 0)
+    {
+        set_identity(bc, band);
+        return;
+    }
+
+    // 与 GstIirEqualizer 相同：A = 10^(dB/40)，带宽换算为角度后 alpha = tan(bw/2)
+    A = pow(10.0, gain_db / 40.0);
+    // 中心频率超过奈奎斯特频率时取 pi；带宽不能取到 pi，否则 tan(bw/2) 无穷大
+    if (freq >= rate / 2.0)
+        omega = G_PI;
+    else if (freq <= 0)
+        omega = 0;
+    else
+        omega = 2.0 * G_PI * freq / rate;
+    if (width >= rate / 2.0)
+        bw = G_PI - 0.00001;
+    else
+        bw = 2.0 * G_PI * width / rate;
+    alpha = tan(bw / 2.0);
+    c = cos(omega);
+
+    switch (type)
+    {
+    case BIQUAD_LOW_SHELF:
+        d = 2.0 * sqrt(A) * alpha;
+        b0 = A * ((A + 1) - (A - 1) * c + d);
+        b1 = 2.0 * A * ((A - 1) - (A + 1) * c);
+        b2 = A * ((A + 1) - (A - 1) * c - d);
+        a0 = (A + 1) + (A - 1) * c + d;
+        a1 = -2.0 * ((A - 1) + (A + 1) * c);
+        a2 = (A + 1) + (A - 1) * c - d;
+        break;
+    case BIQUAD_HIGH_SHELF:
+        d = 2.0 * sqrt(A) * alpha;
+        b0 = A * ((A + 1) + (A - 1) * c + d);
+        b1 = -2.0 * A * ((A - 1) + (A + 1) * c);
+        b2 = A * ((A + 1) + (A - 1) * c - d);
+        a0 = (A + 1) - (A - 1) * c + d;
+        a1 = 2.0 * ((A - 1) - (A + 1) * c);
+        a2 = (A + 1) - (A - 1) * c - d;
+        break;
+    case BIQUAD_PEAK:
+    default:
+        b0 = 1 + alpha * A;
+        b1 = -2.0 * c;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2.0 * c;
+        a2 = 1 - alpha / A;
+        break;
+    }
+
+    bc->coeffs[CO_B0 * lanes + band] = (gfloat)(b0 / a0);
+    bc->coeffs[CO_B1 * lanes + band] = (gfloat)(b1 / a0);
+    bc->coeffs[CO_B2 * lanes + band] = (gfloat)(b2 / a0);
+    bc->coeffs[CO_A1 * lanes + band] = (gfloat)(a1 / a0);
+    bc->coeffs[CO_A2 * lanes + band] = (gfloat)(a2 / a0);
+}
+
+void
+biquad_cascade_reset(BiquadCascade *bc)
+{
+    memset(bc->state, 0, sizeof(gfloat) * 2 * bc->lanes * bc->channels);
+}
+
+void
+biquad_cascade_process_f32(BiquadCascade *bc, gfloat *data, gint frames)
+{
+    CascadeFunc func = get_cascade_func(bc->kernel);
+    gint channels = bc->channels;
+    gint done, n, ch, i;
+
+    // 单声道数据本身就是连续的，直接原地处理
+    if (channels == 1)
+    {
+        func(bc->coeffs, bc->lanes, bc->state, data, frames);
+        return;
+    }
+
+    for (done = 0; done < frames; done += n)
+    {
+        n = MIN(frames - done, BIQUAD_SCRATCH);
+        for (ch = 0; ch < channels; ch++)
+        {
+            gfloat *p = data + (gsize)done * channels + ch;
+            for (i = 0; i < n; i++)
+                bc->scratch[i] = p[(gsize)i * channels];
+            func(bc->coeffs, bc->lanes, bc->state + 2 * bc->lanes * ch, bc->scratch, n);
+            for (i = 0; i < n; i++)
+                p[(gsize)i * channels] = bc->scratch[i];
+        }
+    }
+}
+
+void
+biquad_cascade_process_s16(BiquadCascade *bc, gint16 *data, gint frames)
+{
+    CascadeFunc func = get_cascade_func(bc->kernel);
+    gint channels = bc->channels;
+    gint done, n, ch, i;
+
+    for (done = 0; done < frames; done += n)
+    {
+        n = MIN(frames - done, BIQUAD_SCRATCH);
+        for (ch = 0; ch < channels; ch++)
+        {
+            gint16 *p = data + (gsize)done * channels + ch;
+            for (i = 0; i < n; i++)
+                bc->scratch[i] = p[(gsize)i * channels];
+            func(bc->coeffs, bc->lanes, bc->state + 2 * bc->lanes * ch, bc->scratch, n);
+            // 四舍五入并限制在 S16 的范围内（提升增益时可能溢出）
+            for (i = 0; i < n; i++)
+                p[(gsize)i * channels] = (gint16)CLAMP(lrintf(bc->scratch[i]), G_MININT16, G_MAXINT16);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef BIQUAD_CASCADE_H
+#define BIQUAD_CASCADE_H
+
+#include <glib.h>
+
+/**
+ * 多频段均衡器的二阶 IIR 级联（simdeq 元素的计算部分）
+ *
+ * N 个频段就是 N 个二阶节（biquad，转置直接 II 型）串联：每个采样依次经过所有频段。
+ * 逐个采样、逐个频段计算时，每一级都要等上一级的结果，无法向量化（equalizer-3bands/nbands 就是这样实现的）。
+ *
+ * 这里按 "波前" 的方式把不同的频段放在向量的不同通道中同时计算：
+ * 第 s 步时，第 k 级处理第 s-k 个采样，它的输入正好是第 k-1 级在上一步（第 s-1 步）的输出，
+ * 所以每一步只需要把上一步的输出向量整体移动一个通道，再在第 0 个通道放入新的采样：
+ *
+ *     步骤 s:   级0(x[s])  级1(y0[s-1])  级2(y1[s-2])  级3(y2[s-3])  -> y3[s-3] 为最终输出
+ *
+ * 每一级处理采样的顺序不变，结果与逐级计算完全相同；只是每个 buffer 开头和结尾的三角形区域
+ * （前几级已经开始、后几级还没开始的部分）用标量计算。
+ * 频段数补齐到向量宽度（SSE 4 级，AVX2 8 级），补齐的级为直通（b0 = 1）。
+ * 每一步的耗时由一个二阶节的依赖链决定，与级数无关，所以频段越多加速越明显；
+ * 频段不超过 4 个时 SSE 比 AVX2 更合适（AVX2 要多走 4 个直通级，开头结尾的标量部分也更长）。
+ *
+ * 多声道时每个声道有独立的状态，逐个声道处理（先取出到连续的中间缓冲区）。
+ */
+
+#define BIQUAD_MAX_BANDS 16   /* 最多的频段数（补齐后最多 16 级） */
+#define BIQUAD_SCRATCH 1024   /* 多声道/S16 时的中间缓冲区大小（采样数） */
+
+typedef enum
+{
+    BIQUAD_KERNEL_AUTO,   /* 运行时按 CPU 和频段数选择 */
+    BIQUAD_KERNEL_SCALAR, /* 纯 C，逐个采样逐级计算（所有平台） */
+    BIQUAD_KERNEL_SSE,    /* SSE2 波前，4 级一个向量 */
+    BIQUAD_KERNEL_AVX2,   /* AVX2 波前，8 级一个向量 */
+    BIQUAD_KERNEL_COUNT
+} BiquadKernel;
+
+typedef enum
+{
+    BIQUAD_PEAK,       /* 峰值滤波器 */
+    BIQUAD_LOW_SHELF,  /* 低架滤波器 */
+    BIQUAD_HIGH_SHELF, /* 高架滤波器 */
+} BiquadType;
+
+typedef struct _BiquadCascade
+{
+    gint bands;          /* 频段数 */
+    gint lanes;          /* 补齐后的级数 */
+    gint channels;
+    BiquadKernel kernel; /* 实际使用的实现 */
+    gfloat *coeffs;      /* b0[lanes] b1[lanes] b2[lanes] a1[lanes] a2[lanes]（已经除以 a0） */
+    gfloat *state;       /* 每个声道 z1[lanes] z2[lanes] */
+    gfloat *scratch;     /* 中间缓冲区 */
+} BiquadCascade;
+
+gboolean biquad_kernel_supported(BiquadKernel kernel);
+const gchar *biquad_kernel_name(BiquadKernel kernel);
+/* 按名字查找实现（auto/scalar/sse/avx2），找不到返回 FALSE */
+gboolean biquad_kernel_from_name(const gchar *name, BiquadKernel *kernel);
+
+/* 初始化：所有频段为直通，状态清零；不支持的 kernel 会退回到 AUTO */
+void biquad_cascade_init(BiquadCascade *bc, gint bands, gint channels, BiquadKernel kernel);
+void biquad_cascade_clear(BiquadCascade *bc);
+/**
+ * 设置一个频段：中心频率和带宽（Hz），增益（dB）。设计公式和超出奈奎斯特频率时的截断与 GstIirEqualizer 相同，
+ * 但系数和状态是单精度的（GstIirEqualizer 用双精度），输出只是接近，并不逐位相同
+ */
+void biquad_cascade_set_band(BiquadCascade *bc, gint band, BiquadType type, gdouble freq, gdouble width, gdouble gain_db, gint rate);
+/* 清除滤波器状态（例如 seek 之后） */
+void biquad_cascade_reset(BiquadCascade *bc);
+/* 原地处理交错存储的 frames 帧 */
+void biquad_cascade_process_f32(BiquadCascade *bc, gfloat *data, gint frames);
+void biquad_cascade_process_s16(BiquadCascade *bc, gint16 *data, gint frames);
+
+#endif /* BIQUAD_CASCADE_H */
@@ -0,0 +1,221 @@
+/**
+ * 均衡器基准测试
+ *
+ * 在相同的频段（中心频率、带宽、类型）和增益下对比 simdeq（scalar/sse/avx2）与 equalizer-3bands / equalizer-nbands：
+ *     audiotestsrc wave=white-noise ! audio/x-raw,format=F32/S16 ! <均衡器> ! fakesink sync=false
+ * 以 identity 作为基线（只有 audiotestsrc 和 fakesink 的开销），均衡器本身的耗时 = 总耗时 - 基线耗时。
+ *
+ *   make bench-eq
+ *   ./eq_bench.out [--seconds=60] [--channels=2] [--rate=48000] [--bands=3,10,16]
+ */
+#include <gst/gst.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "biquad_cascade.h"
+#include "simd_eq.h"
+
+#define SAMPLES_PER_BUFFER 1024
+
+/* 运行一次 pipeline 直到 EOS，返回耗时（秒），失败返回 -1 */
+static gdouble
+run_pipeline(const gchar *description)
+{
+    GstElement *pipeline;
+    GstBus *bus;
+    GstMessage *msg;
+    GError *error = NULL;
+    gint64 start, end;
+    gboolean ok;
+
+    pipeline = gst_parse_launch(description, &error);
+    if (!pipeline)
+    {
+        g_printerr("Failed to build '%s': %s\n", description, error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+
+    // 先进入 PAUSED 完成协商和 preroll，只对 PLAYING 之后的部分计时
+    gst_element_set_state(pipeline, GST_STATE_PAUSED);
+    gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+    start = g_get_monotonic_time();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    bus = gst_element_get_bus(pipeline);
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    end = g_get_monotonic_time();
+
+    ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    if (!ok)
+        g_printerr("'%s' failed\n", description);
+    if (msg)
+        gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok ? (end - start) / (gdouble)G_USEC_PER_SEC : -1;
+}
+
+/* 第 i 段的增益：正负交替，所有段都不为 0，避免任何一个实现进入直通 */
+static gdouble
+band_gain(gint i)
+{
+    return i % 2 ? -6.0 : 4.0;
+}
+
+/* GstIirEqualizerBandType 的名字 */
+static const gchar *
+band_type_nick(BiquadType type)
+{
+    switch (type)
+    {
+    case BIQUAD_LOW_SHELF:
+        return "low-shelf";
+    case BIQUAD_HIGH_SHELF:
+        return "high-shelf";
+    case BIQUAD_PEAK:
+    default:
+        return "peak";
+    }
+}
+
+/* 各个均衡器的 pipeline 描述片段（调用者释放），不支持该段数时返回 NULL */
+static gchar *
+eq_description(const gchar *variant, gint bands)
+{
+    GString *s = g_string_new(NULL);
+    gint i;
+
+    if (g_str_equal(variant, "identity"))
+    {
+        g_string_append(s, "identity");
+    }
+    else if (g_str_equal(variant, "equalizer-3bands"))
+    {
+        if (bands != 3)
+            return g_string_free(s, TRUE), NULL;
+        g_string_append(s, "equalizer-3bands");
+        for (i = 0; i < 3; i++)
+            g_string_append_printf(s, " band%d=%g", i, band_gain(i));
+    }
+    else if (g_str_equal(variant, "equalizer-nbands"))
+    {
+        // 频段是子对象（GstChildProxy），用 band0::gain 的形式设置；
+        // equalizer-nbands 3 段时的频率与 equalizer-3bands 不同，频率、带宽和类型都按 simdeq 的频段设置
+        g_string_append_printf(s, "equalizer-nbands num-bands=%d", bands);
+        for (i = 0; i < bands; i++)
+        {
+            gdouble freq, width;
+            BiquadType type;
+
+            simd_eq_band_layout(bands, i, &freq, &width, &type);
+            g_string_append_printf(s, " band%d::freq=%.17g band%d::bandwidth=%.17g band%d::type=%s band%d::gain=%g",
+                                   i, freq, i, width, i, band_type_nick(type), i, band_gain(i));
+        }
+    }
+    else
+    {
+        // simdeq-<kernel>
+        g_string_append_printf(s, "simdeq num-bands=%d kernel=%s", bands, variant + strlen("simdeq-"));
+        for (i = 0; i < bands; i++)
+            g_string_append_printf(s, " band%d=%g", i, band_gain(i));
+    }
+    return g_string_free(s, FALSE);
+}
+
+int main(int argc, char *argv[])
+{
+    gdouble seconds = 60.0;
+    gint channels = 2, rate = 48000;
+    gchar *bands_str = NULL;
+    gchar **bands_list;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"seconds", 0, 0, G_OPTION_ARG_DOUBLE, &seconds, "Audio duration per run", "S"},
+        {"channels", 0, 0, G_OPTION_ARG_INT, &channels, "Number of channels", "N"},
+        {"rate", 0, 0, G_OPTION_ARG_INT, &rate, "Sample rate", "HZ"},
+        {"bands", 0, 0, G_OPTION_ARG_STRING, &bands_str, "Comma separated band counts (default 3,10,16)", "LIST"},
+        {NULL}};
+    const gchar *formats[] = {"F32LE", "S16LE"};
+    const gchar *variants[] = {"identity", "equalizer-3bands", "equalizer-nbands",
+                               "simdeq-scalar", "simdeq-sse", "simdeq-avx2"};
+    gint num_buffers;
+    guint f, b, v;
+
+    context = g_option_context_new("- equalizer benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (seconds <= 0 || channels <= 0 || rate <= 0)
+    {
+        g_printerr("--seconds, --channels and --rate must be > 0\n");
+        return -1;
+    }
+    simd_eq_register();
+
+    bands_list = g_strsplit(bands_str ? bands_str : "3,10,16", ",", -1);
+    num_buffers = MAX((gint)(seconds * rate / SAMPLES_PER_BUFFER), 1);
+    g_print("%d buffers of %d frames, %d channels, %d Hz (%.1f s of audio per run)\n",
+            num_buffers, SAMPLES_PER_BUFFER, channels, rate, (gdouble)num_buffers * SAMPLES_PER_BUFFER / rate);
+    g_print("%-6s %-6s %-18s %10s %14s %10s %12s\n",
+            "format", "bands", "element", "wall-s", "samples/sec", "realtime", "eq-ns/sample");
+
+    for (f = 0; f < G_N_ELEMENTS(formats); f++)
+    {
+        for (b = 0; bands_list[b]; b++)
+        {
+            gint bands = atoi(bands_list[b]);
+            gdouble samples = (gdouble)num_buffers * SAMPLES_PER_BUFFER * channels;
+            gdouble baseline = -1;
+
+            if (bands < 1 || bands > BIQUAD_MAX_BANDS)
+            {
+                g_printerr("Skipping band count '%s' (1~%d)\n", bands_list[b], BIQUAD_MAX_BANDS);
+                continue;
+            }
+            for (v = 0; v < G_N_ELEMENTS(variants); v++)
+            {
+                BiquadKernel kernel;
+                gchar *eq, *description;
+                gdouble t;
+
+                if (g_str_has_prefix(variants[v], "simdeq-") &&
+                    biquad_kernel_from_name(variants[v] + strlen("simdeq-"), &kernel) &&
+                    !biquad_kernel_supported(kernel))
+                    continue;
+                eq = eq_description(variants[v], bands);
+                if (!eq)
+                    continue;
+                description = g_strdup_printf("audiotestsrc wave=white-noise num-buffers=%d samplesperbuffer=%d ! "
+                                              "audio/x-raw,format=%s,rate=%d,channels=%d ! %s ! fakesink sync=false",
+                                              num_buffers, SAMPLES_PER_BUFFER, formats[f], rate, channels, eq);
+                t = run_pipeline(description);
+                g_free(description);
+                g_free(eq);
+                if (t <= 0)
+                    continue;
+                if (v == 0)
+                    baseline = t;
+
+                // realtime: 处理速度是实时播放的多少倍；eq-ns/sample: 扣除基线后每个采样的耗时
+                g_print("%-6.3s %-6d %-18s %10.3f %14.0f %9.0fx", formats[f], bands, variants[v],
+                        t, samples / t, samples / channels / rate / t);
+                if (v > 0 && baseline > 0)
+                    g_print(" %12.2f\n", MAX(t - baseline, 0) * 1e9 / samples);
+                else
+                    g_print(" %12s\n", "-");
+            }
+        }
+    }
+
+    g_strfreev(bands_list);
+    g_free(bands_str);
+    return 0;
+}
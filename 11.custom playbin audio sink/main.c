@@ -1,34 +1,69 @@
 #include <gst/gst.h>
 
+#include "simd_eq.h"
+
 int main(int argc, char *argv[])
 {
     GstElement *pipeline, *bin, *equalizer, *convert, *sink;
     GstPad *pad, *ghost_pad;
     GstBus *bus;
     GstMessage *msg;
+    GOptionContext *context;
+    GError *error = NULL;
+    gboolean stock_eq = FALSE;
+    gchar *kernel = NULL;
+    GOptionEntry entries[] = {
+        {"stock-eq", 0, 0, G_OPTION_ARG_NONE, &stock_eq, "Use equalizer-3bands + audioconvert instead of simdeq", NULL},
+        {"eq-kernel", 0, 0, G_OPTION_ARG_STRING, &kernel, "simdeq implementation: auto, scalar, sse or avx2 (default auto)", "NAME"},
+        {NULL}};
 
     /* Initialize GStreamer */
-    gst_init(&argc, &argv);
+    context = g_option_context_new("- custom playbin audio sink");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    // 注册程序内的 simdeq 元素
+    simd_eq_register();
 
     /* Build the pipeline */
     pipeline = gst_parse_launch("playbin uri=https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer-480p.webm", NULL);
 
     /* Create the elements inside the sink bin */
-    equalizer = gst_element_factory_make("equalizer-3bands", "equalizer");
-    convert = gst_element_factory_make("audioconvert", "convert");
+    // simdeq 直接处理 F32/S16，音频设备的 sink 都能接受这两种格式，后面不需要 audioconvert
+    // （playbin 在 audio-sink 前面已经有自己的格式转换，解码器输出 F32/S16 时它什么都不做）
+    equalizer = gst_element_factory_make(stock_eq ? "equalizer-3bands" : "simdeq", "equalizer");
+    convert = stock_eq ? gst_element_factory_make("audioconvert", "convert") : NULL;
     sink = gst_element_factory_make("autoaudiosink", "audio_sink");
-    if (!equalizer || !convert || !sink)
+    if (!equalizer || (stock_eq && !convert) || !sink)
     {
         g_printerr("Not all elements could be created.\n");
         return -1;
     }
+    if (!stock_eq && kernel)
+        g_object_set(equalizer, "kernel", kernel, NULL);
+    g_free(kernel);
 
     /* Create the sink bin, add the elements and link them */
     // 创建自定义的GstBin，实现音频处理（均衡器）和播放
-    // GstBin myAudioBin = [equalizer-3bands => audioconvert => autoaudiosink ]
+    // GstBin myAudioBin = [simdeq => autoaudiosink ]
+    //   --stock-eq 时为 [equalizer-3bands => audioconvert => autoaudiosink ]
     bin = gst_bin_new("audio_sink_bin");
-    gst_bin_add_many(GST_BIN(bin), equalizer, convert, sink, NULL);
-    gst_element_link_many(equalizer, convert, sink, NULL);
+    if (stock_eq)
+    {
+        gst_bin_add_many(GST_BIN(bin), equalizer, convert, sink, NULL);
+        gst_element_link_many(equalizer, convert, sink, NULL);
+    }
+    else
+    {
+        gst_bin_add_many(GST_BIN(bin), equalizer, sink, NULL);
+        gst_element_link(equalizer, sink);
+    }
     // 获取 equalizer.sink_pad
     pad = gst_element_get_static_pad(equalizer, "sink");
     // 创建ghost_pad, 名为sink、实际指向equalizer.sink_pad
@@ -44,6 +79,7 @@ int main(int argc, char *argv[])
     // band1: 1100Hz增益 ∈ [-24,+12] 默认0
     // band2: 11000Hz增益 ∈ [-24,+12] 默认0
     // 保留低频，完全衰减中高频。
+    // simdeq 默认 3 段，频率和属性名与 equalizer-3bands 相同
     g_object_set(G_OBJECT(equalizer), "band0", (gdouble)0, NULL);
     g_object_set(G_OBJECT(equalizer), "band1", (gdouble)-24.0, NULL);
     g_object_set(G_OBJECT(equalizer), "band2", (gdouble)-24.0, NULL);
@@ -0,0 +1,325 @@
+#include "simd_eq.h"
+#include "biquad_cascade.h"
+
+#include <gst/audio/audio.h>
+#include <math.h>
+
+#define DEFAULT_NUM_BANDS 3
+#define MIN_GAIN -24.0
+#define MAX_GAIN 12.0
+
+typedef struct _GstSimdEq
+{
+    GstAudioFilter parent;
+
+    /* 属性（GST_OBJECT_LOCK 保护） */
+    gint num_bands;
+    gdouble gains[BIQUAD_MAX_BANDS];
+    BiquadKernel kernel;
+    gboolean dirty;   /* 增益变化，需要重新计算系数 */
+    gboolean rebuild; /* 段数或 kernel 变化，需要重新创建级联 */
+
+    /* 只在流线程中使用 */
+    BiquadCascade bc;
+    gboolean have_bc;
+} GstSimdEq;
+
+typedef struct _GstSimdEqClass
+{
+    GstAudioFilterClass parent_class;
+} GstSimdEqClass;
+
+#define GST_SIMD_EQ(obj) ((GstSimdEq *)(obj))
+
+G_DEFINE_TYPE(GstSimdEq, gst_simd_eq, GST_TYPE_AUDIO_FILTER);
+
+enum
+{
+    PROP_0,
+    PROP_NUM_BANDS,
+    PROP_KERNEL,
+    PROP_BAND0, /* band0 ~ band15 依次排列 */
+};
+
+#define CAPS_STR                                                  \
+    "audio/x-raw, "                                               \
+    "format = (string) { " GST_AUDIO_NE(F32) ", " GST_AUDIO_NE(S16) " }, " \
+    "rate = (int) [ 1, MAX ], "                                   \
+    "channels = (int) [ 1, MAX ], "                               \
+    "layout = (string) interleaved"
+
+void
+simd_eq_band_layout(gint num_bands, gint band, gdouble *freq, gdouble *width, BiquadType *type)
+{
+    static const gdouble freq3[3] = {100.0, 1100.0, 11000.0};
+    static const gdouble width3[3] = {100.0, 1000.0, 10000.0};
+
+    if (num_bands == 3)
+    {
+        *freq = freq3[band];
+        *width = width3[band];
+    }
+    else
+    {
+        // 20Hz ~ 20kHz 按对数均分，中心频率取区间的中点
+        gdouble step = pow(20000.0 / 20.0, 1.0 / num_bands);
+        gdouble f0 = 20.0 * pow(step, band);
+        gdouble f1 = f0 * step;
+        *freq = f0 + (f1 - f0) / 2.0;
+        *width = f1 - f0;
+    }
+
+    if (band == 0)
+        *type = BIQUAD_LOW_SHELF;
+    else if (band == num_bands - 1)
+        *type = BIQUAD_HIGH_SHELF;
+    else
+        *type = BIQUAD_PEAK;
+}
+
+/* 按当前增益重新计算系数，返回是否可以直通（调用时持有 GST_OBJECT_LOCK） */
+static gboolean
+update_coefficients(GstSimdEq *self, gint rate)
+{
+    gboolean passthrough = TRUE;
+    gint i;
+
+    for (i = 0; i < self->bc.bands; i++)
+    {
+        gdouble freq, width;
+        BiquadType type;
+
+        simd_eq_band_layout(self->bc.bands, i, &freq, &width, &type);
+        biquad_cascade_set_band(&self->bc, i, type, freq, width, self->gains[i], rate);
+        if (self->gains[i] != 0)
+            passthrough = FALSE;
+    }
+    self->dirty = FALSE;
+    return passthrough;
+}
+
+/* 重新创建级联（段数、kernel 或声道数变化），调用时持有 GST_OBJECT_LOCK */
+static void
+rebuild_cascade(GstSimdEq *self, gint channels)
+{
+    if (self->have_bc)
+        biquad_cascade_clear(&self->bc);
+    biquad_cascade_init(&self->bc, self->num_bands, channels, self->kernel);
+    self->have_bc = TRUE;
+    self->rebuild = FALSE;
+    self->dirty = TRUE;
+    GST_INFO_OBJECT(self, "%d bands, %d channels, kernel %s", self->bc.bands, channels,
+                    biquad_kernel_name(self->bc.kernel));
+}
+
+static gboolean
+gst_simd_eq_setup(GstAudioFilter *filter, const GstAudioInfo *info)
+{
+    GstSimdEq *self = GST_SIMD_EQ(filter);
+
+    GST_OBJECT_LOCK(self);
+    rebuild_cascade(self, GST_AUDIO_INFO_CHANNELS(info));
+    GST_OBJECT_UNLOCK(self);
+    return TRUE;
+}
+
+static gboolean
+gst_simd_eq_stop(GstBaseTransform *trans)
+{
+    GstSimdEq *self = GST_SIMD_EQ(trans);
+
+    GST_OBJECT_LOCK(self);
+    if (self->have_bc)
+        biquad_cascade_clear(&self->bc);
+    self->have_bc = FALSE;
+    GST_OBJECT_UNLOCK(self);
+    return TRUE;
+}
+
+static GstFlowReturn
+gst_simd_eq_transform_ip(GstBaseTransform *trans, GstBuffer *buf)
+{
+    GstSimdEq *self = GST_SIMD_EQ(trans);
+    GstAudioFilter *filter = GST_AUDIO_FILTER(trans);
+    GstClockTime timestamp, stream_time;
+    GstMapInfo map;
+    gint rate = GST_AUDIO_FILTER_RATE(filter);
+    gint bpf = GST_AUDIO_FILTER_BPF(filter);
+    gboolean passthrough;
+
+    if (G_UNLIKELY(rate <= 0 || bpf <= 0))
+        return GST_FLOW_NOT_NEGOTIATED;
+
+    // 让控制器（GstController）更新 band 属性
+    timestamp = GST_BUFFER_TIMESTAMP(buf);
+    stream_time = gst_segment_to_stream_time(&trans->segment, GST_FORMAT_TIME, timestamp);
+    if (GST_CLOCK_TIME_IS_VALID(stream_time))
+        gst_object_sync_values(GST_OBJECT(self), stream_time);
+
+    GST_OBJECT_LOCK(self);
+    if (self->rebuild || !self->have_bc)
+        rebuild_cascade(self, GST_AUDIO_FILTER_CHANNELS(filter));
+    if (self->dirty)
+    {
+        passthrough = update_coefficients(self, rate);
+        GST_OBJECT_UNLOCK(self);
+        gst_base_transform_set_passthrough(trans, passthrough);
+    }
+    else
+    {
+        GST_OBJECT_UNLOCK(self);
+    }
+
+    if (gst_base_transform_is_passthrough(trans) || GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_GAP))
+        return GST_FLOW_OK;
+
+    if (!gst_buffer_map(buf, &map, GST_MAP_READWRITE))
+        return GST_FLOW_ERROR;
+    if (GST_AUDIO_FILTER_FORMAT(filter) == GST_AUDIO_FORMAT_F32)
+        biquad_cascade_process_f32(&self->bc, (gfloat *)map.data, map.size / bpf);
+    else
+        biquad_cascade_process_s16(&self->bc, (gint16 *)map.data, map.size / bpf);
+    gst_buffer_unmap(buf, &map);
+    return GST_FLOW_OK;
+}
+
+static void
+gst_simd_eq_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstSimdEq *self = GST_SIMD_EQ(object);
+    BiquadKernel kernel;
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id)
+    {
+    case PROP_NUM_BANDS:
+        self->num_bands = g_value_get_int(value);
+        self->rebuild = TRUE;
+        break;
+    case PROP_KERNEL:
+        if (!g_value_get_string(value) || !biquad_kernel_from_name(g_value_get_string(value), &kernel))
+        {
+            GST_WARNING_OBJECT(self, "unknown kernel '%s'", g_value_get_string(value));
+            break;
+        }
+        if (!biquad_kernel_supported(kernel))
+            GST_WARNING_OBJECT(self, "kernel %s is not supported by this CPU, using auto", biquad_kernel_name(kernel));
+        self->kernel = kernel;
+        self->rebuild = TRUE;
+        break;
+    default:
+        if (prop_id >= PROP_BAND0 && prop_id < PROP_BAND0 + BIQUAD_MAX_BANDS)
+        {
+            self->gains[prop_id - PROP_BAND0] = g_value_get_double(value);
+            self->dirty = TRUE;
+        }
+        else
+        {
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    // 增益从 0 变为非 0 时需要退出直通模式，否则 transform_ip 不会修改数据
+    gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(self), FALSE);
+}
+
+static void
+gst_simd_eq_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstSimdEq *self = GST_SIMD_EQ(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id)
+    {
+    case PROP_NUM_BANDS:
+        g_value_set_int(value, self->num_bands);
+        break;
+    case PROP_KERNEL:
+        // 已经创建了级联时返回实际使用的实现
+        g_value_set_string(value, biquad_kernel_name(self->have_bc ? self->bc.kernel : self->kernel));
+        break;
+    default:
+        if (prop_id >= PROP_BAND0 && prop_id < PROP_BAND0 + BIQUAD_MAX_BANDS)
+            g_value_set_double(value, self->gains[prop_id - PROP_BAND0]);
+        else
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void
+gst_simd_eq_finalize(GObject *object)
+{
+    GstSimdEq *self = GST_SIMD_EQ(object);
+
+    if (self->have_bc)
+        biquad_cascade_clear(&self->bc);
+    G_OBJECT_CLASS(gst_simd_eq_parent_class)->finalize(object);
+}
+
+static void
+gst_simd_eq_class_init(GstSimdEqClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS(klass);
+    GstAudioFilterClass *filter_class = GST_AUDIO_FILTER_CLASS(klass);
+    GstCaps *caps;
+    gint i;
+
+    gobject_class->set_property = gst_simd_eq_set_property;
+    gobject_class->get_property = gst_simd_eq_get_property;
+    gobject_class->finalize = gst_simd_eq_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_NUM_BANDS,
+                                    g_param_spec_int("num-bands", "Number of bands", "Number of equalizer bands",
+                                                     1, BIQUAD_MAX_BANDS, DEFAULT_NUM_BANDS,
+                                                     G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_KERNEL,
+                                    g_param_spec_string("kernel", "Kernel", "Implementation: auto, scalar, sse or avx2",
+                                                        "auto", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    for (i = 0; i < BIQUAD_MAX_BANDS; i++)
+    {
+        gchar *name = g_strdup_printf("band%d", i);
+        gchar *blurb = g_strdup_printf("Gain of band %d (only used when num-bands > %d)", i, i);
+
+        // 名字不是静态字符串，g_param_spec 会自己复制一份
+        g_object_class_install_property(gobject_class, PROP_BAND0 + i,
+                                        g_param_spec_double(name, name, blurb, MIN_GAIN, MAX_GAIN, 0.0,
+                                                            G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
+        g_free(name);
+        g_free(blurb);
+    }
+
+    gst_element_class_set_static_metadata(element_class, "SIMD N-band equalizer", "Filter/Effect/Audio",
+                                          "N-band IIR equalizer with vectorized biquad cascades (F32/S16)",
+                                          "gstreamer-demos");
+
+    caps = gst_caps_from_string(CAPS_STR);
+    gst_audio_filter_class_add_pad_templates(filter_class, caps);
+    gst_caps_unref(caps);
+
+    filter_class->setup = GST_DEBUG_FUNCPTR(gst_simd_eq_setup);
+    trans_class->stop = GST_DEBUG_FUNCPTR(gst_simd_eq_stop);
+    trans_class->transform_ip = GST_DEBUG_FUNCPTR(gst_simd_eq_transform_ip);
+    trans_class->transform_ip_on_passthrough = TRUE; // 直通时也调用 transform_ip，用来同步控制器和检查增益
+}
+
+static void
+gst_simd_eq_init(GstSimdEq *self)
+{
+    self->num_bands = DEFAULT_NUM_BANDS;
+    self->kernel = BIQUAD_KERNEL_AUTO;
+    self->dirty = TRUE;
+    // 所有增益默认为 0：第一个 buffer 到来时计算系数后进入直通
+    gst_base_transform_set_in_place(GST_BASE_TRANSFORM(self), TRUE);
+}
+
+gboolean
+simd_eq_register(void)
+{
+    return gst_element_register(NULL, "simdeq", GST_RANK_NONE, GST_TYPE_SIMD_EQ);
+}
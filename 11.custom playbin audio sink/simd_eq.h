@@ -0,0 +1,30 @@
+#ifndef SIMD_EQ_H
+#define SIMD_EQ_H
+
+#include <gst/gst.h>
+
+#include "biquad_cascade.h"
+
+/**
+ * simdeq：N 段均衡器元素（替代 equalizer-3bands / equalizer-nbands）
+ *
+ * - 直接处理 F32 和 S16（交错存储，任意采样率和声道数），前后不需要 audioconvert
+ * - num-bands（1~16，默认 3）：3 段时频率与 equalizer-3bands 相同（100/1100/11000 Hz），
+ *   其他段数与 equalizer-nbands 相同（20Hz~20kHz 按对数均分）；第一段为低架，最后一段为高架，其余为峰值滤波器
+ * - band0 ~ band15：各段增益（dB，-24 ~ +12），可以用 GstController 控制
+ * - kernel：auto/scalar/sse/avx2，用于对比不同的实现（见 biquad_cascade.h）
+ * - 所有增益都为 0 时自动切换为直通（passthrough），不做任何计算
+ *
+ * 元素直接编译在程序中，gst_init() 之后调用 simd_eq_register() 注册，之后就可以用
+ * gst_element_factory_make("simdeq", ...) 或者在 gst_parse_launch() 中使用。
+ */
+
+#define GST_TYPE_SIMD_EQ (gst_simd_eq_get_type())
+GType gst_simd_eq_get_type(void);
+
+gboolean simd_eq_register(void);
+
+/* 第 band 段的中心频率、带宽（Hz）和类型：与 equalizer-3bands / equalizer-nbands 的默认频段相同 */
+void simd_eq_band_layout(gint num_bands, gint band, gdouble *freq, gdouble *width, BiquadType *type);
+
+#endif /* SIMD_EQ_H */
@@ -0,0 +1,409 @@
+#include <gst/gst.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * pipeline 启动耗时分析
+ *
+ * 对于只运行很短时间的任务，gst_init() 的插件注册表扫描和 element factory 的查找/加载
+ * 可能比真正的媒体处理还要慢。本示例把 "从 main() 开始到第一个 buffer 到达 sink" 的时间拆成几个阶段：
+ *
+ *   init            gst_init()：核心初始化 + 读取注册表缓存（GST_REGISTRY_UPDATE=no，不扫描插件目录）
+ *   registry scan   gst_update_registry()：stat 每个插件文件，有变化时重新加载并写回缓存（冷启动）
+ *   plugin preload  预先加载需要的插件（热启动，代替 registry scan）
+ *   factory lookup  gst_element_factory_find()
+ *   plugin load     gst_plugin_feature_load()：dlopen 插件（热启动时已经加载）
+ *   create          gst_element_factory_create()
+ *   link            gst_bin_add_many() + gst_element_link_many()
+ *   NULL->READY / READY->PAUSED / PAUSED->PLAYING   每一次状态切换（等待完成）
+ *   first buffer    第一个 buffer 到达 sink 的时间（从 main() 开始）
+ *
+ * 冷启动（默认）：与普通程序相同，启动时扫描插件目录。
+ * 热启动（--warm）：跳过扫描，直接使用注册表缓存，并在进入任务之前预先加载需要的插件。
+ * --compare=N 以子进程的方式各运行 N 次，比较两种方式的中位数。
+ */
+
+#define DEFAULT_ELEMENTS "videotestsrc,vertigotv,videoconvert,fakesink" /* 与 02 示例相同的链路，sink 换成 fakesink */
+
+/* 各阶段的耗时（微秒），顺序与 phase_names 相同 */
+enum
+{
+    PHASE_INIT,
+    PHASE_REGISTRY,
+    PHASE_LOOKUP,
+    PHASE_LOAD,
+    PHASE_CREATE,
+    PHASE_LINK,
+    PHASE_NULL_READY,
+    PHASE_READY_PAUSED,
+    PHASE_PAUSED_PLAYING,
+    PHASE_COUNT
+};
+
+static const gchar *phase_names[PHASE_COUNT] = {
+    "init", "registry", "factory lookup", "plugin load", "create", "link",
+    "NULL->READY", "READY->PAUSED", "PAUSED->PLAYING"};
+
+/* Structure to contain all our information, so we can pass it around */
+typedef struct _Profile
+{
+    gboolean warm;            /* 热启动 */
+    gint64 start;             /* main() 开始的时间 */
+    gint64 phase[PHASE_COUNT];
+    gint64 first_buffer;      /* 第一个 buffer 到达 sink 的时间（相对 start），0 表示还没有到达 */
+    gint64 total;             /* 到 PLAYING 或第一个 buffer 为止（取较晚者） */
+} Profile;
+
+/* 记录一个阶段：返回当前时间，作为下一个阶段的起点 */
+static gint64
+phase_end(Profile *p, gint phase, gint64 begin)
+{
+    gint64 now = g_get_monotonic_time();
+
+    p->phase[phase] += now - begin;
+    return now;
+}
+
+/**
+ * sink 上的探针：只记录第一个 buffer
+ * 运行在流线程中，但 preroll 要等这个 buffer 到达，主线程在 READY->PAUSED 完成之后才读取 first_buffer
+ */
+static GstPadProbeReturn
+first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, Profile *p)
+{
+    p->first_buffer = g_get_monotonic_time() - p->start;
+    return GST_PAD_PROBE_REMOVE;
+}
+
+/* 切换状态并等待完成（READY->PAUSED 要等 sink 收到第一个 buffer 完成 preroll） */
+static gboolean
+change_state(GstElement *pipeline, GstState state)
+{
+    if (gst_element_set_state(pipeline, state) == GST_STATE_CHANGE_FAILURE)
+        return FALSE;
+    return gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) != GST_STATE_CHANGE_FAILURE;
+}
+
+/* 热启动：按 factory 名字找到所属插件并加载 */
+static gint64
+preload_plugins(gchar **names)
+{
+    gint64 begin = g_get_monotonic_time();
+    gint i;
+
+    for (i = 0; names[i] != NULL; i++)
+    {
+        GstPluginFeature *feature = gst_registry_find_feature(gst_registry_get(), names[i], GST_TYPE_ELEMENT_FACTORY);
+        GstPlugin *plugin;
+
+        if (feature == NULL)
+            continue;
+        plugin = gst_plugin_load_by_name(gst_plugin_feature_get_plugin_name(feature));
+        if (plugin != NULL)
+            gst_object_unref(plugin);
+        gst_object_unref(feature);
+    }
+    return g_get_monotonic_time() - begin;
+}
+
+/* 运行一次，结果写入 p */
+static int
+run_profile(Profile *p, gchar **names, int *argc, char ***argv)
+{
+    GstElement *pipeline, **elements;
+    GstElementFactory **factories;
+    GstPluginFeature *feature;
+    GstPad *sink_pad;
+    gint64 t;
+    gint i, n = g_strv_length(names);
+    int ret = 0;
+
+    /**
+     * gst_init() 内部先读取注册表缓存，再扫描所有插件目录（stat 每个插件文件，发现变化时加载插件并写回缓存）。
+     * 设置 GST_REGISTRY_UPDATE=no 让 gst_init() 只读缓存，扫描单独调用 gst_update_registry()，这样两部分可以分开计时。
+     */
+    g_setenv("GST_REGISTRY_UPDATE", "no", TRUE);
+    t = g_get_monotonic_time();
+    gst_init(argc, argv);
+    t = phase_end(p, PHASE_INIT, t);
+    if (p->warm)
+    {
+        // 热启动：不扫描，直接信任缓存；提前加载插件，之后的任务不再有 dlopen 的开销
+        p->phase[PHASE_REGISTRY] = preload_plugins(names);
+    }
+    else
+    {
+        g_unsetenv("GST_REGISTRY_UPDATE");
+        gst_update_registry();
+        phase_end(p, PHASE_REGISTRY, t);
+    }
+
+    /* Look up and load the factories */
+    factories = g_new0(GstElementFactory *, n);
+    elements = g_new0(GstElement *, n);
+    for (i = 0; i < n; i++)
+    {
+        t = g_get_monotonic_time();
+        factories[i] = gst_element_factory_find(names[i]);
+        t = phase_end(p, PHASE_LOOKUP, t);
+        if (factories[i] == NULL)
+        {
+            g_printerr("No element factory named '%s'.\n", names[i]);
+            ret = -1;
+            goto done;
+        }
+        // gst_element_factory_create() 内部也会加载插件，这里单独调用以便计时（返回新的引用）
+        feature = gst_plugin_feature_load(GST_PLUGIN_FEATURE(factories[i]));
+        phase_end(p, PHASE_LOAD, t);
+        gst_object_unref(factories[i]);
+        factories[i] = feature ? GST_ELEMENT_FACTORY(feature) : NULL;
+        if (factories[i] == NULL)
+        {
+            g_printerr("Plugin for '%s' could not be loaded.\n", names[i]);
+            ret = -1;
+            goto done;
+        }
+    }
+
+    /* Create the elements */
+    t = g_get_monotonic_time();
+    pipeline = gst_pipeline_new("startup-pipeline");
+    for (i = 0; i < n; i++)
+        elements[i] = gst_element_factory_create(factories[i], NULL);
+    t = phase_end(p, PHASE_CREATE, t);
+    for (i = 0; i < n; i++)
+    {
+        if (elements[i] == NULL)
+        {
+            g_printerr("Element '%s' could not be created.\n", names[i]);
+            gst_object_unref(pipeline);
+            ret = -1;
+            goto done;
+        }
+    }
+
+    /* Link all elements */
+    for (i = 0; i < n; i++)
+        gst_bin_add(GST_BIN(pipeline), elements[i]);
+    for (i = 0; i + 1 < n && ret == 0; i++)
+    {
+        if (!gst_element_link(elements[i], elements[i + 1]))
+        {
+            g_printerr("%s and %s could not be linked.\n", names[i], names[i + 1]);
+            ret = -1;
+        }
+    }
+    phase_end(p, PHASE_LINK, t);
+
+    // source 只生成一帧，sink 不同步时钟：启动完成后立即结束
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(elements[0]), "num-buffers"))
+        g_object_set(elements[0], "num-buffers", 1, NULL);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(elements[n - 1]), "sync"))
+        g_object_set(elements[n - 1], "sync", FALSE, NULL);
+    sink_pad = gst_element_get_static_pad(elements[n - 1], "sink");
+    if (sink_pad != NULL)
+    {
+        gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)first_buffer_probe, p, NULL);
+        gst_object_unref(sink_pad);
+    }
+
+    /* Walk through the state changes one at a time */
+    // 逐步切换状态，分别计时
+    t = g_get_monotonic_time();
+    if (ret == 0 && change_state(pipeline, GST_STATE_READY))
+        t = phase_end(p, PHASE_NULL_READY, t);
+    else
+        ret = -1;
+    if (ret == 0 && change_state(pipeline, GST_STATE_PAUSED))
+        t = phase_end(p, PHASE_READY_PAUSED, t);
+    else
+        ret = -1;
+    if (ret == 0 && change_state(pipeline, GST_STATE_PLAYING))
+        t = phase_end(p, PHASE_PAUSED_PLAYING, t);
+    else
+        ret = -1;
+    if (ret != 0)
+        g_printerr("Pipeline failed to reach PLAYING.\n");
+    p->total = MAX(t - p->start, p->first_buffer);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+done:
+    for (i = 0; i < n; i++)
+    {
+        if (factories[i] != NULL)
+            gst_object_unref(factories[i]);
+    }
+    g_free(factories);
+    g_free(elements);
+    return ret;
+}
+
+static void
+print_profile(Profile *p)
+{
+    gint i;
+
+    g_print("%s start, time to first buffer %.2f ms, to PLAYING %.2f ms\n",
+            p->warm ? "Warm" : "Cold", p->first_buffer / 1000.0, p->total / 1000.0);
+    for (i = 0; i < PHASE_COUNT; i++)
+    {
+        const gchar *name = i == PHASE_REGISTRY ? (p->warm ? "plugin preload" : "registry scan") : phase_names[i];
+
+        g_print("    %-16s %9.2f ms %5.1f%%\n", name, p->phase[i] / 1000.0, p->total ? 100.0 * p->phase[i] / p->total : 0.0);
+    }
+}
+
+static void
+print_csv(Profile *p)
+{
+    gint i;
+
+    g_print("%s", p->warm ? "warm" : "cold");
+    for (i = 0; i < PHASE_COUNT; i++)
+        g_print(",%.3f", p->phase[i] / 1000.0);
+    g_print(",%.3f,%.3f\n", p->first_buffer / 1000.0, p->total / 1000.0);
+}
+
+static int
+compare_double(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * 以子进程的方式运行 runs 次，返回每一列的中位数
+ *
+ * 每次都必须是一个新进程：同一个进程里第二次运行时注册表和插件都已经在内存中了。
+ */
+static gboolean
+run_children(const gchar *self, gboolean warm, const gchar *elements, gint runs, gdouble *median)
+{
+    gdouble *samples = g_new0(gdouble, (gsize)runs * (PHASE_COUNT + 2));
+    gchar *elements_arg = g_strdup_printf("--elements=%s", elements);
+    gchar *child_argv[] = {(gchar *)self, warm ? "--warm" : "--cold", "--csv", elements_arg, NULL};
+    gboolean ok = TRUE;
+    gint r, c;
+
+    for (r = 0; r < runs && ok; r++)
+    {
+        gchar *out = NULL, **fields;
+        gint status;
+        GError *error = NULL;
+
+        if (!g_spawn_sync(NULL, child_argv, NULL, G_SPAWN_DEFAULT, NULL, NULL, &out, NULL, &status, &error) ||
+            !g_spawn_check_wait_status(status, &error))
+        {
+            g_printerr("Child run failed: %s\n", error->message);
+            g_clear_error(&error);
+            g_free(out);
+            ok = FALSE;
+            break;
+        }
+        // 只取最后一行（前面可能有插件打印的信息）
+        g_strstrip(out);
+        fields = g_strsplit(strrchr(out, '\n') ? strrchr(out, '\n') + 1 : out, ",", -1);
+        for (c = 0; c < PHASE_COUNT + 2 && fields[0] && fields[c + 1]; c++)
+            samples[c * runs + r] = g_ascii_strtod(fields[c + 1], NULL);
+        g_strfreev(fields);
+        g_free(out);
+    }
+    for (c = 0; c < PHASE_COUNT + 2 && ok; c++)
+    {
+        qsort(samples + c * runs, runs, sizeof(gdouble), compare_double);
+        median[c] = samples[c * runs + runs / 2];
+    }
+    g_free(elements_arg);
+    g_free(samples);
+    return ok;
+}
+
+static int
+compare(const gchar *self, const gchar *elements, gint runs)
+{
+    gdouble cold[PHASE_COUNT + 2], warm[PHASE_COUNT + 2];
+    gint i;
+
+    // 先运行一次，确保注册表缓存是最新的（热启动依赖缓存）
+    if (!run_children(self, FALSE, elements, 1, cold) ||
+        !run_children(self, FALSE, elements, runs, cold) ||
+        !run_children(self, TRUE, elements, runs, warm))
+        return -1;
+
+    g_print("Median of %d runs each (ms)\n", runs);
+    g_print("    %-16s %9s %9s %9s\n", "phase", "cold", "warm", "saving");
+    for (i = 0; i < PHASE_COUNT; i++)
+    {
+        const gchar *name = i == PHASE_REGISTRY ? "scan / preload" : phase_names[i];
+
+        g_print("    %-16s %9.2f %9.2f %9.2f\n", name, cold[i], warm[i], cold[i] - warm[i]);
+    }
+    g_print("    %-16s %9.2f %9.2f %9.2f (%.1f%%)\n", "first buffer", cold[PHASE_COUNT], warm[PHASE_COUNT],
+            cold[PHASE_COUNT] - warm[PHASE_COUNT],
+            cold[PHASE_COUNT] > 0 ? 100.0 * (cold[PHASE_COUNT] - warm[PHASE_COUNT]) / cold[PHASE_COUNT] : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    Profile profile = {0};
+    gboolean cold = FALSE, csv = FALSE;
+    gchar *elements = NULL;
+    gchar **names;
+    gint runs = 0;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"warm", 0, 0, G_OPTION_ARG_NONE, &profile.warm, "Skip the registry scan and preload the needed plugins", NULL},
+        {"cold", 0, 0, G_OPTION_ARG_NONE, &cold, "Normal startup with a registry scan (default)", NULL},
+        {"elements", 0, 0, G_OPTION_ARG_STRING, &elements, "Comma separated element chain to start (default " DEFAULT_ELEMENTS ")", "LIST"},
+        {"csv", 0, 0, G_OPTION_ARG_NONE, &csv, "Print the profile as one CSV line", NULL},
+        {"compare", 0, 0, G_OPTION_ARG_INT, &runs, "Run cold and warm starts N times each in child processes and report the saving", "N"},
+        {NULL}};
+    int ret;
+
+    profile.start = g_get_monotonic_time();
+
+    /* Parse command line options */
+    // 不加入 gst_init_get_option_group()：那样会在解析参数时初始化 GStreamer，破坏计时
+    context = g_option_context_new("- pipeline startup profiler");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (profile.warm && cold)
+    {
+        g_printerr("--warm and --cold are mutually exclusive\n");
+        return -1;
+    }
+    if (elements == NULL)
+        elements = g_strdup(DEFAULT_ELEMENTS);
+
+    if (runs > 0)
+    {
+        ret = compare(argv[0], elements, runs);
+        g_free(elements);
+        return ret;
+    }
+
+    names = g_strsplit(elements, ",", -1);
+    if (g_strv_length(names) < 2)
+    {
+        g_printerr("--elements needs at least a source and a sink\n");
+        return -1;
+    }
+    ret = run_profile(&profile, names, &argc, &argv);
+    if (ret == 0 && csv)
+        print_csv(&profile);
+    else if (ret == 0)
+        print_profile(&profile);
+    g_strfreev(names);
+    g_free(elements);
+    return ret;
+}
@@ -0,0 +1,467 @@
+#define _GNU_SOURCE /* pthread_getname_np */
+#include <gst/gst.h>
+#include <glib/gprintf.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * proctime：统计每个元素处理一个 buffer 的耗时（GStreamer tracer 插件）
+ *
+ * 编译成 libgstproctime.so，任何一个示例都可以通过环境变量加载，不需要修改代码：
+ *     GST_PLUGIN_PATH=../13.processing\ time\ tracer GST_TRACERS="proctime" ./main.out
+ *     GST_TRACERS="proctime(file=/tmp/proctime.txt)" ...   结果写入文件（默认 stderr）
+ *
+ * 原理：
+ * - 上游调用 gst_pad_push() 时，下游元素的 chain 函数在同一个线程中同步执行，
+ *   tracer 的 pad-push-pre / pad-push-post 钩子之间的时间就是下游元素（以及它继续 push 给的所有元素）的耗时
+ * - 每个线程维护一个栈：chain 函数里面再次 push 时，内层的耗时从外层减掉，剩下的才是这个元素自己的处理时间
+ *   例如 videoconvert 的 chain 中 push 给 fakesink：videoconvert 的时间 = 总时间 - fakesink 的时间
+ * - ghost pad / proxy pad 只是转发，不单独统计，时间算在 bin 里面真正的元素上
+ *
+ * 为了能一直开着，统计都在线程自己的数据中完成，热路径上没有锁竞争、没有内存分配：
+ * - 每个线程一份统计（GPrivate），同一个元素在不同线程上分开统计；
+ *   每份统计有自己的锁，平时只有这个线程使用，只在输出报告时与报告线程竞争
+ * - 耗时记入对数分桶的直方图（每个 2 的幂再分 8 个桶，误差不超过 12.5%），求百分位数时再合并
+ *
+ * 顶层 pipeline 从 PAUSED 切换到 READY 时输出一次报告（其他 pipeline 的流线程可能还在运行）：
+ * 每个元素的 p50/p99/max，以及每个元素在每个线程上的 p50/p99/max。
+ *
+ * 注意：sink 的 chain 函数会等待时钟（sync=true），它的耗时包括等待的时间。
+ */
+
+#define SUB_BITS 3                     /* 每个 2 的幂分成 2^3 = 8 个桶 */
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define N_BUCKETS (64 * SUB_BUCKETS)
+
+/* 一个元素在一个线程上的统计 */
+typedef struct _ElementStats
+{
+    gpointer element;                  /* 只用作键，不解引用（元素可能已经释放） */
+    gchar *name;
+    guint64 count;
+    GstClockTime total;
+    GstClockTime max;
+    guint64 buckets[N_BUCKETS];
+} ElementStats;
+
+/* 正在执行的一次 push */
+typedef struct _Frame
+{
+    ElementStats *stats;               /* 为 NULL 时只是转发（ghost pad 等），不统计 */
+    GstClockTime start;
+    GstClockTime nested;               /* 内层 push 的耗时 */
+    guint buffers;                     /* buffer list 中的 buffer 数 */
+} Frame;
+
+/* 每个线程一份 */
+typedef struct _ThreadState
+{
+    gchar *name;                       /* 线程名（GstTask 会设置为 元素:pad） */
+    pid_t tid;
+    GArray *stack;                     /* Frame */
+    GMutex lock;                       /* 保护 elements 和其中的统计：报告在其他线程中读取 */
+    GHashTable *elements;              /* 元素指针 -> ElementStats */
+    ElementStats *last;                /* 上一次查找的结果，连续处理同一个元素时省去一次哈希查找 */
+} ThreadState;
+
+typedef struct _GstProctimeTracer
+{
+    GstTracer parent;
+    gchar *file;                       /* 报告写入的文件，NULL 表示 stderr */
+    guint reports;
+} GstProctimeTracer;
+
+typedef struct _GstProctimeTracerClass
+{
+    GstTracerClass parent_class;
+} GstProctimeTracerClass;
+
+#define GST_TYPE_PROCTIME_TRACER (gst_proctime_tracer_get_type())
+#define GST_PROCTIME_TRACER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_PROCTIME_TRACER, GstProctimeTracer))
+
+GType gst_proctime_tracer_get_type(void);
+G_DEFINE_TYPE(GstProctimeTracer, gst_proctime_tracer, GST_TYPE_TRACER);
+
+/* 所有线程的统计：线程退出后仍然保留，直到进程退出 */
+static GPrivate thread_key;
+static GMutex threads_lock;
+static GPtrArray *threads;
+
+static void
+element_stats_free(ElementStats *stats)
+{
+    g_free(stats->name);
+    g_free(stats);
+}
+
+static ThreadState *
+thread_state(void)
+{
+    ThreadState *ts = g_private_get(&thread_key);
+    char name[16] = "";
+
+    if (G_LIKELY(ts != NULL))
+        return ts;
+
+    // 每个线程第一次 push 时创建，之后只在报告时读取
+    ts = g_new0(ThreadState, 1);
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    ts->name = g_strdup(name);
+    ts->tid = (pid_t)syscall(SYS_gettid);
+    ts->stack = g_array_sized_new(FALSE, FALSE, sizeof(Frame), 16);
+    g_mutex_init(&ts->lock);
+    ts->elements = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)element_stats_free);
+    g_private_set(&thread_key, ts);
+
+    g_mutex_lock(&threads_lock);
+    g_ptr_array_add(threads, ts);
+    g_mutex_unlock(&threads_lock);
+    return ts;
+}
+
+/* 对数分桶：前 SUB_BITS+1 位有效数字决定桶的位置 */
+static guint
+bucket_index(GstClockTime value)
+{
+    guint exp;
+
+    if (value < SUB_BUCKETS)
+        return (guint)value;
+    exp = g_bit_nth_msf(value, -1) - SUB_BITS;
+    return (exp + 1) * SUB_BUCKETS + (guint)((value >> exp) & (SUB_BUCKETS - 1));
+}
+
+/* 桶的上界，作为这个桶里的值的估计 */
+static GstClockTime
+bucket_value(guint index)
+{
+    guint exp;
+
+    if (index < SUB_BUCKETS)
+        return index;
+    exp = index / SUB_BUCKETS - 1;
+    return ((GstClockTime)(SUB_BUCKETS + index % SUB_BUCKETS + 1) << exp) - 1;
+}
+
+/* 下游 pad 所属的元素：ghost pad、proxy pad 等只是转发，返回 NULL */
+static GstElement *
+chain_element(GstPad *pad)
+{
+    GstPad *peer = GST_PAD_PEER(pad);
+    GstObject *parent;
+
+    if (peer == NULL || GST_IS_PROXY_PAD(peer))
+        return NULL;
+    parent = GST_OBJECT_PARENT(peer);
+    if (parent == NULL || !GST_IS_ELEMENT(parent) || GST_IS_BIN(parent))
+        return NULL;
+    return GST_ELEMENT_CAST(parent);
+}
+
+/* 调用时持有 ts->lock */
+static ElementStats *
+element_stats(ThreadState *ts, GstElement *element)
+{
+    ElementStats *stats = ts->last;
+
+    if (stats != NULL && stats->element == element)
+        return stats;
+    stats = g_hash_table_lookup(ts->elements, element);
+    if (stats == NULL)
+    {
+        stats = g_new0(ElementStats, 1);
+        stats->element = element;
+        stats->name = gst_object_get_name(GST_OBJECT_CAST(element));
+        g_hash_table_insert(ts->elements, element, stats);
+    }
+    ts->last = stats;
+    return stats;
+}
+
+static void
+push_frame(GstClockTime ts_now, GstPad *pad, guint buffers)
+{
+    ThreadState *ts = thread_state();
+    GstElement *element = chain_element(pad);
+    Frame frame = {NULL, ts_now, 0, buffers};
+
+    if (element != NULL)
+    {
+        g_mutex_lock(&ts->lock);
+        frame.stats = element_stats(ts, element);
+        g_mutex_unlock(&ts->lock);
+    }
+    g_array_append_val(ts->stack, frame);
+}
+
+static void
+pop_frame(GstClockTime ts_now)
+{
+    ThreadState *ts = thread_state();
+    Frame *frame;
+    GstClockTime elapsed, self;
+
+    if (G_UNLIKELY(ts->stack->len == 0))
+        return; /* tracer 在 push 过程中才加载 */
+    frame = &g_array_index(ts->stack, Frame, ts->stack->len - 1);
+    elapsed = ts_now - frame->start;
+    self = elapsed > frame->nested ? elapsed - frame->nested : 0;
+    if (frame->stats != NULL)
+    {
+        ElementStats *stats = frame->stats;
+        // buffer list 按平均值记给其中的每一个 buffer
+        GstClockTime per_buffer = self / frame->buffers;
+
+        g_mutex_lock(&ts->lock);
+        stats->count += frame->buffers;
+        stats->total += self;
+        stats->max = MAX(stats->max, per_buffer);
+        stats->buckets[bucket_index(per_buffer)] += frame->buffers;
+        g_mutex_unlock(&ts->lock);
+    }
+    g_array_set_size(ts->stack, ts->stack->len - 1);
+    // 这次 push 的全部时间都不属于外层的元素
+    if (ts->stack->len > 0)
+        g_array_index(ts->stack, Frame, ts->stack->len - 1).nested += elapsed;
+}
+
+static void
+do_push_buffer_pre(GObject *self, GstClockTime ts, GstPad *pad, GstBuffer *buffer)
+{
+    push_frame(ts, pad, 1);
+}
+
+static void
+do_push_list_pre(GObject *self, GstClockTime ts, GstPad *pad, GstBufferList *list)
+{
+    push_frame(ts, pad, MAX(gst_buffer_list_length(list), 1));
+}
+
+static void
+do_push_post(GObject *self, GstClockTime ts, GstPad *pad, GstFlowReturn res)
+{
+    pop_frame(ts);
+}
+
+/* 从直方图中求百分位数 */
+static GstClockTime
+percentile(const guint64 *buckets, guint64 count, gdouble p, GstClockTime max)
+{
+    guint64 target = (guint64)(count * p + 0.5), seen = 0;
+    guint i;
+
+    for (i = 0; i < N_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= MAX(target, 1))
+            return MIN(bucket_value(i), max);
+    }
+    return max;
+}
+
+/* 调用者保证 count > 0 */
+static void
+print_row(FILE *out, const gchar *name, const gchar *thread, const ElementStats *stats)
+{
+    g_fprintf(out, "%-24s %-20s %10" G_GUINT64_FORMAT " %10.1f %10.1f %10.1f %10.1f\n", name, thread, stats->count,
+              stats->total / 1e3 / stats->count, percentile(stats->buckets, stats->count, 0.5, stats->max) / 1e3,
+              percentile(stats->buckets, stats->count, 0.99, stats->max) / 1e3, stats->max / 1e3);
+}
+
+static void
+merge_stats(ElementStats *into, const ElementStats *stats)
+{
+    guint i;
+
+    into->count += stats->count;
+    into->total += stats->total;
+    into->max = MAX(into->max, stats->max);
+    for (i = 0; i < N_BUCKETS; i++)
+        into->buckets[i] += stats->buckets[i];
+}
+
+static gint
+compare_name(gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0((*(ElementStats *const *)a)->name, (*(ElementStats *const *)b)->name);
+}
+
+/**
+ * 输出报告：先按元素合并所有线程，再按元素 × 线程逐行输出。
+ * 各线程的统计在持有它的锁时读取；还没有处理完任何 buffer 的元素（count 为 0）不输出
+ */
+static void
+write_report(GstProctimeTracer *self, const gchar *title)
+{
+    GHashTable *merged = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)element_stats_free);
+    GPtrArray *rows = g_ptr_array_new();
+    FILE *out = stderr;
+    GHashTableIter iter;
+    ElementStats *stats;
+    guint i, j;
+
+    if (self->file != NULL && (out = fopen(self->file, self->reports ? "a" : "w")) == NULL)
+    {
+        g_printerr("proctime: could not open %s, writing to stderr\n", self->file);
+        out = stderr;
+    }
+    self->reports++;
+
+    g_mutex_lock(&threads_lock);
+    for (i = 0; i < threads->len; i++)
+    {
+        ThreadState *ts = g_ptr_array_index(threads, i);
+
+        g_mutex_lock(&ts->lock);
+        g_hash_table_iter_init(&iter, ts->elements);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&stats))
+        {
+            ElementStats *total;
+
+            if (stats->count == 0)
+                continue;
+            total = g_hash_table_lookup(merged, stats->name);
+            if (total == NULL)
+            {
+                total = g_new0(ElementStats, 1);
+                total->name = g_strdup(stats->name);
+                g_hash_table_insert(merged, total->name, total);
+                g_ptr_array_add(rows, total);
+            }
+            merge_stats(total, stats);
+        }
+        g_mutex_unlock(&ts->lock);
+    }
+    g_ptr_array_sort(rows, compare_name);
+
+    g_fprintf(out, "proctime: per-buffer processing time (us), %s\n", title);
+    g_fprintf(out, "%-24s %-20s %10s %10s %10s %10s %10s\n", "element", "thread", "buffers", "mean", "p50", "p99", "max");
+    for (i = 0; i < rows->len; i++)
+    {
+        ElementStats *total = g_ptr_array_index(rows, i);
+
+        print_row(out, total->name, "(all)", total);
+        for (j = 0; j < threads->len; j++)
+        {
+            ThreadState *ts = g_ptr_array_index(threads, j);
+
+            g_mutex_lock(&ts->lock);
+            g_hash_table_iter_init(&iter, ts->elements);
+            while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&stats))
+            {
+                gchar *thread;
+
+                if (!g_str_equal(stats->name, total->name) || stats->count == 0)
+                    continue;
+                thread = g_strdup_printf("%s/%d", ts->name, (gint)ts->tid);
+                print_row(out, "", thread, stats);
+                g_free(thread);
+            }
+            g_mutex_unlock(&ts->lock);
+        }
+    }
+    g_mutex_unlock(&threads_lock);
+
+    if (out != stderr)
+        fclose(out);
+    g_ptr_array_free(rows, TRUE);
+    g_hash_table_destroy(merged);
+}
+
+/* 顶层 pipeline 停止时输出报告：这个 pipeline 的流线程已经退出循环，其他 pipeline 的线程可能还在更新统计 */
+static void
+do_change_state_post(GObject *object, GstClockTime ts, GstElement *element, GstStateChange transition,
+                     GstStateChangeReturn result)
+{
+    GstProctimeTracer *self = GST_PROCTIME_TRACER(object);
+    gchar *title;
+
+    if (transition != GST_STATE_CHANGE_PAUSED_TO_READY || !GST_IS_PIPELINE(element) ||
+        GST_OBJECT_PARENT(element) != NULL)
+        return;
+    title = g_strdup_printf("%s stopped", GST_OBJECT_NAME(element));
+    write_report(self, title);
+    g_free(title);
+}
+
+/* 参数：file=PATH */
+static void
+parse_params(GstProctimeTracer *self)
+{
+    gchar *params = NULL, *desc;
+    GstStructure *s;
+
+    g_object_get(self, "params", &params, NULL);
+    if (params == NULL)
+        return;
+    desc = g_strdup_printf("proctime,%s", params);
+    s = gst_structure_new_from_string(desc);
+    if (s != NULL)
+    {
+        self->file = g_strdup(gst_structure_get_string(s, "file"));
+        gst_structure_free(s);
+    }
+    else
+        g_printerr("proctime: ignoring malformed params '%s'\n", params);
+    g_free(desc);
+    g_free(params);
+}
+
+static void
+gst_proctime_tracer_constructed(GObject *object)
+{
+    GstProctimeTracer *self = GST_PROCTIME_TRACER(object);
+
+    G_OBJECT_CLASS(gst_proctime_tracer_parent_class)->constructed(object);
+    parse_params(self);
+}
+
+static void
+gst_proctime_tracer_finalize(GObject *object)
+{
+    GstProctimeTracer *self = GST_PROCTIME_TRACER(object);
+
+    // gst_deinit() 时还没有输出过报告（pipeline 没有停止就退出了），补一次
+    if (self->reports == 0)
+        write_report(self, "at exit");
+    g_free(self->file);
+    G_OBJECT_CLASS(gst_proctime_tracer_parent_class)->finalize(object);
+}
+
+static void
+gst_proctime_tracer_class_init(GstProctimeTracerClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->constructed = gst_proctime_tracer_constructed;
+    gobject_class->finalize = gst_proctime_tracer_finalize;
+}
+
+static void
+gst_proctime_tracer_init(GstProctimeTracer *self)
+{
+    GstTracer *tracer = GST_TRACER(self);
+
+    gst_tracing_register_hook(tracer, "pad-push-pre", G_CALLBACK(do_push_buffer_pre));
+    gst_tracing_register_hook(tracer, "pad-push-post", G_CALLBACK(do_push_post));
+    gst_tracing_register_hook(tracer, "pad-push-list-pre", G_CALLBACK(do_push_list_pre));
+    gst_tracing_register_hook(tracer, "pad-push-list-post", G_CALLBACK(do_push_post));
+    gst_tracing_register_hook(tracer, "element-change-state-post", G_CALLBACK(do_change_state_post));
+}
+
+static gboolean
+plugin_init(GstPlugin *plugin)
+{
+    threads = g_ptr_array_new();
+    return gst_tracer_register(plugin, "proctime", GST_TYPE_PROCTIME_TRACER);
+}
+
+#define PACKAGE "gstreamer-demos"
+#define VERSION "1.0"
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, proctime,
+                  "Per-element buffer processing time histograms", plugin_init, VERSION, "LGPL", PACKAGE,
+                  "https://github.com/YiguiDing/gstreamer-demos")
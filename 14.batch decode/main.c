@@ -0,0 +1,489 @@
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include <gst/app/app.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "media_files.h"
+
+/**
+ * 并行批量解码
+ *
+ * 03 示例用一个 uridecodebin 解码一个文件，在 pad_added_handler 中把动态创建的 pad 连接到 sink。
+ * 离线任务（提取特征、生成缩略图、校验文件）需要解码成千上万个本地文件，本示例把它扩展成批量模式：
+ *
+ * - 输入：目录（递归查找所有文件）、文件路径、URI，或者 --list 指定的列表文件（每行一个路径或 URI）
+ * - 同时最多运行 --workers 条 pipeline（每个文件一条：uridecodebin + 每个 pad 一个 sink），
+ *   一条 pipeline 收到 EOS 或 ERROR 后立即释放，并开始解码下一个文件
+ * - 动态 pad 按类型连接到 fakesink 或 appsink（--sink），sink 都不同步时钟，解码速度只受 CPU 和磁盘限制
+ * - 统计解码的视频帧数和音频采样数，结束时输出 文件数/秒、视频帧/秒、音频采样/秒 以及进程的 CPU 时间
+ * - --scale=1,2,4,8 依次用不同的 worker 数解码同一批文件，比较吞吐量随 worker 数的变化
+ */
+
+#define DEFAULT_SINK "fakesink"
+#define DEFAULT_TIMEOUT 30 /* 单个文件的默认超时（秒） */
+
+/* 一个动态 pad 的统计（只有对应的流线程写入，pipeline 停止之后主线程读取） */
+typedef struct _Branch
+{
+    gboolean video; /* 视频：统计帧数；音频：统计采样数 */
+    gint bpf;       /* 音频每帧（所有声道的一个采样）的字节数 */
+    guint64 count;
+} Branch;
+
+typedef struct _Batch Batch;
+
+/* 一个文件的解码任务 */
+typedef struct _Job
+{
+    Batch *batch;
+    gchar *uri;
+    GstElement *pipeline;
+    GMutex lock;       /* 保护 branches：不同的 pad 可能在不同的流线程中同时添加 */
+    GSList *branches;  /* Branch 列表 */
+    guint timeout_id;  /* --timeout 的定时器 */
+    gint64 start;
+} Job;
+
+/* Structure to contain all our information, so we can pass it to callbacks */
+struct _Batch
+{
+    gchar **uris;          /* 所有文件 */
+    guint num_uris;        /* 本次运行解码的文件数 */
+    guint next;            /* 下一个要解码的文件 */
+    guint running;         /* 正在运行的 pipeline 数 */
+    guint workers;         /* 同时运行的 pipeline 上限 */
+    gboolean use_appsink;  /* --sink=appsink */
+    gint decoder_threads;  /* --decoder-threads：每个解码器的线程数，0 表示使用解码器的默认值 */
+    gint timeout;          /* --timeout：单个文件的超时（秒），默认 DEFAULT_TIMEOUT，0 表示不限制 */
+    gboolean verbose;      /* 每个文件输出一行 */
+    GMainLoop *loop;
+
+    /* 统计（只在主线程中更新） */
+    guint done, failed;
+    guint64 video_frames, audio_samples;
+};
+
+static void start_jobs(Batch *batch);
+
+/* fakesink 的 sink pad 上的探针：统计流过的 buffer */
+static GstPadProbeReturn
+count_probe(GstPad *pad, GstPadProbeInfo *info, Branch *branch)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    branch->count += branch->video ? 1 : gst_buffer_get_size(buffer) / branch->bpf;
+    return GST_PAD_PROBE_OK;
+}
+
+/* appsink 的 new_sample 回调（流线程）：取出 sample 统计后直接释放，代替真正的处理 */
+static GstFlowReturn
+on_new_sample(GstAppSink *app_sink, gpointer user_data)
+{
+    Branch *branch = user_data;
+    GstSample *sample = gst_app_sink_pull_sample(app_sink);
+    GstBuffer *buffer;
+
+    if (sample == NULL)
+        return GST_FLOW_EOS;
+    buffer = gst_sample_get_buffer(sample);
+    if (buffer != NULL)
+        branch->count += branch->video ? 1 : gst_buffer_get_size(buffer) / branch->bpf;
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+/* 为新的 pad 创建 sink，raw 音视频 pad 返回 Branch 用于统计 */
+static GstElement *
+make_branch_sink(Job *job, GstCaps *caps, Branch **branch_out)
+{
+    GstStructure *s = gst_caps_get_structure(caps, 0);
+    const gchar *type = gst_structure_get_name(s);
+    GstAudioInfo info;
+    Branch *branch = NULL;
+    GstElement *sink;
+
+    if (g_str_equal(type, "video/x-raw"))
+    {
+        branch = g_new0(Branch, 1);
+        branch->video = TRUE;
+    }
+    else if (g_str_equal(type, "audio/x-raw") && gst_audio_info_from_caps(&info, caps) && GST_AUDIO_INFO_BPF(&info) > 0)
+    {
+        branch = g_new0(Branch, 1);
+        branch->bpf = GST_AUDIO_INFO_BPF(&info);
+    }
+
+    // 字幕等其他类型的 pad 也要连接，否则 uridecodebin 会因为 not-linked 而报错
+    if (job->batch->use_appsink && branch != NULL)
+    {
+        GstAppSinkCallbacks callbacks = {0};
+
+        sink = gst_element_factory_make("appsink", NULL);
+        callbacks.new_sample = on_new_sample;
+        gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, branch, NULL);
+    }
+    else
+    {
+        sink = gst_element_factory_make("fakesink", NULL);
+    }
+    if (sink == NULL)
+    {
+        g_free(branch);
+        return NULL;
+    }
+    // 不同步时钟，尽可能快地解码；不保留最后一个 buffer（否则每个 sink 都多占用解码器缓冲池中的一个 buffer）
+    g_object_set(sink, "sync", FALSE, "enable-last-sample", FALSE, NULL);
+    if (!job->batch->use_appsink && branch != NULL)
+    {
+        GstPad *pad = gst_element_get_static_pad(sink, "sink");
+
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)count_probe, branch, NULL);
+        gst_object_unref(pad);
+    }
+    *branch_out = branch;
+    return sink;
+}
+
+/* This function will be called by the pad-added signal */
+/**
+ * 回调处理函数（流线程）
+ *
+ * 与 03 示例不同，sink 不是预先创建好的：每个新的 pad 都创建一个 sink，加入 pipeline 后连接，
+ * 这样任意个数的音视频流（多音轨、字幕）都能被解码。
+ */
+static void
+pad_added_handler(GstElement *src, GstPad *new_pad, Job *job)
+{
+    GstCaps *caps;
+    GstElement *sink;
+    GstPad *sink_pad;
+    Branch *branch = NULL;
+
+    caps = gst_pad_get_current_caps(new_pad);
+    if (caps == NULL)
+        caps = gst_pad_query_caps(new_pad, NULL);
+    sink = make_branch_sink(job, caps, &branch);
+    gst_caps_unref(caps);
+    if (sink == NULL)
+    {
+        g_printerr("Could not create a sink for pad '%s' of %s\n", GST_PAD_NAME(new_pad), job->uri);
+        return;
+    }
+    if (branch != NULL)
+    {
+        g_mutex_lock(&job->lock);
+        job->branches = g_slist_prepend(job->branches, branch);
+        g_mutex_unlock(&job->lock);
+    }
+
+    // 先加入 pipeline 并切换到与 pipeline 相同的状态，再连接
+    gst_bin_add(GST_BIN(job->pipeline), sink);
+    gst_element_sync_state_with_parent(sink);
+    sink_pad = gst_element_get_static_pad(sink, "sink");
+    if (GST_PAD_LINK_FAILED(gst_pad_link(new_pad, sink_pad)))
+        g_printerr("Could not link pad '%s' of %s\n", GST_PAD_NAME(new_pad), job->uri);
+    gst_object_unref(sink_pad);
+}
+
+/**
+ * pipeline 中（包括 uridecodebin 内部）添加了新的 element
+ *
+ * 很多解码器（avdec_*）默认按 CPU 核数创建解码线程，worker 数较多时线程数 = worker 数 × 核数，
+ * 线程之间互相争抢 CPU。--decoder-threads 限制每个解码器的线程数。
+ */
+static void
+deep_element_added_handler(GstBin *bin, GstBin *sub_bin, GstElement *element, Batch *batch)
+{
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), "max-threads") != NULL)
+        g_object_set(element, "max-threads", batch->decoder_threads, NULL);
+}
+
+/* 解码完成（EOS、ERROR 或超时），主线程中调用 */
+static void
+finish_job(Job *job, gboolean ok)
+{
+    Batch *batch = job->batch;
+    guint64 frames = 0, samples = 0;
+    GSList *l;
+
+    if (job->timeout_id)
+        g_source_remove(job->timeout_id);
+    // 切换到 NULL 会等待所有流线程退出，之后才能安全地读取 Branch
+    gst_element_set_state(job->pipeline, GST_STATE_NULL);
+    for (l = job->branches; l != NULL; l = l->next)
+    {
+        Branch *branch = l->data;
+
+        if (branch->video)
+            frames += branch->count;
+        else
+            samples += branch->count;
+    }
+
+    if (ok)
+        batch->done++;
+    else
+        batch->failed++;
+    batch->video_frames += frames;
+    batch->audio_samples += samples;
+    if (batch->verbose)
+        g_print("%-6s %8.3f s %8" G_GUINT64_FORMAT " frames %10" G_GUINT64_FORMAT " samples  %s\n",
+                ok ? "ok" : "FAILED", (g_get_monotonic_time() - job->start) / (gdouble)G_USEC_PER_SEC,
+                frames, samples, job->uri);
+
+    gst_object_unref(job->pipeline);
+    g_slist_free_full(job->branches, g_free);
+    g_mutex_clear(&job->lock);
+    g_free(job->uri);
+    g_free(job);
+
+    batch->running--;
+    start_jobs(batch);
+}
+
+/* 单个 pipeline 的总线消息（主线程） */
+static gboolean
+bus_handler(GstBus *bus, GstMessage *msg, Job *job)
+{
+    GError *err;
+    gchar *debug_info;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &err, &debug_info);
+        g_printerr("Error from %s while decoding %s: %s\n", GST_OBJECT_NAME(msg->src), job->uri, err->message);
+        g_clear_error(&err);
+        g_free(debug_info);
+        finish_job(job, FALSE);
+        // 只处理第一个 ERROR 或 EOS，之后不再接收这个总线的消息
+        return G_SOURCE_REMOVE;
+    case GST_MESSAGE_EOS:
+        finish_job(job, TRUE);
+        return G_SOURCE_REMOVE;
+    default:
+        return G_SOURCE_CONTINUE;
+    }
+}
+
+/* 在 pipeline 的总线上发出一个错误消息，与真正的错误走同一条路径结束任务 */
+static void
+post_error(Job *job, const gchar *message)
+{
+    GError *err = g_error_new_literal(GST_CORE_ERROR, GST_CORE_ERROR_FAILED, message);
+
+    gst_element_post_message(job->pipeline, gst_message_new_error(GST_OBJECT(job->pipeline), err, NULL));
+    g_error_free(err);
+}
+
+/* --timeout：文件损坏或者解码器卡住时，不让它一直占用一个 worker */
+static gboolean
+timeout_handler(Job *job)
+{
+    job->timeout_id = 0;
+    post_error(job, "Timed out");
+    return G_SOURCE_REMOVE;
+}
+
+/* 开始解码一个文件 */
+static void
+start_job(Batch *batch, const gchar *uri)
+{
+    Job *job = g_new0(Job, 1);
+    GstElement *source;
+    GstBus *bus;
+
+    job->batch = batch;
+    job->uri = g_strdup(uri);
+    g_mutex_init(&job->lock);
+    job->start = g_get_monotonic_time();
+    job->pipeline = gst_pipeline_new(NULL);
+    source = gst_element_factory_make("uridecodebin", NULL);
+    g_object_set(source, "uri", uri, NULL);
+    gst_bin_add(GST_BIN(job->pipeline), source);
+    g_signal_connect(source, "pad-added", G_CALLBACK(pad_added_handler), job);
+    if (batch->decoder_threads > 0)
+        g_signal_connect(job->pipeline, "deep-element-added", G_CALLBACK(deep_element_added_handler), batch);
+
+    // 每条 pipeline 有自己的总线，消息都在主循环中处理
+    bus = gst_element_get_bus(job->pipeline);
+    gst_bus_add_watch(bus, (GstBusFunc)bus_handler, job);
+    gst_object_unref(bus);
+    if (batch->timeout > 0)
+        job->timeout_id = g_timeout_add_seconds(batch->timeout, (GSourceFunc)timeout_handler, job);
+
+    batch->running++;
+    // 文件不存在等错误通常也会出现在总线上；这里再发一个，保证任务一定会结束（只有第一个错误会被处理）
+    if (gst_element_set_state(job->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+        post_error(job, "Unable to set the pipeline to the playing state");
+}
+
+/* 填满 worker：有空闲的 worker 且还有文件时开始新的任务，全部完成后退出主循环 */
+static void
+start_jobs(Batch *batch)
+{
+    while (batch->running < batch->workers && batch->next < batch->num_uris)
+        start_job(batch, batch->uris[batch->next++]);
+    if (batch->running == 0 && batch->next >= batch->num_uris)
+        g_main_loop_quit(batch->loop);
+}
+
+/* 进程的 CPU 时间（用户态 + 内核态，秒） */
+static gdouble
+process_cpu_time(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* 用 workers 个 worker 解码前 count 个文件，report 为 TRUE 时输出一行结果，返回 文件数/秒 */
+static gdouble
+run_batch(Batch *batch, guint workers, guint count, gboolean report, gdouble baseline)
+{
+    gint64 start;
+    gdouble cpu, wall, files_per_sec;
+
+    batch->workers = workers;
+    batch->num_uris = count;
+    batch->next = batch->running = 0;
+    batch->done = batch->failed = 0;
+    batch->video_frames = batch->audio_samples = 0;
+
+    cpu = process_cpu_time();
+    start = g_get_monotonic_time();
+    start_jobs(batch);
+    g_main_loop_run(batch->loop);
+    wall = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+    cpu = process_cpu_time() - cpu;
+
+    files_per_sec = (batch->done + batch->failed) / wall;
+    // cores: CPU 时间 / 墙钟时间，表示平均占用了几个核；它不再随 worker 数增加时，瓶颈就不在解码的并行度上
+    if (report)
+        g_print("%7u %7u %7u %9.3f %10.2f %12.1f %13.0f %9.3f %6.2f %8.2fx\n",
+                workers, batch->done, batch->failed, wall, files_per_sec,
+                batch->video_frames / wall, batch->audio_samples / wall, cpu, cpu / wall,
+                baseline > 0 ? files_per_sec / baseline : 1.0);
+    return files_per_sec;
+}
+
+int main(int argc, char *argv[])
+{
+    Batch batch = {0};
+    gint workers = 0, max_files = 0, i;
+    gchar *list = NULL, *sink = NULL, *scale = NULL;
+    gchar **scale_list = NULL;
+    GPtrArray *uris;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"workers", 'j', 0, G_OPTION_ARG_INT, &workers, "Number of pipelines decoding in parallel (default: number of CPUs)", "N"},
+        {"list", 0, 0, G_OPTION_ARG_FILENAME, &list, "File with one path or URI per line", "FILE"},
+        {"sink", 0, 0, G_OPTION_ARG_STRING, &sink, "Sink for the decoded pads: fakesink or appsink (default " DEFAULT_SINK ")", "NAME"},
+        {"scale", 0, 0, G_OPTION_ARG_STRING, &scale, "Decode the whole batch once per worker count, e.g. 1,2,4,8", "LIST"},
+        {"decoder-threads", 0, 0, G_OPTION_ARG_INT, &batch.decoder_threads, "Set max-threads on decoders that have it, 0 for their default", "N"},
+        {"timeout", 0, 0, G_OPTION_ARG_INT, &batch.timeout, "Give up on a file after S seconds, 0 for no limit (default: 30)", "S"},
+        {"max-files", 0, 0, G_OPTION_ARG_INT, &max_files, "Decode at most N files", "N"},
+        {"verbose", 'v', 0, G_OPTION_ARG_NONE, &batch.verbose, "Print one line per file", NULL},
+        {NULL}};
+
+    batch.timeout = DEFAULT_TIMEOUT;
+    context = g_option_context_new("[DIRECTORY|FILE|URI...] - parallel batch decoding");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+
+    if (sink != NULL && !g_str_equal(sink, "fakesink") && !g_str_equal(sink, "appsink"))
+    {
+        g_printerr("Unknown sink '%s', use fakesink or appsink\n", sink);
+        return -1;
+    }
+    batch.use_appsink = sink != NULL && g_str_equal(sink, "appsink");
+    if (workers <= 0)
+        workers = g_get_num_processors();
+    if (batch.decoder_threads < 0)
+        batch.decoder_threads = 0;
+
+    /* 收集所有文件 */
+    uris = g_ptr_array_new_with_free_func(g_free);
+    if (list != NULL && !media_files_add_list(uris, list))
+        return -1;
+    for (i = 1; i < argc; i++)
+        media_files_add(uris, argv[i]);
+    if (max_files > 0 && uris->len > (guint)max_files)
+        g_ptr_array_set_size(uris, max_files);
+    if (uris->len == 0)
+    {
+        g_printerr("No input files. Usage: %s [OPTION...] DIRECTORY|FILE|URI...\n", argv[0]);
+        return -1;
+    }
+    g_ptr_array_add(uris, NULL);
+    batch.uris = (gchar **)uris->pdata;
+    batch.loop = g_main_loop_new(NULL, FALSE);
+
+    g_print("%u files, sink %s", uris->len - 1, batch.use_appsink ? "appsink" : "fakesink");
+    if (batch.decoder_threads > 0)
+        g_print(", %d decoder threads", batch.decoder_threads);
+    g_print("\n");
+
+    if (scale != NULL)
+    {
+        guint warmup = 0;
+
+        /**
+         * 扩展测试：同一批文件用不同的 worker 数各解码一次。
+         * 第一次运行要加载插件，先用最大的 worker 数解码几个文件预热（不计入结果），
+         * 避免 worker 数最少的一行包含插件加载的时间。文件数据的页缓存不在控制范围内：
+         * 文件总量小于内存时，之后的每一轮都从缓存中读取。
+         */
+        scale_list = g_strsplit(scale, ",", -1);
+        for (i = 0; scale_list[i] != NULL; i++)
+            warmup = MAX(warmup, (guint)MAX(atoi(scale_list[i]), 0));
+        run_batch(&batch, MAX(warmup, 1), MIN(MAX(warmup, 1), uris->len - 1), FALSE, 0);
+    }
+    g_print("%7s %7s %7s %9s %10s %12s %13s %9s %6s %9s\n",
+            "workers", "ok", "failed", "wall-s", "files/sec", "frames/sec", "samples/sec", "cpu-s", "cores", "speedup");
+    if (scale_list != NULL)
+    {
+        gdouble baseline = 0;
+
+        for (i = 0; scale_list[i] != NULL; i++)
+        {
+            gint n = atoi(scale_list[i]);
+            gdouble files_per_sec;
+
+            if (n <= 0)
+            {
+                g_printerr("Skipping worker count '%s'\n", scale_list[i]);
+                continue;
+            }
+            files_per_sec = run_batch(&batch, n, uris->len - 1, TRUE, baseline);
+            // speedup 相对于第一行
+            if (baseline <= 0)
+                baseline = files_per_sec;
+        }
+    }
+    else
+    {
+        run_batch(&batch, workers, uris->len - 1, TRUE, 0);
+    }
+
+    /* Free resources */
+    g_strfreev(scale_list);
+    g_main_loop_unref(batch.loop);
+    g_ptr_array_unref(uris);
+    g_free(list);
+    g_free(sink);
+    g_free(scale);
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "media_files.h"
+#include "media_index.h"
+
+/**
+ * 并行媒体元数据索引
+ *
+ * 09 的 analyze_streams() 要等 playbin 进入 PLAYING（打开文件、探测类型、创建解码器、preroll）之后
+ * 才能取得流信息。对于很大的本地媒体库，我们希望在播放之前就知道每个文件有几条音轨、什么编码、什么语言：
+ *
+ * - 生成索引：用 GstDiscoverer 探测每个文件（只到 parser 为止，不解码），同时运行 --workers 个 discoverer，
+ *   每个 discoverer 一次处理一个文件，discovered 信号到达后立即交给它下一个文件（与 14 示例相同的调度方式）
+ * - 结果写入紧凑的索引文件（格式见 common/media_index.h），可以直接内存映射
+ * - 查询：--lookup 映射索引并按 URI 查找，输出与 analyze_streams() 相同的内容，只需要几微秒
+ * - --bench=N 对索引中的文件随机查询 N 次，输出每次查询的耗时
+ */
+
+#define DEFAULT_INDEX "media.idx"
+#define DEFAULT_TIMEOUT 10 /* 单个文件的探测超时（秒） */
+
+/* Structure to contain all our information, so we can pass it to callbacks */
+typedef struct _Indexer
+{
+    gchar **uris;               /* 所有文件 */
+    guint num_uris;
+    guint next;                 /* 下一个要探测的文件 */
+    guint running;              /* 正在探测的 discoverer 数 */
+    GstDiscoverer **discoverers;
+    guint workers;
+    gboolean verbose;
+    MediaIndexWriter *writer;
+    guint indexed, failed;
+    GMainLoop *loop;
+} Indexer;
+
+/* 一个流的信息写入索引 */
+static void
+add_stream(MediaIndexWriter *w, GstDiscovererStreamInfo *info, MediaStreamType type)
+{
+    MediaIndexStream s = {0};
+    const GstTagList *tags = gst_discoverer_stream_info_get_tags(info);
+    const gchar *codec_tag = NULL, *language = NULL;
+    gchar *codec = NULL;
+    GstCaps *caps;
+
+    if (type == MEDIA_STREAM_VIDEO)
+    {
+        GstDiscovererVideoInfo *video = GST_DISCOVERER_VIDEO_INFO(info);
+
+        s.width = gst_discoverer_video_info_get_width(video);
+        s.height = gst_discoverer_video_info_get_height(video);
+        s.fps_n = gst_discoverer_video_info_get_framerate_num(video);
+        s.fps_d = gst_discoverer_video_info_get_framerate_denom(video);
+        s.bitrate = gst_discoverer_video_info_get_bitrate(video);
+        s.max_bitrate = gst_discoverer_video_info_get_max_bitrate(video);
+        codec_tag = GST_TAG_VIDEO_CODEC;
+    }
+    else if (type == MEDIA_STREAM_AUDIO)
+    {
+        GstDiscovererAudioInfo *audio = GST_DISCOVERER_AUDIO_INFO(info);
+
+        s.channels = gst_discoverer_audio_info_get_channels(audio);
+        s.rate = gst_discoverer_audio_info_get_sample_rate(audio);
+        s.bitrate = gst_discoverer_audio_info_get_bitrate(audio);
+        s.max_bitrate = gst_discoverer_audio_info_get_max_bitrate(audio);
+        language = gst_discoverer_audio_info_get_language(audio);
+        codec_tag = GST_TAG_AUDIO_CODEC;
+    }
+    else
+    {
+        language = gst_discoverer_subtitle_info_get_language(GST_DISCOVERER_SUBTITLE_INFO(info));
+        codec_tag = GST_TAG_SUBTITLE_CODEC;
+    }
+
+    // 编码名和比特率优先使用标签（与 analyze_streams() 输出的内容相同），没有标签时用 caps 生成描述
+    if (tags != NULL)
+    {
+        gst_tag_list_get_string(tags, codec_tag, &codec);
+        if (s.bitrate == 0)
+            gst_tag_list_get_uint(tags, GST_TAG_BITRATE, &s.bitrate);
+    }
+    if (codec == NULL && (caps = gst_discoverer_stream_info_get_caps(info)) != NULL)
+    {
+        codec = gst_pb_utils_get_codec_description(caps);
+        gst_caps_unref(caps);
+    }
+    media_index_writer_add_stream(w, type, &s, codec, language);
+    g_free(codec);
+}
+
+/* 一个文件的信息写入索引：先视频，再音频，最后字幕（与 playbin 的 n-video/n-audio/n-text 对应） */
+static void
+add_file(MediaIndexWriter *w, GstDiscovererInfo *info)
+{
+    const GstTagList *tags = gst_discoverer_info_get_tags(info);
+    gchar *container = NULL;
+    GList *streams, *l;
+
+    if (tags != NULL)
+        gst_tag_list_get_string(tags, GST_TAG_CONTAINER_FORMAT, &container);
+    media_index_writer_add_file(w, gst_discoverer_info_get_uri(info), container,
+                                gst_discoverer_info_get_duration(info), gst_discoverer_info_get_seekable(info));
+    g_free(container);
+
+    streams = gst_discoverer_info_get_video_streams(info);
+    for (l = streams; l != NULL; l = l->next)
+        add_stream(w, l->data, MEDIA_STREAM_VIDEO);
+    gst_discoverer_stream_info_list_free(streams);
+    streams = gst_discoverer_info_get_audio_streams(info);
+    for (l = streams; l != NULL; l = l->next)
+        add_stream(w, l->data, MEDIA_STREAM_AUDIO);
+    gst_discoverer_stream_info_list_free(streams);
+    streams = gst_discoverer_info_get_subtitle_streams(info);
+    for (l = streams; l != NULL; l = l->next)
+        add_stream(w, l->data, MEDIA_STREAM_TEXT);
+    gst_discoverer_stream_info_list_free(streams);
+}
+
+/* 交给 discoverer 下一个文件，没有文件时返回 FALSE */
+static gboolean
+discover_next(Indexer *indexer, GstDiscoverer *discoverer)
+{
+    while (indexer->next < indexer->num_uris)
+    {
+        if (gst_discoverer_discover_uri_async(discoverer, indexer->uris[indexer->next++]))
+            return TRUE;
+        indexer->failed++;
+    }
+    return FALSE;
+}
+
+/**
+ * 一个文件探测完成（主线程）
+ *
+ * 异步模式下 discoverer 在调用 gst_discoverer_start() 的线程的主循环中发出信号，
+ * 所以索引的写入和调度都在主线程中进行，不需要锁。
+ */
+static void
+on_discovered(GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, Indexer *indexer)
+{
+    GstDiscovererResult result = gst_discoverer_info_get_result(info);
+
+    if (result == GST_DISCOVERER_OK)
+    {
+        add_file(indexer->writer, info);
+        indexer->indexed++;
+        if (indexer->verbose)
+            g_print("ok      %s\n", gst_discoverer_info_get_uri(info));
+    }
+    else
+    {
+        indexer->failed++;
+        if (indexer->verbose)
+            g_print("FAILED  %s: %s\n", gst_discoverer_info_get_uri(info),
+                    err ? err->message : result == GST_DISCOVERER_TIMEOUT ? "timeout" : "unknown error");
+    }
+
+    if (!discover_next(indexer, discoverer) && --indexer->running == 0)
+        g_main_loop_quit(indexer->loop);
+}
+
+/* 生成索引 */
+static int
+build_index(Indexer *indexer, const gchar *path, gint timeout)
+{
+    GError *error = NULL;
+    gint64 start;
+    gdouble seconds;
+    gsize size;
+    guint i;
+
+    indexer->writer = media_index_writer_new();
+    indexer->loop = g_main_loop_new(NULL, FALSE);
+    indexer->discoverers = g_new0(GstDiscoverer *, indexer->workers);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < indexer->workers; i++)
+    {
+        GstDiscoverer *discoverer = gst_discoverer_new(timeout * GST_SECOND, &error);
+
+        if (discoverer == NULL)
+        {
+            g_printerr("Could not create a discoverer: %s\n", error->message);
+            g_clear_error(&error);
+            return -1;
+        }
+        indexer->discoverers[i] = discoverer;
+        g_signal_connect(discoverer, "discovered", G_CALLBACK(on_discovered), indexer);
+        gst_discoverer_start(discoverer);
+        if (discover_next(indexer, discoverer))
+            indexer->running++;
+    }
+    if (indexer->running > 0)
+        g_main_loop_run(indexer->loop);
+    seconds = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+
+    size = media_index_writer_save(indexer->writer, path, &error);
+    if (size == 0)
+    {
+        g_printerr("Could not write %s: %s\n", path, error->message);
+        g_clear_error(&error);
+    }
+    else
+    {
+        // 每个文件的平均探测时间（墙钟时间 × worker 数 / 文件数）大致就是 analyze_streams() 之前要等待的时间
+        g_print("Indexed %u files (%u failed) in %.2f s with %u workers: %.1f files/sec, %.1f ms per file per worker\n",
+                indexer->indexed, indexer->failed, seconds, indexer->workers,
+                (indexer->indexed + indexer->failed) / seconds,
+                seconds * 1000 * indexer->workers / MAX(indexer->indexed + indexer->failed, 1));
+        g_print("Wrote %s: %" G_GSIZE_FORMAT " bytes, %.0f bytes per file\n", path, size, (gdouble)size / MAX(indexer->indexed, 1));
+    }
+
+    for (i = 0; i < indexer->workers; i++)
+    {
+        if (indexer->discoverers[i] == NULL)
+            continue;
+        gst_discoverer_stop(indexer->discoverers[i]);
+        g_object_unref(indexer->discoverers[i]);
+    }
+    g_free(indexer->discoverers);
+    g_main_loop_unref(indexer->loop);
+    media_index_writer_free(indexer->writer);
+    return size > 0 ? 0 : -1;
+}
+
+/* 查询并输出，第一次查询包含读入索引页面的缺页时间 */
+static int
+lookup(const MediaIndex *index, gchar **uris, guint num_uris)
+{
+    guint i;
+    int ret = 0;
+
+    for (i = 0; i < num_uris; i++)
+    {
+        GstClockTime t = gst_util_get_timestamp();
+        const MediaIndexFile *file = media_index_lookup(index, uris[i]);
+
+        t = gst_util_get_timestamp() - t;
+        g_print("%s (lookup %.2f us)\n", uris[i], t / 1e3);
+        if (file == NULL)
+        {
+            g_print("not in index\n\n");
+            ret = -1;
+            continue;
+        }
+        if (GST_CLOCK_TIME_IS_VALID(file->duration))
+            g_print("duration %" GST_TIME_FORMAT "%s\n", GST_TIME_ARGS(file->duration),
+                    file->flags & MEDIA_INDEX_SEEKABLE ? ", seekable" : "");
+        media_index_print(index, file);
+        g_print("\n");
+    }
+    return ret;
+}
+
+/* 对索引中的文件随机查询 n 次 */
+static void
+bench_lookups(const MediaIndex *index, guint n)
+{
+    guint num_files = index->header->n_files, *order, i, found = 0;
+    GstClockTime t;
+
+    if (num_files == 0)
+        return;
+    // 预先生成随机顺序，不把随机数的开销计入查询时间
+    order = g_new(guint, n);
+    for (i = 0; i < n; i++)
+        order[i] = g_random_int_range(0, num_files);
+
+    t = gst_util_get_timestamp();
+    for (i = 0; i < n; i++)
+    {
+        const MediaIndexFile *file = &index->files[order[i]];
+
+        // 文件记录在打开时不检查，uri 的偏移可能超出字符串区
+        if (file->uri < index->header->strings_size &&
+            media_index_lookup(index, media_index_string(index, file->uri)) != NULL)
+            found++;
+    }
+    t = gst_util_get_timestamp() - t;
+    g_print("%u random lookups over %u files: %.0f ns per lookup (%u found)\n", n, num_files, (gdouble)t / n, found);
+    g_free(order);
+}
+
+int main(int argc, char *argv[])
+{
+    Indexer indexer = {0};
+    gint workers = 0, timeout = DEFAULT_TIMEOUT, bench = 0, i;
+    gboolean do_lookup = FALSE;
+    gchar *index_path = NULL, *list = NULL;
+    GPtrArray *uris;
+    MediaIndex index;
+    GstClockTime t;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"index", 'i', 0, G_OPTION_ARG_FILENAME, &index_path, "Index file (default " DEFAULT_INDEX ")", "FILE"},
+        {"workers", 'j', 0, G_OPTION_ARG_INT, &workers, "Number of discoverers running in parallel (default: number of CPUs)", "N"},
+        {"timeout", 0, 0, G_OPTION_ARG_INT, &timeout, "Discoverer timeout per file in seconds", "S"},
+        {"list", 0, 0, G_OPTION_ARG_FILENAME, &list, "File with one path or URI per line", "FILE"},
+        {"lookup", 'l', 0, G_OPTION_ARG_NONE, &do_lookup, "Look the files up in the index instead of indexing them", NULL},
+        {"bench", 0, 0, G_OPTION_ARG_INT, &bench, "Time N random lookups over the whole index", "N"},
+        {"verbose", 'v', 0, G_OPTION_ARG_NONE, &indexer.verbose, "Print one line per file", NULL},
+        {NULL}};
+    int ret;
+
+    context = g_option_context_new("[DIRECTORY|FILE|URI...] - media metadata indexer");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    if (index_path == NULL)
+        index_path = g_strdup(DEFAULT_INDEX);
+
+    uris = g_ptr_array_new_with_free_func(g_free);
+    if (list != NULL && !media_files_add_list(uris, list))
+        return -1;
+    for (i = 1; i < argc; i++)
+        media_files_add(uris, argv[i]);
+
+    /* 查询 */
+    if (do_lookup || bench > 0)
+    {
+        t = gst_util_get_timestamp();
+        if (!media_index_open(&index, index_path, &error))
+        {
+            g_printerr("%s\n", error->message);
+            g_clear_error(&error);
+            return -1;
+        }
+        t = gst_util_get_timestamp() - t;
+        g_print("Opened %s: %u files, %u streams (%.2f us)\n\n", index_path,
+                index.header->n_files, index.header->n_streams, t / 1e3);
+        ret = lookup(&index, (gchar **)uris->pdata, uris->len);
+        if (bench > 0)
+            bench_lookups(&index, bench);
+        media_index_close(&index);
+        goto done;
+    }
+
+    /* 生成索引 */
+    if (uris->len == 0)
+    {
+        g_printerr("No input files. Usage: %s [OPTION...] DIRECTORY|FILE|URI...\n", argv[0]);
+        return -1;
+    }
+    gst_pb_utils_init();
+    indexer.uris = (gchar **)uris->pdata;
+    indexer.num_uris = uris->len;
+    // worker 数不超过文件数
+    indexer.workers = MIN(workers > 0 ? (guint)workers : g_get_num_processors(), uris->len);
+    ret = build_index(&indexer, index_path, MAX(timeout, 1));
+
+done:
+    g_ptr_array_unref(uris);
+    g_free(index_path);
+    g_free(list);
+    return ret;
+}
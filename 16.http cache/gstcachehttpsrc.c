@@ -0,0 +1,663 @@
+#include "gstcachehttpsrc.h"
+#include "http_cache.h"
+#include "http_client.h"
+
+#include <gst/base/gstbasesrc.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(cache_http_src_debug);
+#define GST_CAT_DEFAULT cache_http_src_debug
+
+#define DEFAULT_READAHEAD (1024 * 1024)
+#define DEFAULT_BLOCKSIZE (64 * 1024) /* push 模式下每个 buffer 的大小（GstBaseSrc 默认只有 4096） */
+#define DEFAULT_MAX_CACHE_SIZE (G_GUINT64_CONSTANT(2) * 1024 * 1024 * 1024)
+#define STAGE_SIZE (4 * HTTP_CACHE_BLOCK_SIZE) /* 响应体先攒满这么多再写入缓存，写入的位置和长度都按块对齐 */
+
+typedef struct _GstCacheHttpSrc
+{
+    GstBaseSrc parent;
+
+    /* 属性（GST_OBJECT_LOCK 保护） */
+    gchar *location;
+    gchar *cache_dir;
+    guint readahead;
+    guint64 max_cache_size;
+    guint64 bytes_fetched, bytes_served;
+    guint requests;
+
+    /* 只在 start/stop 和流线程中使用 */
+    gchar *uri;           /* start 时复制的 location */
+    gchar *dir;           /* start 时复制的 cache_dir */
+    HttpClient *client;
+    HttpCache cache;
+    GCancellable *cancellable; /* unlock 时取消正在进行的网络请求 */
+
+    /* 服务器不支持 Range 或者没有给出大小（chunked、直播流）时不使用随机访问，直接转发 start 时打开的响应体 */
+    gboolean passthrough;
+    gboolean write_through;    /* passthrough 时大小已知：转发的数据同时写入缓存 */
+
+    /* 写入缓存之前的暂存区：[stage_offset, stage_offset + stage_len) */
+    guint8 *stage;
+    guint64 stage_offset;
+    gsize stage_len;
+} GstCacheHttpSrc;
+
+typedef struct _GstCacheHttpSrcClass
+{
+    GstBaseSrcClass parent_class;
+} GstCacheHttpSrcClass;
+
+#define GST_CACHE_HTTP_SRC(obj) ((GstCacheHttpSrc *)(obj))
+
+static void gst_cache_http_src_uri_handler_init(gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE(GstCacheHttpSrc, gst_cache_http_src, GST_TYPE_BASE_SRC,
+                        G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER, gst_cache_http_src_uri_handler_init));
+
+enum
+{
+    PROP_0,
+    PROP_LOCATION,
+    PROP_CACHE_DIR,
+    PROP_READAHEAD,
+    PROP_MAX_CACHE_SIZE,
+    PROP_BYTES_FETCHED,
+    PROP_BYTES_SERVED,
+    PROP_REQUESTS,
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+/* 暂存区中的数据写入缓存 */
+static gboolean
+stage_flush(GstCacheHttpSrc *self, GError **error)
+{
+    gboolean ok = self->stage_len == 0 || http_cache_write(&self->cache, self->stage_offset, self->stage, self->stage_len, error);
+
+    self->stage_offset += self->stage_len;
+    self->stage_len = 0;
+    return ok;
+}
+
+/* 从缓存的 offset 处开始接收：暂存区满了就写入缓存 */
+static void
+stage_reset(GstCacheHttpSrc *self, guint64 offset)
+{
+    self->stage_offset = offset;
+    self->stage_len = 0;
+}
+
+/* 转发的数据追加到暂存区（passthrough） */
+static gboolean
+stage_append(GstCacheHttpSrc *self, const guint8 *data, gsize length, GError **error)
+{
+    while (length > 0)
+    {
+        gsize n = MIN(length, STAGE_SIZE - self->stage_len);
+
+        memcpy(self->stage + self->stage_len, data, n);
+        self->stage_len += n;
+        data += n;
+        length -= n;
+        if (self->stage_len == STAGE_SIZE && !stage_flush(self, error))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+count_fetched(GstCacheHttpSrc *self, guint64 bytes, guint requests)
+{
+    GST_OBJECT_LOCK(self);
+    self->bytes_fetched += bytes;
+    self->requests += requests;
+    GST_OBJECT_UNLOCK(self);
+}
+
+/**
+ * 把已经打开的响应体全部写入缓存的 offset 处，*received 为收到的字节数。
+ * 边读边写，内存中最多只有一个暂存区（服务器不支持 Range 时响应体是整个资源）
+ */
+static gboolean
+receive(GstCacheHttpSrc *self, guint64 offset, guint64 *received, GError **error)
+{
+    gssize n;
+
+    *received = 0;
+    stage_reset(self, offset);
+    for (;;)
+    {
+        n = http_client_read(self->client, self->stage + self->stage_len, STAGE_SIZE - self->stage_len,
+                             self->cancellable, error);
+        if (n <= 0)
+            break;
+        self->stage_len += n;
+        *received += n;
+        count_fetched(self, n, 0);
+        if (self->stage_len == STAGE_SIZE && !stage_flush(self, error))
+        {
+            http_client_abort(self->client);
+            return FALSE;
+        }
+    }
+    // 出错时已经收到的完整的块也保留
+    return stage_flush(self, n < 0 ? NULL : error) && n == 0;
+}
+
+/* 下载 [offset, offset + size) 写入缓存（流线程） */
+static gboolean
+fetch(GstCacheHttpSrc *self, guint64 offset, guint64 size, GError **error)
+{
+    gint64 total;
+    gboolean ranged, ok;
+    guint64 received = 0;
+
+    ok = http_client_open(self->client, self->uri, offset, size, &total, &ranged, self->cancellable, error);
+    if (ok)
+    {
+        count_fetched(self, 0, 1);
+        // 服务器不支持 Range 时返回整个资源，全部写入缓存，之后就不会再请求；
+        // 206 的数据从 offset 开始（http_client_open() 拒绝从其他位置开始的 Content-Range）
+        if (!ranged)
+            offset = 0;
+        if (ranged && total >= 0 && (guint64)total != self->cache.size)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Size changed from %" G_GUINT64_FORMAT " to %" G_GINT64_FORMAT,
+                        self->cache.size, total);
+            http_client_abort(self->client);
+            ok = FALSE;
+        }
+        else if (!receive(self, offset, &received, error))
+        {
+            ok = FALSE;
+        }
+        else if (offset + received < MIN(offset + size, self->cache.size))
+        {
+            // 数据不够时缺少的块不会被标记，fill 会一直重复请求同一个范围
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Short response: %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes",
+                        received, size);
+            ok = FALSE;
+        }
+    }
+    GST_DEBUG_OBJECT(self, "fetched %" G_GUINT64_FORMAT "+%" G_GUINT64_FORMAT ": %s", offset, size, ok ? "ok" : "failed");
+    return ok;
+}
+
+static gboolean gst_cache_http_src_stop(GstBaseSrc *src);
+
+static gboolean
+gst_cache_http_src_start(GstBaseSrc *src)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+    GError *error = NULL;
+    guint readahead;
+    guint64 max_cache_size;
+
+    GST_OBJECT_LOCK(self);
+    self->uri = g_strdup(self->location);
+    self->dir = g_strdup(self->cache_dir);
+    readahead = self->readahead;
+    max_cache_size = self->max_cache_size;
+    self->bytes_fetched = self->bytes_served = 0;
+    self->requests = 0;
+    GST_OBJECT_UNLOCK(self);
+
+    if (self->uri == NULL)
+    {
+        GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("No URI specified."), (NULL));
+        g_clear_pointer(&self->dir, g_free);
+        return FALSE;
+    }
+    self->client = http_client_new();
+    self->cancellable = g_cancellable_new();
+    self->stage = g_malloc(STAGE_SIZE);
+    self->passthrough = self->write_through = FALSE;
+    if (!http_cache_open(&self->cache, self->dir, self->uri, &error))
+        goto failed;
+    http_cache_evict(self->dir, max_cache_size, &self->cache);
+
+    // 缓存中已经有资源大小时不访问网络（完全缓存的资源播放时一个请求都没有）；
+    // 否则请求开头的 readahead 字节，从响应中得到资源大小
+    if (self->cache.size == 0)
+    {
+        gint64 total;
+        gboolean ranged;
+        guint64 received;
+
+        if (!http_client_open(self->client, self->uri, 0, readahead, &total, &ranged, self->cancellable, &error))
+            goto failed;
+        count_fetched(self, 0, 1);
+        if (ranged && total > 0)
+        {
+            if (!http_cache_set_size(&self->cache, total, &error) || !receive(self, 0, &received, &error))
+                goto failed;
+        }
+        else
+        {
+            // 不支持 Range（200）或者大小未知（chunked、直播流）：像 souphttpsrc 一样顺序转发这个响应体，不能 seek；
+            // 大小已知时转发的数据同时写入缓存，下一次播放直接使用缓存。
+            // 206 但没有总大小时响应体只有开头的 readahead 字节，重新请求到末尾
+            if (ranged)
+            {
+                if (!http_client_open(self->client, self->uri, 0, 0, &total, &ranged, self->cancellable, &error))
+                    goto failed;
+                count_fetched(self, 0, 1);
+            }
+            self->passthrough = TRUE;
+            self->write_through = total > 0 && http_cache_set_size(&self->cache, total, NULL);
+            stage_reset(self, 0);
+            GST_INFO_OBJECT(self, "%s: no range support or unknown size, streaming without seeking", self->uri);
+        }
+    }
+    GST_INFO_OBJECT(self, "%s: %" G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT " cached", self->uri,
+                    self->cache.size, http_cache_cached_bytes(&self->cache));
+    return TRUE;
+
+failed:
+    GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, ("Could not open %s", self->uri), ("%s", error->message));
+    g_clear_error(&error);
+    gst_cache_http_src_stop(src);
+    return FALSE;
+}
+
+static gboolean
+gst_cache_http_src_stop(GstBaseSrc *src)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+    guint64 max_cache_size;
+
+    // passthrough：已经转发、还在暂存区中的数据也写入缓存
+    if (self->write_through)
+        stage_flush(self, NULL);
+    if (self->cache.fd >= 0)
+    {
+        GST_OBJECT_LOCK(self);
+        max_cache_size = self->max_cache_size;
+        GST_OBJECT_UNLOCK(self);
+        // 这次下载之后目录可能超过上限
+        http_cache_evict(self->dir, max_cache_size, &self->cache);
+    }
+    http_cache_close(&self->cache);
+    g_clear_pointer(&self->client, http_client_free);
+    g_clear_object(&self->cancellable);
+    g_clear_pointer(&self->uri, g_free);
+    g_clear_pointer(&self->dir, g_free);
+    g_clear_pointer(&self->stage, g_free);
+    self->passthrough = self->write_through = FALSE;
+    return TRUE;
+}
+
+static gboolean
+gst_cache_http_src_get_size(GstBaseSrc *src, guint64 *size)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+
+    *size = self->cache.size;
+    return self->cache.size > 0;
+}
+
+/* 资源大小已知时任何位置都可以通过缓存或 Range 请求读取；passthrough 只能顺序读取 */
+static gboolean
+gst_cache_http_src_is_seekable(GstBaseSrc *src)
+{
+    return !GST_CACHE_HTTP_SRC(src)->passthrough;
+}
+
+static gboolean
+gst_cache_http_src_unlock(GstBaseSrc *src)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+
+    if (self->cancellable != NULL)
+        g_cancellable_cancel(self->cancellable);
+    return TRUE;
+}
+
+static gboolean
+gst_cache_http_src_unlock_stop(GstBaseSrc *src)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+
+    if (self->cancellable != NULL)
+        g_cancellable_reset(self->cancellable);
+    return TRUE;
+}
+
+/* passthrough：从 start 时打开的响应体中顺序读取 */
+static GstFlowReturn
+fill_passthrough(GstCacheHttpSrc *self, guint64 offset, guint length, GstBuffer *buf)
+{
+    GError *error = NULL;
+    GstMapInfo map;
+    gsize got = 0;
+    gssize n = 0;
+
+    if (!gst_buffer_map(buf, &map, GST_MAP_WRITE))
+    {
+        GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not map the output buffer."), (NULL));
+        return GST_FLOW_ERROR;
+    }
+    while (got < length && (n = http_client_read(self->client, map.data + got, length - got, self->cancellable, &error)) > 0)
+        got += n;
+    // 写入缓存失败不影响播放，只是不再缓存
+    if (self->write_through && got > 0 && !stage_append(self, map.data, got, NULL))
+        self->write_through = FALSE;
+    gst_buffer_unmap(buf, &map);
+
+    if (n < 0 && got == 0)
+    {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_clear_error(&error);
+            return GST_FLOW_FLUSHING;
+        }
+        GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not read %s", self->uri), ("%s", error->message));
+        g_clear_error(&error);
+        return GST_FLOW_ERROR;
+    }
+    g_clear_error(&error);
+    if (got == 0)
+    {
+        if (self->write_through)
+            stage_flush(self, NULL);
+        return GST_FLOW_EOS;
+    }
+    count_fetched(self, got, 0);
+    gst_buffer_set_size(buf, got);
+    GST_BUFFER_OFFSET(buf) = offset;
+    GST_BUFFER_OFFSET_END(buf) = offset + got;
+
+    GST_OBJECT_LOCK(self);
+    self->bytes_served += got;
+    GST_OBJECT_UNLOCK(self);
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_cache_http_src_fill(GstBaseSrc *src, guint64 offset, guint length, GstBuffer *buf)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+    guint64 miss_offset, miss_size;
+    GError *error = NULL;
+    GstMapInfo map;
+    guint readahead;
+    gboolean ok;
+
+    if (self->passthrough)
+        return fill_passthrough(self, offset, length, buf);
+    if (offset >= self->cache.size)
+        return GST_FLOW_EOS;
+    length = MIN(length, self->cache.size - offset);
+
+    GST_OBJECT_LOCK(self);
+    readahead = self->readahead;
+    GST_OBJECT_UNLOCK(self);
+
+    // 先把请求范围内缺少的块下载到缓存，然后统一从缓存读取
+    while (http_cache_find_missing(&self->cache, offset, length, MAX(readahead, length), &miss_offset, &miss_size))
+    {
+        if (!fetch(self, miss_offset, miss_size, &error))
+        {
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                // unlock：flush seek 或者状态切换
+                g_clear_error(&error);
+                return GST_FLOW_FLUSHING;
+            }
+            GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not fetch %s", self->uri), ("%s", error->message));
+            g_clear_error(&error);
+            return GST_FLOW_ERROR;
+        }
+    }
+
+    if (!gst_buffer_map(buf, &map, GST_MAP_WRITE))
+    {
+        GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not map the output buffer."), (NULL));
+        return GST_FLOW_ERROR;
+    }
+    ok = http_cache_read(&self->cache, offset, map.data, length, &error);
+    gst_buffer_unmap(buf, &map);
+    if (!ok)
+    {
+        GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not read the cache of %s", self->uri), ("%s", error->message));
+        g_clear_error(&error);
+        return GST_FLOW_ERROR;
+    }
+    gst_buffer_set_size(buf, length);
+    GST_BUFFER_OFFSET(buf) = offset;
+    GST_BUFFER_OFFSET_END(buf) = offset + length;
+
+    GST_OBJECT_LOCK(self);
+    self->bytes_served += length;
+    GST_OBJECT_UNLOCK(self);
+    return GST_FLOW_OK;
+}
+
+static gboolean
+gst_cache_http_src_query(GstBaseSrc *src, GstQuery *query)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(src);
+
+    // typefind 等根据 URI 的扩展名猜测类型
+    if (GST_QUERY_TYPE(query) == GST_QUERY_URI)
+    {
+        GST_OBJECT_LOCK(self);
+        gst_query_set_uri(query, self->location);
+        GST_OBJECT_UNLOCK(self);
+        return TRUE;
+    }
+    return GST_BASE_SRC_CLASS(gst_cache_http_src_parent_class)->query(src, query);
+}
+
+static gboolean
+set_location(GstCacheHttpSrc *self, const gchar *uri, GError **error)
+{
+    GstState state;
+
+    GST_OBJECT_LOCK(self);
+    state = GST_STATE(self);
+    if (state != GST_STATE_NULL && state != GST_STATE_READY)
+    {
+        GST_OBJECT_UNLOCK(self);
+        g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE, "Changing the URI while running is not supported");
+        return FALSE;
+    }
+    g_free(self->location);
+    self->location = g_strdup(uri);
+    GST_OBJECT_UNLOCK(self);
+    return TRUE;
+}
+
+static void
+gst_cache_http_src_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(object);
+
+    switch (prop_id)
+    {
+    case PROP_LOCATION:
+        set_location(self, g_value_get_string(value), NULL);
+        break;
+    case PROP_CACHE_DIR:
+        GST_OBJECT_LOCK(self);
+        g_free(self->cache_dir);
+        self->cache_dir = g_value_dup_string(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_READAHEAD:
+        GST_OBJECT_LOCK(self);
+        self->readahead = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    case PROP_MAX_CACHE_SIZE:
+        GST_OBJECT_LOCK(self);
+        self->max_cache_size = g_value_get_uint64(value);
+        GST_OBJECT_UNLOCK(self);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_cache_http_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id)
+    {
+    case PROP_LOCATION:
+        g_value_set_string(value, self->location);
+        break;
+    case PROP_CACHE_DIR:
+        g_value_set_string(value, self->cache_dir);
+        break;
+    case PROP_READAHEAD:
+        g_value_set_uint(value, self->readahead);
+        break;
+    case PROP_MAX_CACHE_SIZE:
+        g_value_set_uint64(value, self->max_cache_size);
+        break;
+    case PROP_BYTES_FETCHED:
+        g_value_set_uint64(value, self->bytes_fetched);
+        break;
+    case PROP_BYTES_SERVED:
+        g_value_set_uint64(value, self->bytes_served);
+        break;
+    case PROP_REQUESTS:
+        g_value_set_uint(value, self->requests);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void
+gst_cache_http_src_finalize(GObject *object)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(object);
+
+    g_free(self->location);
+    g_free(self->cache_dir);
+    G_OBJECT_CLASS(gst_cache_http_src_parent_class)->finalize(object);
+}
+
+static void
+gst_cache_http_src_class_init(GstCacheHttpSrcClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS(klass);
+
+    gobject_class->set_property = gst_cache_http_src_set_property;
+    gobject_class->get_property = gst_cache_http_src_get_property;
+    gobject_class->finalize = gst_cache_http_src_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_LOCATION,
+                                    g_param_spec_string("location", "Location", "URI to read", NULL,
+                                                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_CACHE_DIR,
+                                    g_param_spec_string("cache-dir", "Cache directory", "Directory for the cached blocks", NULL,
+                                                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_READAHEAD,
+                                    g_param_spec_uint("readahead", "Readahead", "Minimum number of bytes per HTTP request",
+                                                      HTTP_CACHE_BLOCK_SIZE, G_MAXUINT, DEFAULT_READAHEAD,
+                                                      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_MAX_CACHE_SIZE,
+                                    g_param_spec_uint64("max-cache-size", "Max cache size",
+                                                        "Evict the least recently used entries above this many bytes (0 = unlimited)",
+                                                        0, G_MAXUINT64, DEFAULT_MAX_CACHE_SIZE,
+                                                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_BYTES_FETCHED,
+                                    g_param_spec_uint64("bytes-fetched", "Bytes fetched", "Bytes downloaded from the network since start",
+                                                        0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_BYTES_SERVED,
+                                    g_param_spec_uint64("bytes-served", "Bytes served", "Bytes pushed downstream since start",
+                                                        0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_REQUESTS,
+                                    g_param_spec_uint("requests", "Requests", "HTTP requests since start",
+                                                      0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    GST_DEBUG_CATEGORY_INIT(cache_http_src_debug, "cachehttpsrc", 0, "HTTP source with a disk cache");
+
+    gst_element_class_set_static_metadata(element_class, "Caching HTTP source", "Source/Network",
+                                          "Reads http/https URIs through a block-based disk cache with range requests",
+                                          "gstreamer-demos");
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    basesrc_class->start = GST_DEBUG_FUNCPTR(gst_cache_http_src_start);
+    basesrc_class->stop = GST_DEBUG_FUNCPTR(gst_cache_http_src_stop);
+    basesrc_class->get_size = GST_DEBUG_FUNCPTR(gst_cache_http_src_get_size);
+    basesrc_class->is_seekable = GST_DEBUG_FUNCPTR(gst_cache_http_src_is_seekable);
+    basesrc_class->unlock = GST_DEBUG_FUNCPTR(gst_cache_http_src_unlock);
+    basesrc_class->unlock_stop = GST_DEBUG_FUNCPTR(gst_cache_http_src_unlock_stop);
+    basesrc_class->fill = GST_DEBUG_FUNCPTR(gst_cache_http_src_fill);
+    basesrc_class->query = GST_DEBUG_FUNCPTR(gst_cache_http_src_query);
+}
+
+static void
+gst_cache_http_src_init(GstCacheHttpSrc *self)
+{
+    self->cache_dir = http_cache_default_dir();
+    self->readahead = DEFAULT_READAHEAD;
+    self->max_cache_size = DEFAULT_MAX_CACHE_SIZE;
+    self->cache.fd = -1;
+    gst_base_src_set_blocksize(GST_BASE_SRC(self), DEFAULT_BLOCKSIZE);
+}
+
+/* ################## GstURIHandler ################## */
+
+static GstURIType
+gst_cache_http_src_uri_get_type(GType type)
+{
+    return GST_URI_SRC;
+}
+
+static const gchar *const *
+gst_cache_http_src_uri_get_protocols(GType type)
+{
+    static const gchar *protocols[] = {"http", "https", NULL};
+
+    return protocols;
+}
+
+static gchar *
+gst_cache_http_src_uri_get_uri(GstURIHandler *handler)
+{
+    GstCacheHttpSrc *self = GST_CACHE_HTTP_SRC(handler);
+    gchar *uri;
+
+    GST_OBJECT_LOCK(self);
+    uri = g_strdup(self->location);
+    GST_OBJECT_UNLOCK(self);
+    return uri;
+}
+
+static gboolean
+gst_cache_http_src_uri_set_uri(GstURIHandler *handler, const gchar *uri, GError **error)
+{
+    return set_location(GST_CACHE_HTTP_SRC(handler), uri, error);
+}
+
+static void
+gst_cache_http_src_uri_handler_init(gpointer g_iface, gpointer iface_data)
+{
+    GstURIHandlerInterface *iface = (GstURIHandlerInterface *)g_iface;
+
+    iface->get_type = gst_cache_http_src_uri_get_type;
+    iface->get_protocols = gst_cache_http_src_uri_get_protocols;
+    iface->get_uri = gst_cache_http_src_uri_get_uri;
+    iface->set_uri = gst_cache_http_src_uri_set_uri;
+}
+
+gboolean
+cache_http_src_register(GstPlugin *plugin)
+{
+    // rank 高于 souphttpsrc（PRIMARY），gst_element_make_from_uri() 优先选择这个元素；
+    // 不支持 Range 或者大小未知的资源退回到顺序转发（passthrough），原来能播放的 URI 仍然能播放
+    return gst_element_register(plugin, "cachehttpsrc", GST_RANK_PRIMARY + 100, GST_TYPE_CACHE_HTTP_SRC);
+}
@@ -0,0 +1,37 @@
+#ifndef GST_CACHE_HTTP_SRC_H
+#define GST_CACHE_HTTP_SRC_H
+
+#include <gst/gst.h>
+
+/**
+ * cachehttpsrc：带磁盘缓存的 http/https 源
+ *
+ * 01、03、09、11 每次运行都从 freedesktop.org 重新下载同一个视频。这个源实现 GstURIHandler（http、https），
+ * rank 高于 souphttpsrc，playbin/uridecodebin 创建源时会优先选择它，示例代码不需要任何修改：
+ *
+ * - 数据按块缓存在磁盘上（见 http_cache.h），再次播放同一个 URI 时直接从缓存读取，不访问网络
+ * - 随机访问（GstBaseSrc 的 is_seekable/get_size）：seek 到没有缓存的位置时用 Range 请求只下载缺少的块
+ * - 每次至少下载 readahead 字节（连续缺少的块合并成一个请求），减少请求次数
+ * - 服务器不支持 Range 或者没有给出大小（chunked、直播流）时退回到顺序转发（passthrough，不能 seek），
+ *   大小已知时转发的数据同时写入缓存；rank 高于 souphttpsrc，不能让原来能播放的 URI 打不开
+ * - 响应体边读边写入缓存，不在内存中缓冲整个响应体
+ *
+ * 属性：
+ * - location：URI
+ * - cache-dir：缓存目录（默认 $XDG_CACHE_HOME/gstreamer-demos/http）
+ * - readahead：每个请求至少下载的字节数（默认 1 MiB）
+ * - max-cache-size：缓存目录的大小上限（默认 2 GiB，0 表示不限制），超过时删除最久没有使用的缓存（LRU）
+ * - bytes-fetched、bytes-served、requests（只读）：从网络下载的字节数、输出给下游的字节数、HTTP 请求数
+ *
+ * 两种使用方式：
+ * - 编译成插件 libgstcachehttpsrc.so，通过 GST_PLUGIN_PATH 加载到任何示例中
+ * - 直接编译在程序中，gst_init() 之后调用 cache_http_src_register(NULL)
+ */
+
+#define GST_TYPE_CACHE_HTTP_SRC (gst_cache_http_src_get_type())
+GType gst_cache_http_src_get_type(void);
+
+/* plugin 为 NULL 时注册为静态元素 */
+gboolean cache_http_src_register(GstPlugin *plugin);
+
+#endif /* GST_CACHE_HTTP_SRC_H */
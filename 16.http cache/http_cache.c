@@ -0,0 +1,364 @@
+#include "http_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE HTTP_CACHE_BLOCK_SIZE
+#define BITMAP_SIZE(n_blocks) (((n_blocks) + 7) / 8)
+
+/* uri 的 SHA-1 作为文件名 */
+static void
+cache_paths(const gchar *dir, const gchar *uri, gchar **data_path, gchar **meta_path)
+{
+    gchar *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+    gchar *name;
+
+    name = g_strconcat(key, ".data", NULL);
+    *data_path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    name = g_strconcat(key, ".meta", NULL);
+    *meta_path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    g_free(key);
+}
+
+static gboolean
+set_errno_error(GError **error, const gchar *path)
+{
+    int saved = errno;
+
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "%s: %s", path, g_strerror(saved));
+    return FALSE;
+}
+
+static gboolean
+pwrite_all(gint fd, const guint8 *data, gsize length, guint64 offset)
+{
+    while (length > 0)
+    {
+        gssize n = pwrite(fd, data, length, offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return FALSE;
+        data += n;
+        length -= n;
+        offset += n;
+    }
+    return TRUE;
+}
+
+static gboolean
+pread_all(gint fd, guint8 *data, gsize length, guint64 offset)
+{
+    while (length > 0)
+    {
+        gssize n = pread(fd, data, length, offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            if (n == 0)
+                errno = EIO; // 文件比位图记录的短
+            return FALSE;
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+    return TRUE;
+}
+
+static gboolean
+block_cached(const HttpCache *cache, guint32 block)
+{
+    return (cache->bitmap[block / 8] >> (block % 8)) & 1;
+}
+
+/* 清空位图，大小改为 size */
+static void
+reset(HttpCache *cache, guint64 size)
+{
+    g_free(cache->bitmap);
+    cache->size = size;
+    cache->n_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    cache->bitmap = g_malloc0(BITMAP_SIZE(cache->n_blocks) + 1);
+    cache->n_cached = 0;
+}
+
+/* 保存 .meta：头部 + 位图。原地覆盖写（不用临时文件 + 重命名，每次下载之后都要写，不能每次都 fsync），
+ * 位只会从 0 变成 1，写到一半时最多丢失几个块的标记，不会把没有的数据当成已经缓存 */
+static gboolean
+save_meta(HttpCache *cache, GError **error)
+{
+    HttpCacheMeta meta;
+    gint fd;
+    gboolean ok;
+
+    memset(&meta, 0, sizeof(meta));
+    memcpy(meta.magic, HTTP_CACHE_MAGIC, sizeof(meta.magic));
+    meta.size = cache->size;
+    meta.block_size = BLOCK_SIZE;
+    meta.n_blocks = cache->n_blocks;
+
+    fd = g_open(cache->meta_path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+        return set_errno_error(error, cache->meta_path);
+    ok = pwrite_all(fd, (const guint8 *)&meta, sizeof(meta), 0) &&
+         pwrite_all(fd, cache->bitmap, BITMAP_SIZE(cache->n_blocks), sizeof(meta)) &&
+         ftruncate(fd, sizeof(meta) + BITMAP_SIZE(cache->n_blocks)) == 0;
+    if (!ok)
+        set_errno_error(error, cache->meta_path);
+    close(fd);
+    return ok;
+}
+
+/* 读入已有的 .meta，格式不对时当作没有缓存 */
+static void
+load_meta(HttpCache *cache)
+{
+    HttpCacheMeta meta;
+    gchar *contents = NULL;
+    gsize length;
+    struct stat st;
+    guint32 i;
+
+    if (!g_file_get_contents(cache->meta_path, &contents, &length, NULL) || length < sizeof(meta))
+        goto done;
+    memcpy(&meta, contents, sizeof(meta));
+    if (memcmp(meta.magic, HTTP_CACHE_MAGIC, sizeof(meta.magic)) != 0 || meta.block_size != BLOCK_SIZE ||
+        meta.n_blocks != (meta.size + BLOCK_SIZE - 1) / BLOCK_SIZE || length < sizeof(meta) + BITMAP_SIZE(meta.n_blocks))
+        goto done;
+    // .data 被删除或截断时位图无效
+    if (fstat(cache->fd, &st) != 0 || (guint64)st.st_size < meta.size)
+        goto done;
+
+    reset(cache, meta.size);
+    memcpy(cache->bitmap, contents + sizeof(meta), BITMAP_SIZE(meta.n_blocks));
+    for (i = 0; i < cache->n_blocks; i++)
+        cache->n_cached += block_cached(cache, i);
+
+done:
+    g_free(contents);
+}
+
+gchar *
+http_cache_default_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "gstreamer-demos", "http", NULL);
+}
+
+gboolean
+http_cache_open(HttpCache *cache, const gchar *dir, const gchar *uri, GError **error)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->fd = -1;
+    if (g_mkdir_with_parents(dir, 0755) != 0)
+        return set_errno_error(error, dir);
+    cache_paths(dir, uri, &cache->data_path, &cache->meta_path);
+    cache->fd = g_open(cache->data_path, O_RDWR | O_CREAT, 0644);
+    if (cache->fd < 0)
+    {
+        set_errno_error(error, cache->data_path);
+        http_cache_close(cache);
+        return FALSE;
+    }
+    reset(cache, 0);
+    load_meta(cache);
+    // .meta 的修改时间就是最后使用的时间（LRU），只读取缓存时也要更新
+    g_utime(cache->meta_path, NULL);
+    return TRUE;
+}
+
+gboolean
+http_cache_set_size(HttpCache *cache, guint64 size, GError **error)
+{
+    if (cache->size == size)
+        return TRUE;
+    // 新的资源，或者服务器上的文件已经变化：丢弃原有的数据，.data 截断成稀疏文件
+    reset(cache, size);
+    if (ftruncate(cache->fd, 0) != 0 || ftruncate(cache->fd, size) != 0)
+        return set_errno_error(error, cache->data_path);
+    return save_meta(cache, error);
+}
+
+gboolean
+http_cache_find_missing(HttpCache *cache, guint64 offset, guint64 size, guint64 max_run,
+                        guint64 *miss_offset, guint64 *miss_size)
+{
+    guint32 first = offset / BLOCK_SIZE, last, i, j;
+
+    last = MIN((offset + size + BLOCK_SIZE - 1) / BLOCK_SIZE, cache->n_blocks);
+    for (i = first; i < last && block_cached(cache, i); i++)
+        ;
+    if (i >= last)
+        return FALSE;
+    // 从第一个缺少的块开始，连续缺少的块一起下载（遇到已经缓存的块就停止，不重复下载）
+    for (j = i; j < cache->n_blocks && !block_cached(cache, j) && (guint64)(j - i) * BLOCK_SIZE < max_run; j++)
+        ;
+    *miss_offset = (guint64)i * BLOCK_SIZE;
+    *miss_size = MIN((guint64)j * BLOCK_SIZE, cache->size) - *miss_offset;
+    return TRUE;
+}
+
+gboolean
+http_cache_write(HttpCache *cache, guint64 offset, const guint8 *data, gsize length, GError **error)
+{
+    guint64 end = MIN(offset + length, cache->size);
+    guint32 first, last, i;
+
+    if (end <= offset)
+        return TRUE;
+    if (!pwrite_all(cache->fd, data, end - offset, offset))
+        return set_errno_error(error, cache->data_path);
+
+    // 只标记完整覆盖的块；最后一块到资源末尾就算完整
+    first = (offset + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    last = end == cache->size ? cache->n_blocks : end / BLOCK_SIZE;
+    for (i = first; i < last; i++)
+    {
+        if (block_cached(cache, i))
+            continue;
+        cache->bitmap[i / 8] |= 1 << (i % 8);
+        cache->n_cached++;
+    }
+    return save_meta(cache, error);
+}
+
+gboolean
+http_cache_read(HttpCache *cache, guint64 offset, guint8 *data, gsize length, GError **error)
+{
+    if (!pread_all(cache->fd, data, length, offset))
+        return set_errno_error(error, cache->data_path);
+    return TRUE;
+}
+
+guint64
+http_cache_cached_bytes(HttpCache *cache)
+{
+    guint64 bytes = (guint64)cache->n_cached * BLOCK_SIZE;
+
+    // 最后一块不满
+    if (cache->n_blocks > 0 && block_cached(cache, cache->n_blocks - 1))
+        bytes -= (guint64)cache->n_blocks * BLOCK_SIZE - cache->size;
+    return bytes;
+}
+
+void
+http_cache_close(HttpCache *cache)
+{
+    if (cache->fd >= 0)
+        close(cache->fd);
+    cache->fd = -1;
+    g_clear_pointer(&cache->bitmap, g_free);
+    g_clear_pointer(&cache->data_path, g_free);
+    g_clear_pointer(&cache->meta_path, g_free);
+}
+
+/* 缓存目录中的一项（.data + .meta） */
+typedef struct _CacheEntry
+{
+    gchar *meta_path;
+    gint64 used;       /* .meta 的修改时间 */
+    guint64 bytes;     /* 实际占用的磁盘空间（.data 是稀疏文件，按分配的块计算） */
+} CacheEntry;
+
+static gint
+compare_used(gconstpointer a, gconstpointer b)
+{
+    gint64 ua = ((const CacheEntry *)a)->used, ub = ((const CacheEntry *)b)->used;
+
+    return ua < ub ? -1 : ua > ub;
+}
+
+static void
+cache_entry_clear(CacheEntry *entry)
+{
+    g_free(entry->meta_path);
+}
+
+/* 把 .meta 的路径换成 .data */
+static gchar *
+data_path_for(const gchar *meta_path)
+{
+    gchar *path = g_strdup(meta_path);
+
+    strcpy(path + strlen(path) - strlen(".meta"), ".data");
+    return path;
+}
+
+guint64
+http_cache_evict(const gchar *dir, guint64 max_bytes, const HttpCache *keep)
+{
+    GArray *entries;
+    GDir *d;
+    const gchar *name;
+    guint64 total = 0, removed = 0;
+    guint i;
+
+    if (max_bytes == 0 || (d = g_dir_open(dir, 0, NULL)) == NULL)
+        return 0;
+    entries = g_array_new(FALSE, FALSE, sizeof(CacheEntry));
+    g_array_set_clear_func(entries, (GDestroyNotify)cache_entry_clear);
+    while ((name = g_dir_read_name(d)) != NULL)
+    {
+        CacheEntry entry;
+        GStatBuf st;
+        gchar *data_path;
+
+        if (!g_str_has_suffix(name, ".meta"))
+            continue;
+        entry.meta_path = g_build_filename(dir, name, NULL);
+        if (g_stat(entry.meta_path, &st) != 0)
+        {
+            g_free(entry.meta_path);
+            continue;
+        }
+        entry.used = st.st_mtime;
+        entry.bytes = st.st_size;
+        data_path = data_path_for(entry.meta_path);
+        if (g_stat(data_path, &st) == 0)
+            entry.bytes += (guint64)st.st_blocks * 512;
+        g_free(data_path);
+        total += entry.bytes;
+        g_array_append_val(entries, entry);
+    }
+    g_dir_close(d);
+
+    // 从最久没有使用的开始删除，正在使用的缓存（keep）不删除
+    g_array_sort(entries, compare_used);
+    for (i = 0; i < entries->len && total > max_bytes; i++)
+    {
+        CacheEntry *entry = &g_array_index(entries, CacheEntry, i);
+        gchar *data_path;
+
+        if (keep != NULL && g_strcmp0(entry->meta_path, keep->meta_path) == 0)
+            continue;
+        data_path = data_path_for(entry->meta_path);
+        g_unlink(data_path);
+        g_unlink(entry->meta_path);
+        g_free(data_path);
+        total -= entry->bytes;
+        removed += entry->bytes;
+    }
+    g_array_unref(entries);
+    return removed;
+}
+
+void
+http_cache_remove(const gchar *dir, const gchar *uri)
+{
+    gchar *data_path, *meta_path;
+
+    cache_paths(dir, uri, &data_path, &meta_path);
+    g_unlink(data_path);
+    g_unlink(meta_path);
+    g_free(data_path);
+    g_free(meta_path);
+}
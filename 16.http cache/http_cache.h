@@ -0,0 +1,71 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <glib.h>
+
+/**
+ * HTTP 资源的磁盘缓存（按块缓存，支持随机访问）
+ *
+ * 每个 URI 对应缓存目录中的两个文件，文件名是 URI 的 SHA-1：
+ *
+ *   <sha1>.data   与资源大小相同的稀疏文件，已经下载的块写在原来的偏移处
+ *   <sha1>.meta   HttpCacheMeta + 每块一位的位图（1 表示这一块已经下载）
+ *
+ * - 块大小为 HTTP_CACHE_BLOCK_SIZE，最后一块可以不满
+ * - seek 到没有下载过的位置时只下载缺少的块，已经下载的部分（例如文件开头的索引）一直保留
+ * - 每次写入数据之后立即更新 .meta（先写数据再写位图），进程中途退出也不会把没有写完的块当成已经缓存
+ * - 不做重新验证（ETag/Last-Modified）：假定同一个 URI 的内容不会变化，适合示例中的固定媒体文件；
+ *   服务器返回的大小与缓存的不同时丢弃整个缓存
+ * - 不支持多个进程同时写同一个 URI 的缓存
+ * - 目录的总大小可以限制：超过上限时按最后使用时间（.meta 的修改时间，打开时更新）删除最久没有使用的缓存（LRU）
+ */
+
+#define HTTP_CACHE_BLOCK_SIZE (64 * 1024)
+#define HTTP_CACHE_MAGIC "GSTHCCH1"
+
+typedef struct _HttpCacheMeta
+{
+    gchar magic[8];
+    guint64 size;       /* 资源大小 */
+    guint32 block_size;
+    guint32 n_blocks;
+} HttpCacheMeta;
+
+typedef struct _HttpCache
+{
+    gchar *data_path, *meta_path;
+    gint fd;            /* .data，-1 表示没有打开 */
+    guint64 size;       /* 资源大小，0 表示还不知道 */
+    guint32 n_blocks;
+    guint8 *bitmap;
+    guint32 n_cached;   /* 已经缓存的块数 */
+} HttpCache;
+
+/* 默认缓存目录：$XDG_CACHE_HOME/gstreamer-demos/http */
+gchar *http_cache_default_dir(void);
+/* 打开（或创建）uri 的缓存，读入已有的位图 */
+gboolean http_cache_open(HttpCache *cache, const gchar *dir, const gchar *uri, GError **error);
+/* 设置资源大小；与已有的缓存不同时清空缓存 */
+gboolean http_cache_set_size(HttpCache *cache, guint64 size, GError **error);
+/**
+ * 在 [offset, offset + size) 中查找第一个没有缓存的块，找到时返回 TRUE，
+ * *miss_offset、*miss_size 是从这一块开始连续缺少的块（最多 max_run 字节，不超过资源末尾）
+ */
+gboolean http_cache_find_missing(HttpCache *cache, guint64 offset, guint64 size, guint64 max_run,
+                                 guint64 *miss_offset, guint64 *miss_size);
+/* 写入数据并标记完整覆盖的块（以及到达资源末尾的最后一块），然后保存位图 */
+gboolean http_cache_write(HttpCache *cache, guint64 offset, const guint8 *data, gsize length, GError **error);
+/* 读取已经缓存的数据 */
+gboolean http_cache_read(HttpCache *cache, guint64 offset, guint8 *data, gsize length, GError **error);
+/* 已经缓存的字节数 */
+guint64 http_cache_cached_bytes(HttpCache *cache);
+void http_cache_close(HttpCache *cache);
+/**
+ * 缓存目录的总大小（实际占用的磁盘空间）超过 max_bytes 时，从最久没有使用的开始删除整个缓存，直到不超过上限；
+ * keep 是正在使用的缓存，不删除（可以为 NULL）。max_bytes 为 0 表示不限制。返回删除的字节数
+ */
+guint64 http_cache_evict(const gchar *dir, guint64 max_bytes, const HttpCache *keep);
+/* 删除 uri 的缓存 */
+void http_cache_remove(const gchar *dir, const gchar *uri);
+
+#endif /* HTTP_CACHE_H */
@@ -0,0 +1,388 @@
+#include "http_client.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_REDIRECTS 5
+
+struct _HttpClient
+{
+    GSocketClient *socket_client;
+    GSocketConnection *connection; /* keep-alive 的连接，NULL 表示没有 */
+    GDataInputStream *in;          /* connection 的输入流（带缓冲，按行读取响应头） */
+    gchar *host;                   /* connection 连接的服务器 */
+    gint port;
+    gboolean tls;
+    gchar *redirect_from, *redirect_to; /* 上一次重定向 */
+
+    /* 正在读取的响应体 */
+    gboolean in_body;              /* http_client_open() 之后、响应体读完之前 */
+    gboolean chunked;
+    gboolean chunk_crlf;           /* chunked：上一块的数据之后还有一个空行没有读 */
+    gint64 remaining;              /* 当前块（chunked）或者响应体剩余的字节数，-1 表示读到连接关闭为止 */
+    gboolean close_after;          /* 响应体读完之后关闭连接 */
+};
+
+/* 响应头中需要的字段 */
+typedef struct _Response
+{
+    guint status;
+    gint64 content_length; /* -1 表示没有 */
+    gint64 range_start;    /* Content-Range（bytes a-b/total）中的 a、b，-1 表示没有 */
+    gint64 range_end;
+    gint64 total;          /* Content-Range 中的总大小，-1 表示没有（或者是 *） */
+    gboolean chunked;
+    gboolean close;        /* 服务器在响应之后关闭连接 */
+    gchar *location;
+} Response;
+
+HttpClient *
+http_client_new(void)
+{
+    HttpClient *client = g_new0(HttpClient, 1);
+
+    client->socket_client = g_socket_client_new();
+    return client;
+}
+
+static void
+close_connection(HttpClient *client)
+{
+    client->in_body = FALSE;
+    g_clear_object(&client->in);
+    g_clear_object(&client->connection);
+    g_clear_pointer(&client->host, g_free);
+}
+
+static gboolean
+connect_to(HttpClient *client, const gchar *host, gint port, gboolean tls, GCancellable *cancellable, GError **error)
+{
+    close_connection(client);
+    g_socket_client_set_tls(client->socket_client, tls);
+    client->connection = g_socket_client_connect_to_host(client->socket_client, host, port, cancellable, error);
+    if (client->connection == NULL)
+        return FALSE;
+    client->in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(client->connection)));
+    g_data_input_stream_set_newline_type(client->in, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+    client->host = g_strdup(host);
+    client->port = port;
+    client->tls = tls;
+    return TRUE;
+}
+
+/* 读一行，连接关闭时返回 NULL 并设置 G_IO_ERROR_CONNECTION_CLOSED */
+static gchar *
+read_line(HttpClient *client, GCancellable *cancellable, GError **error)
+{
+    GError *err = NULL;
+    gchar *line = g_data_input_stream_read_line(client->in, NULL, cancellable, &err);
+
+    if (line == NULL)
+    {
+        if (err == NULL)
+            err = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "Connection closed by server");
+        g_propagate_error(error, err);
+        return NULL;
+    }
+    return g_strstrip(line);
+}
+
+/* Content-Range: bytes a-b/total（total 可以是 *）；格式不对时各项保持 -1 */
+static void
+parse_content_range(const gchar *value, Response *resp)
+{
+    guint64 start, end;
+    gchar total[32];
+
+    if (sscanf(value, "bytes %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT "/%31s", &start, &end, total) != 3 || end < start)
+        return;
+    resp->range_start = start;
+    resp->range_end = end;
+    if (g_ascii_isdigit(total[0]))
+        resp->total = g_ascii_strtoll(total, NULL, 10);
+}
+
+/* 发送请求并读取响应头 */
+static gboolean
+send_request(HttpClient *client, GUri *uri, guint64 offset, guint64 size, Response *resp,
+             GCancellable *cancellable, GError **error)
+{
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(client->connection));
+    const gchar *path = g_uri_get_path(uri), *query = g_uri_get_query(uri);
+    gchar *host, *end, *request, *line;
+    gboolean ok;
+
+    // Host 头只在非默认端口时带端口号
+    host = g_uri_get_port(uri) > 0 ? g_strdup_printf("%s:%d", g_uri_get_host(uri), g_uri_get_port(uri))
+                                   : g_strdup(g_uri_get_host(uri));
+    end = size > 0 ? g_strdup_printf("%" G_GUINT64_FORMAT, offset + size - 1) : g_strdup("");
+    request = g_strdup_printf("GET %s%s%s HTTP/1.1\r\n"
+                              "Host: %s\r\n"
+                              "User-Agent: gstreamer-demos\r\n"
+                              "Range: bytes=%" G_GUINT64_FORMAT "-%s\r\n"
+                              "Connection: keep-alive\r\n\r\n",
+                              path[0] ? path : "/", query ? "?" : "", query ? query : "", host, offset, end);
+    ok = g_output_stream_write_all(out, request, strlen(request), NULL, cancellable, error);
+    g_free(request);
+    g_free(end);
+    g_free(host);
+    if (!ok)
+        return FALSE;
+
+    memset(resp, 0, sizeof(*resp));
+    resp->content_length = -1;
+    resp->range_start = resp->range_end = resp->total = -1;
+    line = read_line(client, cancellable, error);
+    if (line == NULL)
+        return FALSE;
+    // HTTP/1.0 的服务器默认不保持连接
+    resp->close = g_str_has_prefix(line, "HTTP/1.0");
+    if (sscanf(line, "HTTP/%*u.%*u %u", &resp->status) != 1)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid status line: %s", line);
+        g_free(line);
+        return FALSE;
+    }
+    g_free(line);
+
+    while ((line = read_line(client, cancellable, error)) != NULL && line[0] != '\0')
+    {
+        gchar *value = strchr(line, ':');
+
+        if (value != NULL)
+        {
+            *value = '\0';
+            value = g_strstrip(value + 1);
+            if (g_ascii_strcasecmp(line, "Content-Length") == 0)
+                resp->content_length = g_ascii_strtoll(value, NULL, 10);
+            else if (g_ascii_strcasecmp(line, "Content-Range") == 0)
+                parse_content_range(value, resp);
+            else if (g_ascii_strcasecmp(line, "Transfer-Encoding") == 0)
+                resp->chunked = g_ascii_strcasecmp(value, "chunked") == 0;
+            else if (g_ascii_strcasecmp(line, "Connection") == 0)
+                resp->close = g_ascii_strcasecmp(value, "close") == 0;
+            else if (g_ascii_strcasecmp(line, "Location") == 0)
+                resp->location = g_strdup(value);
+        }
+        g_free(line);
+    }
+    if (line == NULL)
+    {
+        g_free(resp->location);
+        return FALSE;
+    }
+    g_free(line);
+    return TRUE;
+}
+
+gboolean
+http_client_open(HttpClient *client, const gchar *uri, guint64 offset, guint64 size,
+                 gint64 *total, gboolean *ranged, GCancellable *cancellable, GError **error)
+{
+    gchar *target;
+    Response resp;
+    gint redirects;
+    gboolean ok = FALSE;
+
+    // 上一个响应体没有读完，连接中还有它的数据
+    http_client_abort(client);
+
+    // 之前重定向过的 URI 直接请求重定向的目标
+    target = g_strdup(g_strcmp0(client->redirect_from, uri) == 0 ? client->redirect_to : uri);
+    for (redirects = 0;; redirects++)
+    {
+        GUri *parsed = g_uri_parse(target, G_URI_FLAGS_NONE, error);
+        gboolean tls;
+        gint port;
+        gint attempt;
+
+        if (parsed == NULL)
+            break;
+        tls = g_ascii_strcasecmp(g_uri_get_scheme(parsed), "https") == 0;
+        port = g_uri_get_port(parsed) > 0 ? g_uri_get_port(parsed) : tls ? 443 : 80;
+
+        for (attempt = 0;; attempt++)
+        {
+            GError *err = NULL;
+            gboolean reused = client->connection != NULL && client->tls == tls && client->port == port &&
+                              g_strcmp0(client->host, g_uri_get_host(parsed)) == 0;
+
+            if (!reused && !connect_to(client, g_uri_get_host(parsed), port, tls, cancellable, &err))
+            {
+                g_propagate_error(error, err);
+                break;
+            }
+            if (send_request(client, parsed, offset, size, &resp, cancellable, &err))
+            {
+                ok = TRUE;
+                break;
+            }
+            close_connection(client);
+            // 复用的连接可能在空闲时已经被服务器关闭，重新连接再试一次
+            if (!reused || attempt > 0 || g_cancellable_is_cancelled(cancellable))
+            {
+                g_propagate_error(error, err);
+                break;
+            }
+            g_clear_error(&err);
+        }
+        g_uri_unref(parsed);
+        if (!ok)
+            break;
+
+        if (resp.status >= 300 && resp.status < 400 && resp.location != NULL)
+        {
+            gchar *next = g_uri_resolve_relative(target, resp.location, G_URI_FLAGS_NONE, error);
+
+            // 没有读取重定向响应的响应体，连接不能再用
+            close_connection(client);
+            g_free(resp.location);
+            g_free(target);
+            target = next;
+            ok = FALSE;
+            if (target == NULL)
+                break;
+            if (redirects == MAX_REDIRECTS)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Too many redirects for %s", uri);
+                break;
+            }
+            continue;
+        }
+        g_free(resp.location);
+
+        if (resp.status != 200 && resp.status != 206)
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "HTTP %u for %s", resp.status, target);
+            close_connection(client);
+            ok = FALSE;
+            break;
+        }
+        // 206 的数据必须从请求的 offset 开始：对齐到块或者返回整个资源的服务器会让调用者把数据写到错误的位置
+        if (resp.status == 206 && (resp.range_start != (gint64)offset ||
+                                   (resp.content_length >= 0 && resp.content_length != resp.range_end - resp.range_start + 1)))
+        {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "Unexpected Content-Range for %s: wanted offset %" G_GUINT64_FORMAT ", got %" G_GINT64_FORMAT "-%" G_GINT64_FORMAT,
+                        target, offset, resp.range_start, resp.range_end);
+            close_connection(client);
+            ok = FALSE;
+            break;
+        }
+        *ranged = resp.status == 206;
+        *total = *ranged ? resp.total : resp.chunked ? -1 : resp.content_length;
+        // 响应体由 http_client_read() 读取；既没有长度也不是 chunked 时读到连接关闭为止
+        client->in_body = TRUE;
+        client->chunked = resp.chunked;
+        client->chunk_crlf = FALSE;
+        client->remaining = resp.chunked ? 0 : resp.content_length;
+        client->close_after = resp.close || (!resp.chunked && resp.content_length < 0);
+        if (strcmp(target, uri) != 0)
+        {
+            g_free(client->redirect_from);
+            g_free(client->redirect_to);
+            client->redirect_from = g_strdup(uri);
+            client->redirect_to = g_strdup(target);
+        }
+        break;
+    }
+    g_free(target);
+    return ok;
+}
+
+/* 响应体读完：不能保持的连接在这里关闭 */
+static gssize
+finish_body(HttpClient *client)
+{
+    client->in_body = FALSE;
+    if (client->close_after)
+        close_connection(client);
+    return 0;
+}
+
+/* chunked：读取下一块的长度行（以及上一块之后的空行），最后一块之后读完 trailer */
+static gboolean
+next_chunk(HttpClient *client, GCancellable *cancellable, GError **error)
+{
+    gchar *line;
+
+    if (client->chunk_crlf)
+    {
+        if ((line = read_line(client, cancellable, error)) == NULL)
+            return FALSE;
+        g_free(line);
+    }
+    if ((line = read_line(client, cancellable, error)) == NULL)
+        return FALSE;
+    client->remaining = (gint64)g_ascii_strtoull(line, NULL, 16);
+    client->chunk_crlf = TRUE;
+    g_free(line);
+    if (client->remaining > 0)
+        return TRUE;
+    // 长度为 0 的块之后是可选的 trailer 和一个空行
+    while ((line = read_line(client, cancellable, error)) != NULL && line[0] != '\0')
+        g_free(line);
+    g_free(line);
+    return line != NULL;
+}
+
+gssize
+http_client_read(HttpClient *client, guint8 *data, gsize length, GCancellable *cancellable, GError **error)
+{
+    gsize want = length;
+    gssize n;
+
+    if (!client->in_body || length == 0)
+        return 0;
+    if (client->chunked && client->remaining == 0)
+    {
+        if (!next_chunk(client, cancellable, error))
+        {
+            close_connection(client);
+            return -1;
+        }
+        if (client->remaining == 0)
+            return finish_body(client);
+    }
+    if (!client->chunked && client->remaining == 0)
+        return finish_body(client);
+    if (client->remaining > 0)
+        want = (gsize)MIN((guint64)length, (guint64)client->remaining);
+
+    n = g_input_stream_read(G_INPUT_STREAM(client->in), data, want, cancellable, error);
+    if (n < 0)
+    {
+        close_connection(client);
+        return -1;
+    }
+    if (n == 0)
+    {
+        if (client->remaining < 0)
+            return finish_body(client);
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "Connection closed with %" G_GINT64_FORMAT " bytes missing",
+                    client->remaining);
+        close_connection(client);
+        return -1;
+    }
+    if (client->remaining > 0)
+        client->remaining -= n;
+    return n;
+}
+
+void
+http_client_abort(HttpClient *client)
+{
+    // 没有读完的响应体还在连接中，这个连接不能再用
+    if (client->in_body)
+        close_connection(client);
+}
+
+void
+http_client_free(HttpClient *client)
+{
+    close_connection(client);
+    g_object_unref(client->socket_client);
+    g_free(client->redirect_from);
+    g_free(client->redirect_to);
+    g_free(client);
+}
@@ -0,0 +1,39 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <gio/gio.h>
+
+/**
+ * 最小的 HTTP/1.1 客户端（只用 GIO，不依赖 libsoup）
+ *
+ * 只实现缓存源需要的部分：
+ * - GET 一个字节范围（Range: bytes=a-b），响应体由调用者分段读取（不在内存中缓冲整个响应体）
+ * - http 和 https（GSocketClient 的 TLS 支持）
+ * - keep-alive：同一个服务器的连续请求复用连接，连接已经被服务器关闭时重新连接一次
+ * - 重定向（最多 MAX_REDIRECTS 次），记住重定向的目标，之后的请求直接发给目标
+ * - Content-Length 或 chunked 的响应体
+ *
+ * 所有调用都是阻塞的，cancellable 被取消时立即返回（GstBaseSrc 的 unlock）。
+ */
+
+typedef struct _HttpClient HttpClient;
+
+HttpClient *http_client_new(void);
+/**
+ * 请求 uri 的 [offset, offset + size)，size 为 0 表示到末尾，读完响应头后返回；响应体用 http_client_read() 读取。
+ *
+ * total：资源的总大小，未知时为 -1（chunked 或者直播流）
+ * ranged：服务器是否按范围返回（206）；为 FALSE 时服务器不支持 Range，响应体是从 0 开始的整个资源
+ *
+ * 206 响应的 Content-Range 必须从 offset 开始（长度与 Content-Length 一致），否则返回错误，
+ * 因此 ranged 为 TRUE 时响应体总是从 offset 开始。上一个响应体没有读完时先关闭连接。
+ */
+gboolean http_client_open(HttpClient *client, const gchar *uri, guint64 offset, guint64 size,
+                          gint64 *total, gboolean *ranged, GCancellable *cancellable, GError **error);
+/* 读取最多 length 字节的响应体，返回读到的字节数；0 表示响应体已经读完，-1 表示出错（连接被关闭） */
+gssize http_client_read(HttpClient *client, guint8 *data, gsize length, GCancellable *cancellable, GError **error);
+/* 放弃没有读完的响应体（关闭连接） */
+void http_client_abort(HttpClient *client);
+void http_client_free(HttpClient *client);
+
+#endif /* HTTP_CLIENT_H */
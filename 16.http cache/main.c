@@ -0,0 +1,256 @@
+#include <gst/gst.h>
+#include <string.h>
+
+#include "gstcachehttpsrc.h"
+#include "http_cache.h"
+#include "http_server.h"
+
+/**
+ * 带磁盘缓存的 HTTP 源：冷启动、热启动对比
+ *
+ * 用 playbin 打开同一个 URI 三次，每次都测量：
+ * - startup：设置 PAUSED 到 ASYNC_DONE（打开、探测类型、preroll 第一帧）的时间
+ * - seek：PAUSED 状态下 flush seek 到中间位置，到 ASYNC_DONE 的时间
+ * - 从网络下载的字节数、HTTP 请求数
+ *
+ *   no cache  souphttpsrc（cachehttpsrc 的 rank 临时设为 NONE），作为基准
+ *   cold      cachehttpsrc，先删除这个 URI 的缓存
+ *   warm      cachehttpsrc，使用 cold 留下的缓存
+ *
+ * --serve=FILE 在本地启动一个 HTTP 服务器（common/http_server.c）提供这个文件，代替远程服务器：
+ * 结果不受网络波动影响，服务器统计的发送字节数是实际传输量的基准（souphttpsrc 没有自己的统计）；
+ * --rate 限制服务器的发送速率，模拟慢速网络。
+ */
+
+#define DEFAULT_URI "https://www.freedesktop.org/software/gstreamer-sdk/data/media/sintel_trailer-480p.webm"
+#define TIMEOUT (60 * GST_SECOND)
+
+/* 命令行选项，source-setup 中使用 */
+typedef struct _Options
+{
+    gchar *cache_dir;
+    gint readahead;
+} Options;
+
+/* 一次运行的结果 */
+typedef struct _RunResult
+{
+    GstClockTime startup, seek;     /* GST_CLOCK_TIME_NONE 表示失败 */
+    gboolean have_stats;            /* 源是 cachehttpsrc，以下三项有效 */
+    guint64 fetched, served;
+    guint requests;
+    guint64 server_bytes;           /* --serve：服务器发送的字节数 */
+    guint server_requests;
+} RunResult;
+
+/* playbin 创建源之后、启动之前调用：记下源，设置缓存目录 */
+static void
+source_setup(GstElement *playbin, GstElement *source, GstElement **out)
+{
+    const Options *options = g_object_get_data(G_OBJECT(playbin), "options");
+
+    *out = gst_object_ref(source);
+    if (!G_TYPE_CHECK_INSTANCE_TYPE(source, GST_TYPE_CACHE_HTTP_SRC))
+        return;
+    if (options->cache_dir != NULL)
+        g_object_set(source, "cache-dir", options->cache_dir, NULL);
+    if (options->readahead > 0)
+        g_object_set(source, "readahead", (guint)options->readahead * 1024, NULL);
+}
+
+/* 等待 ASYNC_DONE，返回从 start 开始的时间；出错或超时返回 GST_CLOCK_TIME_NONE */
+static GstClockTime
+wait_async_done(GstBus *bus, GstClockTime start)
+{
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, TIMEOUT, GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_ERROR);
+    GstClockTime elapsed = gst_util_get_timestamp() - start;
+    GError *err;
+    gchar *debug_info;
+
+    if (msg == NULL)
+    {
+        g_printerr("Timed out.\n");
+        return GST_CLOCK_TIME_NONE;
+    }
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+    {
+        gst_message_parse_error(msg, &err, &debug_info);
+        g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+        g_printerr("Debugging information: %s\n", debug_info ? debug_info : "none");
+        g_clear_error(&err);
+        g_free(debug_info);
+        elapsed = GST_CLOCK_TIME_NONE;
+    }
+    gst_message_unref(msg);
+    return elapsed;
+}
+
+static void
+run_once(const gchar *uri, Options *options, HttpServer *server, RunResult *r)
+{
+    GstElement *playbin, *source = NULL;
+    GstBus *bus;
+    GstClockTime start;
+    gint64 duration;
+    guint64 server_bytes = server ? http_server_get_bytes_sent(server) : 0;
+    guint server_requests = server ? http_server_get_requests(server) : 0;
+
+    memset(r, 0, sizeof(*r));
+    r->startup = r->seek = GST_CLOCK_TIME_NONE;
+
+    // 不显示、不出声：fakesink 仍然参与 preroll，打开和 seek 的过程与真正的 sink 相同
+    playbin = gst_element_factory_make("playbin", NULL);
+    g_object_set(playbin, "uri", uri,
+                 "video-sink", gst_element_factory_make("fakesink", NULL),
+                 "audio-sink", gst_element_factory_make("fakesink", NULL), NULL);
+    g_object_set_data(G_OBJECT(playbin), "options", options);
+    g_signal_connect(playbin, "source-setup", G_CALLBACK(source_setup), &source);
+    bus = gst_element_get_bus(playbin);
+
+    start = gst_util_get_timestamp();
+    if (gst_element_set_state(playbin, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE)
+        r->startup = wait_async_done(bus, start);
+    if (GST_CLOCK_TIME_IS_VALID(r->startup) && gst_element_query_duration(playbin, GST_FORMAT_TIME, &duration))
+    {
+        // 跳到中间：cold 时需要 Range 请求下载新的位置，warm 时直接从缓存读取
+        start = gst_util_get_timestamp();
+        if (gst_element_seek_simple(playbin, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, duration / 2))
+            r->seek = wait_async_done(bus, start);
+    }
+    gst_element_set_state(playbin, GST_STATE_NULL);
+
+    // 统计在 start 时清零，stop 之后仍然可以读取
+    if (source != NULL && G_TYPE_CHECK_INSTANCE_TYPE(source, GST_TYPE_CACHE_HTTP_SRC))
+    {
+        g_object_get(source, "bytes-fetched", &r->fetched, "bytes-served", &r->served, "requests", &r->requests, NULL);
+        r->have_stats = TRUE;
+    }
+    if (server != NULL)
+    {
+        r->server_bytes = http_server_get_bytes_sent(server) - server_bytes;
+        r->server_requests = http_server_get_requests(server) - server_requests;
+    }
+    if (source != NULL)
+        gst_object_unref(source);
+    gst_object_unref(bus);
+    gst_object_unref(playbin);
+}
+
+static void
+print_time(GstClockTime t)
+{
+    if (GST_CLOCK_TIME_IS_VALID(t))
+        g_print(" %11.1f", t / 1e6);
+    else
+        g_print(" %11s", "failed");
+}
+
+static void
+print_result(const gchar *run, const gchar *source, const RunResult *r, gboolean have_server)
+{
+    g_print("%-9s %-13s", run, source);
+    print_time(r->startup);
+    print_time(r->seek);
+    if (r->have_stats)
+        g_print(" %12.1f %12.1f %9u", r->fetched / 1024.0, r->served / 1024.0, r->requests);
+    else
+        g_print(" %12s %12s %9s", "-", "-", "-");
+    if (have_server)
+        g_print(" %12.1f %9u", r->server_bytes / 1024.0, r->server_requests);
+    g_print("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Options options = {0};
+    gchar *uri = NULL, *serve = NULL, *cache_dir;
+    gint rate = 0;
+    HttpServer *server = NULL;
+    GstPluginFeature *feature;
+    GstElementFactory *soup;
+    RunResult result;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"uri", 0, 0, G_OPTION_ARG_STRING, &uri, "http(s) URI to open (default: the Sintel trailer)", "URI"},
+        {"serve", 0, 0, G_OPTION_ARG_FILENAME, &serve, "Serve FILE from a local stand-in HTTP server instead", "FILE"},
+        {"rate", 0, 0, G_OPTION_ARG_INT, &rate, "Throttle the local server to KB/s per connection", "KB"},
+        {"cache-dir", 0, 0, G_OPTION_ARG_FILENAME, &options.cache_dir, "Cache directory", "DIR"},
+        {"readahead", 0, 0, G_OPTION_ARG_INT, &options.readahead, "Minimum KB per HTTP request", "KB"},
+        {NULL}};
+
+    context = g_option_context_new("- HTTP disk cache cold/warm startup");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+
+    // 元素直接编译在程序中；编译成插件时用 GST_PLUGIN_PATH 加载，见 plugin.c
+    cache_http_src_register(NULL);
+    feature = GST_PLUGIN_FEATURE(gst_element_factory_find("cachehttpsrc"));
+
+    if (serve != NULL)
+    {
+        gchar *root = g_path_get_dirname(serve), *name = g_path_get_basename(serve);
+
+        server = http_server_new(root, 0, &error);
+        g_free(root);
+        if (server == NULL)
+        {
+            g_printerr("Could not start the local server: %s\n", error->message);
+            g_clear_error(&error);
+            g_free(name);
+            return -1;
+        }
+        http_server_set_rate(server, (guint64)MAX(rate, 0) * 1024);
+        g_free(uri);
+        uri = http_server_get_uri(server, name);
+        g_free(name);
+    }
+    if (uri == NULL)
+        uri = g_strdup(DEFAULT_URI);
+    cache_dir = options.cache_dir ? g_strdup(options.cache_dir) : http_cache_default_dir();
+
+    g_print("URI: %s", uri);
+    if (server != NULL)
+        g_print(" (local server%s)", rate > 0 ? ", throttled" : "");
+    g_print("\ncache: %s\n\n", cache_dir);
+    g_print("%-9s %-13s %11s %11s %12s %12s %9s", "run", "source", "startup-ms", "seek-ms", "fetched-KB", "served-KB", "requests");
+    if (server != NULL)
+        g_print(" %12s %9s", "server-KB", "srv-reqs");
+    g_print("\n");
+
+    /* 基准：souphttpsrc */
+    soup = gst_element_factory_find("souphttpsrc");
+    if (soup != NULL)
+    {
+        gst_plugin_feature_set_rank(feature, GST_RANK_NONE);
+        run_once(uri, &options, server, &result);
+        print_result("no cache", "souphttpsrc", &result, server != NULL);
+        gst_plugin_feature_set_rank(feature, GST_RANK_PRIMARY + 100);
+        gst_object_unref(soup);
+    }
+
+    /* 冷启动：删除缓存 */
+    http_cache_remove(cache_dir, uri);
+    run_once(uri, &options, server, &result);
+    print_result("cold", "cachehttpsrc", &result, server != NULL);
+
+    /* 热启动 */
+    run_once(uri, &options, server, &result);
+    print_result("warm", "cachehttpsrc", &result, server != NULL);
+
+    if (server != NULL)
+        http_server_free(server);
+    gst_object_unref(feature);
+    g_free(cache_dir);
+    g_free(options.cache_dir);
+    g_free(serve);
+    g_free(uri);
+    return 0;
+}
@@ -0,0 +1,21 @@
+#include <gst/gst.h>
+
+#include "gstcachehttpsrc.h"
+
+/**
+ * 把 cachehttpsrc 编译成插件（libgstcachehttpsrc.so），任何示例都可以通过环境变量加载，不需要修改代码：
+ *     GST_PLUGIN_PATH=../16.http\ cache ../01.helloworld/main.out
+ */
+
+static gboolean
+plugin_init(GstPlugin *plugin)
+{
+    return cache_http_src_register(plugin);
+}
+
+#define PACKAGE "gstreamer-demos"
+#define VERSION "1.0"
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, cachehttpsrc,
+                  "HTTP source with a block-based disk cache", plugin_init, VERSION, "LGPL", PACKAGE,
+                  "https://github.com/YiguiDing/gstreamer-demos")
@@ -0,0 +1,595 @@
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+#include <string.h>
+
+#include "media_files.h"
+
+/**
+ * 无缝播放列表（gapless）
+ *
+ * 01 示例播放一个 URI，EOS 之后就退出；要播放列表只能每一项重新创建 pipeline，每次都要付出完整的启动代价
+ * （创建元素、打开文件、探测类型、preroll），两项之间有明显的空隙。
+ *
+ * playbin 在当前一项的数据全部读完（解复用器 EOS，解码和 sink 中还有排队的数据）时发出 about-to-finish 信号，
+ * 在信号中设置下一项的 uri，playbin 立即开始打开、解码下一项，接在当前一项的后面播放，running time 连续：
+ *
+ * - 解析：当前一项开始播放（STREAM_START 消息）时，用 GstDiscoverer 异步探测下一项，无法播放的文件提前跳过
+ *   （并继续探测它之后的项）；来不及探测的坏文件播放时出错，跳过这一项、从下一项重新创建 playbin，不中断整个列表
+ * - 预先 preroll：about-to-finish（流线程）中设置 uri，下一项在当前一项播放完之前就已经解码好
+ *
+ * 测量（音频 sink 的 sink pad 上的探针）：
+ * - gap：新一项的第一个 buffer 的 running time - 上一项最后一个 buffer 结束的 running time
+ * - ahead：新一项的第一个 buffer 到达 sink 时离它应该播放的时刻还有多久（负数表示迟到，会听到空隙）
+ *
+ * --mode=rebuild 是对照：每一项 EOS 之后销毁 playbin、重新创建（01 示例的做法），
+ * 测量重新创建到 PLAYING 的时间（rebuild）和上一项 EOS 到下一项 PLAYING 的空隙。
+ */
+
+#define RESOLVE_TIMEOUT 5 /* 探测下一项的超时（秒） */
+
+typedef enum
+{
+    ITEM_UNRESOLVED,
+    ITEM_RESOLVING,
+    ITEM_OK,
+    ITEM_BAD /* 无法播放，跳过 */
+} ItemState;
+
+typedef struct _Item
+{
+    gchar *uri;
+    ItemState state;
+    GstClockTime duration;
+} Item;
+
+/* Structure to contain all our information, so we can pass it to callbacks */
+typedef struct _Player
+{
+    GstElement *playbin, *audio_sink;
+    GstBus *bus;
+    GMainLoop *loop;
+    gboolean gapless; /* FALSE：每一项重新创建 playbin */
+    gboolean fake;    /* 使用 fakesink（sync=true），不需要音频/视频设备 */
+
+    GMutex lock; /* 保护以下字段：about-to-finish 和探针在流线程中调用 */
+    Item *items;
+    guint n_items;
+    gint current; /* 正在播放的项 */
+    gint pending; /* about-to-finish 中设置的下一项，-1 表示没有 */
+    gint failed;  /* 出错、等待跳过的项，-1 表示没有（主线程） */
+    GstDiscoverer *discoverer;
+
+    /* 音频 sink pad 上的测量（流线程） */
+    gchar *stream_id;        /* 当前的 stream-id */
+    gboolean new_track;      /* 收到新的 STREAM_START，下一个 buffer 是新一项的第一个 buffer */
+    GstClockTime last_end;   /* 上一个 buffer 结束的 running time */
+    GArray *gaps, *aheads;   /* GstClockTimeDiff */
+
+    /* --mode=rebuild */
+    gint64 eos_time;         /* 上一项 EOS 的时刻（单调时钟，微秒），0 表示没有 */
+    gint64 rebuild_start;    /* 开始重新创建的时刻 */
+    GArray *rebuilds, *rebuild_gaps;
+} Player;
+
+static gboolean handle_message(GstBus *bus, GstMessage *msg, Player *p);
+static void resolve_next(Player *p);
+
+/* from 之后第一个可以播放（已经解析为 OK，或者还没有解析）的项，没有时返回 -1；调用者持有 p->lock */
+static gint
+next_playable(Player *p, gint from)
+{
+    guint i;
+
+    for (i = from + 1; i < p->n_items; i++)
+    {
+        if (p->items[i].state != ITEM_BAD)
+            return i;
+    }
+    return -1;
+}
+
+/* 探测结果（主线程） */
+static void
+on_discovered(GstDiscoverer *discoverer, GstDiscovererInfo *info, GError *err, Player *p)
+{
+    const gchar *uri = gst_discoverer_info_get_uri(info);
+    GstDiscovererResult result = gst_discoverer_info_get_result(info);
+    guint i;
+
+    gboolean bad = FALSE;
+
+    g_mutex_lock(&p->lock);
+    for (i = 0; i < p->n_items; i++)
+    {
+        if (p->items[i].state != ITEM_RESOLVING || strcmp(p->items[i].uri, uri) != 0)
+            continue;
+        if (result == GST_DISCOVERER_OK)
+        {
+            p->items[i].state = ITEM_OK;
+            p->items[i].duration = gst_discoverer_info_get_duration(info);
+        }
+        else
+        {
+            p->items[i].state = ITEM_BAD;
+            bad = TRUE;
+            g_print("Skipping %s: %s\n", uri, err ? err->message : "not playable");
+        }
+    }
+    g_mutex_unlock(&p->lock);
+    // 下一项无法播放：继续探测它之后的项，连续的多个坏文件也会被提前跳过
+    if (bad)
+        resolve_next(p);
+}
+
+/* 探测当前一项之后第一个还没有解析的项（跳过已知无法播放的项） */
+static void
+resolve_next(Player *p)
+{
+    gint next;
+    gchar *uri = NULL;
+
+    g_mutex_lock(&p->lock);
+    next = next_playable(p, p->current);
+    if (next >= 0 && p->items[next].state == ITEM_UNRESOLVED)
+    {
+        p->items[next].state = ITEM_RESOLVING;
+        uri = g_strdup(p->items[next].uri);
+    }
+    g_mutex_unlock(&p->lock);
+    if (uri != NULL && !gst_discoverer_discover_uri_async(p->discoverer, uri))
+    {
+        // 探测没有开始：不知道能否播放，按可以播放处理
+        g_mutex_lock(&p->lock);
+        p->items[next].state = ITEM_UNRESOLVED;
+        g_mutex_unlock(&p->lock);
+    }
+    g_free(uri);
+}
+
+/* 当前一项的数据已经全部读完（流线程）：设置下一项，playbin 立即开始打开、解码 */
+static void
+about_to_finish(GstElement *playbin, Player *p)
+{
+    gint next;
+
+    g_mutex_lock(&p->lock);
+    next = next_playable(p, p->pending >= 0 ? p->pending : p->current);
+    if (next >= 0)
+    {
+        p->pending = next;
+        g_object_set(playbin, "uri", p->items[next].uri, NULL);
+    }
+    g_mutex_unlock(&p->lock);
+}
+
+/* 音频 sink 的 sink pad 上的探针（流线程）：测量两项之间的空隙 */
+static GstPadProbeReturn
+audio_probe(GstPad *pad, GstPadProbeInfo *info, Player *p)
+{
+    GstEvent *event;
+    GstBuffer *buffer;
+    GstSegment segment;
+    GstClock *clock;
+    GstClockTime rt, latency;
+    GstClockTimeDiff gap, ahead;
+    const gchar *stream_id;
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+    {
+        event = GST_PAD_PROBE_INFO_EVENT(info);
+        g_mutex_lock(&p->lock);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_STREAM_START)
+        {
+            gst_event_parse_stream_start(event, &stream_id);
+            if (p->stream_id != NULL && g_strcmp0(p->stream_id, stream_id) != 0)
+                p->new_track = TRUE;
+            g_free(p->stream_id);
+            p->stream_id = g_strdup(stream_id);
+        }
+        else if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+        {
+            // seek 之后 running time 重新开始
+            p->last_end = GST_CLOCK_TIME_NONE;
+        }
+        g_mutex_unlock(&p->lock);
+        return GST_PAD_PROBE_OK;
+    }
+
+    buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (event == NULL || !GST_BUFFER_PTS_IS_VALID(buffer))
+    {
+        if (event != NULL)
+            gst_event_unref(event);
+        return GST_PAD_PROBE_OK;
+    }
+    gst_event_copy_segment(event, &segment);
+    gst_event_unref(event);
+    rt = gst_segment_to_running_time(&segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+
+    g_mutex_lock(&p->lock);
+    if (p->new_track && GST_CLOCK_TIME_IS_VALID(rt) && GST_CLOCK_TIME_IS_VALID(p->last_end))
+    {
+        gap = GST_CLOCK_DIFF(p->last_end, rt);
+        // 这个 buffer 应该在 base_time + running time + latency 时播放
+        ahead = 0;
+        clock = gst_element_get_clock(p->audio_sink);
+        if (clock != NULL)
+        {
+            latency = gst_pipeline_get_latency(GST_PIPELINE(p->playbin));
+            ahead = GST_CLOCK_DIFF(gst_clock_get_time(clock),
+                                   gst_element_get_base_time(p->audio_sink) + rt +
+                                       (GST_CLOCK_TIME_IS_VALID(latency) ? latency : 0));
+            gst_object_unref(clock);
+        }
+        g_array_append_val(p->gaps, gap);
+        g_array_append_val(p->aheads, ahead);
+        g_print("Transition: gap %.3f ms, first buffer %.1f ms %s\n", gap / 1e6,
+                ABS(ahead) / 1e6, ahead >= 0 ? "ahead of time" : "late");
+    }
+    p->new_track = FALSE;
+    if (GST_CLOCK_TIME_IS_VALID(rt))
+    {
+        p->last_end = rt;
+        if (GST_BUFFER_DURATION_IS_VALID(buffer))
+            p->last_end = gst_segment_to_running_time(&segment, GST_FORMAT_TIME,
+                                                      GST_BUFFER_PTS(buffer) + GST_BUFFER_DURATION(buffer));
+    }
+    g_mutex_unlock(&p->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstElement *
+make_sink(Player *p, const gchar *factory, const gchar *name)
+{
+    GstElement *sink = gst_element_factory_make(p->fake ? "fakesink" : factory, name);
+
+    // sync=true：fakesink 也按时钟播放，空隙与真正的 sink 相同
+    if (sink != NULL && p->fake)
+        g_object_set(sink, "sync", TRUE, NULL);
+    return sink;
+}
+
+/* 创建 playbin 并开始播放第 index 项 */
+static gboolean
+start_item(Player *p, gint index)
+{
+    GstPad *pad;
+    GstElement *video_sink;
+
+    p->playbin = gst_element_factory_make("playbin", NULL);
+    // 自己创建音频 sink，以便在它的 sink pad 上测量空隙
+    p->audio_sink = make_sink(p, "autoaudiosink", "audio_sink");
+    video_sink = make_sink(p, "autovideosink", "video_sink");
+    if (!p->playbin || !p->audio_sink || !video_sink)
+    {
+        g_printerr("Not all elements could be created.\n");
+        return FALSE;
+    }
+    g_object_set(p->playbin, "uri", p->items[index].uri, "audio-sink", p->audio_sink, "video-sink", video_sink, NULL);
+    pad = gst_element_get_static_pad(p->audio_sink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                      (GstPadProbeCallback)audio_probe, p, NULL);
+    gst_object_unref(pad);
+    if (p->gapless)
+        g_signal_connect(p->playbin, "about-to-finish", G_CALLBACK(about_to_finish), p);
+
+    g_mutex_lock(&p->lock);
+    p->current = index;
+    p->pending = -1;
+    p->failed = -1;
+    g_free(p->stream_id);
+    p->stream_id = NULL;
+    p->new_track = FALSE;
+    p->last_end = GST_CLOCK_TIME_NONE;
+    g_mutex_unlock(&p->lock);
+
+    p->bus = gst_element_get_bus(p->playbin);
+    gst_bus_add_watch(p->bus, (GstBusFunc)handle_message, p);
+    if (gst_element_set_state(p->playbin, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        g_printerr("Unable to set the pipeline to the playing state.\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+stop_item(Player *p)
+{
+    if (p->playbin == NULL)
+        return;
+    if (p->bus != NULL)
+    {
+        gst_bus_remove_watch(p->bus);
+        gst_object_unref(p->bus);
+    }
+    gst_element_set_state(p->playbin, GST_STATE_NULL);
+    gst_object_unref(p->playbin);
+    p->playbin = p->audio_sink = NULL;
+    p->bus = NULL;
+}
+
+/* --mode=rebuild：上一项 EOS 之后销毁 playbin，为下一项重新创建（在主循环中调用，不在 playbin 自己的总线回调中销毁它） */
+static gboolean
+rebuild_next(Player *p)
+{
+    gint next;
+
+    g_mutex_lock(&p->lock);
+    next = next_playable(p, p->current);
+    g_mutex_unlock(&p->lock);
+    if (next < 0)
+    {
+        g_main_loop_quit(p->loop);
+        return G_SOURCE_REMOVE;
+    }
+    p->rebuild_start = g_get_monotonic_time();
+    stop_item(p);
+    if (!start_item(p, next))
+        g_main_loop_quit(p->loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* 出错的元素属于哪一项：向上找到带有 uri 属性的 uridecodebin/urisourcebin，找不到时是 pending（还没有开始播放的下一项）或当前项 */
+static gint
+failed_item(Player *p, GstObject *src)
+{
+    GstObject *obj = gst_object_ref(src), *parent;
+    gchar *uri = NULL;
+    gint index = -1;
+    guint i;
+
+    while (obj != NULL && obj != GST_OBJECT(p->playbin))
+    {
+        if (uri == NULL && GST_IS_ELEMENT(obj) && g_object_class_find_property(G_OBJECT_GET_CLASS(obj), "uri") != NULL)
+            g_object_get(obj, "uri", &uri, NULL);
+        parent = gst_object_get_parent(obj);
+        gst_object_unref(obj);
+        obj = parent;
+    }
+    if (obj != NULL)
+        gst_object_unref(obj);
+
+    g_mutex_lock(&p->lock);
+    for (i = 0; uri != NULL && i < p->n_items && index < 0; i++)
+    {
+        if (strcmp(p->items[i].uri, uri) == 0)
+            index = i;
+    }
+    if (index < 0)
+        index = p->pending >= 0 ? p->pending : p->current;
+    g_mutex_unlock(&p->lock);
+    g_free(uri);
+    return index;
+}
+
+/* 出错的项标记为无法播放，从它之后的第一个可以播放的项重新创建 playbin（出错之后 playbin 不能继续使用） */
+static gboolean
+skip_failed(Player *p)
+{
+    gint next;
+
+    g_mutex_lock(&p->lock);
+    p->items[p->failed].state = ITEM_BAD;
+    next = next_playable(p, p->failed);
+    g_mutex_unlock(&p->lock);
+    stop_item(p);
+    if (next < 0 || !start_item(p, next))
+        g_main_loop_quit(p->loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* Process messages from GStreamer */
+static gboolean
+handle_message(GstBus *bus, GstMessage *msg, Player *p)
+{
+    GError *err;
+    gchar *debug_info;
+    GstState old_state, new_state, pending_state;
+    gint64 now = g_get_monotonic_time(), rebuild, gap;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &err, &debug_info);
+        g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+        g_printerr("Debugging information: %s\n", debug_info ? debug_info : "none");
+        g_clear_error(&err);
+        g_free(debug_info);
+        // 一个坏文件不中断整个列表：跳过出错的项（同一次出错可能有多个 ERROR 消息，只处理第一个）
+        if (p->failed < 0)
+        {
+            p->failed = failed_item(p, GST_MESSAGE_SRC(msg));
+            p->rebuild_start = 0;
+            g_print("Skipping %s\n", p->items[p->failed].uri);
+            g_idle_add((GSourceFunc)skip_failed, p);
+        }
+        break;
+    case GST_MESSAGE_EOS:
+        if (p->gapless)
+        {
+            // about-to-finish 中没有设置下一项：列表播放完
+            g_print("End of playlist.\n");
+            g_main_loop_quit(p->loop);
+        }
+        else
+        {
+            p->eos_time = now;
+            g_idle_add((GSourceFunc)rebuild_next, p);
+        }
+        break;
+    case GST_MESSAGE_STREAM_START:
+        // 新的一项开始播放（gapless 模式下是 about-to-finish 中设置的那一项）
+        g_mutex_lock(&p->lock);
+        if (p->pending >= 0)
+        {
+            p->current = p->pending;
+            p->pending = -1;
+        }
+        g_mutex_unlock(&p->lock);
+        g_print("Now playing [%d/%u] %s", p->current + 1, p->n_items, p->items[p->current].uri);
+        // 时长来自解析时的探测（第一项没有探测）
+        if (GST_CLOCK_TIME_IS_VALID(p->items[p->current].duration))
+            g_print(" (%.1f s)", p->items[p->current].duration / 1e9);
+        g_print("\n");
+        resolve_next(p);
+        break;
+    case GST_MESSAGE_STATE_CHANGED:
+        gst_message_parse_state_changed(msg, &old_state, &new_state, &pending_state);
+        if (GST_MESSAGE_SRC(msg) == GST_OBJECT(p->playbin) && new_state == GST_STATE_PLAYING && p->rebuild_start > 0)
+        {
+            rebuild = now - p->rebuild_start;
+            gap = now - p->eos_time;
+            g_array_append_val(p->rebuilds, rebuild);
+            g_array_append_val(p->rebuild_gaps, gap);
+            g_print("Transition: rebuild %.1f ms, gap %.1f ms\n", rebuild / 1e3, gap / 1e3);
+            p->rebuild_start = 0;
+        }
+        break;
+    default:
+        break;
+    }
+
+    /* We want to keep receiving messages */
+    return TRUE;
+}
+
+/* 平均值和最大值（values 的单位为 scale 分之一毫秒） */
+static void
+print_stat(const gchar *name, GArray *values, gdouble scale, gboolean use_min)
+{
+    gdouble sum = 0, extreme = 0, v;
+    guint i;
+
+    for (i = 0; i < values->len; i++)
+    {
+        v = g_array_index(values, gint64, i) / scale;
+        sum += v;
+        if (i == 0 || (use_min ? v < extreme : v > extreme))
+            extreme = v;
+    }
+    if (values->len > 0)
+        g_print(", %s avg %.3f ms %s %.3f ms", name, sum / values->len, use_min ? "min" : "max", extreme);
+}
+
+static void
+run_playlist(Player *p, gboolean gapless)
+{
+    p->gapless = gapless;
+    p->eos_time = p->rebuild_start = 0;
+    g_array_set_size(p->gaps, 0);
+    g_array_set_size(p->aheads, 0);
+    g_array_set_size(p->rebuilds, 0);
+    g_array_set_size(p->rebuild_gaps, 0);
+
+    g_print("=== %s ===\n", gapless ? "gapless (about-to-finish)" : "rebuild (new playbin per item)");
+    gst_discoverer_start(p->discoverer);
+    if (start_item(p, 0))
+        g_main_loop_run(p->loop);
+    stop_item(p);
+    gst_discoverer_stop(p->discoverer);
+
+    if (gapless)
+    {
+        g_print("gapless: %u transition(s)", p->gaps->len);
+        print_stat("gap", p->gaps, 1e6, FALSE);
+        print_stat("ahead", p->aheads, 1e6, TRUE);
+    }
+    else
+    {
+        g_print("rebuild: %u transition(s)", p->rebuilds->len);
+        print_stat("gap", p->rebuild_gaps, 1e3, FALSE);
+        print_stat("rebuild", p->rebuilds, 1e3, FALSE);
+    }
+    g_print("\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Player player = {0};
+    GPtrArray *uris;
+    gchar *mode = NULL, *list = NULL;
+    gboolean gapless, rebuild;
+    guint i;
+    GOptionContext *context;
+    GError *error = NULL;
+    GOptionEntry entries[] = {
+        {"mode", 0, 0, G_OPTION_ARG_STRING, &mode, "gapless (default), rebuild or both", "MODE"},
+        {"list", 0, 0, G_OPTION_ARG_FILENAME, &list, "File with one path or URI per line", "FILE"},
+        {"fake", 0, 0, G_OPTION_ARG_NONE, &player.fake, "Play into fakesinks (sync=true) instead of the audio/video devices", NULL},
+        {NULL}};
+
+    context = g_option_context_new("[DIRECTORY|FILE|URI...] - gapless playlist");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("Failed to parse options: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_option_context_free(context);
+    gapless = mode == NULL || g_strcmp0(mode, "gapless") == 0 || g_strcmp0(mode, "both") == 0;
+    rebuild = g_strcmp0(mode, "rebuild") == 0 || g_strcmp0(mode, "both") == 0;
+    if (!gapless && !rebuild)
+    {
+        g_printerr("Unknown mode: %s\n", mode);
+        return -1;
+    }
+
+    uris = g_ptr_array_new_with_free_func(g_free);
+    if (list != NULL && !media_files_add_list(uris, list))
+        return -1;
+    for (i = 1; i < (guint)argc; i++)
+        media_files_add(uris, argv[i]);
+    if (uris->len == 0)
+    {
+        g_printerr("No input files. Usage: %s [OPTION...] DIRECTORY|FILE|URI...\n", argv[0]);
+        return -1;
+    }
+
+    gst_pb_utils_init();
+    player.discoverer = gst_discoverer_new(RESOLVE_TIMEOUT * GST_SECOND, &error);
+    if (player.discoverer == NULL)
+    {
+        g_printerr("Could not create the discoverer: %s\n", error->message);
+        g_clear_error(&error);
+        return -1;
+    }
+    g_signal_connect(player.discoverer, "discovered", G_CALLBACK(on_discovered), &player);
+
+    g_mutex_init(&player.lock);
+    player.n_items = uris->len;
+    player.items = g_new0(Item, uris->len);
+    for (i = 0; i < uris->len; i++)
+    {
+        player.items[i].uri = g_ptr_array_index(uris, i);
+        player.items[i].duration = GST_CLOCK_TIME_NONE;
+    }
+    player.gaps = g_array_new(FALSE, FALSE, sizeof(gint64));
+    player.aheads = g_array_new(FALSE, FALSE, sizeof(gint64));
+    player.rebuilds = g_array_new(FALSE, FALSE, sizeof(gint64));
+    player.rebuild_gaps = g_array_new(FALSE, FALSE, sizeof(gint64));
+    player.loop = g_main_loop_new(NULL, FALSE);
+
+    if (gapless)
+        run_playlist(&player, TRUE);
+    if (rebuild)
+        run_playlist(&player, FALSE);
+
+    /* Free resources */
+    g_main_loop_unref(player.loop);
+    g_array_unref(player.gaps);
+    g_array_unref(player.aheads);
+    g_array_unref(player.rebuilds);
+    g_array_unref(player.rebuild_gaps);
+    g_object_unref(player.discoverer);
+    g_mutex_clear(&player.lock);
+    g_free(player.stream_id);
+    g_free(player.items);
+    g_ptr_array_unref(uris);
+    g_free(mode);
+    g_free(list);
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "app_consumer.h"
+
+/* 把一个 sample 的数据交给用户接口，返回用户处理的耗时 */
+static GstClockTime
+consume_sample(AppConsumer *ac, GstSample *sample, gsize *bytes)
+{
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    GstClockTime start;
+
+    if (buffer == NULL || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return 0;
+    // 只读映射：系统内存中的 buffer 直接返回数据指针，不拷贝
+    start = gst_util_get_timestamp();
+    ac->sink->consume(ac->user_data, map.data, map.size, GST_BUFFER_PTS(buffer));
+    start = gst_util_get_timestamp() - start;
+    *bytes += map.size;
+    gst_buffer_unmap(buffer, &map);
+    return start;
+}
+
+/* 取空 appsink 的队列，把所有 sample 交给用户接口（消费者线程） */
+static void
+drain(AppConsumer *ac)
+{
+    GstSample *sample;
+    GstClockTime start = gst_util_get_timestamp(), user_time = 0;
+    guint count = 0;
+    gsize bytes = 0;
+
+    // timeout 为 0：队列为空时立即返回 NULL
+    while ((sample = gst_app_sink_try_pull_sample(ac->app_sink, 0)) != NULL)
+    {
+        user_time += consume_sample(ac, sample, &bytes);
+        gst_sample_unref(sample);
+        count++;
+    }
+
+    g_mutex_lock(&ac->lock);
+    ac->wakeups++;
+    ac->samples += count;
+    ac->bytes += bytes;
+    ac->total_time += gst_util_get_timestamp() - start;
+    ac->user_time += user_time;
+    ac->max_batch = MAX(ac->max_batch, count);
+    g_mutex_unlock(&ac->lock);
+}
+
+/* 消费者线程：等待唤醒，每次取空队列；处理期间入队的 sample 由下一次唤醒一起取出 */
+static gpointer
+consumer_thread(AppConsumer *ac)
+{
+    gboolean eos;
+
+    g_mutex_lock(&ac->lock);
+    while (!ac->stopping)
+    {
+        if (!ac->pending && !ac->eos_pending)
+        {
+            g_cond_wait(&ac->cond, &ac->lock);
+            continue;
+        }
+        eos = ac->eos_pending;
+        ac->pending = ac->eos_pending = FALSE;
+        g_mutex_unlock(&ac->lock);
+
+        drain(ac);
+        if (eos && ac->sink->eos)
+            ac->sink->eos(ac->user_data);
+        g_mutex_lock(&ac->lock);
+    }
+    g_mutex_unlock(&ac->lock);
+    return NULL;
+}
+
+/**
+ * appsink 的 new_sample 回调（流线程）
+ *
+ * 每个 buffer 入队之后同步调用一次，此时队列中只有这一个 sample，在这里取数据每次只能取到一个。
+ * 所以这里只唤醒消费者线程：消费者忙的时候 sample 在队列中积压，下一次唤醒一起取出。
+ */
+static GstFlowReturn
+on_new_sample(GstAppSink *app_sink, gpointer user_data)
+{
+    AppConsumer *ac = user_data;
+
+    g_mutex_lock(&ac->lock);
+    ac->notified++;
+    ac->pending = TRUE;
+    g_cond_signal(&ac->cond);
+    g_mutex_unlock(&ac->lock);
+    return GST_FLOW_OK;
+}
+
+static void
+on_eos(GstAppSink *app_sink, gpointer user_data)
+{
+    AppConsumer *ac = user_data;
+
+    // 用户接口的 eos 在消费者线程中、取空队列之后调用
+    g_mutex_lock(&ac->lock);
+    ac->eos_pending = TRUE;
+    g_cond_signal(&ac->cond);
+    g_mutex_unlock(&ac->lock);
+}
+
+void
+app_consumer_attach(AppConsumer *ac, GstElement *app_sink, const ConsumerSink *sink, gpointer user_data,
+                    guint max_buffers, gboolean drop)
+{
+    GstAppSinkCallbacks callbacks = {0};
+
+    ac->app_sink = GST_APP_SINK(app_sink);
+    ac->sink = sink;
+    ac->user_data = user_data;
+    g_mutex_init(&ac->lock);
+    g_cond_init(&ac->cond);
+    ac->pending = ac->eos_pending = ac->stopping = FALSE;
+    ac->notified = ac->wakeups = ac->samples = ac->bytes = 0;
+    ac->total_time = ac->user_time = 0;
+    ac->max_batch = 0;
+
+    gst_app_sink_set_max_buffers(ac->app_sink, max_buffers);
+    gst_app_sink_set_drop(ac->app_sink, drop);
+    // 注册回调后 appsink 直接调用回调函数，不再发出 new-sample 信号
+    callbacks.eos = on_eos;
+    callbacks.new_sample = on_new_sample;
+    gst_app_sink_set_callbacks(ac->app_sink, &callbacks, ac, NULL);
+    ac->thread = g_thread_new("app-consumer", (GThreadFunc)consumer_thread, ac);
+}
+
+void
+app_consumer_print_stats(AppConsumer *ac, const gchar *prefix)
+{
+    guint64 notified, wakeups, samples, bytes;
+    GstClockTime total_time, user_time;
+    guint max_batch, queued;
+
+    g_mutex_lock(&ac->lock);
+    notified = ac->notified;
+    wakeups = ac->wakeups;
+    samples = ac->samples;
+    bytes = ac->bytes;
+    total_time = ac->total_time;
+    user_time = ac->user_time;
+    max_batch = ac->max_batch;
+    g_mutex_unlock(&ac->lock);
+    // 入队但没有取出的 sample：还在队列中，或者因为 drop 被丢弃了
+    queued = (guint)(notified - MIN(samples, notified));
+
+    g_print("%sappsink consumer: %" G_GUINT64_FORMAT " samples (%" G_GUINT64_FORMAT " bytes) in %" G_GUINT64_FORMAT
+            " wake-ups, max %u per wake-up, %u queued or dropped\n",
+            prefix, samples, bytes, wakeups, max_batch, queued);
+    if (samples > 0)
+        g_print("%sappsink consumer: %.0f ns per sample (%.0f ns pull/map overhead, %.0f ns in sink)\n",
+                prefix, (gdouble)total_time / samples, (gdouble)(total_time - user_time) / samples,
+                (gdouble)user_time / samples);
+}
+
+void
+app_consumer_clear(AppConsumer *ac)
+{
+    if (ac->thread != NULL)
+    {
+        g_mutex_lock(&ac->lock);
+        ac->stopping = TRUE;
+        g_cond_signal(&ac->cond);
+        g_mutex_unlock(&ac->lock);
+        g_thread_join(ac->thread);
+        ac->thread = NULL;
+    }
+    g_cond_clear(&ac->cond);
+    g_mutex_clear(&ac->lock);
+}
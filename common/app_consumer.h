@@ -0,0 +1,61 @@
+#ifndef APP_CONSUMER_H
+#define APP_CONSUMER_H
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+/**
+ * appsink 消费者（回调方式、零拷贝、批量取出）
+ *
+ * 原来的 new_sample() 通过 new-sample 信号触发，再发出 pull-sample 信号取一个 sample，
+ * 每个 buffer 都要经过两次 GObject 信号。这里改为：
+ * - gst_app_sink_set_callbacks() 注册回调，appsink 不发出任何信号（emit-signals 保持 FALSE）
+ * - new_sample 回调在 appsink 的流线程中、每个 buffer 入队之后同步调用，这时队列中只有刚放入的一个 sample；
+ *   所以回调只负责唤醒独立的消费者线程，不在流线程中取数据
+ * - 消费者线程每次被唤醒时用 gst_app_sink_try_pull_sample(sink, 0) 循环取出队列中的所有 sample；
+ *   消费者落后时 sample 在 appsink 的队列中积压，一次唤醒处理一批，队列满时按 max-buffers/drop 阻塞或丢弃
+ * - buffer 以只读方式映射（GST_MAP_READ），数据不拷贝，直接交给用户提供的 ConsumerSink
+ * - 统计每个 sample 的处理耗时，区分 "用户处理" 和 "取出/映射" 两部分
+ */
+
+/* 用户提供的数据接收接口，回调运行在消费者线程中 */
+typedef struct _ConsumerSink
+{
+    /* 处理一个 buffer 的数据（只读，回调返回后数据不再有效） */
+    void (*consume)(gpointer user_data, const guint8 *data, gsize size, GstClockTime pts);
+    /* 收到 EOS（可以为 NULL） */
+    void (*eos)(gpointer user_data);
+} ConsumerSink;
+
+typedef struct _AppConsumer
+{
+    GstAppSink *app_sink;
+    const ConsumerSink *sink; /* 用户接口 */
+    gpointer user_data;       /* 传给用户接口的参数 */
+    GThread *thread;          /* 消费者线程 */
+    GMutex lock;              /* 保护下面的唤醒标志和统计 */
+    GCond cond;               /* 流线程唤醒消费者线程 */
+    gboolean pending;         /* 有新的 sample 入队 */
+    gboolean eos_pending;     /* 收到 EOS，取空队列后通知用户接口 */
+    gboolean stopping;        /* app_consumer_clear()：消费者线程退出 */
+    guint64 notified;         /* new_sample 回调次数（入队的 sample 个数，包括之后被丢弃的） */
+    guint64 wakeups;          /* 消费者线程取数据的次数 */
+    guint64 samples;          /* 取出的 sample 个数 */
+    guint64 bytes;            /* 交给用户接口的字节数 */
+    GstClockTime total_time;  /* 取出 + 映射 + 用户处理的总耗时 */
+    GstClockTime user_time;   /* 用户处理的耗时 */
+    guint max_batch;          /* 一次唤醒取出的最多 sample 个数 */
+} AppConsumer;
+
+/**
+ * 在 app_sink 上注册回调并启动消费者线程。
+ * max_buffers: appsink 内部队列的上限（0 表示不限制）；
+ * drop: 队列满时丢弃最旧的 buffer（TRUE），还是阻塞上游（FALSE，反压会传到 tee 的所有分支）
+ */
+void app_consumer_attach(AppConsumer *ac, GstElement *app_sink, const ConsumerSink *sink, gpointer user_data,
+                         guint max_buffers, gboolean drop);
+void app_consumer_print_stats(AppConsumer *ac, const gchar *prefix);
+/* 停止消费者线程（在 pipeline 停止之后调用） */
+void app_consumer_clear(AppConsumer *ac);
+
+#endif /* APP_CONSUMER_H */
@@ -0,0 +1,295 @@
+#include "bench_report.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* 一个流线程（或主线程） */
+typedef struct _BenchThread
+{
+    gchar *name;             /* 所属元素:pad，例如 audio_queue:src */
+    clockid_t clock;         /* 该线程的 CPU 时钟 */
+    GstClockTime start_cpu;  /* ENTER 时的 CPU 时间（线程池中的线程可能被复用） */
+    GstClockTime cpu;        /* 累计的 CPU 时间 */
+    gboolean running;        /* 还没有收到 LEAVE */
+} BenchThread;
+
+/* 一个 sink 的吞吐量 */
+typedef struct _BenchCounter
+{
+    gchar *label;
+    guint64 buffers;
+    guint64 bytes;
+} BenchCounter;
+
+struct _BenchReport
+{
+    gchar *name;
+    GMutex lock;         /* 保护 threads */
+    GPtrArray *threads;  /* BenchThread */
+    GPtrArray *counters; /* BenchCounter，只由对应 sink 的流线程写入 */
+    BenchThread main;    /* 调用 bench_report_start() 的线程 */
+    gint64 start_time, stop_time;
+    GstClockTime process_cpu;
+};
+
+static GstClockTime
+clock_cpu_time(clockid_t clock)
+{
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return GST_TIMESPEC_TO_TIME(ts);
+}
+
+static void
+bench_thread_free(BenchThread *thread)
+{
+    g_free(thread->name);
+    g_free(thread);
+}
+
+static void
+bench_counter_free(BenchCounter *counter)
+{
+    g_free(counter->label);
+    g_free(counter);
+}
+
+BenchReport *
+bench_report_new(const gchar *name)
+{
+    BenchReport *br = g_new0(BenchReport, 1);
+
+    br->name = g_strdup(name);
+    g_mutex_init(&br->lock);
+    br->threads = g_ptr_array_new_with_free_func((GDestroyNotify)bench_thread_free);
+    br->counters = g_ptr_array_new_with_free_func((GDestroyNotify)bench_counter_free);
+    return br;
+}
+
+/* 记录调用线程（接管 name），调用者持有 br->lock */
+static void
+thread_enter(BenchReport *br, gchar *name)
+{
+    BenchThread *thread = g_new0(BenchThread, 1);
+
+    thread->name = name;
+    if (pthread_getcpuclockid(pthread_self(), &thread->clock) != 0)
+    {
+        bench_thread_free(thread);
+        return;
+    }
+    thread->start_cpu = clock_cpu_time(thread->clock);
+    thread->running = TRUE;
+    g_ptr_array_add(br->threads, thread);
+}
+
+/**
+ * 同步总线处理函数：运行在发出消息的线程中
+ *
+ * STREAM_STATUS ENTER 由即将进入循环的流线程发出，LEAVE 由即将退出循环的流线程发出，
+ * 所以这里的 pthread_self() 就是流线程本身。
+ */
+static GstBusSyncReply
+stream_status_handler(GstBus *bus, GstMessage *msg, BenchReport *br)
+{
+    GstStreamStatusType type;
+    GstElement *owner;
+    gchar *name;
+    guint i;
+
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_STREAM_STATUS)
+        return GST_BUS_PASS;
+    gst_message_parse_stream_status(msg, &type, &owner);
+    if (type != GST_STREAM_STATUS_TYPE_ENTER && type != GST_STREAM_STATUS_TYPE_LEAVE)
+        return GST_BUS_PASS;
+
+    name = g_strdup_printf("%s:%s", GST_OBJECT_NAME(owner), GST_MESSAGE_SRC_NAME(msg));
+    g_mutex_lock(&br->lock);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER)
+    {
+        thread_enter(br, name);
+        name = NULL;
+    }
+    else
+    {
+        for (i = 0; i < br->threads->len; i++)
+        {
+            BenchThread *thread = g_ptr_array_index(br->threads, i);
+
+            if (thread->running && g_str_equal(thread->name, name))
+            {
+                thread->cpu += clock_cpu_time(thread->clock) - thread->start_cpu;
+                thread->running = FALSE;
+                break;
+            }
+        }
+    }
+    g_mutex_unlock(&br->lock);
+    g_free(name);
+    return GST_BUS_PASS;
+}
+
+void
+bench_report_watch_threads(BenchReport *br, GstElement *pipeline)
+{
+    GstBus *bus = gst_element_get_bus(pipeline);
+
+    gst_bus_set_sync_handler(bus, (GstBusSyncHandler)stream_status_handler, br, NULL);
+    gst_object_unref(bus);
+}
+
+void
+bench_report_add_thread(BenchReport *br, const gchar *name)
+{
+    g_mutex_lock(&br->lock);
+    thread_enter(br, g_strdup(name));
+    g_mutex_unlock(&br->lock);
+}
+
+static GstPadProbeReturn
+count_probe(GstPad *pad, GstPadProbeInfo *info, BenchCounter *counter)
+{
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+        counter->buffers += gst_buffer_list_length(list);
+        counter->bytes += gst_buffer_list_calculate_size(list);
+    }
+    else
+    {
+        counter->buffers++;
+        counter->bytes += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void
+bench_report_count_sink(BenchReport *br, GstElement *sink, const gchar *label)
+{
+    BenchCounter *counter = g_new0(BenchCounter, 1);
+    GstPad *pad = gst_element_get_static_pad(sink, "sink");
+
+    counter->label = g_strdup(label);
+    g_ptr_array_add(br->counters, counter);
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                      (GstPadProbeCallback)count_probe, counter, NULL);
+    gst_object_unref(pad);
+}
+
+void
+bench_report_start(BenchReport *br)
+{
+    br->main.name = "main";
+    if (pthread_getcpuclockid(pthread_self(), &br->main.clock) == 0)
+    {
+        br->main.start_cpu = clock_cpu_time(br->main.clock);
+        br->main.running = TRUE;
+    }
+    br->process_cpu = clock_cpu_time(CLOCK_PROCESS_CPUTIME_ID);
+    br->start_time = g_get_monotonic_time();
+}
+
+void
+bench_report_stop(BenchReport *br)
+{
+    guint i;
+
+    br->stop_time = g_get_monotonic_time();
+    br->process_cpu = clock_cpu_time(CLOCK_PROCESS_CPUTIME_ID) - br->process_cpu;
+    if (br->main.running)
+    {
+        br->main.cpu = clock_cpu_time(br->main.clock) - br->main.start_cpu;
+        br->main.running = FALSE;
+    }
+    // 仍在运行的流线程：现在读取它们的 CPU 时钟（线程还没有退出，时钟仍然有效）
+    g_mutex_lock(&br->lock);
+    for (i = 0; i < br->threads->len; i++)
+    {
+        BenchThread *thread = g_ptr_array_index(br->threads, i);
+
+        if (thread->running)
+        {
+            thread->cpu += clock_cpu_time(thread->clock) - thread->start_cpu;
+            thread->running = FALSE;
+        }
+    }
+    g_mutex_unlock(&br->lock);
+}
+
+static void
+append_thread(GString *json, BenchThread *thread, gboolean first)
+{
+    gchar *name = g_strescape(thread->name, NULL);
+
+    g_string_append_printf(json, "%s{\"name\":\"%s\",\"cpu_s\":%.6f}", first ? "" : ",", name,
+                           (gdouble)thread->cpu / GST_SECOND);
+    g_free(name);
+}
+
+gboolean
+bench_report_write(BenchReport *br, guint64 samples, const gchar *path)
+{
+    GString *json = g_string_new(NULL);
+    gdouble wall = (gdouble)(br->stop_time - br->start_time) / G_USEC_PER_SEC;
+    struct rusage usage;
+    guint64 buffers = 0;
+    gboolean ok = TRUE;
+    guint i;
+
+    if (wall <= 0)
+        wall = 1e-9;
+    for (i = 0; i < br->counters->len; i++)
+        buffers += ((BenchCounter *)g_ptr_array_index(br->counters, i))->buffers;
+    getrusage(RUSAGE_SELF, &usage);
+
+    g_string_append_printf(json, "{\"bench\":\"%s\",\"samples\":%" G_GUINT64_FORMAT ",\"wall_s\":%.6f,", br->name, samples, wall);
+    g_string_append_printf(json, "\"samples_per_sec\":%.1f,\"buffers\":%" G_GUINT64_FORMAT ",\"buffers_per_sec\":%.1f,",
+                           samples / wall, buffers, buffers / wall);
+    g_string_append(json, "\"sinks\":[");
+    for (i = 0; i < br->counters->len; i++)
+    {
+        BenchCounter *counter = g_ptr_array_index(br->counters, i);
+
+        g_string_append_printf(json, "%s{\"name\":\"%s\",\"buffers\":%" G_GUINT64_FORMAT ",\"bytes\":%" G_GUINT64_FORMAT ",\"buffers_per_sec\":%.1f}",
+                               i ? "," : "", counter->label, counter->buffers, counter->bytes, counter->buffers / wall);
+    }
+    g_string_append(json, "],\"threads\":[");
+    append_thread(json, &br->main, TRUE);
+    for (i = 0; i < br->threads->len; i++)
+        append_thread(json, g_ptr_array_index(br->threads, i), FALSE);
+    // Linux 上 ru_maxrss 的单位是 KB
+    g_string_append_printf(json, "],\"process_cpu_s\":%.6f,\"peak_rss_kb\":%ld}\n",
+                           (gdouble)br->process_cpu / GST_SECOND, (glong)usage.ru_maxrss);
+
+    if (path == NULL || g_str_equal(path, "-"))
+    {
+        g_print("%s", json->str);
+    }
+    else
+    {
+        GError *error = NULL;
+
+        ok = g_file_set_contents(path, json->str, json->len, &error);
+        if (!ok)
+        {
+            g_printerr("Could not write %s: %s\n", path, error->message);
+            g_clear_error(&error);
+        }
+    }
+    g_string_free(json, TRUE);
+    return ok;
+}
+
+void
+bench_report_free(BenchReport *br)
+{
+    g_ptr_array_unref(br->threads);
+    g_ptr_array_unref(br->counters);
+    g_mutex_clear(&br->lock);
+    g_free(br->name);
+    g_free(br);
+}
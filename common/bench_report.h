@@ -0,0 +1,32 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <gst/gst.h>
+
+/**
+ * 无界面基准测试的统计与报告（make bench，-DHEADLESS_BENCH）
+ *
+ * - 吞吐量：在各个 sink 的 sink pad 上加探针，统计 buffer 个数和字节数
+ * - 每个流线程的 CPU 时间：用同步总线处理函数接收 STREAM_STATUS 消息，
+ *   ENTER/LEAVE 消息在流线程自己的上下文中发出，此时用 pthread_getcpuclockid() 取得该线程的 CPU 时钟
+ * - 峰值内存：getrusage() 的 ru_maxrss
+ * - 结果以一行 JSON 输出，方便脚本比较不同版本的 tee/queue 拓扑
+ */
+
+typedef struct _BenchReport BenchReport;
+
+BenchReport *bench_report_new(const gchar *name);
+/* 在 pipeline 的总线上安装同步处理函数，记录流线程（必须在 PLAYING 之前调用） */
+void bench_report_watch_threads(BenchReport *br, GstElement *pipeline);
+/* 记录调用线程（应用自己创建的线程，例如生产者线程），线程必须在 bench_report_stop() 之后才退出 */
+void bench_report_add_thread(BenchReport *br, const gchar *name);
+/* 统计 element 的 sink pad 上流过的 buffer，label 为 JSON 中的名字（通常是 sink 的名字） */
+void bench_report_count_sink(BenchReport *br, GstElement *sink, const gchar *label);
+/* 开始/停止计时；停止时读取各线程的 CPU 时间，所以要在 pipeline 切换到 NULL 之前调用 */
+void bench_report_start(BenchReport *br);
+void bench_report_stop(BenchReport *br);
+/* 输出 JSON，path 为 NULL 或 "-" 时写到标准输出；samples 为本次生成的采样总数 */
+gboolean bench_report_write(BenchReport *br, guint64 samples, const gchar *path);
+void bench_report_free(BenchReport *br);
+
+#endif /* BENCH_REPORT_H */
@@ -0,0 +1,121 @@
+#include "feeder_pool.h"
+
+/**
+ * 与下游协商缓冲池
+ *
+ * 向 app_src.src 的对端（peer）发送 ALLOCATION 查询：
+ * - 如果下游提供了缓冲池，就直接使用下游的池
+ * - 否则创建一个普通的 GstBufferPool
+ * - size/min 取 "我们的配置" 与 "下游的要求" 中较大的值
+ * - max 固定为 min，池不会增长：池用完时 acquire 不等待，而是退回到普通分配并记为未命中
+ */
+gboolean
+feeder_pool_setup(FeederPool *fp, GstElement *app_src, GstCaps *caps, guint buffer_size, guint buffer_count)
+{
+    GstPad *src_pad;
+    GstQuery *query;
+    GstBufferPool *pool = NULL;
+    GstStructure *config;
+    guint size = 0, min = 0, max = 0;
+
+    fp->buffer_size = buffer_size;
+    fp->buffer_count = buffer_count;
+    if (buffer_count == 0) // 禁用缓冲池：每个 chunk 都走 gst_buffer_new_and_alloc()
+        return TRUE;
+
+    // 向下游发送 ALLOCATION 查询（need_pool=TRUE 表示希望下游提供缓冲池）
+    src_pad = gst_element_get_static_pad(app_src, "src");
+    query = gst_query_new_allocation(caps, TRUE);
+    if (gst_pad_peer_query(src_pad, query) && gst_query_get_n_allocation_pools(query) > 0)
+    {
+        gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+        g_print("Downstream proposed allocation: pool=%s size=%u min=%u max=%u\n",
+                pool ? GST_OBJECT_NAME(pool) : "(none)", size, min, max);
+    }
+    gst_query_unref(query);
+    gst_object_unref(src_pad);
+
+    // 合并下游的要求
+    fp->buffer_size = MAX(buffer_size, size);
+    fp->buffer_count = MAX(buffer_count, min);
+    if (max != 0 && fp->buffer_count > max)
+        fp->buffer_count = max;
+
+    if (pool == NULL)
+        pool = gst_buffer_pool_new();
+
+    config = gst_buffer_pool_get_config(pool);
+    gst_buffer_pool_config_set_params(config, caps, fp->buffer_size, fp->buffer_count, fp->buffer_count);
+    if (!gst_buffer_pool_set_config(pool, config))
+    {
+        /* 池可能修改了我们的配置（例如对齐），检查修改后的参数是否仍然可以接受 */
+        config = gst_buffer_pool_get_config(pool);
+        if (!gst_buffer_pool_config_validate_params(config, caps, fp->buffer_size, fp->buffer_count, fp->buffer_count) ||
+            !gst_buffer_pool_set_config(pool, config))
+        {
+            g_printerr("Buffer pool rejected the configuration, falling back to plain allocation.\n");
+            gst_object_unref(pool);
+            return FALSE;
+        }
+    }
+
+    // 激活缓冲池：在这里一次性分配 buffer_count 个 buffer
+    if (!gst_buffer_pool_set_active(pool, TRUE))
+    {
+        g_printerr("Buffer pool could not be activated, falling back to plain allocation.\n");
+        gst_object_unref(pool);
+        return FALSE;
+    }
+
+    fp->pool = pool;
+    g_print("Buffer pool ready: %u buffers of %u bytes\n", fp->buffer_count, fp->buffer_size);
+    return TRUE;
+}
+
+GstBuffer *
+feeder_pool_acquire(FeederPool *fp, gsize size)
+{
+    GstBuffer *buffer = NULL;
+    GstBufferPoolAcquireParams params = {0};
+
+    if (fp->pool != NULL && size <= fp->buffer_size)
+    {
+        // DONTWAIT: 池已空时立即返回 GST_FLOW_EOS，而不是阻塞生产者
+        params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+        if (gst_buffer_pool_acquire_buffer(fp->pool, &buffer, &params) == GST_FLOW_OK)
+        {
+            g_atomic_int_inc(&fp->hits);
+            // 池中 buffer 的大小是 buffer_size，截取为本次需要的大小（回收时池会恢复原大小）
+            if (gst_buffer_get_size(buffer) != size)
+                gst_buffer_set_size(buffer, size);
+            return buffer;
+        }
+    }
+
+    // 未命中（池已空或未启用）：退回到普通分配
+    g_atomic_int_inc(&fp->misses);
+    return gst_buffer_new_and_alloc(size);
+}
+
+void
+feeder_pool_print_stats(FeederPool *fp, const gchar *prefix)
+{
+    gint hits = g_atomic_int_get(&fp->hits);
+    gint misses = g_atomic_int_get(&fp->misses);
+    gint total = hits + misses;
+
+    g_print("%sbuffer pool: %d hits, %d misses (%.1f%% served from pool, %u x %u bytes)\n",
+            prefix, hits, misses, total ? 100.0 * hits / total : 0.0,
+            fp->pool ? fp->buffer_count : 0, fp->buffer_size);
+}
+
+void
+feeder_pool_clear(FeederPool *fp)
+{
+    if (fp->pool == NULL)
+        return;
+    // 停用后，仍在下游流动的 buffer 回收时会被直接释放
+    gst_buffer_pool_set_active(fp->pool, FALSE);
+    gst_object_unref(fp->pool);
+    fp->pool = NULL;
+}
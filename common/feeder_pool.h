@@ -0,0 +1,35 @@
+#ifndef FEEDER_POOL_H
+#define FEEDER_POOL_H
+
+#include <gst/gst.h>
+
+/**
+ * appsrc 生产者使用的缓冲池（GstBufferPool）
+ *
+ * push_data() 原来每个 chunk 都调用 gst_buffer_new_and_alloc()，
+ * 即每秒成千上万次 malloc/free。这里改为从一个预先分配好的 GstBufferPool 中取 buffer，
+ * 下游释放 buffer 后它会自动回到池中，从而把分配器移出热路径。
+ *
+ * - 池的大小（buffer 个数）和每个 buffer 的大小可以配置
+ * - 通过向下游发送 ALLOCATION 查询来协商（下游可以提供自己的池，或者给出 size/min/max 的要求）
+ * - 记录命中（从池中取到）/未命中（池已空，退回到普通分配）次数
+ */
+typedef struct _FeederPool
+{
+    GstBufferPool *pool; /* 协商得到的缓冲池，NULL 表示尚未配置或已禁用 */
+    guint buffer_size;   /* 池中每个 buffer 的大小（字节） */
+    guint buffer_count;  /* 池中 buffer 的个数（池不会增长，用完即未命中） */
+    gint hits;           /* 从池中取得 buffer 的次数（原子操作） */
+    gint misses;         /* 池已空、退回到 gst_buffer_new_and_alloc() 的次数（原子操作） */
+} FeederPool;
+
+/* 与 app_src 下游协商并激活缓冲池，buffer_count 为 0 表示禁用缓冲池 */
+gboolean feeder_pool_setup(FeederPool *fp, GstElement *app_src, GstCaps *caps, guint buffer_size, guint buffer_count);
+/* 取一个至少 size 字节的可写 buffer，并把它的大小设置为 size */
+GstBuffer *feeder_pool_acquire(FeederPool *fp, gsize size);
+/* 打印命中/未命中统计 */
+void feeder_pool_print_stats(FeederPool *fp, const gchar *prefix);
+/* 停用并释放缓冲池 */
+void feeder_pool_clear(FeederPool *fp);
+
+#endif /* FEEDER_POOL_H */
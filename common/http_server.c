@@ -0,0 +1,373 @@
+#include "http_server.h"
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREADS 16
+#define CHUNK_SIZE (16 * 1024) /* 每次写入的大小，也是限速的粒度 */
+
+struct _HttpServer
+{
+    gchar *root;
+    guint port;
+
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    GCancellable *cancellable; /* 停止时取消所有连接上阻塞的读写 */
+
+    GMutex lock;          /* 保护以下字段 */
+    GCond cond;
+    gboolean started;     /* 服务器线程已经开始监听（或者失败） */
+    gboolean service_gone; /* GThreadedSocketService 已经释放：所有连接的处理函数都已经返回 */
+    GError *error;
+    guint64 rate;
+    guint64 bytes_sent;
+    guint requests;
+};
+
+/* 解析 Range 头，结果为 [*start, *end]；不支持多个范围 */
+static gboolean
+parse_range(const gchar *value, guint64 size, guint64 *start, guint64 *end)
+{
+    gchar *p;
+
+    if (!g_str_has_prefix(value, "bytes=") || strchr(value, ',') != NULL || size == 0)
+        return FALSE;
+    value += strlen("bytes=");
+    if (*value == '-')
+    {
+        // bytes=-n：最后 n 个字节
+        guint64 n = g_ascii_strtoull(value + 1, &p, 10);
+
+        if (n == 0)
+            return FALSE;
+        *start = n < size ? size - n : 0;
+        *end = size - 1;
+        return TRUE;
+    }
+    *start = g_ascii_strtoull(value, &p, 10);
+    if (p == value || *p != '-' || *start >= size)
+        return FALSE;
+    *end = p[1] == '\0' ? size - 1 : MIN(g_ascii_strtoull(p + 1, NULL, 10), size - 1);
+    return *end >= *start;
+}
+
+static gboolean
+write_string(HttpServer *server, GOutputStream *out, const gchar *str)
+{
+    return g_output_stream_write_all(out, str, strlen(str), NULL, server->cancellable, NULL);
+}
+
+/* 按限速发送响应体 */
+static gboolean
+send_body(HttpServer *server, GOutputStream *out, const gchar *data, gsize length)
+{
+    gint64 start = g_get_monotonic_time();
+    gsize sent = 0;
+
+    while (sent < length)
+    {
+        gsize n = MIN(CHUNK_SIZE, length - sent);
+        guint64 rate;
+
+        if (!g_output_stream_write_all(out, data + sent, n, NULL, server->cancellable, NULL))
+            return FALSE;
+        sent += n;
+
+        g_mutex_lock(&server->lock);
+        server->bytes_sent += n;
+        rate = server->rate;
+        g_mutex_unlock(&server->lock);
+
+        // 限速：发送到第 sent 个字节的时刻不早于 start + sent / rate；等待中服务器停止时立即返回
+        if (rate > 0)
+        {
+            gint64 due = start + (gint64)(sent * G_USEC_PER_SEC / rate);
+
+            g_mutex_lock(&server->lock);
+            while (!g_cancellable_is_cancelled(server->cancellable) && g_cond_wait_until(&server->cond, &server->lock, due))
+                ;
+            g_mutex_unlock(&server->lock);
+            if (g_cancellable_is_cancelled(server->cancellable))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* 处理一个请求，返回 FALSE 时关闭连接 */
+static gboolean
+handle_request(HttpServer *server, GDataInputStream *in, GOutputStream *out)
+{
+    gchar *line, **parts = NULL, *range = NULL, *path = NULL, *file_path = NULL, *header;
+    gboolean keep_alive = TRUE, head, ok = FALSE;
+    GMappedFile *file = NULL;
+    guint64 size, start, end;
+
+    line = g_data_input_stream_read_line(in, NULL, server->cancellable, NULL);
+    if (line == NULL)
+        return FALSE; // 客户端关闭了连接
+    parts = g_strsplit(g_strstrip(line), " ", 3);
+    g_free(line);
+
+    // 请求头：只关心 Range 和 Connection
+    while ((line = g_data_input_stream_read_line(in, NULL, server->cancellable, NULL)) != NULL && g_strstrip(line)[0] != '\0')
+    {
+        if (g_ascii_strncasecmp(line, "Range:", 6) == 0)
+            range = g_strdup(g_strstrip(line + 6));
+        else if (g_ascii_strncasecmp(line, "Connection:", 11) == 0)
+            keep_alive = g_ascii_strcasecmp(g_strstrip(line + 11), "close") != 0;
+        g_free(line);
+    }
+    if (line == NULL)
+        goto done;
+    g_free(line);
+
+    g_mutex_lock(&server->lock);
+    server->requests++;
+    g_mutex_unlock(&server->lock);
+
+    if (g_strv_length(parts) != 3 || (strcmp(parts[0], "GET") != 0 && strcmp(parts[0], "HEAD") != 0))
+    {
+        write_string(server, out, "HTTP/1.1 501 Not Implemented\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        goto done;
+    }
+    head = strcmp(parts[0], "HEAD") == 0;
+
+    // 去掉查询字符串，不允许访问 root 之外的文件
+    parts[1][strcspn(parts[1], "?")] = '\0';
+    path = g_uri_unescape_string(parts[1], NULL);
+    if (path != NULL && path[0] == '/' && strstr(path, "..") == NULL)
+    {
+        file_path = g_build_filename(server->root, path, NULL);
+        file = g_mapped_file_new(file_path, FALSE, NULL);
+    }
+    if (file == NULL)
+    {
+        ok = write_string(server, out, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n") && keep_alive;
+        goto done;
+    }
+
+    size = g_mapped_file_get_length(file);
+    if (range == NULL)
+    {
+        header = g_strdup_printf("HTTP/1.1 200 OK\r\n"
+                                 "Content-Type: application/octet-stream\r\n"
+                                 "Accept-Ranges: bytes\r\n"
+                                 "Content-Length: %" G_GUINT64_FORMAT "\r\n"
+                                 "Connection: %s\r\n\r\n",
+                                 size, keep_alive ? "keep-alive" : "close");
+        start = 0;
+        end = size - 1;
+    }
+    else if (parse_range(range, size, &start, &end))
+    {
+        header = g_strdup_printf("HTTP/1.1 206 Partial Content\r\n"
+                                 "Content-Type: application/octet-stream\r\n"
+                                 "Accept-Ranges: bytes\r\n"
+                                 "Content-Length: %" G_GUINT64_FORMAT "\r\n"
+                                 "Content-Range: bytes %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "\r\n"
+                                 "Connection: %s\r\n\r\n",
+                                 end - start + 1, start, end, size, keep_alive ? "keep-alive" : "close");
+    }
+    else
+    {
+        header = g_strdup_printf("HTTP/1.1 416 Range Not Satisfiable\r\n"
+                                 "Content-Range: bytes */%" G_GUINT64_FORMAT "\r\n"
+                                 "Content-Length: 0\r\n\r\n",
+                                 size);
+        ok = write_string(server, out, header) && keep_alive;
+        g_free(header);
+        goto done;
+    }
+
+    ok = write_string(server, out, header);
+    g_free(header);
+    if (ok && !head && size > 0)
+        ok = send_body(server, out, g_mapped_file_get_contents(file) + start, end - start + 1);
+    ok = ok && keep_alive;
+
+done:
+    if (file != NULL)
+        g_mapped_file_unref(file);
+    g_free(file_path);
+    g_free(path);
+    g_free(range);
+    g_strfreev(parts);
+    return ok;
+}
+
+/* 一个连接（GThreadedSocketService 的工作线程中调用） */
+static gboolean
+on_run(GThreadedSocketService *service, GSocketConnection *connection, GObject *source_object, HttpServer *server)
+{
+    GDataInputStream *in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+    g_data_input_stream_set_newline_type(in, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+    while (handle_request(server, in, out))
+        ;
+    g_object_unref(in);
+    return TRUE;
+}
+
+/* 服务释放时调用：每个连接的任务都持有服务的引用，所以这时所有的 on_run() 都已经返回 */
+static void
+service_finalized(HttpServer *server, GObject *where_the_object_was)
+{
+    g_mutex_lock(&server->lock);
+    server->service_gone = TRUE;
+    g_cond_broadcast(&server->cond);
+    g_mutex_unlock(&server->lock);
+}
+
+static gpointer
+server_thread(HttpServer *server)
+{
+    GSocketService *service;
+    GInetAddress *loopback;
+    GSocketAddress *address, *effective = NULL;
+    GError *error = NULL;
+
+    // 监听的 source 加入当前线程的默认 GMainContext，所以先切换到服务器自己的 context
+    g_main_context_push_thread_default(server->context);
+    service = g_threaded_socket_service_new(MAX_THREADS);
+    g_object_weak_ref(G_OBJECT(service), (GWeakNotify)service_finalized, server);
+    loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    address = g_inet_socket_address_new(loopback, server->port);
+    if (g_socket_listener_add_address(G_SOCKET_LISTENER(service), address, G_SOCKET_TYPE_STREAM,
+                                      G_SOCKET_PROTOCOL_TCP, NULL, &effective, &error))
+    {
+        server->port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective));
+        g_object_unref(effective);
+        g_signal_connect(service, "run", G_CALLBACK(on_run), server);
+        g_socket_service_start(service);
+    }
+    g_object_unref(address);
+    g_object_unref(loopback);
+
+    g_mutex_lock(&server->lock);
+    server->started = TRUE;
+    server->error = error;
+    g_cond_signal(&server->cond);
+    g_mutex_unlock(&server->lock);
+
+    if (error == NULL)
+        g_main_loop_run(server->loop);
+
+    // 不再接受新连接，唤醒阻塞在读写或者限速等待中的连接，然后等所有连接的处理函数返回，
+    // 否则 http_server_free() 之后它们还会访问 server
+    g_socket_service_stop(service);
+    g_socket_listener_close(G_SOCKET_LISTENER(service));
+    g_mutex_lock(&server->lock);
+    g_cancellable_cancel(server->cancellable);
+    g_cond_broadcast(&server->cond);
+    g_mutex_unlock(&server->lock);
+    g_object_unref(service);
+    g_mutex_lock(&server->lock);
+    while (!server->service_gone)
+        g_cond_wait(&server->cond, &server->lock);
+    g_mutex_unlock(&server->lock);
+    g_main_context_pop_thread_default(server->context);
+    return NULL;
+}
+
+HttpServer *
+http_server_new(const gchar *root, guint port, GError **error)
+{
+    HttpServer *server = g_new0(HttpServer, 1);
+
+    server->root = g_strdup(root);
+    server->port = port;
+    server->context = g_main_context_new();
+    server->loop = g_main_loop_new(server->context, FALSE);
+    server->cancellable = g_cancellable_new();
+    g_mutex_init(&server->lock);
+    g_cond_init(&server->cond);
+    server->thread = g_thread_new("http-server", (GThreadFunc)server_thread, server);
+
+    // 等待服务器线程开始监听，返回之后就可以连接
+    g_mutex_lock(&server->lock);
+    while (!server->started)
+        g_cond_wait(&server->cond, &server->lock);
+    g_mutex_unlock(&server->lock);
+    if (server->error != NULL)
+    {
+        g_propagate_error(error, server->error);
+        server->error = NULL;
+        http_server_free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void
+http_server_set_rate(HttpServer *server, guint64 bytes_per_sec)
+{
+    g_mutex_lock(&server->lock);
+    server->rate = bytes_per_sec;
+    g_mutex_unlock(&server->lock);
+}
+
+guint
+http_server_get_port(HttpServer *server)
+{
+    return server->port;
+}
+
+gchar *
+http_server_get_uri(HttpServer *server, const gchar *path)
+{
+    gchar *escaped = g_uri_escape_string(path, G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+    gchar *uri = g_strdup_printf("http://127.0.0.1:%u/%s", server->port, escaped[0] == '/' ? escaped + 1 : escaped);
+
+    g_free(escaped);
+    return uri;
+}
+
+guint64
+http_server_get_bytes_sent(HttpServer *server)
+{
+    guint64 bytes;
+
+    g_mutex_lock(&server->lock);
+    bytes = server->bytes_sent;
+    g_mutex_unlock(&server->lock);
+    return bytes;
+}
+
+guint
+http_server_get_requests(HttpServer *server)
+{
+    guint requests;
+
+    g_mutex_lock(&server->lock);
+    requests = server->requests;
+    g_mutex_unlock(&server->lock);
+    return requests;
+}
+
+static gboolean
+quit_loop(GMainLoop *loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+void
+http_server_free(HttpServer *server)
+{
+    // 服务器线程退出之前会等待所有连接的处理函数返回（见 server_thread()）。
+    // 在服务器线程中退出主循环（直接调用 g_main_loop_quit() 时服务器线程可能还没有进入 g_main_loop_run()）
+    g_main_context_invoke(server->context, (GSourceFunc)quit_loop, server->loop);
+    g_thread_join(server->thread);
+    g_main_loop_unref(server->loop);
+    g_main_context_unref(server->context);
+    g_object_unref(server->cancellable);
+    g_mutex_clear(&server->lock);
+    g_cond_clear(&server->cond);
+    g_free(server->root);
+    g_free(server);
+}
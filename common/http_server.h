@@ -0,0 +1,35 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <glib.h>
+
+/**
+ * 本地测试用的 HTTP 服务器（代替 freedesktop.org 等远程服务器）
+ *
+ * 测量网络源（缓存、缓冲）的行为时，远程服务器的速度和延迟每次都不一样，也无法知道到底传输了多少字节。
+ * 这个服务器只监听 127.0.0.1，把 root 目录中的文件通过 HTTP/1.1 提供出去：
+ *
+ * - GET/HEAD，Range 请求（bytes=a-b、bytes=a-、bytes=-n，单个范围），返回 206 和 Content-Range
+ * - keep-alive：一个连接上可以连续处理多个请求
+ * - 可以限速（每个连接每秒发送的字节数），模拟慢速网络
+ * - 统计请求数和发送的字节数（响应体），作为 "实际从网络传输了多少" 的基准
+ *
+ * 服务器在自己的线程和 GMainContext 中接受连接，每个连接由 GThreadedSocketService 的一个线程处理，
+ * 调用者的主循环阻塞（例如 gst_bus_timed_pop()）时也能正常工作。
+ */
+
+typedef struct _HttpServer HttpServer;
+
+/* port 为 0 时由系统分配，之后用 http_server_get_port() 取得 */
+HttpServer *http_server_new(const gchar *root, guint port, GError **error);
+/* 每个连接的发送速率（字节/秒），0 表示不限速；可以在运行中修改 */
+void http_server_set_rate(HttpServer *server, guint64 bytes_per_sec);
+guint http_server_get_port(HttpServer *server);
+/* 返回 http://127.0.0.1:端口/path 形式的 URI（path 相对于 root） */
+gchar *http_server_get_uri(HttpServer *server, const gchar *path);
+guint64 http_server_get_bytes_sent(HttpServer *server);
+guint http_server_get_requests(HttpServer *server);
+/* 关闭所有连接（包括还在发送中的），等它们的处理线程退出后再释放 */
+void http_server_free(HttpServer *server);
+
+#endif /* HTTP_SERVER_H */
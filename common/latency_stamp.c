@@ -0,0 +1,364 @@
+#include "latency_stamp.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/* 附加在 buffer 上的创建时间 */
+typedef struct _LatencyStampMeta
+{
+    GstMeta meta;
+    GstClockTime created;
+} LatencyStampMeta;
+
+/* 一次测量：到达 sink 时的延迟和该分支 queue 的水位（微秒） */
+typedef struct _Sample
+{
+    guint32 latency;
+    guint32 level;
+} Sample;
+
+/* 一个被测量的分支 */
+typedef struct _Branch
+{
+    LatencyTracker *lt;
+    gchar *name;
+    GstPad *pad;         /* sink 的 sink pad */
+    gulong probe_id;
+    GstElement *queue;   /* 可以为 NULL */
+    /* 以下字段用 lt->lock 保护 */
+    GArray *samples;     /* Sample */
+    guint64 unstamped;   /* 没有 meta 的 buffer（meta 在途中被丢掉了） */
+} Branch;
+
+/* 输出新 buffer 的元素（wavescope）：把输入的时间戳转交给输出 */
+typedef struct _Relay
+{
+    LatencyTracker *lt;
+    GstPad *sink_pad, *src_pad;
+    gulong sink_probe, src_probe;
+    GstClockTime last;   /* 进入的最新的创建时间，用 lt->lock 保护 */
+} Relay;
+
+struct _LatencyTracker
+{
+    gdouble spike_factor;
+    GMutex lock;
+    GPtrArray *branches; /* Branch* */
+    GPtrArray *relays;   /* Relay* */
+};
+
+static GType
+latency_stamp_meta_api_get_type(void)
+{
+    static gsize type = 0;
+    static const gchar *tags[] = {NULL};
+
+    if (g_once_init_enter(&type))
+        g_once_init_leave(&type, gst_meta_api_type_register("LatencyStampMetaAPI", tags));
+    return (GType)type;
+}
+
+static gboolean
+latency_stamp_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+    ((LatencyStampMeta *)meta)->created = GST_CLOCK_TIME_NONE;
+    return TRUE;
+}
+
+static void latency_stamp_set(GstBuffer *buffer, GstClockTime created);
+
+/* 时间戳与数据的内容无关，任何变换（拷贝、格式转换、重采样）都原样保留 */
+static gboolean
+latency_stamp_meta_transform(GstBuffer *dest, GstMeta *meta, GstBuffer *buffer, GQuark type, gpointer data)
+{
+    latency_stamp_set(dest, ((LatencyStampMeta *)meta)->created);
+    return TRUE;
+}
+
+static const GstMetaInfo *
+latency_stamp_meta_get_info(void)
+{
+    static gsize info = 0;
+
+    if (g_once_init_enter(&info))
+        g_once_init_leave(&info, (gsize)gst_meta_register(latency_stamp_meta_api_get_type(), "LatencyStampMeta",
+                                                          sizeof(LatencyStampMeta), latency_stamp_meta_init, NULL,
+                                                          latency_stamp_meta_transform));
+    return (const GstMetaInfo *)info;
+}
+
+static void
+latency_stamp_set(GstBuffer *buffer, GstClockTime created)
+{
+    LatencyStampMeta *meta = (LatencyStampMeta *)gst_buffer_get_meta(buffer, latency_stamp_meta_api_get_type());
+
+    if (meta == NULL)
+        meta = (LatencyStampMeta *)gst_buffer_add_meta(buffer, latency_stamp_meta_get_info(), NULL);
+    meta->created = created;
+}
+
+void
+latency_stamp_add(GstBuffer *buffer)
+{
+    latency_stamp_set(buffer, gst_util_get_timestamp());
+}
+
+gboolean
+latency_stamp_get(GstBuffer *buffer, GstClockTime *created)
+{
+    LatencyStampMeta *meta = (LatencyStampMeta *)gst_buffer_get_meta(buffer, latency_stamp_meta_api_get_type());
+
+    if (meta == NULL || !GST_CLOCK_TIME_IS_VALID(meta->created))
+        return FALSE;
+    *created = meta->created;
+    return TRUE;
+}
+
+/* 对探针中的 buffer（或 buffer list 中的每一个 buffer）调用 func */
+static void
+foreach_buffer(GstPadProbeInfo *info, void (*func)(GstBuffer *buffer, gpointer user_data), gpointer user_data)
+{
+    GstBufferList *list;
+    guint i;
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER)
+    {
+        func(GST_PAD_PROBE_INFO_BUFFER(info), user_data);
+        return;
+    }
+    list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    for (i = 0; i < gst_buffer_list_length(list); i++)
+        func(gst_buffer_list_get(list, i), user_data);
+}
+
+/* 分支 sink 的探针：记录一个 buffer 的延迟，调用者持有 lt->lock */
+typedef struct _Arrival
+{
+    Branch *branch;
+    GstClockTime now;
+    guint64 level;
+} Arrival;
+
+static void
+record_buffer(GstBuffer *buffer, gpointer user_data)
+{
+    Arrival *arrival = user_data;
+    GstClockTime created;
+    Sample sample;
+
+    if (!latency_stamp_get(buffer, &created))
+    {
+        arrival->branch->unstamped++;
+        return;
+    }
+    sample.latency = (guint32)MIN((arrival->now - created) / GST_USECOND, G_MAXUINT32);
+    sample.level = (guint32)MIN(arrival->level / GST_USECOND, G_MAXUINT32);
+    g_array_append_val(arrival->branch->samples, sample);
+}
+
+static GstPadProbeReturn
+branch_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Branch *branch = user_data;
+    Arrival arrival = {branch, gst_util_get_timestamp(), 0};
+
+    // 到达时该分支 queue 中排队的时长：延迟尖峰是不是在 queue 里等出来的
+    if (branch->queue != NULL)
+        g_object_get(branch->queue, "current-level-time", &arrival.level, NULL);
+    g_mutex_lock(&branch->lt->lock);
+    foreach_buffer(info, record_buffer, &arrival);
+    g_mutex_unlock(&branch->lt->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+/* 转交：记录进入元素的最新时间戳，调用者持有 lt->lock */
+static void
+relay_remember(GstBuffer *buffer, gpointer user_data)
+{
+    Relay *relay = user_data;
+    GstClockTime created;
+
+    if (latency_stamp_get(buffer, &created) && (!GST_CLOCK_TIME_IS_VALID(relay->last) || created > relay->last))
+        relay->last = created;
+}
+
+static GstPadProbeReturn
+relay_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Relay *relay = user_data;
+
+    g_mutex_lock(&relay->lt->lock);
+    foreach_buffer(info, relay_remember, relay);
+    g_mutex_unlock(&relay->lt->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+/* 输出的一帧包含到目前为止进入的音频，用最新的时间戳（帧中最新的那部分音频的延迟） */
+static GstPadProbeReturn
+relay_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    Relay *relay = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime created, last;
+
+    g_mutex_lock(&relay->lt->lock);
+    last = relay->last;
+    g_mutex_unlock(&relay->lt->lock);
+    if (!GST_CLOCK_TIME_IS_VALID(last) || latency_stamp_get(buffer, &created))
+        return GST_PAD_PROBE_OK;
+
+    // 探针中可以替换 buffer：刚输出的帧通常只有一个引用，make_writable 不会拷贝
+    buffer = gst_buffer_make_writable(buffer);
+    latency_stamp_set(buffer, last);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    return GST_PAD_PROBE_OK;
+}
+
+LatencyTracker *
+latency_tracker_new(gdouble spike_factor)
+{
+    LatencyTracker *lt = g_new0(LatencyTracker, 1);
+
+    lt->spike_factor = spike_factor;
+    g_mutex_init(&lt->lock);
+    lt->branches = g_ptr_array_new();
+    lt->relays = g_ptr_array_new();
+    return lt;
+}
+
+void
+latency_tracker_watch(LatencyTracker *lt, GstElement *sink, GstElement *queue, const gchar *branch)
+{
+    Branch *b = g_new0(Branch, 1);
+
+    b->lt = lt;
+    b->name = g_strdup(branch);
+    b->queue = queue ? gst_object_ref(queue) : NULL;
+    b->samples = g_array_new(FALSE, FALSE, sizeof(Sample));
+    // autoaudiosink/autovideosink 是 bin，探针加在它的 ghost pad 上
+    b->pad = gst_element_get_static_pad(sink, "sink");
+    b->probe_id = gst_pad_add_probe(b->pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, branch_probe, b, NULL);
+    g_ptr_array_add(lt->branches, b);
+}
+
+void
+latency_tracker_relay(LatencyTracker *lt, GstElement *element)
+{
+    Relay *relay = g_new0(Relay, 1);
+
+    relay->lt = lt;
+    relay->last = GST_CLOCK_TIME_NONE;
+    relay->sink_pad = gst_element_get_static_pad(element, "sink");
+    relay->src_pad = gst_element_get_static_pad(element, "src");
+    relay->sink_probe = gst_pad_add_probe(relay->sink_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                                          relay_sink_probe, relay, NULL);
+    relay->src_probe = gst_pad_add_probe(relay->src_pad, GST_PAD_PROBE_TYPE_BUFFER, relay_src_probe, relay, NULL);
+    g_ptr_array_add(lt->relays, relay);
+}
+
+static gint
+compare_guint32(gconstpointer a, gconstpointer b)
+{
+    guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile_ms(const guint32 *sorted, guint n, gdouble p)
+{
+    return sorted[MIN(n - 1, (guint)(p * n))] / 1000.0;
+}
+
+void
+latency_tracker_print_summary(LatencyTracker *lt)
+{
+    guint i, j;
+
+    g_mutex_lock(&lt->lock);
+    g_print("Latency from buffer creation to sink (ms), spike = more than %.1fx p50:\n", lt->spike_factor);
+    g_print("%-8s %9s %8s %8s %8s %8s %7s %12s %10s %6s %10s\n", "branch", "buffers", "p50", "p90", "p99", "max", "spikes",
+            "queue@spike", "queue avg", "corr", "unstamped");
+    for (i = 0; i < lt->branches->len; i++)
+    {
+        Branch *b = g_ptr_array_index(lt->branches, i);
+        guint n = b->samples->len, spikes = 0;
+        guint32 *sorted, threshold;
+        gdouble sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0, spike_level = 0, cov, corr = 0;
+
+        if (n == 0)
+        {
+            g_print("%-8s %9u %8s %8s %8s %8s %7s %12s %10s %6s %10" G_GUINT64_FORMAT "\n", b->name, 0, "-", "-", "-", "-",
+                    "-", "-", "-", "-", b->unstamped);
+            continue;
+        }
+        sorted = g_new(guint32, n);
+        for (j = 0; j < n; j++)
+            sorted[j] = g_array_index(b->samples, Sample, j).latency;
+        qsort(sorted, n, sizeof(guint32), compare_guint32);
+        threshold = (guint32)(sorted[n / 2] * lt->spike_factor);
+
+        // 延迟（x）与 queue 水位（y）的皮尔逊相关系数，以及尖峰时的平均水位
+        for (j = 0; j < n; j++)
+        {
+            Sample *s = &g_array_index(b->samples, Sample, j);
+
+            sx += s->latency;
+            sy += s->level;
+            sxx += (gdouble)s->latency * s->latency;
+            syy += (gdouble)s->level * s->level;
+            sxy += (gdouble)s->latency * s->level;
+            if (s->latency > threshold)
+            {
+                spikes++;
+                spike_level += s->level;
+            }
+        }
+        cov = n * sxy - sx * sy;
+        if ((n * sxx - sx * sx) > 0 && (n * syy - sy * sy) > 0)
+            corr = cov / sqrt((n * sxx - sx * sx) * (n * syy - sy * sy));
+
+        g_print("%-8s %9u %8.2f %8.2f %8.2f %8.2f %7u ", b->name, n, percentile_ms(sorted, n, 0.5),
+                percentile_ms(sorted, n, 0.9), percentile_ms(sorted, n, 0.99), sorted[n - 1] / 1000.0, spikes);
+        if (spikes > 0)
+            g_print("%12.2f ", spike_level / spikes / 1000.0);
+        else
+            g_print("%12s ", "-");
+        g_print("%10.2f %6.2f %10" G_GUINT64_FORMAT "\n", sy / n / 1000.0, corr, b->unstamped);
+        g_free(sorted);
+    }
+    g_mutex_unlock(&lt->lock);
+}
+
+void
+latency_tracker_free(LatencyTracker *lt)
+{
+    guint i;
+
+    for (i = 0; i < lt->branches->len; i++)
+    {
+        Branch *b = g_ptr_array_index(lt->branches, i);
+
+        gst_pad_remove_probe(b->pad, b->probe_id);
+        gst_object_unref(b->pad);
+        if (b->queue != NULL)
+            gst_object_unref(b->queue);
+        g_array_free(b->samples, TRUE);
+        g_free(b->name);
+        g_free(b);
+    }
+    for (i = 0; i < lt->relays->len; i++)
+    {
+        Relay *relay = g_ptr_array_index(lt->relays, i);
+
+        gst_pad_remove_probe(relay->sink_pad, relay->sink_probe);
+        gst_pad_remove_probe(relay->src_pad, relay->src_probe);
+        gst_object_unref(relay->sink_pad);
+        gst_object_unref(relay->src_pad);
+        g_free(relay);
+    }
+    g_ptr_array_free(lt->branches, TRUE);
+    g_ptr_array_free(lt->relays, TRUE);
+    g_mutex_clear(&lt->lock);
+    g_free(lt);
+}
@@ -0,0 +1,39 @@
+#ifndef LATENCY_STAMP_H
+#define LATENCY_STAMP_H
+
+#include <gst/gst.h>
+
+/**
+ * 端到端延迟测量：从 buffer 创建到到达各分支的 sink
+ *
+ * - 生产者创建 buffer 时调用 latency_stamp_add()，附加一个自定义的 GstMeta（LatencyStampMeta），
+ *   记录创建时的单调时间（gst_util_get_timestamp()）
+ * - 这个 meta 没有任何 tag，basetransform 类的元素（audioconvert、audioresample 等）拷贝 buffer 时会一起拷贝；
+ *   tee 和 queue 传递的是同一个 buffer
+ * - 每个分支的 sink pad 上的探针读取 meta，延迟 = 到达时间 - 创建时间，同时读取该分支 queue 的水位
+ * - 把音频变成视频帧的元素（wavescope）输出的是新的 buffer，meta 会丢失：
+ *   latency_tracker_relay() 记录进入该元素的最新的时间戳，附加到它输出的每一帧上
+ *
+ * 结束时每个分支报告延迟的分布（p50/p90/p99/max）、延迟尖峰（超过 p50 的若干倍）的次数，
+ * 以及尖峰时 queue 的平均水位与整体平均水位，和延迟与水位的相关系数：
+ * 相关系数接近 1 说明延迟主要花在这个分支的 queue 里排队。
+ */
+
+/* 给 buffer 附加当前时间（buffer 必须可写） */
+void latency_stamp_add(GstBuffer *buffer);
+/* 读取 buffer 的创建时间，没有 meta 时返回 FALSE */
+gboolean latency_stamp_get(GstBuffer *buffer, GstClockTime *created);
+
+typedef struct _LatencyTracker LatencyTracker;
+
+/* spike_factor: 延迟超过 p50 的多少倍算作尖峰 */
+LatencyTracker *latency_tracker_new(gdouble spike_factor);
+/* 在 sink 的 sink pad 上测量名为 branch 的分支，queue 为该分支的 queue（可以为 NULL） */
+void latency_tracker_watch(LatencyTracker *lt, GstElement *sink, GstElement *queue, const gchar *branch);
+/* element 输出的 buffer 会丢失 meta（例如 wavescope）：把进入的最新时间戳附加到输出上 */
+void latency_tracker_relay(LatencyTracker *lt, GstElement *element);
+/* 打印每个分支的延迟分布和与 queue 水位的相关性 */
+void latency_tracker_print_summary(LatencyTracker *lt);
+void latency_tracker_free(LatencyTracker *lt);
+
+#endif /* LATENCY_STAMP_H */
@@ -0,0 +1,83 @@
+#include "media_files.h"
+
+#include <string.h>
+
+/* g_ptr_array_sort() 传入的是元素的地址 */
+static gint
+compare_paths(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+void
+media_files_add(GPtrArray *uris, const gchar *input)
+{
+    GDir *dir;
+    const gchar *name;
+
+    if (gst_uri_is_valid(input))
+    {
+        g_ptr_array_add(uris, g_strdup(input));
+        return;
+    }
+    if (g_file_test(input, G_FILE_TEST_IS_DIR))
+    {
+        GPtrArray *children = g_ptr_array_new_with_free_func(g_free);
+        guint i;
+
+        dir = g_dir_open(input, 0, NULL);
+        if (dir == NULL)
+        {
+            g_printerr("Could not open directory %s\n", input);
+            g_ptr_array_unref(children);
+            return;
+        }
+        // 跳过隐藏文件；按名字排序，每次运行的顺序相同
+        while ((name = g_dir_read_name(dir)) != NULL)
+        {
+            if (name[0] != '.')
+                g_ptr_array_add(children, g_build_filename(input, name, NULL));
+        }
+        g_dir_close(dir);
+        g_ptr_array_sort(children, compare_paths);
+        for (i = 0; i < children->len; i++)
+            media_files_add(uris, g_ptr_array_index(children, i));
+        g_ptr_array_unref(children);
+        return;
+    }
+    if (g_file_test(input, G_FILE_TEST_IS_REGULAR))
+    {
+        gchar *uri = gst_filename_to_uri(input, NULL);
+
+        if (uri != NULL)
+            g_ptr_array_add(uris, uri);
+        return;
+    }
+    g_printerr("Skipping %s: not a file, directory or URI\n", input);
+}
+
+gboolean
+media_files_add_list(GPtrArray *uris, const gchar *path)
+{
+    gchar *contents, **lines;
+    GError *error = NULL;
+    guint i;
+
+    if (!g_file_get_contents(path, &contents, NULL, &error))
+    {
+        g_printerr("Could not read %s: %s\n", path, error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        gchar *line = g_strstrip(lines[i]);
+
+        if (line[0] != '\0' && line[0] != '#')
+            media_files_add(uris, line);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return TRUE;
+}
@@ -0,0 +1,20 @@
+#ifndef MEDIA_FILES_H
+#define MEDIA_FILES_H
+
+#include <gst/gst.h>
+
+/**
+ * 收集要处理的媒体文件（14 批量解码、15 元数据索引共用）
+ *
+ * - 目录：递归查找，跳过隐藏文件，按名字排序（每次运行的顺序相同）
+ * - 普通文件：转换成 file:// URI（gst_filename_to_uri()，相对路径按当前目录转换成绝对路径）
+ * - URI：原样加入
+ *
+ * uris 是元素为 gchar * 的 GPtrArray，由调用者创建（free_func 为 g_free）。
+ */
+
+void media_files_add(GPtrArray *uris, const gchar *input);
+/* 列表文件：每行一个路径或 URI，忽略空行和 # 开头的注释 */
+gboolean media_files_add_list(GPtrArray *uris, const gchar *path);
+
+#endif /* MEDIA_FILES_H */
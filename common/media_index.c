@@ -0,0 +1,313 @@
+#include "media_index.h"
+
+#include <string.h>
+
+#define ALIGN8(n) (((n) + 7) & ~(gsize)7)
+
+/* FNV-1a（32 位）：URI 很短，简单的逐字节哈希就足够快 */
+static guint32
+uri_hash(const gchar *uri)
+{
+    guint32 h = 2166136261u;
+
+    for (; *uri; uri++)
+        h = (h ^ (guint8)*uri) * 16777619u;
+    return h;
+}
+
+/* ################## 生成索引 ################## */
+
+struct _MediaIndexWriter
+{
+    GArray *files;        /* MediaIndexFile */
+    GArray *streams;      /* MediaIndexStream */
+    GString *strings;     /* 所有字符串，以 \0 分隔 */
+    GHashTable *offsets;  /* 字符串 -> 偏移 + 1（去重） */
+};
+
+MediaIndexWriter *
+media_index_writer_new(void)
+{
+    MediaIndexWriter *w = g_new0(MediaIndexWriter, 1);
+
+    w->files = g_array_new(FALSE, TRUE, sizeof(MediaIndexFile));
+    w->streams = g_array_new(FALSE, TRUE, sizeof(MediaIndexStream));
+    // 偏移 0 是空字符串
+    w->strings = g_string_new_len("", 1);
+    w->offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    return w;
+}
+
+/* 加入一个字符串，返回它的偏移；编码名、语言在整个库中只有很少几种，去重之后几乎不占空间 */
+static guint32
+writer_string(MediaIndexWriter *w, const gchar *str)
+{
+    gpointer offset;
+
+    if (str == NULL || str[0] == '\0')
+        return 0;
+    offset = g_hash_table_lookup(w->offsets, str);
+    if (offset != NULL)
+        return GPOINTER_TO_UINT(offset) - 1;
+    offset = GUINT_TO_POINTER(w->strings->len + 1);
+    g_string_append_len(w->strings, str, strlen(str) + 1);
+    g_hash_table_insert(w->offsets, g_strdup(str), offset);
+    return GPOINTER_TO_UINT(offset) - 1;
+}
+
+void
+media_index_writer_add_file(MediaIndexWriter *w, const gchar *uri, const gchar *container,
+                            GstClockTime duration, gboolean seekable)
+{
+    MediaIndexFile file = {0};
+
+    file.duration = duration;
+    // URI 几乎都不相同，不参与去重，直接追加
+    file.uri = w->strings->len;
+    g_string_append_len(w->strings, uri, strlen(uri) + 1);
+    file.hash = uri_hash(uri);
+    file.container = writer_string(w, container);
+    file.first_stream = w->streams->len;
+    file.flags = seekable ? MEDIA_INDEX_SEEKABLE : 0;
+    g_array_append_val(w->files, file);
+}
+
+void
+media_index_writer_add_stream(MediaIndexWriter *w, MediaStreamType type, const MediaIndexStream *stream,
+                              const gchar *codec, const gchar *language)
+{
+    MediaIndexFile *file = &g_array_index(w->files, MediaIndexFile, w->files->len - 1);
+    MediaIndexStream s = *stream;
+
+    s.codec = writer_string(w, codec);
+    s.language = writer_string(w, language);
+    g_array_append_val(w->streams, s);
+    if (type == MEDIA_STREAM_VIDEO)
+        file->n_video++;
+    else if (type == MEDIA_STREAM_AUDIO)
+        file->n_audio++;
+    else
+        file->n_text++;
+}
+
+gsize
+media_index_writer_save(MediaIndexWriter *w, const gchar *path, GError **error)
+{
+    MediaIndexHeader header;
+    guint32 *buckets, mask, i;
+    GByteArray *out;
+    gboolean ok;
+    gsize size;
+
+    memset(&header, 0, sizeof(header));
+
+    // 装载因子不超过 0.5，开放寻址的探测次数很少
+    header.n_buckets = 16;
+    while (header.n_buckets < w->files->len * 2)
+        header.n_buckets *= 2;
+    mask = header.n_buckets - 1;
+    buckets = g_new0(guint32, header.n_buckets);
+    for (i = 0; i < w->files->len; i++)
+    {
+        guint32 b = g_array_index(w->files, MediaIndexFile, i).hash & mask;
+
+        while (buckets[b] != 0)
+            b = (b + 1) & mask;
+        buckets[b] = i + 1;
+    }
+
+    memcpy(header.magic, MEDIA_INDEX_MAGIC, sizeof(header.magic));
+    header.version = MEDIA_INDEX_VERSION;
+    header.byte_order = MEDIA_INDEX_BYTE_ORDER;
+    header.n_files = w->files->len;
+    header.n_streams = w->streams->len;
+    header.strings_size = w->strings->len;
+    header.files_offset = ALIGN8(sizeof(header));
+    header.streams_offset = ALIGN8(header.files_offset + (gsize)w->files->len * sizeof(MediaIndexFile));
+    header.buckets_offset = ALIGN8(header.streams_offset + (gsize)w->streams->len * sizeof(MediaIndexStream));
+    header.strings_offset = ALIGN8(header.buckets_offset + (gsize)header.n_buckets * sizeof(guint32));
+    size = header.strings_offset + w->strings->len;
+
+    out = g_byte_array_sized_new(size);
+    g_byte_array_set_size(out, size);
+    memset(out->data, 0, size);
+    memcpy(out->data, &header, sizeof(header));
+    memcpy(out->data + header.files_offset, w->files->data, (gsize)w->files->len * sizeof(MediaIndexFile));
+    memcpy(out->data + header.streams_offset, w->streams->data, (gsize)w->streams->len * sizeof(MediaIndexStream));
+    memcpy(out->data + header.buckets_offset, buckets, (gsize)header.n_buckets * sizeof(guint32));
+    memcpy(out->data + header.strings_offset, w->strings->str, w->strings->len);
+    g_free(buckets);
+
+    // g_file_set_contents() 先写临时文件再重命名
+    ok = g_file_set_contents(path, (const gchar *)out->data, size, error);
+    g_byte_array_unref(out);
+    return ok ? size : 0;
+}
+
+void
+media_index_writer_free(MediaIndexWriter *w)
+{
+    g_array_unref(w->files);
+    g_array_unref(w->streams);
+    g_string_free(w->strings, TRUE);
+    g_hash_table_unref(w->offsets);
+    g_free(w);
+}
+
+/* ################## 查询 ################## */
+
+/* 检查 [offset, offset + count * size) 在文件范围内 */
+static gboolean
+section_valid(gsize length, guint64 offset, guint64 count, gsize size)
+{
+    return offset % 8 == 0 && offset <= length && count <= (length - offset) / size;
+}
+
+/* 打开时只检查头部和各部分的范围，不遍历所有记录（否则每次打开都要读入整个文件） */
+static gboolean
+index_valid(const MediaIndex *index, gsize length)
+{
+    const MediaIndexHeader *h = index->header;
+
+    return section_valid(length, h->files_offset, h->n_files, sizeof(MediaIndexFile)) &&
+           section_valid(length, h->streams_offset, h->n_streams, sizeof(MediaIndexStream)) &&
+           section_valid(length, h->buckets_offset, h->n_buckets, sizeof(guint32)) &&
+           section_valid(length, h->strings_offset, h->strings_size, 1) &&
+           h->strings_size > 0 && index->strings[h->strings_size - 1] == '\0' &&
+           h->n_buckets > h->n_files && (h->n_buckets & (h->n_buckets - 1)) == 0;
+}
+
+/* 查询到的记录在返回之前检查：流和字符串的偏移都在范围内 */
+static gboolean
+file_valid(const MediaIndex *index, const MediaIndexFile *file)
+{
+    const MediaIndexHeader *h = index->header;
+    guint32 i, n = file->n_video + file->n_audio + file->n_text;
+
+    if (file->container >= h->strings_size || (guint64)file->first_stream + n > h->n_streams)
+        return FALSE;
+    for (i = 0; i < n; i++)
+    {
+        const MediaIndexStream *s = &index->streams[file->first_stream + i];
+
+        if (s->codec >= h->strings_size || s->language >= h->strings_size)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean
+media_index_open(MediaIndex *index, const gchar *path, GError **error)
+{
+    const guint8 *data;
+    gsize length;
+
+    memset(index, 0, sizeof(*index));
+    // 只读映射：只有查询时访问到的页才会被读入
+    index->file = g_mapped_file_new(path, FALSE, error);
+    if (index->file == NULL)
+        return FALSE;
+    data = (const guint8 *)g_mapped_file_get_contents(index->file);
+    length = g_mapped_file_get_length(index->file);
+    index->header = (const MediaIndexHeader *)data;
+    if (length < sizeof(MediaIndexHeader) || memcmp(index->header->magic, MEDIA_INDEX_MAGIC, 8) != 0 ||
+        index->header->version != MEDIA_INDEX_VERSION || index->header->byte_order != MEDIA_INDEX_BYTE_ORDER)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: not a media index (version %u)", path, MEDIA_INDEX_VERSION);
+        media_index_close(index);
+        return FALSE;
+    }
+    index->files = (const MediaIndexFile *)(data + index->header->files_offset);
+    index->streams = (const MediaIndexStream *)(data + index->header->streams_offset);
+    index->buckets = (const guint32 *)(data + index->header->buckets_offset);
+    index->strings = (const gchar *)(data + index->header->strings_offset);
+    if (!index_valid(index, length))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: corrupted media index", path);
+        media_index_close(index);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+const MediaIndexFile *
+media_index_lookup(const MediaIndex *index, const gchar *uri)
+{
+    guint32 hash = uri_hash(uri), mask = index->header->n_buckets - 1, b, slot, probes;
+
+    // 空桶结束探测；装载因子不超过 0.5，正常的索引一定存在空桶，
+    // 但桶表不会在打开时逐个检查，损坏的索引可能没有空桶，所以最多探测 n_buckets 次
+    for (b = hash & mask, probes = 0; probes < index->header->n_buckets && (slot = index->buckets[b]) != 0;
+         b = (b + 1) & mask, probes++)
+    {
+        const MediaIndexFile *file;
+
+        if (slot > index->header->n_files)
+            return NULL;
+        file = &index->files[slot - 1];
+        if (file->hash == hash && file->uri < index->header->strings_size &&
+            strcmp(index->strings + file->uri, uri) == 0)
+            return file_valid(index, file) ? file : NULL;
+    }
+    return NULL;
+}
+
+const MediaIndexStream *
+media_index_file_streams(const MediaIndex *index, const MediaIndexFile *file)
+{
+    return &index->streams[file->first_stream];
+}
+
+const gchar *
+media_index_string(const MediaIndex *index, guint32 offset)
+{
+    return index->strings + offset;
+}
+
+void
+media_index_print(const MediaIndex *index, const MediaIndexFile *file)
+{
+    const MediaIndexStream *s = media_index_file_streams(index, file);
+    gint idx;
+
+    g_print("%d video stream(s), %d audio stream(s), %d text stream(s)\n",
+            file->n_video, file->n_audio, file->n_text);
+
+    g_print("\n");
+    for (idx = 0; idx < file->n_video; idx++, s++)
+    {
+        g_print("video stream %d:\n", idx);
+        if (s->codec)
+            g_print("\t codec: %s\n", media_index_string(index, s->codec));
+        if (s->width)
+            g_print("\t size: %ux%u @ %u/%u\n", s->width, s->height, s->fps_n, s->fps_d);
+    }
+
+    g_print("\n");
+    for (idx = 0; idx < file->n_audio; idx++, s++)
+    {
+        g_print("audio stream %d:\n", idx);
+        if (s->codec)
+            g_print("\t codec: %s\n", media_index_string(index, s->codec));
+        if (s->language)
+            g_print("\t language: %s\n", media_index_string(index, s->language));
+        if (s->bitrate)
+            g_print("\t bitrate: %u\n", s->bitrate);
+    }
+
+    g_print("\n");
+    for (idx = 0; idx < file->n_text; idx++, s++)
+    {
+        g_print("subtitle stream %d:\n", idx);
+        if (s->language)
+            g_print("\t language: %s\n", media_index_string(index, s->language));
+    }
+}
+
+void
+media_index_close(MediaIndex *index)
+{
+    if (index->file)
+        g_mapped_file_unref(index->file);
+    index->file = NULL;
+}
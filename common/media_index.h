@@ -0,0 +1,108 @@
+#ifndef MEDIA_INDEX_H
+#define MEDIA_INDEX_H
+
+#include <gst/gst.h>
+
+/**
+ * 媒体元数据索引（15 示例生成，09 示例在播放之前查询）
+ *
+ * 09 的 analyze_streams() 要等 pipeline 进入 PLAYING 之后，才能通过 get-video-tags 等信号取得流信息。
+ * 索引文件预先保存每个文件的流信息（流数量、编码、语言、比特率、分辨率、采样率），查询时：
+ *
+ * - 整个文件用 GMappedFile 只读映射，不解析、不拷贝，结构体直接指向映射的内存
+ * - URI 的 FNV-1a 哈希 + 开放寻址哈希表，一次查询通常只比较一次字符串
+ * - 字符串（URI、编码名、语言）集中存放并去重，结构体中只保存偏移量；偏移 0 是空字符串，表示没有
+ *
+ * 文件布局（所有整数按生成索引的机器的字节序，各部分按 8 字节对齐）：
+ *
+ *   MediaIndexHeader
+ *   MediaIndexFile[n_files]
+ *   MediaIndexStream[n_streams]    每个文件的流连续存放：先视频，再音频，最后字幕
+ *   guint32 buckets[n_buckets]     文件下标 + 1，0 表示空
+ *   gchar strings[strings_size]
+ */
+
+#define MEDIA_INDEX_MAGIC "GSTMIDX1"
+#define MEDIA_INDEX_VERSION 1
+#define MEDIA_INDEX_BYTE_ORDER 0x01020304
+
+#define MEDIA_INDEX_SEEKABLE (1 << 0)
+
+typedef enum
+{
+    MEDIA_STREAM_VIDEO,
+    MEDIA_STREAM_AUDIO,
+    MEDIA_STREAM_TEXT
+} MediaStreamType;
+
+typedef struct _MediaIndexHeader
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 byte_order; /* MEDIA_INDEX_BYTE_ORDER，用另一种字节序的机器打开时不相等 */
+    guint32 n_files;
+    guint32 n_streams;
+    guint32 n_buckets;  /* 哈希表大小（2 的幂） */
+    guint32 strings_size;
+    guint64 files_offset, streams_offset, buckets_offset, strings_offset;
+} MediaIndexHeader;
+
+typedef struct _MediaIndexFile
+{
+    guint64 duration;      /* 纳秒，GST_CLOCK_TIME_NONE 表示未知 */
+    guint32 uri;           /* 字符串偏移 */
+    guint32 hash;          /* URI 的哈希值，探测时先比较哈希 */
+    guint32 container;     /* 容器格式（字符串偏移） */
+    guint32 first_stream;  /* 第一个流在 MediaIndexStream 数组中的下标 */
+    guint16 n_video, n_audio, n_text;
+    guint16 flags;         /* MEDIA_INDEX_SEEKABLE */
+} MediaIndexFile;
+
+typedef struct _MediaIndexStream
+{
+    guint32 codec;         /* 字符串偏移 */
+    guint32 language;      /* 字符串偏移（音频、字幕） */
+    guint32 bitrate;       /* bit/s，0 表示未知 */
+    guint32 max_bitrate;
+    guint32 width, height; /* 视频 */
+    guint32 fps_n, fps_d;  /* 视频 */
+    guint32 channels, rate; /* 音频 */
+} MediaIndexStream;
+
+/* 生成索引 */
+typedef struct _MediaIndexWriter MediaIndexWriter;
+
+MediaIndexWriter *media_index_writer_new(void);
+/* 开始一个文件，之后用 media_index_writer_add_stream() 加入它的流（必须按视频、音频、字幕的顺序） */
+void media_index_writer_add_file(MediaIndexWriter *w, const gchar *uri, const gchar *container,
+                                 GstClockTime duration, gboolean seekable);
+/* 加入当前文件的一个流，stream 中的 codec/language 字段被忽略，使用后两个参数（可以为 NULL） */
+void media_index_writer_add_stream(MediaIndexWriter *w, MediaStreamType type, const MediaIndexStream *stream,
+                                   const gchar *codec, const gchar *language);
+/* 写入文件（先写临时文件再重命名，读者不会看到写了一半的索引），返回写入的字节数，失败返回 0 */
+gsize media_index_writer_save(MediaIndexWriter *w, const gchar *path, GError **error);
+void media_index_writer_free(MediaIndexWriter *w);
+
+/* 查询索引 */
+typedef struct _MediaIndex
+{
+    GMappedFile *file;                /* 映射的文件，NULL 表示未打开 */
+    const MediaIndexHeader *header;
+    const MediaIndexFile *files;
+    const MediaIndexStream *streams;
+    const guint32 *buckets;
+    const gchar *strings;
+} MediaIndex;
+
+/* 映射索引并检查头部（各部分都在文件范围内）；记录本身在查询到时才检查，只有访问到的页会被读入 */
+gboolean media_index_open(MediaIndex *index, const gchar *path, GError **error);
+/* 按 URI 查找，不存在时返回 NULL */
+const MediaIndexFile *media_index_lookup(const MediaIndex *index, const gchar *uri);
+/* 文件的第一个流，之后依次是 n_video 个视频流、n_audio 个音频流、n_text 个字幕流 */
+const MediaIndexStream *media_index_file_streams(const MediaIndex *index, const MediaIndexFile *file);
+const gchar *media_index_string(const MediaIndex *index, guint32 offset);
+/* 按 09 的 analyze_streams() 的格式输出 */
+void media_index_print(const MediaIndex *index, const MediaIndexFile *file);
+void media_index_close(MediaIndex *index);
+
+#endif /* MEDIA_INDEX_H */
@@ -0,0 +1,169 @@
+#include "pcm_replay.h"
+
+#include <string.h>
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static guint16
+read_le16(const guint8 *p)
+{
+    guint16 v;
+
+    memcpy(&v, p, sizeof(v));
+    return GUINT16_FROM_LE(v);
+}
+
+static guint32
+read_le32(const guint8 *p)
+{
+    guint32 v;
+
+    memcpy(&v, p, sizeof(v));
+    return GUINT32_FROM_LE(v);
+}
+
+/**
+ * 解析 WAV 头：RIFF <size> WAVE，之后是若干个 <id><size><data> 块，
+ * 需要 "fmt " 块（格式）和 "data" 块（PCM 数据），其他块（LIST 等）跳过。
+ */
+static gboolean
+parse_wav(PcmReplay *pr, const guint8 *file, gsize length, GError **error)
+{
+    const guint8 *p = file + 12, *end = file + length;
+    guint16 format = 0, channels = 0, bits = 0;
+    guint32 rate = 0;
+    GstAudioFormat audio_format;
+
+    if (length < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "not a RIFF/WAVE file");
+        return FALSE;
+    }
+
+    while (end - p >= 8)
+    {
+        guint32 chunk_size = read_le32(p + 4);
+        const guint8 *body = p + 8;
+        gsize available = end - body;
+
+        if (memcmp(p, "fmt ", 4) == 0 && chunk_size >= 16 && available >= 16)
+        {
+            format = read_le16(body);
+            channels = read_le16(body + 2);
+            rate = read_le32(body + 4);
+            bits = read_le16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE：真正的格式在 SubFormat GUID 的前两个字节
+            if (format == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 26 && available >= 26)
+                format = read_le16(body + 24);
+        }
+        else if (memcmp(p, "data", 4) == 0)
+        {
+            if (rate == 0 || channels == 0)
+                break;
+            pr->data = body;
+            // 录音程序被中断时 data 块的大小可能不正确，以文件实际长度为准
+            pr->size = MIN((gsize)chunk_size, available);
+            break;
+        }
+        // 块按 2 字节对齐
+        if ((gsize)chunk_size + (chunk_size & 1) > available)
+            break;
+        p = body + chunk_size + (chunk_size & 1);
+    }
+
+    if (pr->data == NULL)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "missing fmt or data chunk");
+        return FALSE;
+    }
+    if (format == WAVE_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+        audio_format = gst_audio_format_build_integer(bits != 8, G_LITTLE_ENDIAN, bits, bits); // 8 位 WAV 是无符号的
+    else if (format == WAVE_FORMAT_IEEE_FLOAT && (bits == 32 || bits == 64))
+        audio_format = bits == 32 ? GST_AUDIO_FORMAT_F32LE : GST_AUDIO_FORMAT_F64LE;
+    else
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "unsupported WAV format 0x%04x with %u bits", format, bits);
+        return FALSE;
+    }
+    gst_audio_info_set_format(&pr->info, audio_format, rate, channels, NULL);
+    return TRUE;
+}
+
+gboolean
+pcm_replay_open(PcmReplay *pr, const gchar *path, gboolean loop, gint raw_rate, gint raw_channels, GError **error)
+{
+    const guint8 *file;
+    gsize length;
+
+    memset(pr, 0, sizeof(*pr));
+    pr->loop = loop;
+    // 只读映射：文件内容按需由页缓存换入，不占用额外的内存
+    pr->file = g_mapped_file_new(path, FALSE, error);
+    if (pr->file == NULL)
+        return FALSE;
+    file = (const guint8 *)g_mapped_file_get_contents(pr->file);
+    length = g_mapped_file_get_length(pr->file);
+
+    if (g_str_has_suffix(path, ".wav") || g_str_has_suffix(path, ".WAV"))
+    {
+        if (!parse_wav(pr, file, length, error))
+        {
+            g_prefix_error(error, "%s: ", path);
+            pcm_replay_close(pr);
+            return FALSE;
+        }
+    }
+    else
+    {
+        pr->data = file;
+        pr->size = length;
+        gst_audio_info_set_format(&pr->info, GST_AUDIO_FORMAT_S16LE, raw_rate, raw_channels, NULL);
+    }
+
+    // 丢弃末尾不完整的帧
+    pr->size -= pr->size % GST_AUDIO_INFO_BPF(&pr->info);
+    if (pr->size == 0)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: no audio data", path);
+        pcm_replay_close(pr);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+GstBuffer *
+pcm_replay_next(PcmReplay *pr, gsize chunk_bytes)
+{
+    guint bpf = GST_AUDIO_INFO_BPF(&pr->info);
+    gsize size;
+
+    if (pr->offset >= pr->size)
+    {
+        if (!pr->loop)
+            return NULL;
+        pr->offset = 0;
+        pr->loops++;
+    }
+    size = MIN(MAX(chunk_bytes - chunk_bytes % bpf, bpf), pr->size - pr->offset);
+
+    /**
+     * 零拷贝：buffer 的内存直接指向映射中的数据（只读），
+     * buffer 持有 GMappedFile 的一个引用，最后一个 buffer 释放时才调用 g_mapped_file_unref()
+     */
+    g_mapped_file_ref(pr->file);
+    pr->offset += size;
+    return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, (gpointer)(pr->data + pr->offset - size), size, 0, size,
+                                       pr->file, (GDestroyNotify)g_mapped_file_unref);
+}
+
+void
+pcm_replay_close(PcmReplay *pr)
+{
+    // 仍在下游流动的 buffer 持有自己的引用，映射在它们全部释放后才解除
+    if (pr->file)
+        g_mapped_file_unref(pr->file);
+    pr->file = NULL;
+    pr->data = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef PCM_REPLAY_H
+#define PCM_REPLAY_H
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+/**
+ * 内存映射的 PCM 文件回放（替代合成波形，用于压力测试）
+ *
+ * - 用 GMappedFile 把整个文件映射到内存，不读取、不拷贝
+ * - 每个 chunk 用 gst_buffer_new_wrapped_full() 包装映射中的一段，buffer 持有 GMappedFile 的引用，
+ *   下游释放最后一个 buffer 之前映射不会被解除
+ * - 支持 WAV（PCM/IEEE float，解析 RIFF 头）和无头的原始 S16LE 数据（采样率和声道数由调用者指定）
+ * - 可选循环播放：到达文件末尾后从头开始
+ */
+typedef struct _PcmReplay
+{
+    GMappedFile *file;  /* 映射的文件，NULL 表示未打开 */
+    const guint8 *data; /* PCM 数据的起始位置（跳过 WAV 头） */
+    gsize size;         /* PCM 数据的字节数（整数帧） */
+    GstAudioInfo info;  /* 数据格式 */
+    gsize offset;       /* 下一个 chunk 的起始位置（字节） */
+    gboolean loop;      /* 到达末尾后从头开始 */
+    guint loops;        /* 从头重新开始的次数 */
+} PcmReplay;
+
+/**
+ * 打开并映射文件。扩展名为 .wav 时解析 WAV 头，否则按原始 S16LE 处理，使用 raw_rate/raw_channels。
+ * 失败时返回 FALSE 并设置 error。
+ */
+gboolean pcm_replay_open(PcmReplay *pr, const gchar *path, gboolean loop, gint raw_rate, gint raw_channels, GError **error);
+/* 取下一个 chunk（最多 chunk_bytes 字节，向下取整为整数帧，零拷贝）；不循环时到达末尾返回 NULL */
+GstBuffer *pcm_replay_next(PcmReplay *pr, gsize chunk_bytes);
+void pcm_replay_close(PcmReplay *pr);
+
+#endif /* PCM_REPLAY_H */
@@ -0,0 +1,79 @@
+#include "push_batch.h"
+
+void
+push_batch_init(PushBatch *pb, GstElement *app_src, guint batch_size,
+                GstClockTime latency_budget, GstClockTime chunk_duration)
+{
+    pb->app_src = GST_APP_SRC(app_src);
+    pb->batch_size = MAX(batch_size, 1);
+    pb->list = NULL;
+    pb->list_duration = 0;
+    pb->latency_budget = latency_budget;
+    pb->pushes = 0;
+    pb->buffers = 0;
+
+    // 延迟预算换算成 chunk 个数：批次覆盖的时长不超过预算（至少 1 个 chunk）
+    if (GST_CLOCK_TIME_IS_VALID(latency_budget) && chunk_duration > 0)
+        pb->batch_size = CLAMP(latency_budget / chunk_duration, 1, pb->batch_size);
+}
+
+GstFlowReturn
+push_batch_flush(PushBatch *pb)
+{
+    GstBufferList *list = pb->list;
+    guint length;
+
+    if (list == NULL)
+        return GST_FLOW_OK;
+    pb->list = NULL;
+    pb->list_duration = 0;
+
+    length = gst_buffer_list_length(list);
+    g_atomic_int_inc(&pb->pushes);
+    g_atomic_int_add(&pb->buffers, length);
+    // 只有一个 buffer 时不必经过列表
+    if (length == 1)
+    {
+        GstBuffer *buffer = gst_buffer_ref(gst_buffer_list_get(list, 0));
+
+        gst_buffer_list_unref(list);
+        return gst_app_src_push_buffer(pb->app_src, buffer);
+    }
+    // 接管 list 的所有权
+    return gst_app_src_push_buffer_list(pb->app_src, list);
+}
+
+GstFlowReturn
+push_batch_add(PushBatch *pb, GstBuffer *buffer)
+{
+    if (pb->list == NULL)
+        pb->list = gst_buffer_list_new_sized(pb->batch_size);
+    if (GST_BUFFER_DURATION_IS_VALID(buffer))
+        pb->list_duration += GST_BUFFER_DURATION(buffer);
+    gst_buffer_list_add(pb->list, buffer);
+
+    // 达到批次大小，或者已经用完延迟预算（chunk 时长不固定时）
+    if (gst_buffer_list_length(pb->list) >= pb->batch_size ||
+        (GST_CLOCK_TIME_IS_VALID(pb->latency_budget) && pb->list_duration >= pb->latency_budget))
+        return push_batch_flush(pb);
+    return GST_FLOW_OK;
+}
+
+void
+push_batch_clear(PushBatch *pb)
+{
+    if (pb->list)
+        gst_buffer_list_unref(pb->list);
+    pb->list = NULL;
+    pb->list_duration = 0;
+}
+
+void
+push_batch_print_stats(PushBatch *pb, const gchar *prefix)
+{
+    gint pushes = g_atomic_int_get(&pb->pushes);
+    gint buffers = g_atomic_int_get(&pb->buffers);
+
+    g_print("%sappsrc: %d pushes, %d buffers (%.1f buffers per push, batch size %u)\n",
+            prefix, pushes, buffers, pushes ? (gdouble)buffers / pushes : 0.0, pb->batch_size);
+}
@@ -0,0 +1,44 @@
+#ifndef PUSH_BATCH_H
+#define PUSH_BATCH_H
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+/**
+ * appsrc 批量推送（GstBufferList）
+ *
+ * 原来每个 chunk 都通过 g_signal_emit_by_name(app_src, "push-buffer", ...) 推送，
+ * 每个 buffer 都要付出一次 GObject 信号封送（marshalling）和一次下游 chain 调用的开销。
+ * 这里把 N 个 chunk 攒成一个 GstBufferList，再用 gst_app_src_push_buffer_list() 一次推送：
+ * - 直接调用 gst_app_src_* 接口，不经过信号
+ * - 下游支持 chain_list 的元素（queue、tee 等）一次处理整个列表
+ *
+ * 攒批会增加延迟：列表中第一个 chunk 要等最后一个 chunk 生成后才被推送。
+ * latency_budget 限制一个批次覆盖的最大时长，批次大小取 batch_size 与 latency_budget 允许的较小值。
+ */
+typedef struct _PushBatch
+{
+    GstAppSrc *app_src;          /* 推送目标 */
+    guint batch_size;            /* 实际的批次大小（chunk 个数），1 表示逐个 buffer 推送 */
+    GstBufferList *list;         /* 正在攒的批次，NULL 表示为空 */
+    GstClockTime list_duration;  /* 当前批次覆盖的时长 */
+    GstClockTime latency_budget; /* 一个批次最多覆盖的时长，GST_CLOCK_TIME_NONE 表示不限制 */
+    gint pushes;                 /* 调用 push 的次数（原子操作） */
+    gint buffers;                /* 推送的 buffer 总数（原子操作） */
+} PushBatch;
+
+/**
+ * 初始化：chunk_duration 是一个 chunk 的时长，用来把 latency_budget 换算成批次大小。
+ * latency_budget 为 GST_CLOCK_TIME_NONE 时只按 batch_size 攒批。
+ */
+void push_batch_init(PushBatch *pb, GstElement *app_src, guint batch_size,
+                     GstClockTime latency_budget, GstClockTime chunk_duration);
+/* 加入一个 buffer（接管所有权），批次满了就推送；返回推送结果，未推送时返回 GST_FLOW_OK */
+GstFlowReturn push_batch_add(PushBatch *pb, GstBuffer *buffer);
+/* 推送当前批次中剩余的 buffer（批次为空时什么也不做） */
+GstFlowReturn push_batch_flush(PushBatch *pb);
+/* 丢弃未推送的 buffer */
+void push_batch_clear(PushBatch *pb);
+void push_batch_print_stats(PushBatch *pb, const gchar *prefix);
+
+#endif /* PUSH_BATCH_H */
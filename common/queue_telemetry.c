@@ -0,0 +1,242 @@
+#include "queue_telemetry.h"
+
+#include <stdio.h>
+
+#define BACKPRESSURE_FILL 90.0 /* 填充率超过这个百分比（并且发生了 overrun）就认为该分支在阻塞 tee */
+
+/* 一个分支 */
+typedef struct _Branch
+{
+    GstElement *queue;
+    gchar *name;
+    guint max_buffers;     /* queue 的三个上限，0 表示不限制 */
+    guint max_bytes;
+    guint64 max_time;
+    gint overruns;         /* overrun 信号次数（原子操作，信号在流线程中发出） */
+    gint underruns;        /* underrun 信号次数（原子操作） */
+    gint last_overruns;    /* 上一次采样时的 overrun 次数（只由采样线程访问） */
+    gdouble max_fill;      /* 最大填充率（%） */
+    guint flagged;         /* 被标记为反压来源的采样次数 */
+} Branch;
+
+struct _QueueTelemetry
+{
+    guint interval_ms;
+    gchar *csv_path;
+    FILE *csv;
+    GPtrArray *branches; /* Branch */
+    GThread *thread;
+    GMutex lock;         /* 与 cond 一起用于可中断的休眠 */
+    GCond cond;
+    gboolean stop;
+    gint64 start_time;
+    gchar *culprit;      /* 当前被标记的分支名，只在变化时打印 */
+};
+
+static void
+on_overrun(GstElement *queue, Branch *branch)
+{
+    g_atomic_int_inc(&branch->overruns);
+}
+
+static void
+on_underrun(GstElement *queue, Branch *branch)
+{
+    g_atomic_int_inc(&branch->underruns);
+}
+
+static void
+branch_free(Branch *branch)
+{
+    g_signal_handlers_disconnect_by_data(branch->queue, branch);
+    gst_object_unref(branch->queue);
+    g_free(branch->name);
+    g_free(branch);
+}
+
+QueueTelemetry *
+queue_telemetry_new(guint interval_ms, const gchar *csv_path)
+{
+    QueueTelemetry *qt = g_new0(QueueTelemetry, 1);
+
+    qt->interval_ms = MAX(interval_ms, 1);
+    qt->csv_path = g_strdup(csv_path);
+    qt->branches = g_ptr_array_new_with_free_func((GDestroyNotify)branch_free);
+    g_mutex_init(&qt->lock);
+    g_cond_init(&qt->cond);
+    return qt;
+}
+
+void
+queue_telemetry_add(QueueTelemetry *qt, GstElement *queue, const gchar *branch_name)
+{
+    Branch *branch = g_new0(Branch, 1);
+
+    branch->queue = gst_object_ref(queue);
+    branch->name = g_strdup(branch_name);
+    g_object_get(queue,
+                 "max-size-buffers", &branch->max_buffers,
+                 "max-size-bytes", &branch->max_bytes,
+                 "max-size-time", &branch->max_time,
+                 NULL);
+    g_signal_connect(queue, "overrun", G_CALLBACK(on_overrun), branch);
+    g_signal_connect(queue, "underrun", G_CALLBACK(on_underrun), branch);
+    g_ptr_array_add(qt->branches, branch);
+}
+
+/* 填充率：三个上限中最接近的那个（queue 达到任何一个上限都会阻塞） */
+static gdouble
+fill_percent(Branch *branch, guint buffers, guint bytes, guint64 time)
+{
+    gdouble fill = 0;
+
+    if (branch->max_buffers)
+        fill = MAX(fill, 100.0 * buffers / branch->max_buffers);
+    if (branch->max_bytes)
+        fill = MAX(fill, 100.0 * bytes / branch->max_bytes);
+    if (branch->max_time)
+        fill = MAX(fill, 100.0 * time / branch->max_time);
+    return fill;
+}
+
+static void
+sample_once(QueueTelemetry *qt)
+{
+    gint64 now_ms = (g_get_monotonic_time() - qt->start_time) / 1000;
+    Branch *culprit = NULL;
+    gdouble culprit_fill = 0;
+    guint i;
+
+    for (i = 0; i < qt->branches->len; i++)
+    {
+        Branch *branch = g_ptr_array_index(qt->branches, i);
+        guint buffers, bytes;
+        guint64 time;
+        gint overruns = g_atomic_int_get(&branch->overruns);
+        gint underruns = g_atomic_int_get(&branch->underruns);
+        gdouble fill;
+        gboolean blocking;
+
+        // queue 的属性读取会加 queue 自己的锁，可以在任意线程调用
+        g_object_get(branch->queue,
+                     "current-level-buffers", &buffers,
+                     "current-level-bytes", &bytes,
+                     "current-level-time", &time,
+                     NULL);
+        fill = fill_percent(branch, buffers, bytes, time);
+        branch->max_fill = MAX(branch->max_fill, fill);
+        // 队列接近满并且本周期内发生过 overrun：tee 正阻塞在这个分支上
+        blocking = fill >= BACKPRESSURE_FILL && overruns > branch->last_overruns;
+        branch->last_overruns = overruns;
+        if (blocking)
+        {
+            branch->flagged++;
+            if (culprit == NULL || fill > culprit_fill)
+            {
+                culprit = branch;
+                culprit_fill = fill;
+            }
+        }
+
+        if (qt->csv)
+            fprintf(qt->csv, "%" G_GINT64_FORMAT ",%s,%u,%u,%" G_GUINT64_FORMAT ",%.1f,%d,%d,%d\n",
+                    now_ms, branch->name, buffers, bytes, time, fill, overruns, underruns, blocking);
+    }
+    if (qt->csv)
+        fflush(qt->csv);
+
+    // 反压来源变化时打印一次
+    if (g_strcmp0(qt->culprit, culprit ? culprit->name : NULL) != 0)
+    {
+        if (culprit)
+            g_printerr("[telemetry %" G_GINT64_FORMAT " ms] backpressure from branch '%s' (queue %.0f%% full)\n",
+                       now_ms, culprit->name, culprit_fill);
+        else
+            g_printerr("[telemetry %" G_GINT64_FORMAT " ms] backpressure cleared\n", now_ms);
+        g_free(qt->culprit);
+        qt->culprit = culprit ? g_strdup(culprit->name) : NULL;
+    }
+}
+
+static gpointer
+sampler_loop(QueueTelemetry *qt)
+{
+    gint64 deadline = g_get_monotonic_time();
+
+    g_mutex_lock(&qt->lock);
+    while (!qt->stop)
+    {
+        g_mutex_unlock(&qt->lock);
+        sample_once(qt);
+        g_mutex_lock(&qt->lock);
+        // 按固定节奏采样（不受采样本身耗时的影响），stop 时立即唤醒
+        deadline += qt->interval_ms * G_TIME_SPAN_MILLISECOND;
+        while (!qt->stop && g_cond_wait_until(&qt->cond, &qt->lock, deadline))
+            ;
+    }
+    g_mutex_unlock(&qt->lock);
+    return NULL;
+}
+
+gboolean
+queue_telemetry_start(QueueTelemetry *qt)
+{
+    if (qt->csv_path)
+    {
+        qt->csv = fopen(qt->csv_path, "w");
+        if (qt->csv == NULL)
+        {
+            g_printerr("Could not open %s for writing\n", qt->csv_path);
+            return FALSE;
+        }
+        fprintf(qt->csv, "time_ms,branch,level_buffers,level_bytes,level_time_ns,fill_percent,overruns,underruns,backpressure\n");
+    }
+    qt->start_time = g_get_monotonic_time();
+    qt->thread = g_thread_new("queue-telemetry", (GThreadFunc)sampler_loop, qt);
+    return TRUE;
+}
+
+void
+queue_telemetry_stop(QueueTelemetry *qt)
+{
+    if (qt->thread == NULL)
+        return;
+    g_mutex_lock(&qt->lock);
+    qt->stop = TRUE;
+    g_cond_signal(&qt->cond);
+    g_mutex_unlock(&qt->lock);
+    g_thread_join(qt->thread);
+    qt->thread = NULL;
+    if (qt->csv)
+        fclose(qt->csv);
+    qt->csv = NULL;
+}
+
+void
+queue_telemetry_print_summary(QueueTelemetry *qt)
+{
+    guint i;
+
+    g_print("queue telemetry (%u ms interval%s%s):\n", qt->interval_ms,
+            qt->csv_path ? ", series in " : "", qt->csv_path ? qt->csv_path : "");
+    for (i = 0; i < qt->branches->len; i++)
+    {
+        Branch *branch = g_ptr_array_index(qt->branches, i);
+
+        g_print("  %-12s max fill %5.1f%%, %d overruns, %d underruns, flagged as backpressure %u times\n",
+                branch->name, branch->max_fill, g_atomic_int_get(&branch->overruns),
+                g_atomic_int_get(&branch->underruns), branch->flagged);
+    }
+}
+
+void
+queue_telemetry_free(QueueTelemetry *qt)
+{
+    queue_telemetry_stop(qt);
+    g_ptr_array_unref(qt->branches);
+    g_mutex_clear(&qt->lock);
+    g_cond_clear(&qt->cond);
+    g_free(qt->culprit);
+    g_free(qt->csv_path);
+    g_free(qt);
+}
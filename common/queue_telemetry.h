@@ -0,0 +1,30 @@
+#ifndef QUEUE_TELEMETRY_H
+#define QUEUE_TELEMETRY_H
+
+#include <gst/gst.h>
+
+/**
+ * queue 水位遥测（tee 拓扑中各分支的反压追踪）
+ *
+ * tee 把同一个 buffer 依次推给每个分支，任何一个分支的 queue 满了，tee 就会阻塞在这个分支上，
+ * 其他分支随之断流（queue 被抽空、发出 underrun）。这里用一个采样线程：
+ * - 按固定间隔读取每个 queue 的 current-level-buffers/bytes/time，换算成相对于上限的填充率
+ * - 统计 overrun（队列满）/underrun（队列空）信号的次数
+ * - 每次采样为每个分支写一行 CSV（时间序列）
+ * - 填充率超过阈值并且在本周期内发生了 overrun 的分支被标记为反压来源（backpressure）
+ */
+
+typedef struct _QueueTelemetry QueueTelemetry;
+
+/* interval_ms: 采样间隔；csv_path: CSV 输出文件，NULL 表示只在结束时打印汇总 */
+QueueTelemetry *queue_telemetry_new(guint interval_ms, const gchar *csv_path);
+/* 加入一个分支的 queue（必须在 start 之前调用），branch 为 CSV 中的分支名 */
+void queue_telemetry_add(QueueTelemetry *qt, GstElement *queue, const gchar *branch);
+/* 启动/停止采样线程 */
+gboolean queue_telemetry_start(QueueTelemetry *qt);
+void queue_telemetry_stop(QueueTelemetry *qt);
+/* 打印每个分支的汇总：最大填充率、overrun/underrun 次数、被标记为反压来源的次数 */
+void queue_telemetry_print_summary(QueueTelemetry *qt);
+void queue_telemetry_free(QueueTelemetry *qt);
+
+#endif /* QUEUE_TELEMETRY_H */
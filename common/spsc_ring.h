@@ -0,0 +1,83 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <glib.h>
+
+/**
+ * 无锁单生产者/单消费者（SPSC）环形队列
+ *
+ * - 只允许一个线程调用 spsc_ring_push()，一个线程调用 spsc_ring_pop()
+ * - head 只由生产者写，tail 只由消费者写，双方通过 g_atomic_int_get/set（带内存屏障）读取对方的位置
+ * - head/tail 是一直递增的计数器（允许回绕），下标为 计数器 & mask，所以容量必须是 2 的幂
+ * - 队列满/空时不阻塞，由调用者决定是等待还是丢弃
+ */
+typedef struct _SpscRing
+{
+    gpointer *slots; /* 存放元素的数组 */
+    guint capacity;  /* 容量（2 的幂） */
+    guint mask;      /* capacity - 1 */
+    gint head;       /* 下一个写入位置（生产者） */
+    gint tail;       /* 下一个读取位置（消费者） */
+} SpscRing;
+
+/* 初始化，capacity 向上取整为 2 的幂 */
+static inline void
+spsc_ring_init(SpscRing *ring, guint capacity)
+{
+    guint size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+    ring->slots = g_new0(gpointer, size);
+    ring->capacity = size;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+static inline void
+spsc_ring_clear(SpscRing *ring)
+{
+    g_free(ring->slots);
+    ring->slots = NULL;
+}
+
+/* 当前元素个数（任意线程都可以调用，结果是一个近似值） */
+static inline guint
+spsc_ring_length(SpscRing *ring)
+{
+    return (guint)g_atomic_int_get(&ring->head) - (guint)g_atomic_int_get(&ring->tail);
+}
+
+/* 生产者：放入一个元素，队列已满时返回 FALSE */
+static inline gboolean
+spsc_ring_push(SpscRing *ring, gpointer item)
+{
+    guint head = (guint)ring->head; // 只有生产者写 head，不需要原子读
+    guint tail = (guint)g_atomic_int_get(&ring->tail);
+
+    if (head - tail == ring->capacity)
+        return FALSE;
+    ring->slots[head & ring->mask] = item;
+    // 先写数据再发布 head，消费者看到新的 head 时一定能看到数据
+    g_atomic_int_set(&ring->head, (gint)(head + 1));
+    return TRUE;
+}
+
+/* 消费者：取出一个元素，队列为空时返回 NULL */
+static inline gpointer
+spsc_ring_pop(SpscRing *ring)
+{
+    guint tail = (guint)ring->tail; // 只有消费者写 tail，不需要原子读
+    guint head = (guint)g_atomic_int_get(&ring->head);
+    gpointer item;
+
+    if (head == tail)
+        return NULL;
+    item = ring->slots[tail & ring->mask];
+    // 读完数据再释放槽位
+    g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+    return item;
+}
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE /* cpu_set_t, pthread_setaffinity_np */
+#include "thread_policy.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* 一条规则 */
+typedef struct _PolicyRule
+{
+    gchar *element;     /* 元素名，"*" 匹配所有线程 */
+    gchar *cpus_spec;   /* cpus= 的原始写法，用于打印 */
+    cpu_set_t cpus;
+    gboolean has_nice;
+    gint nice;
+    gint fifo;          /* SCHED_FIFO 优先级，0 表示不修改调度策略 */
+} PolicyRule;
+
+/* 一个被记录的线程 */
+typedef struct _PolicyThread
+{
+    gchar *name;        /* 元素:pad，例如 audio_queue:src */
+    pid_t tid;
+    gchar *applied;     /* 实际生效的策略 */
+    guint64 start_wait; /* ENTER 时 schedstat 的等待时间（纳秒） */
+    guint64 start_slices;
+    guint64 wait;       /* 累计的等待时间（LEAVE 或汇总时计算） */
+    guint64 slices;     /* 累计的运行次数（时间片） */
+    gboolean running;   /* 还没有收到 LEAVE */
+} PolicyThread;
+
+struct _ThreadPolicy
+{
+    GMutex lock;        /* 保护 threads */
+    GPtrArray *rules;   /* PolicyRule，只在启动前修改 */
+    GPtrArray *threads; /* PolicyThread */
+    GstBus *bus;
+    gulong handler_id;
+};
+
+static void
+policy_rule_free(PolicyRule *rule)
+{
+    g_free(rule->element);
+    g_free(rule->cpus_spec);
+    g_free(rule);
+}
+
+static void
+policy_thread_free(PolicyThread *thread)
+{
+    g_free(thread->name);
+    g_free(thread->applied);
+    g_free(thread);
+}
+
+static pid_t
+current_tid(void)
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+/**
+ * 读取线程的调度统计：/proc/self/task/<tid>/schedstat 的三个字段为
+ * 运行时间（纳秒）、在运行队列中等待的时间（纳秒）、运行次数
+ */
+static gboolean
+read_schedstat(pid_t tid, guint64 *wait, guint64 *slices)
+{
+    gchar *path = g_strdup_printf("/proc/self/task/%d/schedstat", (gint)tid);
+    gchar *contents = NULL;
+    guint64 run;
+    gboolean ok;
+
+    ok = g_file_get_contents(path, &contents, NULL, NULL) &&
+         sscanf(contents, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &run, wait, slices) == 3;
+    g_free(contents);
+    g_free(path);
+    return ok;
+}
+
+ThreadPolicy *
+thread_policy_new(void)
+{
+    ThreadPolicy *tp = g_new0(ThreadPolicy, 1);
+
+    g_mutex_init(&tp->lock);
+    tp->rules = g_ptr_array_new_with_free_func((GDestroyNotify)policy_rule_free);
+    tp->threads = g_ptr_array_new_with_free_func((GDestroyNotify)policy_thread_free);
+    return tp;
+}
+
+/* 解析 CPU 列表：0,2-3 */
+static gboolean
+parse_cpus(const gchar *spec, cpu_set_t *cpus)
+{
+    gchar **parts = g_strsplit(spec, ",", -1);
+    gboolean ok = parts[0] != NULL;
+    gint i;
+
+    CPU_ZERO(cpus);
+    for (i = 0; ok && parts[i] != NULL; i++)
+    {
+        gchar *end;
+        gint64 first = g_ascii_strtoll(parts[i], &end, 10), last = first, cpu;
+
+        if (*end == '-')
+            last = g_ascii_strtoll(end + 1, &end, 10);
+        if (*end != '\0' || end == parts[i] || first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            ok = FALSE;
+            break;
+        }
+        for (cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, cpus);
+    }
+    g_strfreev(parts);
+    return ok;
+}
+
+gboolean
+thread_policy_add_rule(ThreadPolicy *tp, const gchar *rule, GError **error)
+{
+    gchar **parts = g_strsplit(rule, ":", -1);
+    PolicyRule *pr;
+    gint i;
+
+    if (parts[0] == NULL || parts[0][0] == '\0' || parts[1] == NULL)
+    {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                    "Thread policy '%s' must look like ELEMENT:key=value[:key=value...]", rule);
+        g_strfreev(parts);
+        return FALSE;
+    }
+
+    pr = g_new0(PolicyRule, 1);
+    pr->element = g_strdup(parts[0]);
+    for (i = 1; parts[i] != NULL; i++)
+    {
+        gchar *value = strchr(parts[i], '=');
+        gchar *end = NULL;
+        gboolean fifo_bad = FALSE;
+
+        if (value != NULL)
+            *value++ = '\0';
+        if (value != NULL && g_str_equal(parts[i], "cpus") && parse_cpus(value, &pr->cpus))
+        {
+            g_free(pr->cpus_spec);
+            pr->cpus_spec = g_strdup(value);
+            continue;
+        }
+        if (value != NULL && g_str_equal(parts[i], "nice"))
+        {
+            pr->nice = (gint)g_ascii_strtoll(value, &end, 10);
+            pr->has_nice = TRUE;
+        }
+        else if (value != NULL && g_str_equal(parts[i], "fifo"))
+        {
+            pr->fifo = (gint)g_ascii_strtoll(value, &end, 10);
+            // 0 在内部表示不修改调度策略，不能显式指定
+            fifo_bad = pr->fifo < 1 || pr->fifo > 99;
+        }
+        if (end == NULL || end == value || *end != '\0' || pr->nice < -20 || pr->nice > 19 || fifo_bad)
+        {
+            g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                        "Bad setting '%s' in thread policy '%s' (use cpus=LIST, nice=-20..19 or fifo=1..99)", parts[i], rule);
+            policy_rule_free(pr);
+            g_strfreev(parts);
+            return FALSE;
+        }
+    }
+    g_strfreev(parts);
+    g_ptr_array_add(tp->rules, pr);
+    return TRUE;
+}
+
+/* 查找规则：先找与元素名完全相同的，再找 "*" */
+static PolicyRule *
+find_rule(ThreadPolicy *tp, const gchar *element)
+{
+    PolicyRule *any = NULL;
+    guint i;
+
+    for (i = 0; i < tp->rules->len; i++)
+    {
+        PolicyRule *rule = g_ptr_array_index(tp->rules, i);
+
+        if (g_strcmp0(rule->element, element) == 0)
+            return rule;
+        if (g_str_equal(rule->element, "*"))
+            any = rule;
+    }
+    return any;
+}
+
+/* 对调用线程应用规则，返回实际生效（或失败）的描述 */
+static gchar *
+apply_rule(PolicyRule *rule, pid_t tid)
+{
+    GString *applied = g_string_new(NULL);
+    gint err;
+
+    if (rule == NULL)
+        return g_strdup("default");
+
+    if (rule->cpus_spec != NULL)
+    {
+        err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &rule->cpus);
+        g_string_append_printf(applied, "cpus=%s%s%s ", rule->cpus_spec, err ? "!" : "", err ? g_strerror(err) : "");
+    }
+    if (rule->has_nice)
+    {
+        // Linux 上 setpriority(PRIO_PROCESS, tid) 只影响这一个线程
+        err = setpriority(PRIO_PROCESS, tid, rule->nice) == 0 ? 0 : errno;
+        g_string_append_printf(applied, "nice=%d%s%s ", rule->nice, err ? "!" : "", err ? g_strerror(err) : "");
+    }
+    if (rule->fifo > 0)
+    {
+        struct sched_param param = {0};
+
+        param.sched_priority = rule->fifo;
+        err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0)
+            g_printerr("Could not switch %d to SCHED_FIFO %d: %s (needs CAP_SYS_NICE or RLIMIT_RTPRIO)\n",
+                       (gint)tid, rule->fifo, g_strerror(err));
+        g_string_append_printf(applied, "fifo=%d%s%s ", rule->fifo, err ? "!" : "", err ? g_strerror(err) : "");
+    }
+    if (applied->len > 0)
+        g_string_truncate(applied, applied->len - 1);
+    return g_string_free(applied, FALSE);
+}
+
+/* 在调用线程中：应用规则并记录起始的调度统计（接管 name） */
+static void
+thread_enter(ThreadPolicy *tp, const gchar *element, gchar *name)
+{
+    PolicyThread *thread = g_new0(PolicyThread, 1);
+
+    thread->name = name;
+    thread->tid = current_tid();
+    thread->applied = apply_rule(find_rule(tp, element), thread->tid);
+    read_schedstat(thread->tid, &thread->start_wait, &thread->start_slices);
+    thread->running = TRUE;
+
+    g_mutex_lock(&tp->lock);
+    g_ptr_array_add(tp->threads, thread);
+    g_mutex_unlock(&tp->lock);
+}
+
+/* 累加从 ENTER 到现在的等待时间，调用者持有 tp->lock */
+static void
+thread_update(PolicyThread *thread)
+{
+    guint64 wait, slices;
+
+    if (!thread->running || !read_schedstat(thread->tid, &wait, &slices))
+        return;
+    thread->wait += wait - thread->start_wait;
+    thread->slices += slices - thread->start_slices;
+    thread->start_wait = wait;
+    thread->start_slices = slices;
+}
+
+/**
+ * sync-message::stream-status 信号：与同步总线处理函数一样运行在发出消息的线程中，
+ * ENTER/LEAVE 都由流线程自己发出，所以可以直接修改 pthread_self() 的调度属性。
+ * 线程池中的线程可能被复用，再次 ENTER 时按新的元素名重新应用规则。
+ */
+static void
+stream_status_cb(GstBus *bus, GstMessage *msg, ThreadPolicy *tp)
+{
+    GstStreamStatusType type;
+    GstElement *owner;
+    pid_t tid;
+    guint i;
+
+    gst_message_parse_stream_status(msg, &type, &owner);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER)
+    {
+        thread_enter(tp, GST_OBJECT_NAME(owner),
+                     g_strdup_printf("%s:%s", GST_OBJECT_NAME(owner), GST_MESSAGE_SRC_NAME(msg)));
+    }
+    else if (type == GST_STREAM_STATUS_TYPE_LEAVE)
+    {
+        tid = current_tid();
+        g_mutex_lock(&tp->lock);
+        for (i = 0; i < tp->threads->len; i++)
+        {
+            PolicyThread *thread = g_ptr_array_index(tp->threads, i);
+
+            if (thread->running && thread->tid == tid)
+            {
+                thread_update(thread);
+                thread->running = FALSE;
+            }
+        }
+        g_mutex_unlock(&tp->lock);
+    }
+}
+
+void
+thread_policy_watch(ThreadPolicy *tp, GstElement *pipeline)
+{
+    tp->bus = gst_element_get_bus(pipeline);
+    gst_bus_enable_sync_message_emission(tp->bus);
+    tp->handler_id = g_signal_connect(tp->bus, "sync-message::stream-status", G_CALLBACK(stream_status_cb), tp);
+}
+
+void
+thread_policy_add_thread(ThreadPolicy *tp, const gchar *name)
+{
+    thread_enter(tp, name, g_strdup(name));
+}
+
+void
+thread_policy_print_summary(ThreadPolicy *tp)
+{
+    guint i;
+
+    g_mutex_lock(&tp->lock);
+    g_print("%-28s %7s %-28s %9s %13s %13s\n", "thread", "tid", "policy", "slices", "avg wait(us)", "total wait(ms)");
+    for (i = 0; i < tp->threads->len; i++)
+    {
+        PolicyThread *thread = g_ptr_array_index(tp->threads, i);
+
+        thread_update(thread);
+        // 平均每次被唤醒后在运行队列中等待的时间，就是这个线程的调度延迟
+        g_print("%-28s %7d %-28s %9" G_GUINT64_FORMAT " %13.1f %13.2f\n", thread->name, (gint)thread->tid, thread->applied,
+                thread->slices, thread->slices ? thread->wait / 1000.0 / thread->slices : 0.0, thread->wait / 1e6);
+    }
+    g_mutex_unlock(&tp->lock);
+}
+
+void
+thread_policy_free(ThreadPolicy *tp)
+{
+    if (tp->bus != NULL)
+    {
+        g_signal_handler_disconnect(tp->bus, tp->handler_id);
+        gst_bus_disable_sync_message_emission(tp->bus);
+        gst_object_unref(tp->bus);
+    }
+    g_ptr_array_free(tp->rules, TRUE);
+    g_ptr_array_free(tp->threads, TRUE);
+    g_mutex_clear(&tp->lock);
+    g_free(tp);
+}
@@ -0,0 +1,37 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include <gst/gst.h>
+
+/**
+ * 流线程的 CPU 亲和性与调度策略（Linux）
+ *
+ * 流线程由 GStreamer 在内部创建（每个 queue、每个 source 一个），应用拿不到线程句柄。
+ * 但线程进入循环之前会在自己的上下文中发出 STREAM_STATUS ENTER 消息，
+ * 这里通过总线的 sync-message 信号接收它（不占用 gst_bus_set_sync_handler()，可以与 bench_report 同时使用），
+ * 按消息所属元素的名字查找规则，对 pthread_self() 设置：
+ * - cpus=0,2-3     CPU 亲和性（pthread_setaffinity_np）
+ * - nice=N         nice 值（setpriority，Linux 上对单个线程生效）
+ * - fifo=PRIO      SCHED_FIFO 实时调度（需要 CAP_SYS_NICE 或 RLIMIT_RTPRIO，失败时只打印警告）
+ *
+ * 规则的格式为 ELEMENT:key=value[:key=value...]，ELEMENT 为 * 时匹配所有线程，例如：
+ *     --thread-policy=audio_queue:cpus=2:fifo=50 --thread-policy=video_queue:cpus=0-1:nice=10
+ *
+ * 同时从 /proc/thread-self/schedstat 记录每个线程在运行队列中等待的时间（调度延迟），
+ * 对比设置策略前后的汇总即可看出抖动是否减少。
+ */
+
+typedef struct _ThreadPolicy ThreadPolicy;
+
+ThreadPolicy *thread_policy_new(void);
+/* 加入一条规则，格式错误时返回 FALSE 并设置 error */
+gboolean thread_policy_add_rule(ThreadPolicy *tp, const gchar *rule, GError **error);
+/* 监听 pipeline 的流线程（必须在 PLAYING 之前调用） */
+void thread_policy_watch(ThreadPolicy *tp, GstElement *pipeline);
+/* 对调用线程应用名为 name 的规则并开始记录（应用自己创建的线程，例如生产者线程） */
+void thread_policy_add_thread(ThreadPolicy *tp, const gchar *name);
+/* 打印每个线程应用的策略和调度延迟（要在 pipeline 切换到 NULL 之前调用，否则流线程已经退出） */
+void thread_policy_print_summary(ThreadPolicy *tp);
+void thread_policy_free(ThreadPolicy *tp);
+
+#endif /* THREAD_POLICY_H */
@@ -0,0 +1,372 @@
+#include "waveform.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WAVEFORM_X86 1
+#endif
+
+/* 一个 chunk 的系数：块内每个采样相对于块起点状态的系数，以及推进一个块的矩阵 */
+struct _WaveformCoeffs
+{
+    gfloat pa[WAVEFORM_BLOCK]; /* scale * M^(k+1)[0][0] */
+    gfloat pb[WAVEFORM_BLOCK]; /* scale * M^(k+1)[0][1] */
+    gdouble s00, s01, s10, s11; /* M^BLOCK */
+    gdouble inv_freq;          /* 1 / freq，用于块尾的逐个采样递推 */
+    gfloat scale;              /* 输出缩放：S16 为 500，F32 为 500 / 32768 */
+};
+
+/* 把一个声道的 n 个采样（已缩放的 float）写入 out，a/b 为该声道的状态 */
+typedef void (*RenderFunc)(const WaveformCoeffs *co, gdouble *a, gdouble *b, gfloat *out, gint n);
+/* float -> S16：向零截断（与原始实现的 (gint16) 转换一致），超出范围时饱和，各个实现的结果相同 */
+typedef void (*ToS16Func)(const gfloat *in, gint16 *out, gint n);
+
+/* ################## 标量实现 ################## */
+
+/* 不足一个块的尾部：直接按原始递推计算（乘以 1/freq 代替除法） */
+static void
+render_tail(const WaveformCoeffs *co, gdouble *pa, gdouble *pb, gfloat *out, gint n)
+{
+    gdouble a = *pa, b = *pb;
+    gint i;
+
+    for (i = 0; i < n; i++)
+    {
+        a += b;
+        b -= a * co->inv_freq;
+        out[i] = (gfloat)(co->scale * a);
+    }
+    *pa = a;
+    *pb = b;
+}
+
+/* 用 M^BLOCK 把状态推进一个块 */
+static inline void
+advance_block(const WaveformCoeffs *co, gdouble *a, gdouble *b)
+{
+    gdouble na = co->s00 * *a + co->s01 * *b;
+    gdouble nb = co->s10 * *a + co->s11 * *b;
+    *a = na;
+    *b = nb;
+}
+
+static void
+render_scalar(const WaveformCoeffs *co, gdouble *pa, gdouble *pb, gfloat *out, gint n)
+{
+    gdouble a = *pa, b = *pb;
+    gint i = 0, k;
+
+    for (; i + WAVEFORM_BLOCK <= n; i += WAVEFORM_BLOCK)
+    {
+        gfloat fa = (gfloat)a, fb = (gfloat)b;
+        for (k = 0; k < WAVEFORM_BLOCK; k++) // 块内的采样互不依赖
+            out[i + k] = co->pa[k] * fa + co->pb[k] * fb;
+        advance_block(co, &a, &b);
+    }
+    render_tail(co, &a, &b, out + i, n - i);
+    *pa = a;
+    *pb = b;
+}
+
+static void
+to_s16_scalar(const gfloat *in, gint16 *out, gint n)
+{
+    gint i;
+
+    for (i = 0; i < n; i++)
+    {
+        gfloat v = in[i];
+
+        // 与 cvtt + packs 相同：超出范围时饱和（NaN 也得到 -32768），而不是 (gint16) 转换的未定义行为
+        if (v >= 32767.0f)
+            out[i] = G_MAXINT16;
+        else if (!(v > -32768.0f))
+            out[i] = G_MININT16;
+        else
+            out[i] = (gint16)v;
+    }
+}
+
+/* ################## SSE2 实现 ################## */
+#ifdef WAVEFORM_X86
+__attribute__((target("sse2"))) static void
+render_sse(const WaveformCoeffs *co, gdouble *pa, gdouble *pb, gfloat *out, gint n)
+{
+    gdouble a = *pa, b = *pb;
+    gint i = 0, k;
+
+    for (; i + WAVEFORM_BLOCK <= n; i += WAVEFORM_BLOCK)
+    {
+        __m128 va = _mm_set1_ps((gfloat)a);
+        __m128 vb = _mm_set1_ps((gfloat)b);
+        for (k = 0; k < WAVEFORM_BLOCK; k += 4)
+        {
+            __m128 x = _mm_mul_ps(_mm_loadu_ps(co->pa + k), va);
+            __m128 y = _mm_mul_ps(_mm_loadu_ps(co->pb + k), vb);
+            _mm_storeu_ps(out + i + k, _mm_add_ps(x, y));
+        }
+        advance_block(co, &a, &b);
+    }
+    render_tail(co, &a, &b, out + i, n - i);
+    *pa = a;
+    *pb = b;
+}
+
+__attribute__((target("sse2"))) static void
+to_s16_sse(const gfloat *in, gint16 *out, gint n)
+{
+    gint i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // cvtt: 截断取整；packs: 有符号饱和压缩为 16 位
+        __m128i lo = _mm_cvttps_epi32(_mm_loadu_ps(in + i));
+        __m128i hi = _mm_cvttps_epi32(_mm_loadu_ps(in + i + 4));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+    }
+    to_s16_scalar(in + i, out + i, n - i);
+}
+
+/* ################## AVX2 实现 ################## */
+__attribute__((target("avx2"))) static void
+render_avx2(const WaveformCoeffs *co, gdouble *pa, gdouble *pb, gfloat *out, gint n)
+{
+    gdouble a = *pa, b = *pb;
+    gint i = 0;
+    // 一个块正好是 4 个 AVX 向量，系数在整个 chunk 内不变，放在寄存器中
+    __m256 pa0 = _mm256_loadu_ps(co->pa), pa1 = _mm256_loadu_ps(co->pa + 8);
+    __m256 pa2 = _mm256_loadu_ps(co->pa + 16), pa3 = _mm256_loadu_ps(co->pa + 24);
+    __m256 pb0 = _mm256_loadu_ps(co->pb), pb1 = _mm256_loadu_ps(co->pb + 8);
+    __m256 pb2 = _mm256_loadu_ps(co->pb + 16), pb3 = _mm256_loadu_ps(co->pb + 24);
+
+    for (; i + WAVEFORM_BLOCK <= n; i += WAVEFORM_BLOCK)
+    {
+        __m256 va = _mm256_set1_ps((gfloat)a);
+        __m256 vb = _mm256_set1_ps((gfloat)b);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(pa0, va), _mm256_mul_ps(pb0, vb)));
+        _mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_mul_ps(pa1, va), _mm256_mul_ps(pb1, vb)));
+        _mm256_storeu_ps(out + i + 16, _mm256_add_ps(_mm256_mul_ps(pa2, va), _mm256_mul_ps(pb2, vb)));
+        _mm256_storeu_ps(out + i + 24, _mm256_add_ps(_mm256_mul_ps(pa3, va), _mm256_mul_ps(pb3, vb)));
+        advance_block(co, &a, &b);
+    }
+    render_tail(co, &a, &b, out + i, n - i);
+    *pa = a;
+    *pb = b;
+}
+
+__attribute__((target("avx2"))) static void
+to_s16_avx2(const gfloat *in, gint16 *out, gint n)
+{
+    gint i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i lo = _mm256_cvttps_epi32(_mm256_loadu_ps(in + i));
+        __m256i hi = _mm256_cvttps_epi32(_mm256_loadu_ps(in + i + 8));
+        // packs 在 128 位的两半内分别压缩，结果顺序为 lo0 hi0 lo1 hi1，用 permute 恢复为 lo0 lo1 hi0 hi1
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i *)(out + i), packed);
+    }
+    to_s16_sse(in + i, out + i, n - i);
+}
+#endif /* WAVEFORM_X86 */
+
+/* ################## 运行时分派 ################## */
+
+static const gchar *kernel_names[WAVEFORM_KERNEL_COUNT] = {"auto", "scalar", "sse", "avx2"};
+
+gboolean
+waveform_kernel_supported(WaveformKernel kernel)
+{
+    switch (kernel)
+    {
+    case WAVEFORM_KERNEL_AUTO:
+    case WAVEFORM_KERNEL_SCALAR:
+        return TRUE;
+#ifdef WAVEFORM_X86
+    case WAVEFORM_KERNEL_SSE:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case WAVEFORM_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+const gchar *
+waveform_kernel_name(WaveformKernel kernel)
+{
+    return kernel < WAVEFORM_KERNEL_COUNT ? kernel_names[kernel] : "unknown";
+}
+
+gboolean
+waveform_kernel_from_name(const gchar *name, WaveformKernel *kernel)
+{
+    gint i;
+
+    for (i = 0; i < WAVEFORM_KERNEL_COUNT; i++)
+    {
+        if (g_ascii_strcasecmp(name, kernel_names[i]) == 0)
+        {
+            *kernel = (WaveformKernel)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static RenderFunc
+get_render_func(WaveformKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef WAVEFORM_X86
+    case WAVEFORM_KERNEL_SSE:
+        return render_sse;
+    case WAVEFORM_KERNEL_AVX2:
+        return render_avx2;
+#endif
+    default:
+        return render_scalar;
+    }
+}
+
+static ToS16Func
+get_to_s16_func(WaveformKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef WAVEFORM_X86
+    case WAVEFORM_KERNEL_SSE:
+        return to_s16_sse;
+    case WAVEFORM_KERNEL_AVX2:
+        return to_s16_avx2;
+#endif
+    default:
+        return to_s16_scalar;
+    }
+}
+
+void
+waveform_init(Waveform *wf, gint channels, WaveformFormat format, WaveformKernel kernel)
+{
+    gint ch;
+
+    if (!waveform_kernel_supported(kernel))
+        kernel = WAVEFORM_KERNEL_AUTO;
+    if (kernel == WAVEFORM_KERNEL_AUTO)
+    {
+        kernel = WAVEFORM_KERNEL_SCALAR;
+        if (waveform_kernel_supported(WAVEFORM_KERNEL_SSE))
+            kernel = WAVEFORM_KERNEL_SSE;
+        if (waveform_kernel_supported(WAVEFORM_KERNEL_AVX2))
+            kernel = WAVEFORM_KERNEL_AVX2;
+    }
+
+    wf->channels = MAX(channels, 1);
+    wf->format = format;
+    wf->kernel = kernel;
+    wf->a = g_new0(gdouble, wf->channels);
+    wf->b = g_new0(gdouble, wf->channels);
+    for (ch = 0; ch < wf->channels; ch++)
+        wf->b[ch] = 1; // 与原始实现相同的初始状态
+    wf->c = 0;
+    wf->d = 1;
+    wf->co = g_new0(WaveformCoeffs, 1);
+    wf->scratch = g_new0(gfloat, WAVEFORM_SCRATCH);
+    wf->scratch16 = format == WAVEFORM_FORMAT_S16 && wf->channels > 1 ? g_new0(gint16, WAVEFORM_SCRATCH) : NULL;
+}
+
+void
+waveform_clear(Waveform *wf)
+{
+    g_free(wf->a);
+    g_free(wf->b);
+    g_free(wf->co);
+    g_free(wf->scratch);
+    g_free(wf->scratch16);
+    wf->a = wf->b = NULL;
+    wf->co = NULL;
+    wf->scratch = NULL;
+    wf->scratch16 = NULL;
+}
+
+/* 根据本 chunk 的频率计算系数：对单位向量 (1,0)、(0,1) 逐步应用 M，记录 a 分量 */
+static void
+compute_coeffs(WaveformCoeffs *co, gfloat freq, gfloat scale)
+{
+    gdouble inv = 1.0 / freq;
+    gdouble xa = 1, xb = 0, ya = 0, yb = 1;
+    gint k;
+
+    for (k = 0; k < WAVEFORM_BLOCK; k++)
+    {
+        xa += xb;
+        xb -= xa * inv;
+        ya += yb;
+        yb -= ya * inv;
+        co->pa[k] = (gfloat)(scale * xa);
+        co->pb[k] = (gfloat)(scale * ya);
+    }
+    co->s00 = xa;
+    co->s10 = xb;
+    co->s01 = ya;
+    co->s11 = yb;
+    co->inv_freq = inv;
+    co->scale = scale;
+}
+
+void
+waveform_fill(Waveform *wf, gpointer out, gint num_frames)
+{
+    RenderFunc render = get_render_func(wf->kernel);
+    ToS16Func to_s16 = get_to_s16_func(wf->kernel);
+    gint channels = wf->channels;
+    gint done, n, ch, i;
+    gfloat freq;
+
+    /* Generate some psychodelic waveforms */
+    // 频率扫描：与原始实现一样，每个 chunk 更新一次
+    wf->c += wf->d;
+    wf->d -= wf->c / 1000;
+    freq = 1100 + 1000 * wf->d;
+    compute_coeffs(wf->co, freq, wf->format == WAVEFORM_FORMAT_S16 ? 500.0f : 500.0f / 32768.0f);
+
+    // 单声道 F32：直接写入输出，不需要中间缓冲区
+    if (channels == 1 && wf->format == WAVEFORM_FORMAT_F32)
+    {
+        render(wf->co, &wf->a[0], &wf->b[0], (gfloat *)out, num_frames);
+        return;
+    }
+
+    // 其他情况：每个声道先生成到中间缓冲区，再转换格式并交错写入
+    for (done = 0; done < num_frames; done += n)
+    {
+        n = MIN(num_frames - done, WAVEFORM_SCRATCH);
+        for (ch = 0; ch < channels; ch++)
+        {
+            render(wf->co, &wf->a[ch], &wf->b[ch], wf->scratch, n);
+            if (wf->format == WAVEFORM_FORMAT_S16)
+            {
+                gint16 *dst = (gint16 *)out + (gsize)done * channels;
+                if (channels == 1)
+                    to_s16(wf->scratch, dst, n);
+                else
+                {
+                    // 先用（饱和的）转换函数转换整块，再交错写入
+                    to_s16(wf->scratch, wf->scratch16, n);
+                    for (i = 0; i < n; i++)
+                        dst[i * channels + ch] = wf->scratch16[i];
+                }
+            }
+            else
+            {
+                gfloat *dst = (gfloat *)out + (gsize)done * channels;
+                for (i = 0; i < n; i++)
+                    dst[i * channels + ch] = wf->scratch[i];
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <glib.h>
+
+/**
+ * "迷幻" 波形生成器（08 示例 push_data() 中的波形）
+ *
+ * 原始实现逐个采样计算递推：
+ *     a += b;
+ *     b -= a / freq;
+ *     out = 500 * a;
+ * 每个采样都依赖上一个采样，并且有一次浮点除法，无法向量化。
+ *
+ * 这个递推是一个线性变换：[a, b] <- M * [a, b]，其中 M = [[1, 1], [-1/f, 1 - 1/f]]。
+ * 在一个 chunk 内 freq 不变，所以可以预先算出 M^1 ... M^BLOCK 的第一行，
+ * 一个块（BLOCK 个采样）里的每个采样都只是块起点状态的线性组合：
+ *     out[k] = pa[k] * a + pb[k] * b
+ * 块内的采样互不依赖，可以用 SSE/AVX2 并行计算；块与块之间用 M^BLOCK 推进状态（double 精度，避免累积误差）。
+ */
+
+#define WAVEFORM_BLOCK 32    /* 每个块的采样数（AVX2 的 4 个向量） */
+#define WAVEFORM_SCRATCH 1024 /* 多声道/S16 输出时的中间缓冲区大小（采样数） */
+
+typedef enum
+{
+    WAVEFORM_FORMAT_S16, /* 与原始实现相同：(gint16)(500 * a) */
+    WAVEFORM_FORMAT_F32, /* 500 * a / 32768，与 S16 输出的听感相同 */
+} WaveformFormat;
+
+typedef enum
+{
+    WAVEFORM_KERNEL_AUTO,   /* 运行时选择当前 CPU 支持的最快实现 */
+    WAVEFORM_KERNEL_SCALAR, /* 纯 C 实现（所有平台） */
+    WAVEFORM_KERNEL_SSE,    /* SSE2，x86/x86_64 */
+    WAVEFORM_KERNEL_AVX2,   /* AVX2，x86/x86_64 */
+    WAVEFORM_KERNEL_COUNT
+} WaveformKernel;
+
+typedef struct _WaveformCoeffs WaveformCoeffs;
+
+typedef struct _Waveform
+{
+    gint channels;         /* 声道数，每个声道有独立的振荡器状态 */
+    WaveformFormat format; /* 输出格式（交错存储） */
+    WaveformKernel kernel; /* 实际使用的实现 */
+    gdouble *a, *b;        /* 每个声道的振荡器状态 */
+    gfloat c, d;           /* 频率扫描状态，所有声道共用，每个 chunk 更新一次 */
+    WaveformCoeffs *co;    /* 当前 chunk 的系数（SIMD 实现使用非对齐的 load/store，不要求对齐） */
+    gfloat *scratch;       /* 中间缓冲区 */
+    gint16 *scratch16;     /* 多声道 S16 输出时转换后、交错前的中间缓冲区 */
+} Waveform;
+
+/* 当前 CPU 是否支持某个实现 */
+gboolean waveform_kernel_supported(WaveformKernel kernel);
+const gchar *waveform_kernel_name(WaveformKernel kernel);
+/* 按名字查找实现（auto/scalar/sse/avx2），找不到返回 FALSE */
+gboolean waveform_kernel_from_name(const gchar *name, WaveformKernel *kernel);
+
+/* 初始化生成器，状态与原始实现相同（a = 0, b = 1, c = 0, d = 1）；不支持的 kernel 会退回到 AUTO */
+void waveform_init(Waveform *wf, gint channels, WaveformFormat format, WaveformKernel kernel);
+void waveform_clear(Waveform *wf);
+/* 生成一个 chunk：num_frames 帧交错存储的采样，写入 out */
+void waveform_fill(Waveform *wf, gpointer out, gint num_frames);
+
+#endif /* WAVEFORM_H */